@@ -0,0 +1,87 @@
+#pragma once
+
+#include "event_writer.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Collapses runs of accesses into one summary event per run (--coalesce).
+ *
+ * A run is a sequence of accesses by one thread to one variable from one instruction and call
+ * stack, seen under the same sampling ratio. It is reported when it has collected the maximum
+ * number of accesses or after a gap without one, as its first event carrying the last value, the
+ * access count and the duration; a run of a single access is reported unchanged. The load and
+ * the store of a read-modify-write loop come from different instructions and so form two runs
+ * side by side.
+ */
+class AccessCoalescer {
+public:
+    /** Gap ending a run when only a maximum count was given. */
+    static constexpr uint64_t DEFAULT_GAP = 10'000'000;
+
+    /** Accesses of a run between two pauses of its watchpoint: every HOT_RUN-th one makes it hot. */
+    static constexpr uint32_t HOT_RUN = 16;
+
+    /** Open runs kept at most; the most idle one is reported to make room. */
+    static constexpr size_t MAX_RUNS = 64;
+
+    /**
+     * @brief Creates a coalescer without open runs.
+     *
+     * @param maxEvents Accesses after which a run is reported, 0 for no limit.
+     * @param gap Nanoseconds without an access that end a run, 0 for DEFAULT_GAP.
+     */
+    AccessCoalescer(size_t maxEvents, uint64_t gap);
+
+    /**
+     * @brief Adds one access to its run, reporting the run if it is complete.
+     *
+     * @param event The access, with its IP and time.
+     * @param events Output pipeline for finished runs.
+     * @return true if the run has just become hot (another HOT_RUN accesses).
+     */
+    bool add(const WatchEvent& event, EventWriter& events);
+
+    /**
+     * @brief Reports the runs that have been idle for longer than the gap.
+     *
+     * @param now Current CLOCK_MONOTONIC time in nanoseconds.
+     * @param events Output pipeline.
+     */
+    void expire(uint64_t now, EventWriter& events);
+
+    /**
+     * @brief Keeps the runs of a thread's variable open until a given time and one gap beyond.
+     *
+     * Used while its watchpoint is paused, when the accesses cannot be seen.
+     */
+    void hold(int32_t tid, uint16_t varIndex, uint64_t until);
+
+    /** @brief Returns when the next run may expire, UINT64_MAX if none is open. */
+    [[nodiscard]] uint64_t nextExpiry() const;
+
+    /** @brief Reports every open run. */
+    void flush(EventWriter& events);
+
+    /** @brief Returns the number of open runs. */
+    [[nodiscard]] size_t size() const { return runs.size(); }
+
+private:
+    struct Run {
+        WatchEvent summary;       ///< First access, updated with the last value and the count
+        uint64_t lastTime = 0;    ///< Time of the latest access
+        uint64_t holdUntil = 0;   ///< End of a pause, which counts as an access
+
+        [[nodiscard]] uint64_t idleSince() const { return lastTime > holdUntil ? lastTime : holdUntil; }
+    };
+
+    /** Emits the run at the given index and removes it. */
+    void report(size_t index, EventWriter& events);
+
+    std::vector<Run> runs;
+    size_t maxEvents;
+    uint64_t gap;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "elf_utils.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Per-instruction access counters of the watched variables.
+ *
+ * A flat open-addressing hash table keyed by (IP, variable) with linear probing, so recording
+ * a trap costs a multiply, a probe and an increment.
+ */
+class AccessProfile {
+public:
+    /** Counters of one (IP, variable) pair. */
+    struct Entry {
+        uint64_t ip = 0;         ///< Instruction pointer, 0 marks an empty bucket
+        uint16_t varIndex = 0;   ///< Index of the variable in the watch list
+        uint64_t reads = 0;      ///< Accesses that left the value unchanged
+        uint64_t writes = 0;     ///< Accesses that wrote the variable
+
+        [[nodiscard]] uint64_t total() const { return reads + writes; }
+    };
+
+    /**
+     * @brief Creates an empty profile.
+     *
+     * @param capacity Initial number of buckets (rounded up to a power of two).
+     */
+    explicit AccessProfile(size_t capacity = 1024);
+
+    /**
+     * @brief Counts one access.
+     *
+     * @param ip Instruction pointer reported by the trap.
+     * @param varIndex Index of the accessed variable.
+     * @param write Whether the access wrote the variable.
+     * @param weight Accesses the access stands for when sampling.
+     */
+    void record(uint64_t ip, uint16_t varIndex, bool write, uint64_t weight = 1);
+
+    /** @brief Returns the number of distinct (IP, variable) pairs. */
+    [[nodiscard]] size_t size() const { return used; }
+
+    /**
+     * @brief Returns the busiest entries, most accesses first.
+     *
+     * @param count Maximum number of entries.
+     */
+    [[nodiscard]] std::vector<Entry> top(size_t count) const;
+
+private:
+    /** @brief Doubles the table and re-inserts every entry. */
+    void grow();
+
+    std::unique_ptr<Entry[]> buckets;
+    size_t mask;
+    size_t used = 0;
+};
+
+/**
+ * @brief Prints a hotspot table, resolving IPs to function+offset.
+ *
+ * @param out Destination stream.
+ * @param entries Rows to print, as returned by AccessProfile::top().
+ * @param names Variable names by index.
+ * @param functions Function symbols of the executable (see readFunctionSymbols).
+ * @param loadBias Difference between runtime and link-time addresses of the executable.
+ */
+void printProfile(std::ostream& out,
+                  const std::vector<AccessProfile::Entry>& entries,
+                  const std::vector<std::string>& names,
+                  const std::vector<FunctionSymbol>& functions,
+                  uintptr_t loadBias);
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <unordered_map>
+
+/**
+ * @brief int3 breakpoints planted in the code of one traced process (--only-in).
+ *
+ * A site is an entry breakpoint, kept until the process execs, and/or a return breakpoint,
+ * counted once per active call that returns there and removed with the last one. Sites
+ * are written through any stopped thread of the process, which shares its address space.
+ */
+class BreakpointSet {
+public:
+    /** One patched instruction. */
+    struct Site {
+        uint8_t original = 0;   ///< Byte the int3 replaced
+        bool entry = false;     ///< Entry of a scope function
+        uint32_t returns = 0;   ///< Active calls returning here
+    };
+
+    /**
+     * @brief Plants the entry breakpoint of a function.
+     *
+     * @param tid Stopped thread of the process.
+     * @param address Runtime address of the function.
+     * @throws std::runtime_error If the code cannot be patched.
+     */
+    void insertEntry(pid_t tid, uintptr_t address);
+
+    /**
+     * @brief Adds a call returning to an address, planting its breakpoint if needed.
+     *
+     * @param tid Stopped thread of the process.
+     * @param address Return address of the call.
+     * @throws std::runtime_error If the code cannot be patched.
+     */
+    void insertReturn(pid_t tid, uintptr_t address);
+
+    /**
+     * @brief Drops a call returning to an address, removing its breakpoint after the last one.
+     *
+     * @param tid Stopped thread of the process.
+     * @param address Return address of the call.
+     */
+    void releaseReturn(pid_t tid, uintptr_t address);
+
+    /** @brief Returns the site at an address, null if there is none. */
+    [[nodiscard]] const Site* find(uintptr_t address) const;
+
+    /** @brief Returns true if no breakpoint is planted. */
+    [[nodiscard]] bool empty() const { return sites.empty(); }
+
+    /**
+     * @brief Runs the original instruction at a site in a thread stopped on its int3.
+     *
+     * The thread's IP is moved back to the site, the original byte put back for one single
+     * step and the int3 planted again. Other threads run through the site unnoticed meanwhile.
+     *
+     * @param tid Thread stopped on the site's int3.
+     * @param address The site.
+     * @param deferredSignal Receives a signal that arrived meanwhile, see singleStep().
+     * @return false if the thread exited instead.
+     */
+    bool stepOver(pid_t tid, uintptr_t address, int& deferredSignal);
+
+    /**
+     * @brief Puts the original code of every site back, e.g. before detaching.
+     *
+     * The sites stay known to find(), so threads that trapped on one meanwhile can still be
+     * moved back to it.
+     */
+    void restoreCode(pid_t tid);
+
+    /** @brief Drops every site without touching the code, after exec replaced it. */
+    void forget() {
+        sites.clear();
+        planted = true;
+    }
+
+private:
+    std::unordered_map<uintptr_t, Site> sites;
+    bool planted = true;   ///< False once restoreCode() took the int3s out
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <pthread.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * One command of the --control protocol, a line of text:
+ *
+ *   add [--mode=write|rw|exec] <symbol>   watch a variable of the executable
+ *   remove <symbol>                      stop watching it
+ *   list                                 one line per watched variable
+ *   pause / resume                       disarm / re-arm every watchpoint
+ *   stats                                counters of the tracer
+ */
+struct ControlCommand {
+    enum class Kind { Add, Remove, List, Pause, Resume, Stats };
+
+    Kind kind = Kind::List;
+    std::string symbol;                    ///< Variable of add and remove
+    WatchMode mode = WatchMode::ReadWrite; ///< Accesses that trigger an added watchpoint
+};
+
+/**
+ * @brief Parses one command line.
+ *
+ * @param line The command, without its newline.
+ * @return The command.
+ * @throws std::invalid_argument If the line is not a valid command.
+ */
+ControlCommand parseControlCommand(const std::string& line);
+
+/**
+ * @brief Unix stream socket taking commands for a running tracer (--control).
+ *
+ * A server thread accepts one client at a time and reads newline-terminated commands. Each
+ * command is handed over to the tracer thread, which is woken through wakeTracer() so that a
+ * blocked waitpid() returns, and runs it between two stops. The reply, zero or more lines
+ * followed by "ok" or "error: <reason>", is written back once the tracer has answered.
+ */
+class ControlServer {
+public:
+    /**
+     * @brief Binds the socket and starts the server thread.
+     *
+     * A stale socket left at the path is replaced; the new one is only accessible to its owner.
+     *
+     * @param path File system path of the socket.
+     * @param tracer Thread that runs the commands.
+     * @throws std::runtime_error If the socket cannot be created.
+     */
+    ControlServer(const std::string& path, pthread_t tracer);
+
+    /** @brief Stops the server thread, failing a command still waiting, and removes the socket. */
+    ~ControlServer();
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    /** @brief Returns true if a command waits for the tracer; a cheap check for every loop. */
+    [[nodiscard]] bool pending() const { return waiting.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Takes the waiting command (tracer thread).
+     *
+     * @param line Receives the command line.
+     * @return false if there was none.
+     */
+    bool take(std::string& line);
+
+    /**
+     * @brief Answers the command taken last (tracer thread).
+     *
+     * @param reply Reply lines, each ending with a newline, including the final "ok" or "error:".
+     */
+    void answer(std::string reply);
+
+private:
+    enum class State { Idle, Waiting, Taken, Answered };
+
+    /** @brief Server thread body: accepts clients until the server stops. */
+    void serve();
+
+    /** @brief Reads and answers the commands of one client until it disconnects. */
+    void serveClient(int client);
+
+    /** @brief Hands a command to the tracer and waits for its reply. */
+    std::string dispatch(const std::string& line);
+
+    std::string path;                  ///< Socket path, removed on shutdown
+    pthread_t tracer;                  ///< Thread running the commands
+    int listener = -1;                 ///< Listening socket
+    int stopEvent = -1;                ///< eventfd that wakes the server thread on shutdown
+    std::mutex mutex;                  ///< Guards the fields below
+    std::condition_variable answered;  ///< Signalled when the tracer replied or the server stops
+    State state = State::Idle;
+    std::string command;               ///< Command waiting for the tracer
+    std::string reply;                 ///< Reply of the tracer
+    bool stopping = false;             ///< The server is shutting down
+    std::atomic<bool> waiting{false};  ///< state == Waiting, readable without the mutex
+    std::thread server;
+};
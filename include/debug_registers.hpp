@@ -0,0 +1,141 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <sys/types.h>
+
+/** Number of address debug registers (DR0–DR3) available on x86-64. */
+constexpr int DEBUG_SLOT_COUNT = 4;
+
+/**
+ * @brief Encodes a watch length in bytes into the DR7 LEN field.
+ *
+ * @param size Length in bytes (1, 2, 4 or 8).
+ * @return LEN bits for DR7, or -1 if the size cannot be watched by a single slot.
+ */
+long drLenCode(const size_t& size);
+
+/**
+ * @brief Encodes a watch mode into the DR7 RW field.
+ *
+ * @param mode Kind of access that should trigger the slot.
+ * @return RW bits for DR7.
+ */
+uint64_t drRwCode(WatchMode mode);
+
+/**
+ * @brief A naturally aligned piece of a range that one debug register can watch.
+ */
+struct WatchChunk {
+    uintptr_t address;  ///< Start, aligned to size
+    size_t size;        ///< 1, 2, 4 or 8 bytes
+};
+
+/**
+ * @brief Covers a range exactly with the fewest naturally aligned 1/2/4/8-byte chunks.
+ *
+ * Taking the largest aligned chunk that still fits at each position is optimal for
+ * power-of-two sizes, e.g. 13 bytes at 0x1003 become 1@0x1003 4@0x1004 8@0x1008.
+ *
+ * @param address Start of the range.
+ * @param size Length of the range in bytes.
+ * @return The chunks in address order.
+ */
+std::vector<WatchChunk> planChunks(uintptr_t address, size_t size);
+
+/**
+ * @brief Software copy of the debug register configuration of a thread.
+ *
+ * Slots are handed out in order DR0..DR3. The DR7 value is kept in sync with
+ * the allocated slots so that it can be written to any thread as-is.
+ */
+class DebugRegisterState {
+public:
+    /**
+     * @brief Allocates the first free slot and programs it for the given range.
+     *
+     * @param address Linear address to watch (must be aligned to size).
+     * @param size Length in bytes (1, 2, 4 or 8); ignored for WatchMode::Execute, which requires LEN=00.
+     * @param mode Kind of access that triggers the slot.
+     * @return Index of the allocated slot (0–3).
+     * @throws std::runtime_error If no slot is free or the range is not watchable.
+     */
+    int allocate(uintptr_t address, size_t size, WatchMode mode = WatchMode::ReadWrite);
+
+    /**
+     * @brief Programs a given slot for the given range, whether it was free or not.
+     *
+     * @param slot Slot to program (0–3).
+     * @param address Linear address to watch (must be aligned to size).
+     * @param size Length in bytes (1, 2, 4 or 8); ignored for WatchMode::Execute.
+     * @param mode Kind of access that triggers the slot.
+     * @throws std::runtime_error If the range is not watchable.
+     */
+    void assign(int slot, uintptr_t address, size_t size, WatchMode mode);
+
+    /** @brief Disables and frees the given slot. */
+    void release(int slot);
+
+    /** @brief Returns true if the slot is currently allocated (local or global enable bit set). */
+    [[nodiscard]] bool isUsed(int slot) const { return (dr7 & (0b11UL << (slot * 2))) != 0; }
+
+    /** @brief Returns the number of free slots. */
+    [[nodiscard]] int freeSlots() const;
+
+    /** @brief Points an allocated slot at another address of the same alignment. */
+    void setAddress(int slot, uintptr_t address) { addresses[slot] = address; }
+
+    /** @brief Returns the address programmed into the slot. */
+    [[nodiscard]] uintptr_t address(int slot) const { return addresses[slot]; }
+
+    /** @brief Returns the DR7 value matching the allocated slots. */
+    [[nodiscard]] uint64_t control() const { return dr7; }
+
+    /**
+     * @brief Reads the current DR0–DR3 and DR7 of a stopped thread.
+     *
+     * @param tid TID of the stopped, traced thread.
+     * @return The thread's configuration, suitable for restoring it with apply().
+     */
+    static DebugRegisterState capture(pid_t tid);
+
+    /**
+     * @brief Writes DR0–DR3 and DR7 into a stopped thread.
+     *
+     * @param tid TID of the stopped, traced thread.
+     */
+    void apply(pid_t tid) const;
+
+private:
+    std::array<uintptr_t, DEBUG_SLOT_COUNT> addresses{};  ///< DR0–DR3
+    uint64_t dr7 = 0;                                     ///< Matching DR7 value
+};
+
+/**
+ * @brief Decodes the B0–B3 bits of DR6.
+ *
+ * @param dr6 Raw DR6 value.
+ * @param slots Output array receiving the indices of the slots that fired.
+ * @return Number of entries written to slots.
+ */
+int decodeDr6(uint64_t dr6, std::array<int, DEBUG_SLOT_COUNT>& slots);
+
+/**
+ * @brief Reads DR6 of a stopped thread.
+ *
+ * @param tid TID of the stopped, traced thread.
+ * @return The DR6 value.
+ * @throws std::runtime_error If the read fails.
+ */
+uint64_t readDebugStatus(pid_t tid);
+
+/**
+ * @brief Clears DR6 of a stopped thread.
+ *
+ * @param tid TID of the stopped, traced thread.
+ */
+void clearDebugStatus(pid_t tid);
@@ -1,16 +1,60 @@
 #pragma once
 
+#include "types.hpp"
+#include "watch_backend.hpp"
+
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 #include <sys/types.h>
 
 /**
- * @brief The Debugger class runs a child process under ptrace and sets a hardware watchpoint
- * on a specified global variable. It logs reads and writes to the variable in the following format:
+ * @brief Rejects tracer settings that the backend cannot honour or that contradict each other.
+ *
+ * @param backend Backend that will do the tracing.
+ * @param options Tracer settings.
+ * @throws std::invalid_argument Naming the first offending option.
+ */
+void validateOptions(BackendKind backend, const TracerOptions& options);
+
+/**
+ * @brief Rejects a variable whose watch options the backend or the tracer settings cannot honour.
+ *
+ * @param var Variable to watch, with its symbol resolved as far as the executable allows.
+ * @param backend Backend that will do the tracing.
+ * @param options Tracer settings.
+ * @throws std::invalid_argument Naming the variable or the offending option.
+ */
+void validateVariable(const WatchedVariable& var, BackendKind backend, const TracerOptions& options);
+
+/**
+ * @brief Splits range variables into chunks that can each be watched on their own.
+ *
+ * A range is covered by the fewest naturally aligned 1/2/4/8-byte chunks (see planChunks()).
+ * If that many debug registers are still free after the plain variables (and the dynamic
+ * linker hook of library variables), each chunk gets its own register; otherwise every chunk
+ * is marked as guarded and watched through page protection, which costs two injected
+ * mprotect() calls and a single-step per fault but has no size limit. Chunks are named
+ * "<name>+<offset>", the first one keeps the variable's name.
+ *
+ * @param vars Variables as given on the command line.
+ * @param backend Backend that will watch them; only ptrace supports page protection.
+ * @return The variables with every range replaced by its chunks.
+ * @throws std::invalid_argument If a range is empty, needs page protection that the backend
+ *         cannot do, or has more chunks than events can address.
+ */
+std::vector<WatchedVariable> expandRanges(const std::vector<WatchedVariable>& vars, BackendKind backend);
+
+/**
+ * @brief The Debugger class runs a child process under ptrace and watches up to four global
+ * variables (one per debug register DR0–DR3) through a WatchBackend. With the default ptrace
+ * backend, threads created by the child are followed and armed as well, and reads and writes
+ * are logged, tagged with the TID of the accessing thread, in the following format:
  *
  * Example output:
- *   <symbol>    write    <old> -> <new>
- *   <symbol>    read     <value>
+ *   <symbol>    write    <old> -> <new>    tid=<tid>
+ *   <symbol>    read     <value>    tid=<tid>
  */
 class Debugger {
 public:
@@ -20,7 +64,7 @@ public:
      * @param programPath Path to the target executable.
      * @param varName Name of the global variable to watch (for logging purposes).
      * @param symbolOffset Offset of the symbol from the ELF symbol table (resolved at runtime).
-     * @param varSize Size of the variable in bytes (4 or 8).
+     * @param varSize Size of the variable in bytes (1, 2, 4 or 8).
      * @param execArgs Optional argv array to pass to execv in the child process.
      */
     Debugger(std::string programPath,
@@ -29,44 +73,97 @@ public:
              size_t varSize,
              char** execArgs);
 
+    /**
+     * @brief Constructs a Debugger watching several variables at once.
+     *
+     * @param programPath Path to the target executable.
+     * @param variables Variables to watch (name, symbol offset and size must be set).
+     * @param execArgs Optional argv array to pass to execv in the child process.
+     * @param backend Mechanism used to observe accesses.
+     * @param options Tracer settings.
+     */
+    Debugger(std::string programPath,
+             std::vector<WatchedVariable> variables,
+             char** execArgs,
+             BackendKind backend = BackendKind::Ptrace,
+             TracerOptions options = {});
+
+    /**
+     * @brief Constructs a Debugger that attaches to an already running process.
+     *
+     * @param attachPid PID of the process to attach to.
+     * @param variables Variables to watch (name, symbol offset and size must be set).
+     * @param backend Mechanism used to observe accesses.
+     * @param options Tracer settings.
+     */
+    Debugger(pid_t attachPid,
+             std::vector<WatchedVariable> variables,
+             BackendKind backend = BackendKind::Ptrace,
+             TracerOptions options = {});
+
     /** @brief Returns the path of the target program. */
     [[nodiscard]] std::string getProgramPath() const { return programPath; }
 
-    /** @brief Returns the name of the watched variable. */
-    [[nodiscard]] std::string getVarName() const { return varName; }
+    /** @brief Returns the name of the first watched variable. */
+    [[nodiscard]] std::string getVarName() const { return variables.front().name; }
+
+    /** @brief Returns the ELF symbol offset of the first watched variable. */
+    [[nodiscard]] uintptr_t getSymbolOffset() const { return variables.front().symbolOffset; }
+
+    /** @brief Returns the size in bytes of the first watched variable. */
+    [[nodiscard]] size_t getVarSize() const { return variables.front().size; }
 
-    /** @brief Returns the ELF symbol offset of the watched variable. */
-    [[nodiscard]] uintptr_t getSymbolOffset() const { return symbolOffset; }
+    /** @brief Returns the PID to attach to, or 0 when the target is launched. */
+    [[nodiscard]] pid_t getAttachPid() const { return attachPid; }
 
-    /** @brief Returns the size in bytes of the watched variable. */
-    [[nodiscard]] size_t getVarSize() const { return varSize; }
+    /** @brief Returns the backend used to observe accesses. */
+    [[nodiscard]] BackendKind getBackend() const { return backend; }
+
+    /** @brief Returns the tracer settings. */
+    [[nodiscard]] const TracerOptions& getOptions() const { return options; }
+
+    /** @brief Returns all watched variables. */
+    [[nodiscard]] const std::vector<WatchedVariable>& getVariables() const { return variables; }
 
     /**
-     * @brief Forks and execs the target process, sets the hardware watchpoint, and
-     * monitors the variable in the child process.
+     * @brief Launches (or attaches to) the target process, resolves the runtime addresses
+     * and hands the stopped process over to the selected backend.
+     *
+     * A launched target is armed at its exec event, before the first user instruction
+     * of the target (or of its dynamic linker) runs. On SIGINT/SIGTERM gwatch detaches
+     * and restores the debug registers, leaving the target running.
      */
     void run() const;
 
+    /**
+     * @brief Like run(), but hands the events to a given sink and installs no signal handler.
+     *
+     * The tracer detaches when requestDetach() is called from another thread.
+     *
+     * @param sink Consumer of the events, used on the writer thread; null for the text or
+     *        --record output run() writes.
+     */
+    void run(std::unique_ptr<EventSink> sink) const;
+
 private:
     /**
-     * @brief Main loop that applies the hardware watchpoint and logs variable accesses.
+     * @brief Forks the target and runs it under PTRACE_SEIZE up to its exec event.
      *
-     * @param pid PID of the traced child process.
-     * @param runtimeAddress Runtime memory address of the watched variable.
+     * @return The child, stopped at PTRACE_EVENT_EXEC.
      */
-    void watchVariable(pid_t pid, uintptr_t runtimeAddress) const;
+    Tracee launch() const;
 
     /**
-     * @brief Installs a hardware watchpoint using debug registers DR0–DR7.
+     * @brief Seizes and interrupts every thread listed in /proc/<pid>/task.
      *
-     * @param pid PID of the traced child process.
-     * @param runtimeAddress Runtime memory address of the variable to watch.
+     * @return The process with all its threads stopped.
      */
-    void setHardwareWatchpoint(pid_t pid, uintptr_t runtimeAddress) const;
-
-    std::string programPath;   ///< Path to the target executable
-    std::string varName;       ///< Name of the variable to watch
-    uintptr_t symbolOffset;    ///< ELF symbol offset
-    size_t varSize;            ///< Variable size in bytes
-    char** execArgs;           ///< Optional exec arguments
-};
\ No newline at end of file
+    Tracee attach() const;
+
+    std::string programPath;                 ///< Path to the target executable
+    std::vector<WatchedVariable> variables;  ///< Variables to watch
+    char** execArgs;                         ///< Optional exec arguments
+    BackendKind backend;                     ///< Mechanism used to observe accesses
+    pid_t attachPid = 0;                     ///< Process to attach to, 0 to launch programPath
+    TracerOptions options;                   ///< Tracer settings
+};
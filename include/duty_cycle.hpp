@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Duty cycle of the watchpoints that keeps the time the tracee is stopped within a budget
+ * (--overhead-budget).
+ *
+ * Watchpoints are armed for one WINDOW, then disarmed for as long as it takes to bring the time
+ * stopped during that window down to the budget's share of the whole cycle:
+ *
+ *   off = stopped / budget - armed
+ *
+ * A window that stayed within the budget is followed by the next one right away. Accesses seen in
+ * a window stand for that window and the pause before it, so each carries the ratio
+ * WINDOW / (pause + WINDOW) by which counts are scaled up.
+ */
+class DutyCycle {
+public:
+    /** Length of an armed window. */
+    static constexpr uint64_t WINDOW = 10'000'000;
+
+    /**
+     * Charged per stop on top of the time the tracer spends handling it, for the trap, the
+     * context switches and the waitpid() wake-up, which the tracer cannot time.
+     */
+    static constexpr uint64_t STOP_ALLOWANCE = 5'000;
+
+    /**
+     * @brief Starts with the watchpoints armed.
+     *
+     * @param budget Share of the time the tracee may spend stopped, in (0, 1).
+     * @param now Current CLOCK_MONOTONIC time in nanoseconds.
+     */
+    DutyCycle(double budget, uint64_t now);
+
+    /** @brief Adds the time the tracee spent stopped for one stop, STOP_ALLOWANCE included by the caller. */
+    void charge(uint64_t nanos) {
+        windowStopped += nanos;
+        totalStopped += nanos;
+    }
+
+    /**
+     * @brief Ends the window or the pause when it is due.
+     *
+     * @param now Current CLOCK_MONOTONIC time in nanoseconds.
+     * @return true if the watchpoints have to be armed or disarmed.
+     */
+    bool update(uint64_t now);
+
+    /** @brief Returns true while the watchpoints are armed. */
+    [[nodiscard]] bool armed() const { return isArmed; }
+
+    /** @brief Returns when update() will next change the state. */
+    [[nodiscard]] uint64_t nextChange() const { return isArmed ? windowStart + WINDOW : pauseEnd; }
+
+    /** @brief Returns the share of the cycle the current window stands for, 1 if nothing was skipped. */
+    [[nodiscard]] float ratio() const { return windowRatio; }
+
+    /** @brief Returns how long the watchpoints have been disarmed, 0 while they are armed. */
+    [[nodiscard]] uint64_t pausedFor(uint64_t now) const { return isArmed || now < windowStart ? 0 : now - windowStart; }
+
+    /** @brief Returns the time stopped so far as a share of the time elapsed since the start. */
+    [[nodiscard]] double overhead(uint64_t now) const;
+
+    /** @brief Returns the share of the time elapsed since the start the watchpoints were armed. */
+    [[nodiscard]] double armedShare(uint64_t now) const;
+
+private:
+    double budget;
+    uint64_t start;              ///< Creation time
+    uint64_t windowStart;        ///< Start of the current window, or of the pause
+    uint64_t pauseEnd = 0;       ///< End of the current pause
+    uint64_t windowStopped = 0;  ///< Stopped time charged since windowStart
+    uint64_t totalStopped = 0;   ///< Stopped time charged since the start
+    uint64_t totalArmed = 0;     ///< Length of the finished windows
+    float windowRatio = 1.0f;
+    bool isArmed = true;
+};
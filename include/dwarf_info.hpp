@@ -0,0 +1,163 @@
+#pragma once
+
+#include "symbol_index.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Location of a variable, struct field or array element described by DWARF.
+ */
+struct DwarfLocation {
+    std::string symbol;                     ///< Variable the expression starts from
+    uint64_t offset = 0;                    ///< Byte offset of the selected value inside the variable
+    size_t size = 0;                        ///< Size of the selected value in bytes
+    std::shared_ptr<const ValueType> type;  ///< Scalar type, null for aggregates
+};
+
+/**
+ * @brief Splits "config.limits.max_conns" or "table[17]" into its variable name.
+ *
+ * @param expression Variable name optionally followed by '.member' and '[index]' selectors.
+ * @return The leading variable name.
+ */
+std::string variableOfPath(const std::string& expression);
+
+/**
+ * @brief Returns true if the expression selects a member or element rather than a whole variable.
+ */
+bool isVariablePath(const std::string& expression);
+
+/**
+ * @brief Lazily parsed .debug_info of one binary (DWARF 2-5).
+ *
+ * Only unit headers are scanned up front. A unit's DIEs are decoded the first time a
+ * variable defined in it is looked up: .debug_pubnames/.debug_gnu_pubnames, when present,
+ * name the defining unit directly; otherwise units are decoded in order until the variable
+ * turns up. Split DWARF, type units and compressed sections are not supported.
+ */
+class DwarfInfo {
+public:
+    /**
+     * @brief Maps a binary and indexes its unit headers.
+     *
+     * @param path Path to the binary.
+     * @throws std::runtime_error If the file cannot be mapped or is not a 64-bit ELF.
+     */
+    explicit DwarfInfo(const std::string& path);
+
+    /** @brief Returns true if the binary carries .debug_info. */
+    [[nodiscard]] bool hasDebugInfo() const { return !info.empty(); }
+
+    /**
+     * @brief Resolves a variable expression to an offset, size and type.
+     *
+     * @param expression "var", "var.member", "var[3]", "var.items[2].count", ...
+     * @param location Output parameter receiving the result.
+     * @return false if no unit defines the variable.
+     * @throws std::invalid_argument If the expression is malformed or does not match the type
+     *         (unknown member, index out of bounds, bit-field, indexing through a pointer).
+     * @throws std::runtime_error If the debug information is malformed.
+     */
+    bool resolve(const std::string& expression, DwarfLocation& location);
+
+    /** @brief Returns the number of units decoded so far. */
+    [[nodiscard]] size_t parsedUnits() const;
+
+    /** @brief Returns the number of units in .debug_info. */
+    [[nodiscard]] size_t unitCount() const { return units.size(); }
+
+private:
+    /** One attribute specification of an abbreviation. */
+    struct AbbrevAttribute {
+        uint16_t name;
+        uint16_t form;
+        int64_t implicitConst;
+    };
+
+    struct Abbrev {
+        uint16_t tag = 0;
+        bool hasChildren = false;
+        std::vector<AbbrevAttribute> attributes;
+    };
+
+    using AbbrevTable = std::unordered_map<uint64_t, Abbrev>;
+
+    /** Decoded attribute; references are stored as .debug_info offsets. */
+    struct Attribute {
+        uint16_t name;
+        uint16_t form;
+        uint64_t value;          ///< Constant, offset, index or reference
+        std::string_view data;   ///< Inline string, block or expression
+    };
+
+    struct Die {
+        uint64_t offset;            ///< .debug_info offset
+        uint16_t tag;
+        uint32_t parent;            ///< Index of the parent DIE, NONE for the unit DIE
+        uint32_t nextSibling;       ///< Index of the next sibling, NONE for the last child
+        uint32_t firstAttribute;    ///< Index into Unit::attributes
+        uint32_t attributeCount;
+        bool hasChildren;
+    };
+
+    struct Unit {
+        uint64_t offset = 0;          ///< Offset of the unit header in .debug_info
+        uint64_t end = 0;             ///< Offset one past the unit
+        uint64_t dieOffset = 0;       ///< Offset of the unit DIE
+        uint64_t abbrevOffset = 0;
+        uint16_t version = 0;
+        uint8_t addressSize = 8;
+        uint8_t offsetSize = 4;       ///< 4 for 32-bit DWARF, 8 for 64-bit
+        bool parsed = false;
+        uint64_t strOffsetsBase = 0;  ///< DW_AT_str_offsets_base of the unit DIE
+        std::vector<Die> dies;        ///< In offset order
+        std::vector<Attribute> attributes;
+    };
+
+    /** A DIE in a given unit. */
+    struct DieRef {
+        uint32_t unit;
+        uint32_t index;
+    };
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    void scanUnits();
+    const AbbrevTable& abbrevTable(uint64_t offset);
+    void parseUnit(uint32_t unitIndex);
+    void indexVariables(uint32_t unitIndex);
+    bool findVariable(const std::string& name, DieRef& ref);
+    bool findInPubnames(std::string_view section, bool gnu, const std::string& name, uint64_t& unitOffset) const;
+
+    const Die& die(DieRef ref) const { return units[ref.unit].dies[ref.index]; }
+    const Attribute* attribute(DieRef ref, uint16_t name) const;
+    std::string_view stringOf(DieRef ref, const Attribute& attr) const;
+    std::string_view nameOf(DieRef ref) const;
+    bool referenceOf(DieRef ref, uint16_t name, DieRef& target);
+    bool typeOf(DieRef ref, DieRef& type);
+    uint32_t firstChild(DieRef ref) const;
+    DieRef dieAt(uint64_t offset);
+    DieRef stripQualifiers(DieRef type);
+    uint64_t sizeOf(DieRef type, uint32_t dimension = 0, int depth = 0);
+    bool arrayBounds(DieRef array, uint32_t dimension, uint64_t& count, uint32_t& dimensions);
+    bool findMember(DieRef type, std::string_view name, uint64_t& offset, DieRef& member, int depth = 0);
+    std::shared_ptr<const ValueType> valueType(DieRef type);
+
+    std::unique_ptr<ElfImage> image;
+    std::string_view info;        ///< .debug_info
+    std::string_view abbrev;      ///< .debug_abbrev
+    std::string_view str;         ///< .debug_str
+    std::string_view lineStr;     ///< .debug_line_str
+    std::string_view strOffsets;  ///< .debug_str_offsets
+    std::vector<Unit> units;      ///< In section order
+    std::unordered_map<uint64_t, AbbrevTable> abbrevTables;
+    std::unordered_map<std::string, DieRef> variables;  ///< Defined variables of the parsed units
+    size_t nextUnparsed = 0;      ///< Sequential scan position when there is no name index
+};
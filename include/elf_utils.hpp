@@ -2,10 +2,44 @@
 
 #include <string>
 #include <cstdint>
+#include <vector>
+
+/**
+ * @brief Function symbol of an ELF binary, at its link-time address.
+ */
+struct FunctionSymbol {
+    uintptr_t address;  ///< Symbol value
+    size_t size;        ///< Size in bytes
+    std::string name;   ///< Symbol name
+};
+
+/**
+ * @brief One symbol to resolve with findSymbolAddresses().
+ */
+struct SymbolLookup {
+    std::string name;        ///< Symbol to look up
+    uintptr_t address = 0;   ///< Symbol value, if found
+    size_t size = 0;         ///< Symbol size, if found
+    bool found = false;      ///< Whether the symbol was found
+    bool tls = false;        ///< Thread-local (STT_TLS): address is an offset into the TLS block
+};
+
+/**
+ * @brief Resolves several symbols of a binary(ELF) at once.
+ *
+ * Exported symbols are looked up through .gnu.hash or DT_HASH. Anything else goes through a
+ * hash index over .symtab, built in one pass and cached on disk by NT_GNU_BUILD_ID (see
+ * symbolCacheDirectory()), so repeated runs against the same build skip the scan entirely.
+ *
+ * @param path Path to the executable.
+ * @param symbols Symbols to resolve; address, size and found are filled in.
+ * @return true if the binary could be read, false otherwise.
+ */
+bool findSymbolAddresses(const std::string& path, std::vector<SymbolLookup>& symbols);
 
 /**
  * @brief Finds the address and size of a symbol in a binary(ELF).
- * This function parses the symbol table of the given binary to locate the specified symbol.
+ * Convenience wrapper around findSymbolAddresses() for a single symbol.
  *
  * @param path Path to the executable.
  * @param symbol Name of the symbol to search for.
@@ -14,3 +48,51 @@
  * @return true if the symbol was found successfully, false otherwise.
  */
 bool findSymbolAddress(const std::string& path, const std::string& symbol, uintptr_t& address, size_t& size);
+
+/**
+ * @brief Reads the entry point (e_entry) from the ELF header of a binary.
+ *
+ * @param path Path to the executable.
+ * @param entry Output parameter that will hold the link-time entry address.
+ * @return true if the header was read successfully, false otherwise.
+ */
+bool getEntryPoint(const std::string& path, uintptr_t& entry);
+
+/**
+ * @brief Reads the program interpreter (PT_INTERP) of a binary.
+ *
+ * @param path Path to the executable.
+ * @param interpreter Output parameter that will hold the interpreter path, e.g. the dynamic linker.
+ * @return true if the binary has an interpreter, false otherwise.
+ */
+bool getInterpreter(const std::string& path, std::string& interpreter);
+
+/**
+ * @brief Computes where the executable's TLS block starts relative to the thread pointer.
+ *
+ * On x86-64 (TLS variant II) the executable's block ends right below the thread pointer, so a
+ * thread-local symbol with value v lives at fs_base - offset + v in every thread.
+ *
+ * @param path Path to the executable.
+ * @param offset Output parameter receiving the distance from the block start up to the thread pointer.
+ * @return true if the binary has a PT_TLS segment, false otherwise.
+ */
+bool getTlsBlockOffset(const std::string& path, uintptr_t& offset);
+
+/**
+ * @brief Reads every function symbol of a binary from .symtab and .dynsym.
+ *
+ * @param path Path to the executable.
+ * @param functions Output vector, sorted by address with one entry per address.
+ * @return true if the binary was read successfully, false otherwise.
+ */
+bool readFunctionSymbols(const std::string& path, std::vector<FunctionSymbol>& functions);
+
+/**
+ * @brief Formats a link-time address as function+offset.
+ *
+ * @param functions Function symbols sorted by address (see readFunctionSymbols).
+ * @param address Link-time address to describe.
+ * @return "name+0xoff" if a function covers the address, the address in hex otherwise.
+ */
+std::string describeAddress(const std::vector<FunctionSymbol>& functions, uintptr_t address);
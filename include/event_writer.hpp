@@ -0,0 +1,193 @@
+#pragma once
+
+#include "spsc_ring.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Consumer of batches of events, called on the writer thread.
+ */
+class EventSink {
+public:
+    virtual ~EventSink() = default;
+
+    /**
+     * @brief Handles a batch of events in the order they were produced.
+     *
+     * @param events Events dequeued in one go.
+     */
+    virtual void consume(std::span<const WatchEvent> events) = 0;
+
+    /** @brief Pushes out anything buffered; called when the queue runs empty and on shutdown. */
+    virtual void flush() = 0;
+
+    /**
+     * @brief Appends a variable added while tracing (--control), before its first event.
+     *
+     * @param name Name of the variable, which gets the next index.
+     * @param type Value type, null for raw values.
+     */
+    virtual void addVariable([[maybe_unused]] const std::string& name, [[maybe_unused]] std::shared_ptr<const ValueType> type) {}
+};
+
+/**
+ * @brief Sink that formats events as text lines with std::to_chars and writes them in
+ * large write(2) batches:
+ *
+ *   <symbol>    write    <old> -> <new>    tid=<tid>
+ *   <symbol>    read     <value>    tid=<tid>
+ *   <symbol>    access    ip=<ip>    tid=<tid>    time=<ns>
+ *   <symbol>    exec    tid=<tid>
+ *
+ * A coalesced run (--coalesce) is the line of its first access, with the last value, followed by
+ * "    count=<n>    ip=<ip>    duration=<us>us" (the IP only where the line has none). An access
+ * seen while sampling (--overhead-budget) ends with "    sampled=<percent>%", and one with a
+ * call stack (--backtrace) with "    stack=#<id>".
+ *
+ * Values of variables with a known type are printed as that type (signed, floating point,
+ * true/false, enumerator name, hexadecimal pointer); the rest as unsigned decimals.
+ */
+class TextEventSink : public EventSink {
+public:
+    /**
+     * @brief Creates a sink writing to a file descriptor.
+     *
+     * @param names Variable names, indexed by WatchEvent::varIndex.
+     * @param fd Destination file descriptor (not owned).
+     * @param types Value types by variable index; missing or null entries print raw.
+     * @param showPid Append the process ID after the thread ID (several processes traced).
+     */
+    TextEventSink(std::vector<std::string> names, int fd,
+                  std::vector<std::shared_ptr<const ValueType>> types = {}, bool showPid = false);
+
+    void consume(std::span<const WatchEvent> events) override;
+    void flush() override;
+    void addVariable(const std::string& name, std::shared_ptr<const ValueType> type) override;
+
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+    static constexpr size_t MAX_LINE = 256;
+
+    /** Appends one value formatted according to the variable's type. */
+    char* appendValue(char* out, uint64_t value, uint16_t varIndex) const;
+
+    /** Appends "    tid=N", followed by "    pid=N" if requested. */
+    char* appendThread(char* out, const WatchEvent& event) const;
+
+    /** Appends the count, IP and duration of a coalesced run. */
+    static char* appendRun(char* out, const WatchEvent& event);
+
+    std::vector<std::string> names;    ///< Variable names by index
+    std::vector<std::shared_ptr<const ValueType>> types; ///< Value types by index
+    std::vector<size_t> lineBudget;    ///< Worst-case line length by index
+    int fd;                            ///< Output file descriptor
+    bool showPid;                      ///< Tag lines with the process ID
+    std::unique_ptr<char[]> buffer;    ///< Pending output
+    size_t used = 0;                   ///< Bytes pending in buffer
+};
+
+/**
+ * @brief Sink handing the events, unformatted, to a function (libgwatch embedding).
+ */
+class CallbackEventSink : public EventSink {
+public:
+    /**
+     * @brief Creates a sink calling a function with each batch.
+     *
+     * @param callback Called on the writer thread with the events of one batch.
+     */
+    explicit CallbackEventSink(std::function<void(std::span<const WatchEvent>)> callback)
+        : callback(std::move(callback)) {}
+
+    void consume(std::span<const WatchEvent> events) override { callback(events); }
+    void flush() override {}
+
+private:
+    std::function<void(std::span<const WatchEvent>)> callback;
+};
+
+/**
+ * @brief Asynchronous event pipeline: a bounded SPSC queue drained by a writer thread.
+ *
+ * The tracer thread only copies a WatchEvent into the queue; formatting and I/O happen
+ * on the writer thread, so output latency no longer adds to the time the tracee is stopped.
+ */
+class EventWriter {
+public:
+    /**
+     * @brief Starts the writer thread.
+     *
+     * @param sink Consumer of the events, used on the writer thread only.
+     * @param policy Behaviour when the queue is full.
+     * @param capacity Queue capacity in events (power of two).
+     */
+    EventWriter(std::unique_ptr<EventSink> sink, QueuePolicy policy, size_t capacity);
+
+    /** @brief Drains the queue and stops the writer thread. */
+    ~EventWriter();
+
+    EventWriter(const EventWriter&) = delete;
+    EventWriter& operator=(const EventWriter&) = delete;
+
+    /**
+     * @brief Enqueues an event (tracer thread only).
+     *
+     * @return false if the event was dropped because the queue is full.
+     */
+    bool emit(const WatchEvent& event) {
+        if (policy == QueuePolicy::Block) {
+            queue.push(event);
+            return true;
+        }
+        if (queue.tryPush(event))
+            return true;
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /** @brief Flushes every queued event and joins the writer thread. Idempotent. */
+    void close();
+
+    /** @brief Returns the number of events dropped under QueuePolicy::Drop. */
+    [[nodiscard]] uint64_t dropped() const { return droppedEvents.load(std::memory_order_relaxed); }
+
+    /** @brief Returns the current queue depth. */
+    [[nodiscard]] size_t depth() const { return queue.size(); }
+
+    /**
+     * @brief Adds a variable to the sink (tracer thread only).
+     *
+     * The sink sees it before any event emitted afterwards, which may then use its index.
+     *
+     * @param name Name of the variable.
+     * @param type Value type, null for raw values.
+     */
+    void declareVariable(std::string name, std::shared_ptr<const ValueType> type);
+
+private:
+    /** @brief Writer thread body. */
+    void drainLoop();
+
+    /** @brief Hands the declared variables to the sink (writer thread). */
+    void applyDeclarations();
+
+    std::unique_ptr<EventSink> sink;
+    QueuePolicy policy;
+    SpscRing<WatchEvent> queue;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> droppedEvents{0};
+    std::mutex declarationsMutex;        ///< Guards declarations
+    std::vector<std::pair<std::string, std::shared_ptr<const ValueType>>> declarations;
+    std::atomic<bool> declared{false};   ///< declarations is not empty
+    std::thread writer;
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "event_writer.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <pthread.h>
+#include <span>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+class DwarfInfo;
+
+/**
+ * @brief Embedding API of libgwatch: one target process and the variables watched in it.
+ *
+ * Watches are described by the same VariableSpec the command line fills in and resolved
+ * against the executable when they are added, so a missing symbol fails right away. A run
+ * launches or attaches to the target and delivers every access as a WatchEvent; nothing is
+ * formatted unless the caller asks for a text sink. An event's varIndex indexes variables(),
+ * where a range appears as its chunks.
+ *
+ * Example:
+ *   WatchSession session("./app");
+ *   session.addWatch(VariableSpec{ .symbol = "counter", .mode = WatchMode::Write });
+ *   session.run([](std::span<const WatchEvent> events) { ... });
+ *
+ * Tracing takes over SIGALRM of the host process to interrupt the tracer thread, and only one
+ * session can run at a time, since a process has one set of ptrace children to wait for.
+ */
+class WatchSession {
+public:
+    /** Receives batches of events on the writer thread, in the order they were produced. */
+    using EventCallback = std::function<void(std::span<const WatchEvent>)>;
+
+    /**
+     * @brief Creates a session that launches a program.
+     *
+     * @param programPath Path to the target executable.
+     * @param args argv of the target as passed to execvp; empty to run programPath alone.
+     * @param backend Mechanism used to observe accesses.
+     * @param options Tracer settings.
+     */
+    explicit WatchSession(std::string programPath, std::vector<std::string> args = {},
+                          BackendKind backend = BackendKind::Ptrace, TracerOptions options = {});
+
+    /**
+     * @brief Creates a session that attaches to a running process.
+     *
+     * @param attachPid PID of the process.
+     * @param backend Mechanism used to observe accesses.
+     * @param options Tracer settings.
+     */
+    explicit WatchSession(pid_t attachPid, BackendKind backend = BackendKind::Ptrace, TracerOptions options = {});
+
+    ~WatchSession();
+
+    WatchSession(const WatchSession&) = delete;
+    WatchSession& operator=(const WatchSession&) = delete;
+
+    /**
+     * @brief Resolves a variable and adds it to the watch list.
+     *
+     * @param spec Variable as on the command line: symbol, field path, library symbol or range.
+     * @return ID of the watch, for watch() and removeWatch().
+     * @throws std::invalid_argument If the variable cannot be found in the executable or watched by the backend.
+     * @throws std::runtime_error If the executable cannot be read or the session is running.
+     */
+    size_t addWatch(const VariableSpec& spec);
+
+    /**
+     * @brief Resolves several variables with one pass over the symbol tables.
+     *
+     * Nothing is added if one of them fails.
+     *
+     * @param specs Variables as on the command line.
+     * @return IDs of the watches, in the order of specs.
+     * @throws std::invalid_argument If a variable cannot be found in the executable or watched by the backend.
+     * @throws std::runtime_error If the executable cannot be read or the session is running.
+     */
+    std::vector<size_t> addWatches(std::span<const VariableSpec> specs);
+
+    /**
+     * @brief Removes a watch; the IDs of the others stay valid.
+     *
+     * @throws std::invalid_argument If there is no such watch.
+     * @throws std::runtime_error If the session is running.
+     */
+    void removeWatch(size_t id);
+
+    /**
+     * @brief Returns a resolved watch: link-time address, size and type of the variable.
+     *
+     * @throws std::invalid_argument If there is no such watch.
+     */
+    [[nodiscard]] const WatchedVariable& watch(size_t id) const;
+
+    /**
+     * @brief Returns the variables as the next run watches them, indexed by WatchEvent::varIndex.
+     *
+     * @throws std::invalid_argument If a range needs page protection the backend cannot do.
+     */
+    [[nodiscard]] std::vector<WatchedVariable> variables() const;
+
+    /**
+     * @brief Traces the target until it exits or stop() is called, passing events to a callback.
+     *
+     * @param onEvents Called on the writer thread with each batch of events.
+     * @throws std::invalid_argument If the watch list cannot be armed (none, or too many) or the options
+     *         of the session are not supported by its backend.
+     * @throws std::runtime_error If the target cannot be traced.
+     */
+    void run(EventCallback onEvents);
+
+    /**
+     * @brief Traces the target, passing events to a sink (see TextEventSink, TraceFileSink).
+     *
+     * @param sink Consumer of the events, used on the writer thread.
+     */
+    void run(std::unique_ptr<EventSink> sink);
+
+    /**
+     * @brief Traces the target as the gwatch command does: events printed to stdout or
+     * recorded to TracerOptions::recordPath, SIGINT and SIGTERM detaching.
+     */
+    void run();
+
+    /**
+     * @brief Makes a run on another thread, or the callback, detach and return.
+     *
+     * The target keeps running without its watchpoints. Returns at once; no effect when
+     * the session is not running.
+     */
+    void stop();
+
+private:
+    /** @brief Throws unless the watch list may change. */
+    void checkIdle() const;
+
+    /** @brief Runs the target with a sink; null for the default output. */
+    void trace(std::unique_ptr<EventSink> sink, bool defaultSignals);
+
+    /** @brief Returns the debug information of the executable, null if it has none. */
+    DwarfInfo* debugInfo();
+
+    std::string programPath;                          ///< Target executable
+    std::vector<std::string> args;                    ///< argv of a launched target
+    pid_t attachPid = 0;                              ///< Process to attach to, 0 to launch
+    BackendKind backend;                              ///< Mechanism used to observe accesses
+    TracerOptions options;                            ///< Tracer settings
+    std::vector<std::optional<WatchedVariable>> watches; ///< Watches by ID, empty once removed
+    std::unique_ptr<DwarfInfo> dwarf;                 ///< Debug information, opened on first use
+    bool dwarfTried = false;                          ///< Whether opening it was attempted
+
+    std::mutex stopMutex;                             ///< Orders stop() against the end of a run
+    std::atomic<bool> running{false};                 ///< A run is in progress
+    pthread_t tracer{};                               ///< Thread of the run in progress
+    std::thread interrupter;                          ///< Repeats the detach request until the run ends
+};
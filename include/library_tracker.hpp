@@ -0,0 +1,69 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Object in the dynamic linker's link map.
+ */
+struct LoadedObject {
+    std::string path;   ///< l_name as seen by the target (empty for the executable)
+    uintptr_t base;     ///< l_addr: load bias of the object
+};
+
+/**
+ * @brief Follows the dynamic linker's r_debug rendezvous of a traced process.
+ *
+ * The linker calls _dl_debug_state() after every change to its link map, with r_state set to
+ * RT_CONSISTENT once the change is complete. A breakpoint on hookAddress() therefore fires for
+ * every library mapped at startup or through dlopen(), before the library's constructors run.
+ */
+class LibraryTracker {
+public:
+    /**
+     * @brief Locates _r_debug and _dl_debug_state in the dynamic linker of a stopped process.
+     *
+     * Only the interpreter's hash table is consulted; no other library is read.
+     *
+     * @param pid Process ID of the target.
+     * @throws std::runtime_error If the target has no dynamic linker or it lacks the symbols.
+     */
+    explicit LibraryTracker(pid_t pid);
+
+    /** @brief Returns the runtime address of _dl_debug_state. */
+    [[nodiscard]] uintptr_t hookAddress() const { return hook; }
+
+    /**
+     * @brief Reads the link map if it is consistent.
+     *
+     * @param objects Output vector receiving the loaded objects in link-map order.
+     * @return false if the linker is in the middle of a change (or has not started yet).
+     */
+    bool loadedObjects(std::vector<LoadedObject>& objects) const;
+
+    /**
+     * @brief Returns the path under which the tracer can open a target path.
+     *
+     * @param targetPath Path as seen by the target, e.g. an l_name.
+     */
+    [[nodiscard]] std::string hostPath(const std::string& targetPath) const;
+
+private:
+    pid_t pid;               ///< Target process
+    uintptr_t rDebug = 0;    ///< Runtime address of _r_debug
+    uintptr_t hook = 0;      ///< Runtime address of _dl_debug_state
+};
+
+/**
+ * @brief Tells whether a loaded object is the library requested with --var lib:symbol.
+ *
+ * Matches the full path, the file name, or the file name with a version suffix
+ * ("libfoo.so" matches "/usr/lib/libfoo.so.1").
+ *
+ * @param request Library part of the --var argument.
+ * @param path Path of the loaded object.
+ */
+bool matchesLibrary(const std::string& request, const std::string& path);
@@ -1,9 +1,20 @@
 #pragma once
 
 #include <sys/types.h>
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string>
 
+/**
+ * @brief One contiguous range of the target's memory and the local buffer receiving it.
+ */
+struct MemoryRegion {
+    uintptr_t address;  ///< Address in the target process
+    size_t size;        ///< Number of bytes to read
+    void* buffer;       ///< Local destination, at least size bytes
+};
+
 /**
  * @brief Retrieves the base address of a loaded executable in a process.
  *
@@ -18,19 +29,83 @@
  */
 uintptr_t getBaseAddress(pid_t pid, const std::string& programPath);
 
+/**
+ * @brief Looks up an entry of the auxiliary vector of a process.
+ *
+ * @param pid Process ID of the target process.
+ * @param type Entry type (AT_*).
+ * @return The entry's value.
+ * @throws std::runtime_error If /proc/<pid>/auxv cannot be read or has no such entry.
+ */
+uintptr_t getAuxvValue(pid_t pid, unsigned long type);
+
+/**
+ * @brief Computes the load bias of the main executable of a process.
+ *
+ * The bias is the difference between the runtime entry point reported by the kernel
+ * in AT_ENTRY and the link-time entry point. It is valid as soon as the process has
+ * been exec'd, before its dynamic linker runs, and is zero for non-PIE executables.
+ *
+ * @param pid Process ID of the target process.
+ * @param elfEntry e_entry from the executable's ELF header.
+ * @return Value to add to link-time addresses (st_value) to get runtime addresses.
+ */
+uintptr_t getLoadBias(pid_t pid, uintptr_t elfEntry);
+
 /**
  * @brief Reads memory from a target process at a specific address.
  *
- * Uses `ptrace` to read data from another process's memory.
+ * Reads exactly size bytes and zero-extends them, so 1-, 2- and 4-byte variables
+ * never pick up neighbouring bytes.
  *
  * @param pid Process ID of the target process.
  * @param addr Address in the target process's memory to read from.
- * @param size Number of bytes to read.
+ * @param size Number of bytes to read (at most 8).
  * @return The value read from memory as a 64-bit integer.
- * @throws std::runtime_error If the read fails.
+ * @throws std::runtime_error If the read fails or size is larger than 8.
  */
 uint64_t readProcessMemory(const pid_t& pid, const uintptr_t& addr, const size_t& size);
 
+/**
+ * @brief Reads an arbitrary number of bytes from a target process.
+ *
+ * Uses `process_vm_readv` and falls back to word-wise `PTRACE_PEEKDATA` when the
+ * syscall is unavailable or not permitted, or the pages are protected against reads.
+ *
+ * @param pid Process ID of the target process.
+ * @param addr Address in the target process's memory to read from.
+ * @param buffer Local destination of at least size bytes.
+ * @param size Number of bytes to read.
+ * @throws std::runtime_error If the read fails.
+ */
+void readProcessMemory(const pid_t& pid, const uintptr_t& addr, void* buffer, const size_t& size);
+
+/**
+ * @brief Reads several regions of a target process with a single `process_vm_readv`.
+ *
+ * Regions that the vectored read could not complete are retried one by one with
+ * the PEEKDATA fallback.
+ *
+ * @param pid Process ID of the target process.
+ * @param regions Regions to read; each buffer receives its region's bytes.
+ * @throws std::runtime_error If any region cannot be read.
+ */
+void readProcessMemory(const pid_t& pid, std::span<const MemoryRegion> regions);
+
+/**
+ * @brief Reads as much of a range as is readable, with a single `process_vm_readv`.
+ *
+ * Stops at the first page that cannot be read instead of failing, e.g. past the top of a
+ * thread's stack. There is no PEEKDATA fallback.
+ *
+ * @param pid Process ID of the target process.
+ * @param addr Start of the range in the target process.
+ * @param buffer Local destination of at least size bytes.
+ * @param size Number of bytes to read at most.
+ * @return Number of bytes read, 0 if the first page cannot be read.
+ */
+size_t readProcessMemoryPrefix(const pid_t& pid, const uintptr_t& addr, void* buffer, const size_t& size);
+
 /**
  * @brief Resolves an absolute path for a given file or directory.
  *
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Watches address ranges through page protection instead of debug registers.
+ *
+ * The pages covering the ranges are made inaccessible (read-only when only writes matter)
+ * by injecting mprotect() into the tracee, so every access faults with SIGSEGV. The tracer
+ * restores the pages, single-steps the faulting instruction and protects them again.
+ * Faults on other data sharing the pages are stepped over the same way and filtered out
+ * by the caller using the fault address.
+ *
+ * Accesses made by the kernel on the target's behalf (e.g. read(2) into a guarded buffer)
+ * fail with EFAULT instead of faulting, and other threads are not guarded while one of
+ * them is being stepped.
+ */
+class PageGuard {
+public:
+    /**
+     * @brief Records the pages to guard and their current protections.
+     *
+     * @param pid Traced process.
+     * @param ranges Address ranges to guard as (address, size) pairs.
+     * @param writesOnly Fault on writes only instead of on every access.
+     * @throws std::runtime_error If a page is not mapped or /proc cannot be read.
+     */
+    PageGuard(pid_t pid, const std::vector<std::pair<uintptr_t, size_t>>& ranges, bool writesOnly);
+
+    /**
+     * @brief Revokes access to the guarded pages.
+     *
+     * @param tid Any stopped thread of the process, used to run mprotect().
+     * @param deferredSignal Receives a signal that arrived meanwhile, see singleStep().
+     * @throws std::runtime_error If mprotect() fails.
+     */
+    void protect(pid_t tid, int& deferredSignal);
+
+    /**
+     * @brief Gives the guarded pages back their original protections.
+     *
+     * @param tid Any stopped thread of the process, used to run mprotect().
+     * @param deferredSignal Receives a signal that arrived meanwhile, see singleStep().
+     * @throws std::runtime_error If mprotect() fails.
+     */
+    void unprotect(pid_t tid, int& deferredSignal);
+
+    /** @brief Returns true if the address lies in a guarded page. */
+    [[nodiscard]] bool covers(uintptr_t address) const;
+
+    /** @brief Returns true while the pages are protected. */
+    [[nodiscard]] bool active() const { return protectedNow; }
+
+    /** @brief Returns true if only writes fault (the pages stay readable). */
+    [[nodiscard]] bool writesOnly() const { return keepReadable; }
+
+    /** @brief Returns the number of guarded pages. */
+    [[nodiscard]] size_t pageCount() const;
+
+private:
+    /** Part of the guarded pages with one original protection. */
+    struct Segment {
+        uintptr_t start;
+        size_t length;
+        int originalProt;
+    };
+
+    void applyProtections(pid_t tid, bool guard, int& deferredSignal);
+
+    std::vector<Segment> segments;    ///< In address order
+    uintptr_t scratch = 0;            ///< Code borrowed for the injected system calls
+    bool keepReadable = false;        ///< Guard against writes only
+    bool protectedNow = false;        ///< Pages currently guarded
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "watch_backend.hpp"
+
+/**
+ * @brief Backend built on perf_event_open(PERF_TYPE_BREAKPOINT).
+ *
+ * The kernel records a sample (IP, TID, time) into an mmap'd ring buffer on every
+ * access, and the tracee is detached so it never stops. Samples carry no memory
+ * contents, so accesses are reported without values:
+ *
+ *   <symbol>    access    ip=<ip>    tid=<tid>    time=<ns>
+ */
+class PerfBackend : public WatchBackend {
+public:
+    explicit PerfBackend(const TracerOptions& options) : options(options) {}
+
+    void watch(const Tracee& tracee, std::vector<WatchedVariable>& vars, EventWriter& events) override;
+
+private:
+    TracerOptions options;    ///< Tracer settings
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Values a predicate can refer to, captured for one access.
+ */
+struct PredicateInput {
+    int64_t oldValue;   ///< `old`: value before the access
+    int64_t newValue;   ///< `new`: value after the access
+    int64_t tid;        ///< `tid`: accessing thread
+};
+
+/**
+ * @brief Condition on a watched access, compiled once into stack bytecode.
+ *
+ * Grammar (C precedence, all arithmetic on signed 64-bit integers):
+ *
+ *   expr    := and ('||' and)*
+ *   and     := cmp ('&&' cmp)*
+ *   cmp     := sum (('=='|'!='|'<'|'<='|'>'|'>=') sum)?
+ *   sum     := term (('+'|'-') term)*
+ *   term    := unary (('*'|'/'|'%') unary)*
+ *   unary   := ('!'|'-') unary | primary
+ *   primary := number | 'old' | 'new' | 'tid' | '(' expr ')'
+ *
+ * Numbers are decimal or 0x-prefixed hexadecimal. Division or modulo by zero yields 0,
+ * so evaluation never fails in the trap path.
+ */
+class Predicate {
+public:
+    /**
+     * @brief Parses an expression.
+     *
+     * @param source Expression text, e.g. "new > 1000 && new != old".
+     * @return The compiled predicate.
+     * @throws std::invalid_argument If the expression is malformed or too deeply nested.
+     */
+    static Predicate compile(const std::string& source);
+
+    /**
+     * @brief Evaluates the predicate; non-zero results count as true.
+     *
+     * @param input Values of the access being tested.
+     */
+    [[nodiscard]] bool evaluate(const PredicateInput& input) const;
+
+    /** @brief Returns the original expression text. */
+    [[nodiscard]] const std::string& source() const { return text; }
+
+    /** Maximum operand stack depth an expression may need. */
+    static constexpr size_t MAX_STACK = 32;
+
+    /** Maximum nesting of parentheses and unary operators, which the parser follows by recursion. */
+    static constexpr size_t MAX_NESTING = 64;
+
+private:
+    friend class PredicateParser;
+
+    enum class Op : uint8_t {
+        Push, LoadOld, LoadNew, LoadTid,
+        Add, Sub, Mul, Div, Mod, Neg, Not,
+        Eq, Ne, Lt, Le, Gt, Ge, And, Or
+    };
+
+    /** One bytecode instruction; operand is only used by Push. */
+    struct Instruction {
+        Op op;
+        int64_t operand;
+    };
+
+    std::string text;                      ///< Source expression
+    std::vector<Instruction> code;         ///< Postfix program
+};
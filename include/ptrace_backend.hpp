@@ -0,0 +1,368 @@
+#pragma once
+
+#include "access_coalescer.hpp"
+#include "access_profile.hpp"
+#include "breakpoints.hpp"
+#include "control_server.hpp"
+#include "debug_registers.hpp"
+#include "duty_cycle.hpp"
+#include "library_tracker.hpp"
+#include "page_guard.hpp"
+#include "stack_table.hpp"
+#include "tracer_stats.hpp"
+#include "watch_backend.hpp"
+
+#include <sys/user.h>
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * @brief Backend that stops the tracee on every access through ptrace and debug registers.
+ *
+ * Each trap is decoded from DR6 and the variable is re-read while the thread is stopped,
+ * which makes it possible to tell reads from writes and to report old and new values.
+ * With TracerOptions::followChildren every process forked by the target is traced too,
+ * each with its own copy of the watch state.
+ */
+class PtraceBackend : public WatchBackend {
+public:
+    explicit PtraceBackend(const TracerOptions& options) : options(options) {}
+
+    void watch(const Tracee& tracee, std::vector<WatchedVariable>& vars, EventWriter& events) override;
+
+private:
+    /**
+     * Tracer-side state of one traced process, indexed like the watch list.
+     *
+     * A forked child starts as a copy of its parent; an exec places the variables anew.
+     */
+    struct ProcessState {
+        std::vector<uintptr_t> addresses;  ///< Runtime address, the offset from fs_base if thread-local; 0 if absent
+        std::vector<uint64_t> lastValues;  ///< Last observed values (thread-local ones are kept per thread)
+        DebugRegisterState debugRegs;      ///< Configuration shared by the process' threads
+        std::optional<PageGuard> pageGuard;///< Page protection of guarded range chunks, if any
+        BreakpointSet breakpoints;         ///< int3s at the entries of --only-in functions and their return addresses
+    };
+
+    /** One active call of an --only-in function in a thread. */
+    struct ScopeFrame {
+        uintptr_t returnAddress;  ///< Where the call returns to
+        uintptr_t stackPointer;   ///< rsp once it has returned
+    };
+
+    /** Tracer-side state of one traced thread. */
+    struct ThreadState {
+        pid_t process = 0;              ///< Thread group the thread belongs to, 0 until looked up
+        uint32_t generation = 0;        ///< Configuration generation installed, 0 if never armed
+        DebugRegisterState original;    ///< Debug registers found on attach, restored on detach
+        int pendingSignal = 0;          ///< Signal held back during setup, delivered on the first resume
+        uintptr_t threadPointer = 0;    ///< fs_base once the thread has set up its TLS, 0 before
+        std::array<uint64_t, DEBUG_SLOT_COUNT> tlsValues{};  ///< Last values of thread-local variables, by slot
+        uint8_t pausedSlots = 0;        ///< Slots disarmed in this thread while their hot run is paused
+        std::vector<ScopeFrame> scope;  ///< Active calls of --only-in functions, outermost first
+        std::array<uint16_t, DEBUG_SLOT_COUNT> armedVars{};  ///< 1 + index of the variable each slot was armed for, 0 if none
+    };
+
+    /**
+     * @brief Main loop that logs variable accesses of every thread of the tracee.
+     *
+     * @param pid PID of the traced process.
+     * @param vars Variables with their runtime addresses resolved and slots assigned.
+     * @param events Output pipeline for the reported accesses.
+     */
+    void watchVariable(pid_t pid, std::vector<WatchedVariable>& vars, EventWriter& events);
+
+    /**
+     * @brief Reports one access of a watched variable.
+     *
+     * Write-only slots only trap on writes, so those are reported as writes even when the
+     * value did not change; read/write slots fall back to comparing values. Accesses failing
+     * the variable's condition only update its last value. In profile mode the access is
+     * counted against the current IP instead of being emitted through emitEvent().
+     *
+     * @param events Output pipeline.
+     * @param varIndex Index of the variable in the watch list.
+     * @param var The accessed variable.
+     * @param lastValue Last value of the variable, or of the thread's instance if it is thread-local; updated.
+     * @param currentValue Value read after the access.
+     * @param pid Process of the accessing thread.
+     * @param tid Stopped accessing thread.
+     * @return true if the access made its coalesced run hot, see emitEvent().
+     */
+    bool reportChange(EventWriter& events, uint16_t varIndex, const WatchedVariable& var, uint64_t& lastValue,
+                      uint64_t currentValue, pid_t pid, pid_t tid);
+
+    /**
+     * @brief Emits an event, or adds it to its run when coalescing.
+     *
+     * @param events Output pipeline.
+     * @param event The access; its IP is read from the stopped thread if missing and needed, and
+     *        its call stack is captured with --backtrace.
+     * @return true if the run has just become hot and its watchpoint may be paused.
+     */
+    bool emitEvent(EventWriter& events, WatchEvent& event);
+
+    /**
+     * @brief Captures the call stack of a stopped thread and interns it.
+     *
+     * One GETREGS gives the IP and the frame and stack pointers; one process_vm_readv copies
+     * the top of the stack that the frame-pointer walk may need for TracerOptions::backtraceDepth
+     * frames.
+     *
+     * @param tid Stopped thread.
+     * @param ip Receives the thread's instruction pointer.
+     * @return ID of the stack in the stack table.
+     */
+    uint32_t captureStack(pid_t tid, uint64_t& ip);
+
+    /**
+     * @brief Disarms a variable's slot in one thread for TracerOptions::coalescePause.
+     *
+     * The slot is re-armed by serviceTimers() through PTRACE_INTERRUPT; its run is held open
+     * meanwhile, so the accesses after the pause continue it.
+     *
+     * @param tid Stopped thread.
+     * @param state Its tracer-side state.
+     * @param var The variable of the hot run.
+     * @param vars All watched variables.
+     */
+    void pauseSlot(pid_t tid, ThreadState& state, const WatchedVariable& var, const std::vector<WatchedVariable>& vars);
+
+    /**
+     * @brief Re-arms paused slots, switches the duty cycle and reports idle runs that are due,
+     * then sets the wakeup for the next.
+     *
+     * @param events Output pipeline.
+     * @param now Current CLOCK_MONOTONIC time in nanoseconds.
+     */
+    void serviceTimers(EventWriter& events, uint64_t now);
+
+    /**
+     * @brief Assigns a debug register slot to every variable and arms all threads of the tracee.
+     *
+     * @param tracee The stopped target process and its threads.
+     * @param vars Variables to watch; their slot field is filled in.
+     */
+    void setHardwareWatchpoint(const Tracee& tracee, std::vector<WatchedVariable>& vars);
+
+    /**
+     * @brief Places shared library variables whose library is now in the link map.
+     *
+     * Looks up each pending variable in its library only, allocates a slot for it and reads
+     * its initial value. The threads still have to be re-armed by the caller.
+     *
+     * @param pid PID of the traced process.
+     * @param process Its tracer-side state.
+     * @param vars All watched variables.
+     * @return true if the debug register configuration changed.
+     */
+    bool resolveLibraries(pid_t pid, ProcessState& process, std::vector<WatchedVariable>& vars);
+
+    /**
+     * @brief Places the variables again after a process called exec.
+     *
+     * A new image of the watched executable keeps every variable at the same link-time
+     * address; another binary is searched for the variables by name and size. Library
+     * variables and page-guarded chunks are not followed into the new image.
+     *
+     * @param pid PID of the process, stopped in PTRACE_EVENT_EXEC.
+     * @param process Its tracer-side state, rebuilt.
+     * @param vars All watched variables.
+     */
+    void resolveAfterExec(pid_t pid, ProcessState& process, const std::vector<WatchedVariable>& vars);
+
+    /**
+     * @brief Plants the entry breakpoints of the --only-in functions in a process.
+     *
+     * @param pid PID of the stopped process.
+     * @param process Its tracer-side state.
+     * @param exePath Its executable, searched for the functions by name.
+     * @param loadBias Load bias of the executable.
+     * @param required Whether a missing function is an error rather than a warning.
+     * @throws std::runtime_error If a required function is missing or the code cannot be patched.
+     */
+    void placeScope(pid_t pid, ProcessState& process, const std::string& exePath, uintptr_t loadBias, bool required);
+
+    /**
+     * @brief Handles a thread stopped on an int3 of --only-in.
+     *
+     * An entry pushes the call with the return address on the stack and plants a breakpoint
+     * there; a return pops every call whose frame it has left (including ones unwound past by
+     * longjmp or exceptions). The watchpoints of the thread are armed while it is inside at
+     * least one call, then the original instruction is stepped over.
+     *
+     * @param tid Thread stopped on the int3.
+     * @param thread Its tracer-side state.
+     * @param process Its process' state.
+     * @param regs Registers of the thread, rip one past the int3.
+     * @param vars All watched variables.
+     * @param deferredSignal Receives a signal that arrived during the step.
+     * @return false if the thread exited during the step.
+     */
+    bool crossScope(pid_t tid, ThreadState& thread, ProcessState& process, const user_regs_struct& regs,
+                    const std::vector<WatchedVariable>& vars, int& deferredSignal);
+
+    /**
+     * @brief Takes the --only-in breakpoints out of a forked child that is not followed, and
+     * lets it go.
+     *
+     * @param child The new process, auto-attached by the fork event.
+     * @param parent Tracer-side state of its parent, whose breakpoints it inherited.
+     */
+    void releaseChild(pid_t child, const ProcessState& parent);
+
+    /**
+     * @brief Runs the command waiting on the --control socket and answers it.
+     *
+     * Called between stops, while every thread runs. Commands that change the watch list or
+     * pause the watchpoints take effect in each thread at the stop forced by rearmAll().
+     *
+     * @param vars All watched variables; add appends to them.
+     * @param events Output pipeline, told about added variables.
+     */
+    void runCommand(std::vector<WatchedVariable>& vars, EventWriter& events);
+
+    /**
+     * @brief Starts watching a variable of the executable in every traced process.
+     *
+     * The symbol is looked up in each process' image and given a debug register that is free
+     * in all of them. Nothing changes if it is missing from every process or cannot be watched.
+     *
+     * @param command The add command.
+     * @param vars All watched variables; the new one is appended.
+     * @param events Output pipeline, told about the new variable.
+     * @return Reply lines of the command.
+     * @throws std::runtime_error If the variable cannot be watched.
+     */
+    std::string addWatch(const ControlCommand& command, std::vector<WatchedVariable>& vars, EventWriter& events);
+
+    /**
+     * @brief Stops watching a variable in every traced process; its index stays taken.
+     *
+     * @param command The remove command.
+     * @param vars All watched variables.
+     * @throws std::runtime_error If the variable is not watched or is guarded by page protection.
+     */
+    void removeWatch(const ControlCommand& command, std::vector<WatchedVariable>& vars);
+
+    /**
+     * @brief Makes every thread take the current configuration: bumps the generation and
+     * interrupts them all, so each is re-armed at its next stop.
+     */
+    void rearmAll();
+
+    /**
+     * @brief Writes the --stats file with the totals of the run so far.
+     *
+     * @param events Output pipeline, for the dropped events.
+     */
+    void writeStats(const EventWriter& events) const;
+
+    /**
+     * @brief Finds the process of a thread seen for the first time.
+     *
+     * A forked child may report its first stop before its parent's fork event: it then
+     * starts as a copy of the parent's state.
+     *
+     * @param tid The new thread.
+     * @return Its thread group ID, with an entry in processes.
+     */
+    pid_t processOf(pid_t tid);
+
+    /**
+     * @brief Locates the thread's instances of the thread-local variables.
+     *
+     * Reads fs_base; once the thread has installed its thread pointer, records it, reads the
+     * initial values and prints the addresses. The thread still has to be re-armed by the caller.
+     *
+     * @param tid Stopped thread.
+     * @param state The thread's tracer-side state.
+     * @param vars All watched variables.
+     */
+    void resolveThreadPointer(pid_t tid, ThreadState& state, const std::vector<WatchedVariable>& vars);
+
+    /**
+     * @brief Returns the ptrace request that resumes a thread.
+     *
+     * Threads whose TLS is not set up yet run under PTRACE_SYSCALL, so the system call that
+     * installs the thread pointer is seen before any code can touch a thread-local variable.
+     */
+    [[nodiscard]] int resumeRequest(const ThreadState& state) const;
+
+    /**
+     * @brief Handles a thread stopped on a SIGSEGV caused by the page guard.
+     *
+     * Steps the faulting instruction with the pages unprotected, then compares the guarded
+     * chunks around the fault address with their last values: changed chunks are reported as
+     * writes, an unchanged chunk at the fault address as a read. Faults on neighbouring data
+     * are stepped over silently. The thread is left stopped; the SIGSEGV is discarded.
+     *
+     * @param tid Thread in the SIGSEGV signal-delivery-stop.
+     * @param pid Its process, which has a page guard.
+     * @param address Fault address from the signal information.
+     * @param vars All watched variables.
+     * @param events Output pipeline.
+     * @param dr6 Receives the debug status of the step, for debug register hits of the same instruction.
+     * @param deferredSignal Receives a signal that arrived during the step and must be delivered.
+     * @return false if the thread exited while being stepped.
+     */
+    bool handleGuardFault(pid_t tid, pid_t pid, uintptr_t address, std::vector<WatchedVariable>& vars, EventWriter& events,
+                          uint64_t& dr6, int& deferredSignal);
+
+    /**
+     * @brief Installs the debug register configuration of its process into a stopped thread.
+     *
+     * Thread-local slots are pointed at the thread's own instance, or left disabled while the
+     * thread has no thread pointer yet. Paused slots, and every watch slot while the duty
+     * cycle is off, --control paused them or the thread is outside the --only-in functions,
+     * stay disabled. DR6 is cleared: a trap still pending in it must have been decoded first.
+     *
+     * @param tid TID of the stopped thread.
+     * @param state Tracer-side state of the thread.
+     * @param vars All watched variables.
+     */
+    void armThread(pid_t tid, ThreadState& state, const std::vector<WatchedVariable>& vars) const;
+
+    /**
+     * @brief Stops every thread, restores its original debug registers and detaches from it.
+     *
+     * Used when the user interrupts gwatch: the target keeps running without any
+     * watchpoint left behind.
+     */
+    void detachAll();
+
+    TracerOptions options;                             ///< Tracer settings
+    pid_t rootPid = 0;                                 ///< Process gwatch was started on
+    dev_t imageDevice = 0;                             ///< Device of the root's executable, to recognise it after exec
+    ino_t imageInode = 0;                              ///< Inode of the root's executable
+    uint32_t generation = 1;                           ///< Bumped whenever a process' debugRegs change
+    std::unique_ptr<LibraryTracker> libraries;         ///< Link-map tracking of the root process, if library variables are watched
+    int hookSlot = -1;                                 ///< Slot of the dynamic linker hook, -1 if none
+    std::vector<WatchedVariable*> guardedVars;         ///< Guarded chunks in address order (the same in forked children)
+    std::vector<WatchedVariable*> tlsVars;             ///< Thread-local variables, armed per thread
+    std::unordered_map<pid_t, ProcessState> processes; ///< Traced processes by PID
+    std::unordered_map<pid_t, ThreadState> threads;    ///< Traced threads by TID
+    AccessProfile profile;                             ///< Per-IP counters in profile mode
+    std::optional<AccessCoalescer> coalescer;          ///< Open runs when coalescing
+    std::deque<std::pair<uint64_t, pid_t>> pauses;     ///< Re-arm time and thread of each pause, in time order
+    uint64_t wakeupAt = 0;                             ///< Time the wakeup timer is set to, 0 if unset
+    std::optional<DutyCycle> dutyCycle;                ///< Armed and disarmed windows under an overhead budget
+    std::vector<double> estimates;                     ///< Accesses per variable scaled by the sampling ratio
+    std::vector<uint64_t> windowAccesses;              ///< Accesses per variable seen in the latest armed window
+    uint64_t stopReported = 0;                         ///< When waitpid() reported the stop being handled
+    std::optional<StackTable> stacks;                  ///< Interned call stacks of the events with --backtrace
+    std::vector<uint8_t> stackWindow;                  ///< Copy of the top of the stack being walked
+    std::vector<uint64_t> stackFrames;                 ///< Frames of the stack being walked
+    std::optional<ControlServer> control;              ///< Command socket with --control
+    bool paused = false;                               ///< Watchpoints disarmed by the pause command
+    std::vector<uint64_t> accessCounts;                ///< Accesses seen per variable, for list and stats
+    uint64_t stopCount = 0;                            ///< Stops reported by waitpid(), for stats
+    std::optional<TracerStats> stats;                  ///< Cost of tracing with --stats
+    uint64_t requestsAtStart = 0;                      ///< ptraceRequestCount() when tracing started
+    uint64_t requestsAtStop = 0;                       ///< ptraceRequestCount() when the stop being handled was reported
+    bool trapStop = false;                             ///< The stop being handled is a watchpoint trap
+};
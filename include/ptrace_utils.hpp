@@ -0,0 +1,127 @@
+#pragma once
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <initializer_list>
+
+/**
+ * @brief Issues a ptrace request and throws if it fails.
+ *
+ * @param request ptrace request (PTRACE_*).
+ * @param pid PID/TID of the traced thread.
+ * @param addr Request specific address argument.
+ * @param data Request specific data argument.
+ * @param errMsg Message prefix used for the exception.
+ * @throws std::runtime_error If ptrace returns -1 with errno set.
+ */
+void ptraceChecked(int request, const pid_t& pid, void* addr, void* data, const char* errMsg);
+
+/**
+ * @brief Issues a ptrace request, counted in ptraceRequestCount().
+ *
+ * @return The result of ptrace(), with errno set by it.
+ */
+long ptraceRequest(int request, pid_t pid, void* addr, void* data);
+
+/** @brief Returns the number of ptrace requests the calling thread has issued (--stats). */
+uint64_t ptraceRequestCount();
+
+/**
+ * @brief Resumes a stopped thread, tolerating threads that have just been killed.
+ *
+ * A thread sitting in a ptrace-stop can disappear under us (e.g. exit_group() from
+ * another thread); ESRCH is therefore not an error here.
+ *
+ * @param request PTRACE_CONT, PTRACE_LISTEN or PTRACE_SINGLESTEP.
+ * @param tid TID of the stopped thread.
+ * @param sig Signal to deliver, 0 for none.
+ * @throws std::runtime_error If ptrace fails for another reason.
+ */
+void resumeThread(int request, pid_t tid, int sig);
+
+/**
+ * @brief Executes exactly one instruction of a stopped thread and waits for the trap.
+ *
+ * Other stops of the thread on the way (interrupts, group-stops) are stepped again. A signal
+ * arriving meanwhile is held back in deferredSignal so the caller can deliver it on resume.
+ *
+ * @param tid TID of the stopped thread.
+ * @param deferredSignal Receives a signal that must still be delivered, left untouched otherwise.
+ * @return false if the thread exited instead.
+ * @throws std::runtime_error If ptrace or waitpid fails.
+ */
+bool singleStep(pid_t tid, int& deferredSignal);
+
+/**
+ * @brief Makes a stopped thread execute one system call on the tracer's behalf.
+ *
+ * The registers and the code word at scratch are saved, a `syscall` instruction is written
+ * there and single-stepped with the given arguments, then code and registers are restored.
+ * scratch must be code that no other thread runs meanwhile, e.g. the executable's entry point.
+ *
+ * @param tid TID of the stopped thread.
+ * @param scratch Address of at least two bytes of code to borrow.
+ * @param number System call number.
+ * @param args Up to six arguments.
+ * @param deferredSignal Receives a signal that arrived meanwhile, see singleStep().
+ * @return The raw return value: negative errno on failure.
+ * @throws std::runtime_error If the thread cannot be controlled or exits.
+ */
+long injectSyscall(pid_t tid, uintptr_t scratch, long number, std::initializer_list<uint64_t> args, int& deferredSignal);
+
+/**
+ * @brief Installs the SIGINT/SIGTERM handler that asks the tracer to detach.
+ *
+ * The handler is installed without SA_RESTART, so a tracer blocked in waitpid()
+ * or poll() returns with EINTR and can check detachRequested().
+ */
+void installDetachHandler();
+
+/** @brief Returns true once SIGINT or SIGTERM has been received, or requestDetach() called. */
+bool detachRequested();
+
+/**
+ * @brief Installs the SIGUSR1 handler that asks the tracer to write its statistics (--stats).
+ *
+ * A SIGUSR1 delivered to another thread of gwatch is passed on to the tracer thread; the
+ * handler has no SA_RESTART, so a blocked waitpid() or poll() returns with EINTR.
+ *
+ * @param tracer Thread running the backend.
+ */
+void installStatsHandler(pthread_t tracer);
+
+/** @brief Returns true once per SIGUSR1 received since the last call. */
+bool statsRequested();
+
+/**
+ * @brief Interrupts a tracer thread blocked in waitpid() or poll().
+ *
+ * The thread is sent SIGALRM, handled without SA_RESTART, so the call returns EINTR. A
+ * signal that lands just before the tracer blocks is lost, so callers repeat it until the
+ * tracer has seen their request.
+ *
+ * @param tracer Thread running the backend.
+ */
+void wakeTracer(pthread_t tracer);
+
+/**
+ * @brief Asks a tracer running on another thread to detach, as SIGINT does for gwatch.
+ *
+ * @param tracer Thread running the backend, woken with wakeTracer().
+ */
+void requestDetach(pthread_t tracer);
+
+/** @brief Forgets an earlier detach request, before a new target is traced. */
+void clearDetachRequest();
+
+/**
+ * @brief Interrupts the tracer thread at a given time, so a blocked waitpid() returns EINTR.
+ *
+ * A timer created for the calling thread on its first call sends it SIGALRM, handled without
+ * SA_RESTART. Each call replaces the previous time; other threads never see the signal.
+ *
+ * @param deadline Absolute CLOCK_MONOTONIC time in nanoseconds, 0 to cancel.
+ */
+void scheduleWakeup(uint64_t deadline);
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+/**
+ * @brief Bounded lock-free single-producer/single-consumer ring buffer.
+ *
+ * The producer only writes tail and the consumer only writes head; both indices grow
+ * monotonically and are masked into the power-of-two storage. Either side can block on
+ * the other through std::atomic::wait on a wake-up counter, and is only notified when it
+ * announced that it sleeps, so the fast path never makes a syscall.
+ *
+ * @tparam T Trivially copyable element type.
+ */
+template <typename T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable_v<T>, "SpscRing elements must be trivially copyable");
+
+public:
+    /**
+     * @brief Creates a ring with the given capacity.
+     *
+     * @param capacity Number of elements; must be a power of two.
+     */
+    explicit SpscRing(size_t capacity)
+        : mask(capacity - 1), slots(std::make_unique<T[]>(capacity)) {
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+            throw std::invalid_argument("SpscRing capacity must be a power of two");
+    }
+
+    /** @brief Returns the number of elements the ring can hold. */
+    [[nodiscard]] size_t capacity() const { return mask + 1; }
+
+    /** @brief Returns the number of queued elements (approximate when called concurrently). */
+    [[nodiscard]] size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Appends an element if there is room (producer side).
+     *
+     * @return false if the ring is full.
+     */
+    bool tryPush(const T& value) {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask)
+                return false;
+        }
+
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_seq_cst);
+        if (consumerSleeping.load(std::memory_order_seq_cst))
+            signal(consumerWakeups);
+        return true;
+    }
+
+    /**
+     * @brief Appends an element, sleeping while the ring is full (producer side).
+     */
+    void push(const T& value) {
+        while (!tryPush(value)) {
+            const uint32_t observed = producerWakeups.load(std::memory_order_seq_cst);
+            producerSleeping.store(true, std::memory_order_seq_cst);
+            if (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_seq_cst) > mask)
+                producerWakeups.wait(observed, std::memory_order_seq_cst);
+            producerSleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Removes up to max elements into out (consumer side).
+     *
+     * @return Number of elements copied.
+     */
+    size_t popBatch(T* out, size_t max) {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        const uint64_t t = tail.load(std::memory_order_acquire);
+        size_t count = static_cast<size_t>(t - h);
+        if (count > max)
+            count = max;
+
+        for (size_t i = 0; i < count; ++i)
+            out[i] = slots[(h + i) & mask];
+
+        if (count > 0) {
+            head.store(h + count, std::memory_order_seq_cst);
+            if (producerSleeping.load(std::memory_order_seq_cst))
+                signal(producerWakeups);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Sleeps until the ring is non-empty or cancel is set (consumer side).
+     *
+     * @param cancel Flag that, once set and followed by wake(), ends the wait.
+     */
+    void waitForData(const std::atomic<bool>& cancel) {
+        const uint32_t observed = consumerWakeups.load(std::memory_order_seq_cst);
+        consumerSleeping.store(true, std::memory_order_seq_cst);
+        if (head.load(std::memory_order_relaxed) == tail.load(std::memory_order_seq_cst) &&
+            !cancel.load(std::memory_order_seq_cst))
+            consumerWakeups.wait(observed, std::memory_order_seq_cst);
+        consumerSleeping.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Wakes a consumer sleeping in waitForData(), to be called after setting its cancel flag.
+     */
+    void wake() {
+        signal(consumerWakeups);
+    }
+
+private:
+    static void signal(std::atomic<uint32_t>& wakeups) {
+        wakeups.fetch_add(1, std::memory_order_seq_cst);
+        wakeups.notify_one();
+    }
+
+    static constexpr size_t CACHE_LINE = 64;
+
+    const uint64_t mask;
+    std::unique_ptr<T[]> slots;
+
+    alignas(CACHE_LINE) std::atomic<uint64_t> head{0};           ///< Next element to pop
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail{0};           ///< Next free slot
+    uint64_t cachedHead = 0;                                     ///< Producer's copy of head
+    alignas(CACHE_LINE) std::atomic<bool> consumerSleeping{false};
+    std::atomic<bool> producerSleeping{false};
+    std::atomic<uint32_t> consumerWakeups{0};                    ///< Bumped to wake the consumer
+    std::atomic<uint32_t> producerWakeups{0};                    ///< Bumped to wake the producer
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "elf_utils.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Interned call stacks of the reported accesses (--backtrace).
+ *
+ * Identical stacks share one ID, so an event carries a 32-bit number instead of its frames.
+ * The frames of all stacks are kept back to back in one array, and a flat open-addressing
+ * table keyed by the hash of the frames maps them to their ID.
+ */
+class StackTable {
+public:
+    /** Deepest stack --backtrace accepts. */
+    static constexpr size_t MAX_DEPTH = 64;
+
+    /**
+     * @brief Creates an empty table.
+     *
+     * @param capacity Initial number of buckets (rounded up to a power of two).
+     */
+    explicit StackTable(size_t capacity = 256);
+
+    /**
+     * @brief Returns the ID of a stack, adding it if it was not seen before.
+     *
+     * @param frames Return addresses, innermost first.
+     * @return The stack's ID, starting at 1; 0 for an empty stack.
+     */
+    uint32_t intern(std::span<const uint64_t> frames);
+
+    /** @brief Returns the frames of a stack, innermost first; empty for an unknown ID. */
+    [[nodiscard]] std::span<const uint64_t> frames(uint32_t id) const;
+
+    /** @brief Returns the number of distinct stacks. */
+    [[nodiscard]] size_t size() const { return offsets.size() - 1; }
+
+private:
+    struct Bucket {
+        uint64_t hash = 0;
+        uint32_t id = 0;   ///< 0 marks an empty bucket
+    };
+
+    /** @brief Doubles the table and re-inserts every stack. */
+    void grow();
+
+    std::unique_ptr<Bucket[]> buckets;
+    size_t mask;
+    std::vector<uint64_t> frameData;     ///< Frames of every stack, in ID order
+    std::vector<uint32_t> offsets{0};    ///< Start of stack ID in frameData at ID - 1, plus the end
+};
+
+/**
+ * @brief Walks the frame-pointer chain of a stopped thread through a copy of its stack.
+ *
+ * Each frame saves the caller's frame pointer at [rbp] and the return address at [rbp + 8].
+ * The walk stops at a frame pointer outside the copy, one that does not move towards the
+ * base of the stack, or a null return address, so code built without frame pointers ends
+ * the stack early rather than producing garbage.
+ *
+ * @param ip Instruction pointer of the thread, the innermost frame.
+ * @param framePointer rbp of the thread.
+ * @param stackAddress Address in the target the copy starts at (the thread's rsp).
+ * @param stack Copy of the target's stack from stackAddress up.
+ * @param frames Receives the frames, innermost first; its size is the maximum depth.
+ * @return Number of frames written.
+ */
+size_t walkFramePointers(uint64_t ip, uint64_t framePointer, uint64_t stackAddress,
+                         std::span<const uint8_t> stack, std::span<uint64_t> frames);
+
+/**
+ * @brief Prints every stack of a table as "#id" followed by one indented frame per line.
+ *
+ * @param out Destination stream.
+ * @param stacks Stacks to print.
+ * @param functions Function symbols of the executable (see readFunctionSymbols).
+ * @param loadBias Difference between runtime and link-time addresses of the executable.
+ */
+void printStacks(std::ostream& out, const StackTable& stacks, const std::vector<FunctionSymbol>& functions,
+                 uintptr_t loadBias);
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <elf.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Read-only mapping of a whole ELF file with validated section headers.
+ */
+class ElfImage {
+public:
+    /**
+     * @brief Maps a file.
+     *
+     * @param path Path to the binary.
+     * @throws std::runtime_error If the file cannot be mapped or is not a 64-bit ELF.
+     */
+    explicit ElfImage(const std::string& path);
+    ~ElfImage();
+
+    ElfImage(const ElfImage&) = delete;
+    ElfImage& operator=(const ElfImage&) = delete;
+
+    /** @brief Returns the ELF header. */
+    [[nodiscard]] const Elf64_Ehdr& header() const { return *reinterpret_cast<const Elf64_Ehdr*>(data); }
+
+    /** @brief Returns the section header table (e_shnum entries). */
+    [[nodiscard]] const Elf64_Shdr* sections() const {
+        return reinterpret_cast<const Elf64_Shdr*>(data + header().e_shoff);
+    }
+
+    /** @brief Returns a pointer to a file offset. */
+    [[nodiscard]] const char* at(uint64_t offset) const { return data + offset; }
+
+    /** @brief Returns true if [offset, offset + size) lies inside the file. */
+    [[nodiscard]] bool contains(uint64_t offset, uint64_t size) const {
+        return offset <= length && size <= length - offset;
+    }
+
+    /**
+     * @brief Returns the contents of a section.
+     *
+     * @param name Section name, e.g. ".debug_info".
+     * @return The section bytes, or an empty view if the section is missing, empty (NOBITS)
+     *         or compressed.
+     */
+    [[nodiscard]] std::string_view section(std::string_view name) const;
+
+    /**
+     * @brief Returns the NT_GNU_BUILD_ID note as lowercase hex.
+     *
+     * @return The build ID, or an empty string if the binary has none.
+     */
+    [[nodiscard]] std::string buildId() const;
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+};
+
+/**
+ * @brief Lookup of defined .dynsym entries through the .gnu.hash or DT_HASH (.hash) table.
+ */
+class DynamicSymbolTable {
+public:
+    explicit DynamicSymbolTable(const ElfImage& image);
+
+    /** @brief Returns true if the binary has a hash table over .dynsym. */
+    [[nodiscard]] bool hashed() const { return gnuHash != nullptr || sysvHash != nullptr; }
+
+    /**
+     * @brief Looks up a defined dynamic symbol.
+     *
+     * @param name Symbol name.
+     * @param symbol Output parameter receiving the symbol if found.
+     * @return true if found.
+     */
+    bool find(std::string_view name, Elf64_Sym& symbol) const;
+
+private:
+    bool findGnu(std::string_view name, Elf64_Sym& symbol) const;
+    bool findSysv(std::string_view name, Elf64_Sym& symbol) const;
+
+    const Elf64_Sym* symbols = nullptr;   ///< .dynsym
+    const char* strings = nullptr;        ///< .dynstr
+    const uint32_t* gnuHash = nullptr;    ///< .gnu.hash contents, if present
+    const uint32_t* sysvHash = nullptr;   ///< .hash contents, if present
+};
+
+/**
+ * @brief Hash index from symbol name to value, size and type, serialisable to a cache file.
+ *
+ * The serialised form is used directly for lookups, both in memory after building and
+ * when mapped from disk:
+ *
+ *   Header  { magic[8], count, stringBytes }
+ *   Entry   { hash, address, size, nameOffset, nameLength, type } x count, sorted by hash
+ *   char    names[stringBytes]
+ */
+class SymbolIndex {
+public:
+    SymbolIndex() = default;
+    ~SymbolIndex();
+
+    SymbolIndex(const SymbolIndex&) = delete;
+    SymbolIndex& operator=(const SymbolIndex&) = delete;
+    SymbolIndex(SymbolIndex&& other) noexcept;
+    SymbolIndex& operator=(SymbolIndex&& other) noexcept;
+
+    /**
+     * @brief Indexes every defined symbol of the given symbol table sections, in order.
+     *
+     * When a name is defined several times the first definition wins, as with a linear scan.
+     *
+     * @param image Mapped binary.
+     * @param tables Section indices of SHT_SYMTAB/SHT_DYNSYM sections.
+     */
+    static SymbolIndex build(const ElfImage& image, const std::vector<int>& tables);
+
+    /**
+     * @brief Maps a cache file written by save().
+     *
+     * @param path Cache file path.
+     * @return true if the file exists and is a valid index.
+     */
+    bool load(const std::string& path);
+
+    /**
+     * @brief Writes the index atomically (temporary file and rename).
+     *
+     * @param path Cache file path; its directory must exist.
+     * @return true on success.
+     */
+    [[nodiscard]] bool save(const std::string& path) const;
+
+    /**
+     * @brief Looks up a symbol.
+     *
+     * @param name Symbol name.
+     * @param address Output parameter receiving the symbol value.
+     * @param size Output parameter receiving the symbol size.
+     * @param type Output parameter receiving the symbol type (STT_OBJECT, STT_TLS, ...).
+     * @return true if found.
+     */
+    bool find(std::string_view name, uintptr_t& address, size_t& size, unsigned& type) const;
+
+    /** @brief Returns the number of indexed symbols. */
+    [[nodiscard]] uint64_t size() const;
+
+private:
+    struct Header {
+        char magic[8];
+        uint64_t count;
+        uint64_t stringBytes;
+    };
+
+    struct Entry {
+        uint64_t hash;
+        uint64_t address;
+        uint64_t size;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t type;           ///< ELF64_ST_TYPE of the symbol
+        uint32_t reserved = 0;
+    };
+
+    static constexpr char MAGIC[8] = { 'G', 'W', 'S', 'Y', 'M', 'I', 'X', '2' };
+
+    void reset();
+
+    std::vector<char> owned;          ///< Serialised index built in memory
+    const char* data = nullptr;       ///< Serialised index (owned or mapped)
+    size_t length = 0;                ///< Size of data
+    bool mapped = false;              ///< data is an mmap of a cache file
+};
+
+/**
+ * @brief Directory of the persistent symbol index cache.
+ *
+ * $GWATCH_CACHE_DIR, else $XDG_CACHE_HOME/gwatch, else $HOME/.cache/gwatch.
+ *
+ * @return The directory, or an empty string if none can be determined.
+ */
+std::string symbolCacheDirectory();
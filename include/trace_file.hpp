@@ -0,0 +1,244 @@
+#pragma once
+
+#include "event_writer.hpp"
+#include "types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Fixed-size event record of a .gwt trace, a WatchEvent with a stable layout.
+ */
+struct TraceRecord {
+    uint64_t time;       ///< CLOCK_MONOTONIC timestamp in nanoseconds
+    uint64_t ip;         ///< Instruction pointer, if known
+    uint64_t oldValue;   ///< Value before a write
+    uint64_t newValue;   ///< Value after the access
+    int32_t pid;         ///< Process of the accessing thread
+    int32_t tid;         ///< Accessing thread
+    uint16_t varIndex;   ///< Index of the variable in the trace's variable table
+    uint8_t kind;        ///< EventKind
+    uint8_t reserved;
+    float sampleRatio;   ///< Share of the accesses watched, 0 if all were (--overhead-budget)
+};
+static_assert(sizeof(TraceRecord) == 48);
+
+/**
+ * @brief Time index entry of one chunk of records.
+ *
+ * The masks have bit (varIndex % 64) and bit (tid % 64) set for every record of the chunk, so a
+ * filter on one variable or thread can skip chunks that certainly do not contain it.
+ */
+struct TraceChunk {
+    uint64_t firstTime;  ///< Earliest timestamp in the chunk
+    uint64_t lastTime;   ///< Latest timestamp in the chunk
+    uint64_t varMask;    ///< Variables present, hashed to 64 bits
+    uint64_t tidMask;    ///< Threads present, hashed to 64 bits
+    uint32_t records;    ///< Records in the chunk
+    uint32_t reserved;
+};
+static_assert(sizeof(TraceChunk) == 40);
+
+/**
+ * @brief Header at offset 0 of a .gwt trace.
+ *
+ * Layout: header and variable table padded to a page, then the records back to back in
+ * chunks of chunkRecords, then the chunk index. indexOffset stays 0 until the recording is
+ * closed; recordCount is kept current at every flush so an interrupted trace stays readable.
+ */
+struct TraceHeader {
+    char magic[8];           ///< "GWTRACE1"
+    uint32_t version;        ///< Format version, 1
+    uint32_t recordSize;     ///< sizeof(TraceRecord)
+    uint32_t chunkRecords;   ///< Records per chunk (all but the last chunk are full)
+    uint32_t variableCount;  ///< Entries in the variable table following the header
+    uint64_t dataOffset;     ///< File offset of the first record, page-aligned
+    uint64_t recordCount;    ///< Records written
+    uint64_t indexOffset;    ///< File offset of the chunk index, 0 while recording
+    uint64_t chunkCount;     ///< Entries in the chunk index
+    uint64_t startTime;      ///< CLOCK_MONOTONIC nanoseconds when the recording started
+    uint64_t startRealtime;  ///< CLOCK_REALTIME nanoseconds when the recording started
+};
+
+/** @brief TraceVariable::typeKind of a variable without a DWARF type. */
+constexpr uint8_t TRACE_UNTYPED = 0xFF;
+
+/**
+ * @brief Variable table entry; names follow the table as one blob.
+ */
+struct TraceVariable {
+    uint32_t nameOffset;  ///< Offset of the name in the blob
+    uint16_t nameLength;  ///< Length of the name
+    uint8_t typeKind;     ///< ValueType::Kind, TRACE_UNTYPED if the variable has no DWARF type
+    uint8_t typeSize;     ///< Size of the value in bytes
+};
+
+/** @brief Returns CLOCK_MONOTONIC in nanoseconds, the time base of every event. */
+uint64_t monotonicNanos();
+
+/**
+ * @brief Sink recording events into a chunked, mmap-backed binary trace (--record).
+ *
+ * The file grows one chunk at a time; the current chunk is mapped and each event is copied
+ * into it field by field, so recording costs little more than a memcpy. Enumerator names of
+ * the variable types are not recorded.
+ */
+class TraceFileSink : public EventSink {
+public:
+    static constexpr size_t DEFAULT_CHUNK_RECORDS = 1 << 16;
+
+    /**
+     * @brief Creates the trace and writes its header and variable table.
+     *
+     * @param path File to create or truncate.
+     * @param names Variable names, indexed by WatchEvent::varIndex.
+     * @param types Value types by variable index; missing or null entries are untyped.
+     * @param chunkRecords Records per chunk, a multiple of 256 so chunks stay page-aligned.
+     * @throws std::invalid_argument If chunkRecords is not a positive multiple of 256.
+     * @throws std::runtime_error If the file cannot be created or mapped.
+     */
+    TraceFileSink(const std::string& path, const std::vector<std::string>& names,
+                  const std::vector<std::shared_ptr<const ValueType>>& types = {},
+                  size_t chunkRecords = DEFAULT_CHUNK_RECORDS);
+
+    /** @brief Writes the chunk index and trims the file to its records. */
+    ~TraceFileSink() override;
+
+    TraceFileSink(const TraceFileSink&) = delete;
+    TraceFileSink& operator=(const TraceFileSink&) = delete;
+
+    void consume(std::span<const WatchEvent> events) override;
+    void flush() override;
+
+private:
+    /** Maps the next chunk, extending the file. */
+    void nextChunk();
+
+    int fd = -1;
+    TraceHeader* header = nullptr;     ///< Mapped header page(s)
+    size_t headerBytes = 0;
+    TraceRecord* chunk = nullptr;      ///< Mapped current chunk
+    size_t chunkRecords;
+    size_t chunkUsed = 0;              ///< Records in the current chunk
+    uint64_t recordCount = 0;
+    std::vector<TraceChunk> index;     ///< One entry per chunk started
+    bool failed = false;               ///< The file could not grow; further events are dropped
+};
+
+/**
+ * @brief Selection of trace records; the defaults select everything.
+ */
+struct TraceFilter {
+    uint64_t from = 0;            ///< Earliest timestamp (absolute, nanoseconds)
+    uint64_t to = UINT64_MAX;     ///< Latest timestamp (absolute, nanoseconds)
+    int varIndex = -1;            ///< Only this variable, -1 for all
+    int32_t tid = 0;              ///< Only this thread, 0 for all
+
+    /** @brief Returns false if no record of the chunk can match. */
+    [[nodiscard]] bool mayMatch(const TraceChunk& chunk) const;
+
+    /** @brief Returns true if the record is selected. */
+    [[nodiscard]] bool matches(const TraceRecord& record) const {
+        return record.time >= from && record.time <= to && (varIndex < 0 || record.varIndex == varIndex) &&
+               (tid == 0 || record.tid == tid);
+    }
+};
+
+/**
+ * @brief Read-only view of a .gwt trace.
+ *
+ * The file is mapped, not read: only the chunks a query selects through the index are
+ * paged in. A trace whose recording was interrupted has no index; it is rebuilt from the
+ * records counted at the last flush.
+ */
+class TraceReader {
+public:
+    /**
+     * @brief Maps a trace and checks its header.
+     *
+     * @param path Trace file.
+     * @throws std::runtime_error If the file cannot be mapped or is not a valid trace.
+     */
+    explicit TraceReader(const std::string& path);
+    ~TraceReader();
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    [[nodiscard]] const TraceHeader& header() const { return *fileHeader; }
+    [[nodiscard]] const std::vector<std::string>& names() const { return variableNames; }
+    [[nodiscard]] const std::vector<std::shared_ptr<const ValueType>>& types() const { return variableTypes; }
+    [[nodiscard]] const std::vector<TraceChunk>& chunks() const { return chunkIndex; }
+
+    /** @brief Returns true if the recording was closed properly. */
+    [[nodiscard]] bool complete() const { return fileHeader->indexOffset != 0; }
+
+    /** @brief Returns the records of one chunk. */
+    [[nodiscard]] std::span<const TraceRecord> records(size_t chunk) const;
+
+    /**
+     * @brief Calls visit(record) for every selected record, in file order.
+     *
+     * @return Number of chunks actually decoded.
+     */
+    template <typename Visit>
+    size_t forEach(const TraceFilter& filter, Visit&& visit) const {
+        size_t decoded = 0;
+        for (size_t c = 0; c < chunkIndex.size(); ++c) {
+            if (!filter.mayMatch(chunkIndex[c]))
+                continue;
+            ++decoded;
+            for (const TraceRecord& record : records(c)) {
+                if (filter.matches(record))
+                    visit(record);
+            }
+        }
+        return decoded;
+    }
+
+private:
+    const char* base = nullptr;
+    size_t size = 0;
+    const TraceHeader* fileHeader = nullptr;
+    std::vector<std::string> variableNames;
+    std::vector<std::shared_ptr<const ValueType>> variableTypes;
+    std::vector<TraceChunk> chunkIndex;
+};
+
+/**
+ * @brief Per-variable totals of the records a filter selects.
+ */
+struct TraceSummary {
+    uint64_t writes = 0;
+    uint64_t reads = 0;
+    uint64_t accesses = 0;    ///< Accesses without values (perf backend)
+    uint64_t executions = 0;
+    size_t threads = 0;       ///< Distinct accessing threads
+    uint64_t firstTime = 0;   ///< Earliest selected record, 0 if none
+    uint64_t lastTime = 0;    ///< Latest selected record
+    double estimated = 0;     ///< Accesses the sampled records stand for
+    bool sampled = false;     ///< Whether any record was sampled
+
+    [[nodiscard]] uint64_t total() const { return writes + reads + accesses + executions; }
+};
+
+/**
+ * @brief Totals the selected records per variable, decoding only the chunks that may match.
+ *
+ * @param trace Trace to summarise.
+ * @param filter Records to count.
+ * @return One summary per variable of the trace.
+ */
+std::vector<TraceSummary> summarizeTrace(const TraceReader& trace, const TraceFilter& filter);
+
+/**
+ * @brief Prints summaries as a table, times in seconds from the start of the recording.
+ *
+ * Sampled traces get a column with the estimated number of accesses.
+ */
+void printTraceSummary(std::ostream& out, const TraceReader& trace, const std::vector<TraceSummary>& summaries);
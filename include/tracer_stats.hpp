@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+
+/**
+ * @brief Histogram with power-of-two buckets.
+ *
+ * Bucket i counts the values of bit width i, i.e. [2^(i-1), 2^i), and bucket 0 the zeros, so
+ * recording a value costs a bit scan and an increment whatever its magnitude. Quantiles are
+ * known to within a factor of two, enough to spot a regression in an overhead budget.
+ */
+class LogHistogram {
+public:
+    static constexpr size_t BUCKETS = 65;
+
+    /** @brief Counts one value. */
+    void record(uint64_t value) {
+        ++buckets[std::bit_width(value)];
+        ++total;
+        sum += value;
+        if (value < minimum) minimum = value;
+        if (value > maximum) maximum = value;
+    }
+
+    /** @brief Returns the number of recorded values. */
+    [[nodiscard]] uint64_t count() const { return total; }
+
+    /** @brief Returns the mean of the recorded values, 0 if there are none. */
+    [[nodiscard]] double mean() const { return total == 0 ? 0 : static_cast<double>(sum) / static_cast<double>(total); }
+
+    /**
+     * @brief Returns an upper bound of a quantile: the top of the bucket holding it, at most the maximum.
+     *
+     * @param q Quantile in [0, 1].
+     * @return The bound, 0 if nothing was recorded.
+     */
+    [[nodiscard]] uint64_t quantile(double q) const;
+
+    /**
+     * @brief Writes the histogram as a JSON object: count, min, mean, p50, p90, p99, max and
+     * the non-empty buckets as {"le": <top>, "count": <n>}.
+     */
+    void writeJson(std::ostream& out) const;
+
+private:
+    std::array<uint64_t, BUCKETS> buckets{};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t minimum = UINT64_MAX;
+    uint64_t maximum = 0;
+};
+
+/**
+ * @brief What tracing costs the target (--stats), written as JSON at exit and on SIGUSR1.
+ *
+ * A trap is a stop that reported at least one access. The backend records each trap's cost
+ * while it runs; the totals it keeps anyway are passed in when the statistics are written.
+ */
+struct TracerStats {
+    /** Totals of the run so far, kept by the backend and the output pipeline. */
+    struct Totals {
+        uint64_t stops = 0;           ///< Stops reported by waitpid()
+        uint64_t accesses = 0;        ///< Accesses seen, reported or not
+        uint64_t ptraceRequests = 0;  ///< ptrace requests issued since tracing started
+        uint64_t dropped = 0;         ///< Events dropped on a full output queue
+        uint64_t lost = 0;            ///< Samples the kernel lost (perf backend)
+    };
+
+    /**
+     * @param backend Name of the backend, "ptrace" or "perf".
+     * @param start CLOCK_MONOTONIC time in nanoseconds when tracing started.
+     */
+    TracerStats(std::string backend, uint64_t start) : backend(std::move(backend)), start(start) {}
+
+    /**
+     * @brief Writes the statistics as one JSON object.
+     *
+     * @param out Destination.
+     * @param now Current CLOCK_MONOTONIC time in nanoseconds.
+     * @param totals Totals of the run so far.
+     */
+    void writeJson(std::ostream& out, uint64_t now, const Totals& totals) const;
+
+    /**
+     * @brief Replaces a file with the JSON statistics; readers never see a partial file.
+     *
+     * @throws std::runtime_error If the file cannot be written.
+     */
+    void writeFile(const std::string& path, uint64_t now, const Totals& totals) const;
+
+    std::string backend;         ///< Backend that produced the statistics
+    uint64_t start;              ///< When tracing started
+    uint64_t traps = 0;          ///< Stops, or perf samples, that reported an access
+    LogHistogram stoppedNanos;   ///< Time each trap kept its thread stopped, from waitpid() to resume
+    LogHistogram ptracePerTrap;  ///< ptrace requests issued while handling each trap
+    LogHistogram readNanos;      ///< Latency of reading the accessed variables of a trap
+    LogHistogram queueDepth;     ///< Output queue depth after each trap, or each perf ring drain
+};
@@ -1,12 +1,147 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+
+class Predicate;
+
+/**
+ * Mechanism used to observe variable accesses.
+ */
+enum class BackendKind {
+    Ptrace,  ///< Stop the tracee on every access (reports values)
+    Perf     ///< perf_event hardware breakpoints sampled into a ring buffer (non-stopping)
+};
+
+/**
+ * Kind of access that triggers a watchpoint (DR7 RW field).
+ */
+enum class WatchMode {
+    Write,      ///< Data writes only (RW=01)
+    ReadWrite,  ///< Data reads and writes (RW=11)
+    Execute     ///< Instruction fetch at the address (RW=00)
+};
+
+/**
+ * What the output queue does when the writer thread cannot keep up.
+ */
+enum class QueuePolicy {
+    Block,  ///< Stall the tracer (and thus the tracee) until there is room
+    Drop    ///< Discard the event and count it
+};
+
+/**
+ * Tracer settings that are independent of the target and the variables.
+ */
+struct TracerOptions {
+    QueuePolicy queuePolicy = QueuePolicy::Block;  ///< Full output queue behaviour
+    size_t queueCapacity = 1 << 16;                ///< Output queue size in events (power of two)
+    size_t profileTop = 0;                         ///< Rows of the hotspot table, 0 to stream events instead
+    bool followChildren = false;                   ///< Trace forked children and re-arm them (--follow-children)
+    std::string recordPath;                        ///< Binary trace to record into instead of printing, empty for text
+    size_t coalesceEvents = 0;                     ///< Accesses per coalesced run at most (--coalesce=<n>), 0 for no limit
+    uint64_t coalesceGap = 0;                      ///< Idle nanoseconds ending a run (--coalesce=<t>us), 0 for the default
+    uint64_t coalescePause = 0;                    ///< Nanoseconds a hot run's watchpoint is disarmed (--coalesce-pause), 0 never
+    bool coalesce = false;                         ///< Collapse runs of accesses from one instruction (--coalesce)
+    double overheadBudget = 0;                     ///< Share of the time the tracee may be stopped (--overhead-budget), 0 for no limit
+    size_t backtraceDepth = 0;                     ///< Frames of the call stack captured per event (--backtrace), 0 for none
+    std::vector<std::string> scopeFunctions;       ///< Watch only while a thread is inside one of them (--only-in)
+    std::string controlPath;                       ///< Unix socket taking commands while tracing (--control), empty for none
+    std::string statsPath;                         ///< JSON file of tracer statistics (--stats), empty for none
+};
+
+/**
+ * One --var argument with the options that apply to it.
+ */
+struct VariableSpec {
+    std::string symbol;                          ///< Symbol name
+    std::string library;                         ///< Shared library from "lib.so:symbol", empty for the executable
+    WatchMode mode = WatchMode::ReadWrite;       ///< Accesses that trigger the watchpoint
+    std::shared_ptr<const Predicate> condition;  ///< Report condition, may be null
+    bool range = false;                          ///< Watch every byte of the object (--range, --addr)
+    uintptr_t address = 0;                       ///< Link-time address of an --addr range, 0 for symbols
+    size_t length = 0;                           ///< Length of an --addr range in bytes
+};
 
 /**
  * Helper structure to hold parsed command-line arguments.
  */
 struct Arguments {
-    std::string symbol;
+    std::vector<VariableSpec> variables;
     std::string execPath;
     char** execArgs;
-};
\ No newline at end of file
+    BackendKind backend = BackendKind::Ptrace;
+    int attachPid = 0;
+    TracerOptions options;
+};
+
+/**
+ * Scalar type of a watched value, taken from DWARF, used to format and compare it.
+ */
+struct ValueType {
+    enum class Kind {
+        Unsigned,  ///< Unsigned integer or character
+        Signed,    ///< Two's complement integer
+        Float,     ///< IEEE 754 binary32 or binary64
+        Bool,      ///< Printed as true/false
+        Enum,      ///< Printed as the enumerator name when one matches
+        Pointer    ///< Printed in hexadecimal
+    };
+
+    Kind kind = Kind::Unsigned;
+    size_t size = 0;                                      ///< Size in bytes
+    std::vector<std::pair<uint64_t, std::string>> enumerators; ///< Enum values (truncated to size) and names
+};
+
+/**
+ * Per-variable watch state shared between symbol resolution and the tracer loop.
+ */
+struct WatchedVariable {
+    std::string name;            ///< Symbol name, used for logging
+    uintptr_t symbolOffset = 0;  ///< ELF symbol value (resolved once the library is loaded for library variables)
+    size_t size = 0;             ///< Size in bytes
+    uintptr_t runtimeAddress = 0;///< Address in the traced process, 0 while its library is not loaded
+    int slot = -1;               ///< Debug register slot (DR0–DR3), -1 if unarmed
+    uint64_t lastValue = 0;      ///< Last observed value
+    WatchMode mode = WatchMode::ReadWrite; ///< Accesses that trigger the watchpoint
+    std::shared_ptr<const Predicate> condition; ///< Only accesses matching it are reported; null for all
+    std::string library;         ///< Shared library defining the symbol, empty for the executable
+    std::shared_ptr<const ValueType> type; ///< DWARF type of the value; null to treat it as raw unsigned
+    bool range = false;          ///< Any size or alignment; split into chunks before watching
+    bool guarded = false;        ///< Chunk watched through page protection instead of a debug register
+    bool tls = false;            ///< Thread-local: one instance per thread, runtimeAddress and lastValue unused
+    int64_t tpOffset = 0;        ///< Thread-local: offset of the instance from the thread pointer (fs_base)
+    bool removed = false;        ///< Removed while tracing (--control); its index stays taken
+};
+
+/**
+ * Kind of a reported access.
+ */
+enum class EventKind : uint8_t {
+    Read,    ///< Value unchanged by the access
+    Write,   ///< Value written: oldValue -> newValue
+    Access,  ///< Access without value information (perf backend)
+    Execute  ///< Instruction at the watched address is about to run
+};
+
+/**
+ * Fixed-size record of one access, produced by a backend and formatted by the writer thread.
+ */
+struct WatchEvent {
+    uint64_t oldValue;   ///< Value before a write
+    uint64_t newValue;   ///< Value after the access
+    uint64_t ip;         ///< Instruction pointer, if known
+    uint64_t time;       ///< Timestamp in nanoseconds, if known
+    uint64_t duration;   ///< Nanoseconds from the first to the last access of a coalesced run
+    int32_t pid;         ///< Process of the accessing thread
+    int32_t tid;         ///< Accessing thread
+    uint16_t varIndex;   ///< Index of the variable in the watch list
+    EventKind kind;      ///< Read, write or plain access
+    uint32_t count;      ///< Accesses summarised by a coalesced run (--coalesce), 0 for a single access
+    float sampleRatio;   ///< Share of the time watched when seen (--overhead-budget), 0 if not sampled
+    uint32_t stack;      ///< Interned call stack of the access (--backtrace), 0 if none
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "event_writer.hpp"
+#include "types.hpp"
+
+#include <memory>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * @brief A traced process handed over to a backend.
+ *
+ * Every listed thread is seized and sitting in a ptrace-stop that has already been waited for.
+ */
+struct Tracee {
+    pid_t pid = 0;                 ///< Thread-group ID
+    std::vector<pid_t> threads;    ///< All threads of the process, including pid
+    bool attached = false;         ///< True for --pid mode: the process is not our child
+};
+
+/**
+ * @brief Common interface of the mechanisms that deliver variable accesses.
+ *
+ * The Debugger launches or attaches to the target and resolves runtime addresses; a
+ * backend then takes over the stopped tracee and reports accesses until it exits or
+ * the user interrupts gwatch, in which case the target is detached and left running.
+ */
+class WatchBackend {
+public:
+    virtual ~WatchBackend() = default;
+
+    /**
+     * @brief Arms watchpoints on the variables and reports accesses until the target exits.
+     *
+     * @param tracee The stopped target process and its threads.
+     * @param vars Variables with their runtime addresses resolved.
+     * @param events Output pipeline receiving one WatchEvent per reported access.
+     */
+    virtual void watch(const Tracee& tracee, std::vector<WatchedVariable>& vars, EventWriter& events) = 0;
+};
+
+/**
+ * @brief Creates the backend for the given kind.
+ *
+ * @param kind Backend selected on the command line.
+ * @param options Tracer settings.
+ * @return Newly created backend.
+ */
+std::unique_ptr<WatchBackend> createBackend(BackendKind kind, const TracerOptions& options);
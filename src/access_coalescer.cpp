@@ -0,0 +1,88 @@
+#include "access_coalescer.hpp"
+
+#include <algorithm>
+
+AccessCoalescer::AccessCoalescer(size_t maxEvents, uint64_t gap)
+    : maxEvents(maxEvents), gap(gap != 0 ? gap : DEFAULT_GAP) {
+    runs.reserve(MAX_RUNS);
+}
+
+bool AccessCoalescer::add(const WatchEvent& event, EventWriter& events) {
+    for (size_t i = 0; i < runs.size(); ++i) {
+        Run& run = runs[i];
+        WatchEvent& summary = run.summary;
+        if (summary.ip != event.ip || summary.tid != event.tid || summary.varIndex != event.varIndex ||
+            summary.pid != event.pid || summary.sampleRatio != event.sampleRatio || summary.stack != event.stack)
+            continue;
+
+        if (event.time > run.idleSince() + gap) {
+            report(i, events);
+            break;  // the access starts a new run
+        }
+
+        // A run is a write if any of its accesses wrote: first old value -> last new value.
+        summary.newValue = event.newValue;
+        if (event.kind == EventKind::Write)
+            summary.kind = EventKind::Write;
+        run.lastTime = event.time;
+        const bool hot = ++summary.count % HOT_RUN == 0;
+        if (maxEvents != 0 && summary.count >= maxEvents)
+            report(i, events);
+        return hot;
+    }
+
+    if (maxEvents == 1) {
+        events.emit(event);
+        return false;
+    }
+    if (runs.size() == MAX_RUNS) {
+        const auto idlest = std::ranges::min_element(runs, {}, &Run::lastTime);
+        report(static_cast<size_t>(idlest - runs.begin()), events);
+    }
+
+    Run run;
+    run.summary = event;
+    run.summary.count = 1;
+    run.lastTime = event.time;
+    runs.push_back(run);
+    return false;
+}
+
+void AccessCoalescer::expire(uint64_t now, EventWriter& events) {
+    for (size_t i = 0; i < runs.size();) {
+        if (now > runs[i].idleSince() + gap)
+            report(i, events);
+        else
+            ++i;
+    }
+}
+
+void AccessCoalescer::hold(int32_t tid, uint16_t varIndex, uint64_t until) {
+    for (Run& run : runs) {
+        if (run.summary.tid == tid && run.summary.varIndex == varIndex)
+            run.holdUntil = until;
+    }
+}
+
+uint64_t AccessCoalescer::nextExpiry() const {
+    uint64_t next = UINT64_MAX;
+    for (const Run& run : runs)
+        next = std::min(next, run.idleSince() + gap + 1);
+    return next;
+}
+
+void AccessCoalescer::flush(EventWriter& events) {
+    while (!runs.empty())
+        report(0, events);
+}
+
+void AccessCoalescer::report(size_t index, EventWriter& events) {
+    WatchEvent event = runs[index].summary;
+    if (event.count > 1)
+        event.duration = runs[index].lastTime - event.time;
+    else
+        event.count = 0;
+    events.emit(event);
+    // Runs stay in the order they started, so reports of one batch come out in time order.
+    runs.erase(runs.begin() + static_cast<std::ptrdiff_t>(index));
+}
@@ -0,0 +1,92 @@
+#include "access_profile.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+
+static size_t bucketOf(uint64_t ip, uint16_t varIndex, size_t mask) {
+    // Fibonacci hashing; the high bits of the product are the best mixed.
+    const uint64_t key = ip ^ (static_cast<uint64_t>(varIndex) << 56);
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+AccessProfile::AccessProfile(size_t capacity)
+    : buckets(std::make_unique<Entry[]>(std::bit_ceil(std::max<size_t>(capacity, 16)))),
+      mask(std::bit_ceil(std::max<size_t>(capacity, 16)) - 1) {}
+
+void AccessProfile::record(uint64_t ip, uint16_t varIndex, bool write, uint64_t weight) {
+    size_t i = bucketOf(ip, varIndex, mask);
+    while (buckets[i].ip != 0 && (buckets[i].ip != ip || buckets[i].varIndex != varIndex))
+        i = (i + 1) & mask;
+
+    Entry& entry = buckets[i];
+    if (entry.ip == 0) {
+        // Keep the load factor under one half so probe sequences stay short.
+        if ((used + 1) * 2 > mask + 1) {
+            grow();
+            record(ip, varIndex, write, weight);
+            return;
+        }
+        entry.ip = ip;
+        entry.varIndex = varIndex;
+        ++used;
+    }
+    (write ? entry.writes : entry.reads) += weight;
+}
+
+void AccessProfile::grow() {
+    const size_t oldSize = mask + 1;
+    auto old = std::move(buckets);
+    mask = oldSize * 2 - 1;
+    buckets = std::make_unique<Entry[]>(oldSize * 2);
+
+    for (size_t j = 0; j < oldSize; ++j) {
+        if (old[j].ip == 0)
+            continue;
+        size_t i = bucketOf(old[j].ip, old[j].varIndex, mask);
+        while (buckets[i].ip != 0)
+            i = (i + 1) & mask;
+        buckets[i] = old[j];
+    }
+}
+
+std::vector<AccessProfile::Entry> AccessProfile::top(size_t count) const {
+    std::vector<Entry> entries;
+    entries.reserve(used);
+    for (size_t i = 0; i <= mask; ++i) {
+        if (buckets[i].ip != 0)
+            entries.push_back(buckets[i]);
+    }
+
+    const auto busier = [](const Entry& a, const Entry& b) {
+        return a.total() != b.total() ? a.total() > b.total() : a.ip < b.ip;
+    };
+    count = std::min(count, entries.size());
+    std::partial_sort(entries.begin(), entries.begin() + static_cast<std::ptrdiff_t>(count), entries.end(), busier);
+    entries.resize(count);
+    return entries;
+}
+
+void printProfile(std::ostream& out,
+                  const std::vector<AccessProfile::Entry>& entries,
+                  const std::vector<std::string>& names,
+                  const std::vector<FunctionSymbol>& functions,
+                  uintptr_t loadBias) {
+    size_t locationWidth = 8;
+    size_t nameWidth = 8;
+    std::vector<std::string> locations;
+    for (const auto& entry : entries) {
+        locations.push_back(describeAddress(functions, entry.ip - loadBias));
+        locationWidth = std::max(locationWidth, locations.back().size());
+        nameWidth = std::max(nameWidth, names[entry.varIndex].size());
+    }
+
+    out << std::left << std::setw(static_cast<int>(locationWidth)) << "location" << "  "
+        << std::setw(static_cast<int>(nameWidth)) << "variable" << std::right
+        << "  " << std::setw(12) << "reads" << "  " << std::setw(12) << "writes" << "\n";
+    for (size_t i = 0; i < entries.size(); ++i) {
+        out << std::left << std::setw(static_cast<int>(locationWidth)) << locations[i] << "  "
+            << std::setw(static_cast<int>(nameWidth)) << names[entries[i].varIndex] << std::right
+            << "  " << std::setw(12) << entries[i].reads << "  " << std::setw(12) << entries[i].writes << "\n";
+    }
+}
@@ -1,52 +1,328 @@
 #include "args.hpp"
+#include "debugger.hpp"
+#include "predicate.hpp"
+#include "stack_table.hpp"
 
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
 
-bool parseArguments(const int& argc, char** argv, Arguments& args) {
-    if (argc < 5) {
+/**
+ * Parses a duration in microseconds, "<n>us" (or "<n>µs"); with requireUnit false a bare number is accepted too.
+ */
+static bool parseMicros(const char* text, bool requireUnit, uint64_t& nanos) {
+    char* end = nullptr;
+    const unsigned long long micros = std::strtoull(text, &end, 10);
+    if (end == text || micros == 0)
         return false;
-    }
-
-    if (std::strcmp(argv[1], "--var") != 0) {
-        std::cerr << "Error: Expected '--var' as first argument\n";
+    const bool unit = std::strcmp(end, "us") == 0 || std::strcmp(end, "\u00b5s") == 0;
+    if (!unit && (requireUnit || *end != '\0'))
         return false;
+    nanos = static_cast<uint64_t>(micros) * 1000;
+    return true;
+}
+
+bool parseArguments(const int& argc, char** argv, Arguments& args) {
+    args.variables.clear();
+    args.execPath.clear();
+    args.execArgs = nullptr;
+    args.backend = BackendKind::Ptrace;
+    args.attachPid = 0;
+    args.options = TracerOptions{};
+
+    WatchMode mode = WatchMode::ReadWrite;
+    std::shared_ptr<const Predicate> condition;
+    int i = 1;
+    for (; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--var") == 0) {
+            if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+                std::cerr << "Error: Symbol name cannot be empty\n";
+                return false;
+            }
+            VariableSpec spec;
+            spec.symbol = argv[++i];
+            // "lib.so:symbol" names a global of a shared library; plain symbols live in the executable.
+            const size_t colon = spec.symbol.find(':');
+            if (colon != std::string::npos && spec.symbol.find(".so") < colon) {
+                spec.library = spec.symbol.substr(0, colon);
+                spec.symbol.erase(0, colon + 1);
+                if (spec.symbol.empty()) {
+                    std::cerr << "Error: Symbol name cannot be empty\n";
+                    return false;
+                }
+            }
+            spec.mode = mode;
+            spec.condition = condition;
+            args.variables.push_back(std::move(spec));
+        } else if (std::strcmp(argv[i], "--range") == 0) {
+            if (args.variables.empty() || args.variables.back().address != 0) {
+                std::cerr << "Error: '--range' applies to the preceding '--var'\n";
+                return false;
+            }
+            args.variables.back().range = true;
+        } else if (std::strcmp(argv[i], "--addr") == 0) {
+            char* end = nullptr;
+            const unsigned long long address = i + 1 < argc ? std::strtoull(argv[i + 1], &end, 16) : 0;
+            if (address == 0 || *end != '\0') {
+                std::cerr << "Error: '--addr' expects a non-zero hexadecimal address\n";
+                return false;
+            }
+            VariableSpec spec;
+            spec.symbol = argv[++i];
+            spec.address = static_cast<uintptr_t>(address);
+            spec.range = true;
+            spec.mode = mode;
+            spec.condition = condition;
+            args.variables.push_back(std::move(spec));
+        } else if (std::strcmp(argv[i], "--len") == 0) {
+            char* end = nullptr;
+            const unsigned long long length = i + 1 < argc ? std::strtoull(argv[i + 1], &end, 0) : 0;
+            if (length == 0 || *end != '\0') {
+                std::cerr << "Error: '--len' expects a positive number of bytes\n";
+                return false;
+            }
+            if (args.variables.empty() || args.variables.back().address == 0) {
+                std::cerr << "Error: '--len' applies to the preceding '--addr'\n";
+                return false;
+            }
+            args.variables.back().length = static_cast<size_t>(length);
+            ++i;
+        } else if (std::strcmp(argv[i], "--when") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: '--when' expects a condition\n";
+                return false;
+            }
+            try {
+                condition = std::make_shared<const Predicate>(Predicate::compile(argv[++i]));
+            } catch (const std::invalid_argument &e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return false;
+            }
+        } else if (std::strncmp(argv[i], "--mode=", 7) == 0) {
+            const char* const name = argv[i] + 7;
+            if (std::strcmp(name, "write") == 0) {
+                mode = WatchMode::Write;
+            } else if (std::strcmp(name, "rw") == 0) {
+                mode = WatchMode::ReadWrite;
+            } else if (std::strcmp(name, "exec") == 0) {
+                mode = WatchMode::Execute;
+            } else {
+                std::cerr << "Error: Unknown watch mode '" << name << "' (expected write, rw or exec)\n";
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--exec") == 0) {
+            if (i + 1 >= argc || argv[i + 1][0] == '\0') {
+                std::cerr << "Error: Executable path cannot be empty\n";
+                return false;
+            }
+            args.execPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--pid") == 0) {
+            char* end = nullptr;
+            const long pid = i + 1 < argc ? std::strtol(argv[i + 1], &end, 10) : 0;
+            if (pid <= 0 || *end != '\0') {
+                std::cerr << "Error: '--pid' expects a positive process ID\n";
+                return false;
+            }
+            args.attachPid = static_cast<int>(pid);
+            ++i;
+        } else if (std::strncmp(argv[i], "--queue=", 8) == 0) {
+            const char* const policy = argv[i] + 8;
+            if (std::strcmp(policy, "block") == 0) {
+                args.options.queuePolicy = QueuePolicy::Block;
+            } else if (std::strcmp(policy, "drop") == 0) {
+                args.options.queuePolicy = QueuePolicy::Drop;
+            } else {
+                std::cerr << "Error: Unknown queue policy '" << policy << "' (expected block or drop)\n";
+                return false;
+            }
+        } else if (std::strncmp(argv[i], "--queue-size=", 13) == 0) {
+            char* end = nullptr;
+            const unsigned long long size = std::strtoull(argv[i] + 13, &end, 10);
+            if (size == 0 || *end != '\0' || (size & (size - 1)) != 0) {
+                std::cerr << "Error: '--queue-size' expects a power of two\n";
+                return false;
+            }
+            args.options.queueCapacity = size;
+        } else if (std::strcmp(argv[i], "--profile") == 0) {
+            args.options.profileTop = 20;
+        } else if (std::strncmp(argv[i], "--profile=", 10) == 0) {
+            char* end = nullptr;
+            const long rows = std::strtol(argv[i] + 10, &end, 10);
+            if (rows <= 0 || *end != '\0') {
+                std::cerr << "Error: '--profile' expects a positive number of rows\n";
+                return false;
+            }
+            args.options.profileTop = static_cast<size_t>(rows);
+        } else if (std::strcmp(argv[i], "--record") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: '--record' expects a file name\n";
+                return false;
+            }
+            args.options.recordPath = argv[++i];
+        } else if (std::strncmp(argv[i], "--coalesce=", 11) == 0) {
+            // A bare number caps the accesses per run; a duration sets the gap that ends one.
+            const char* const limit = argv[i] + 11;
+            char* end = nullptr;
+            const unsigned long long count = std::strtoull(limit, &end, 10);
+            if (end != limit && count > 0 && *end == '\0') {
+                args.options.coalesceEvents = static_cast<size_t>(count);
+            } else if (!parseMicros(limit, true, args.options.coalesceGap)) {
+                std::cerr << "Error: '--coalesce' expects a number of events or a gap in microseconds (e.g. 200us)\n";
+                return false;
+            }
+            args.options.coalesce = true;
+        } else if (std::strncmp(argv[i], "--coalesce-pause=", 17) == 0) {
+            if (!parseMicros(argv[i] + 17, false, args.options.coalescePause)) {
+                std::cerr << "Error: '--coalesce-pause' expects a positive number of microseconds\n";
+                return false;
+            }
+        } else if (std::strncmp(argv[i], "--overhead-budget=", 18) == 0) {
+            const char* const budget = argv[i] + 18;
+            char* end = nullptr;
+            const double percent = std::strtod(budget, &end);
+            if (end == budget || !(percent > 0 && percent < 100) || (std::strcmp(end, "%") != 0 && *end != '\0')) {
+                std::cerr << "Error: '--overhead-budget' expects a percentage between 0 and 100 (e.g. 2%)\n";
+                return false;
+            }
+            args.options.overheadBudget = percent / 100;
+        } else if (std::strncmp(argv[i], "--backtrace=", 12) == 0) {
+            char* end = nullptr;
+            const long depth = std::strtol(argv[i] + 12, &end, 10);
+            if (depth <= 0 || depth > static_cast<long>(StackTable::MAX_DEPTH) || *end != '\0') {
+                std::cerr << "Error: '--backtrace' expects a number of frames from 1 to " << StackTable::MAX_DEPTH << "\n";
+                return false;
+            }
+            args.options.backtraceDepth = static_cast<size_t>(depth);
+        } else if (std::strcmp(argv[i], "--only-in") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: '--only-in' expects a function name\n";
+                return false;
+            }
+            args.options.scopeFunctions.emplace_back(argv[++i]);
+        } else if (std::strcmp(argv[i], "--control") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: '--control' expects a socket path\n";
+                return false;
+            }
+            args.options.controlPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: '--stats' expects a file name\n";
+                return false;
+            }
+            args.options.statsPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--follow-children") == 0) {
+            args.options.followChildren = true;
+        } else if (std::strncmp(argv[i], "--backend=", 10) == 0) {
+            const char* const name = argv[i] + 10;
+            if (std::strcmp(name, "ptrace") == 0) {
+                args.backend = BackendKind::Ptrace;
+            } else if (std::strcmp(name, "perf") == 0) {
+                args.backend = BackendKind::Perf;
+            } else {
+                std::cerr << "Error: Unknown backend '" << name << "' (expected perf or ptrace)\n";
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--") == 0) {
+            args.execArgs = argv + i + 1;
+            break;
+        } else {
+            std::cerr << "Error: Unknown argument '" << argv[i] << "'\n";
+            return false;
+        }
     }
-    args.symbol = argv[2];
 
-    if (args.symbol.empty()) {
-        std::cerr << "Error: Symbol name cannot be empty\n";
+    if (args.variables.empty()) {
+        std::cerr << "Error: Expected at least one '--var'\n";
         return false;
     }
 
-    if (std::strcmp(argv[3], "--exec") != 0) {
-        std::cerr << "Error: Expected '--exec' as third argument\n";
+    // The compatibility rules are libgwatch's, so the command line and the API reject the same settings.
+    try {
+        validateOptions(args.backend, args.options);
+        for (const auto& spec : args.variables) {
+            if (spec.address != 0 && spec.length == 0)
+                throw std::invalid_argument("'--addr " + spec.symbol + "' needs a '--len'");
+            WatchedVariable var{ spec.symbol };
+            var.library = spec.library;
+            var.mode = spec.mode;
+            var.condition = spec.condition;
+            var.range = spec.range;
+            validateVariable(var, args.backend, args.options);
+        }
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "Error: " << e.what() << "\n";
         return false;
     }
-    args.execPath = argv[4];
 
-    if (args.execPath.empty()) {
-        std::cerr << "Error: Executable path cannot be empty\n";
+    if (args.execPath.empty() == (args.attachPid == 0)) {
+        std::cerr << "Error: Expected exactly one of '--exec' or '--pid'\n";
         return false;
     }
 
-    if (argc > 5) {
-        if (std::strcmp(argv[5], "--") != 0) {
-            std::cerr << "Error: Expected '--' before program arguments\n";
-            return false;
-        }
-        args.execArgs = argv + 6;
-    } else {
-        args.execArgs = nullptr;
+    if (args.attachPid != 0 && args.execArgs != nullptr) {
+        std::cerr << "Error: Program arguments cannot be passed with '--pid'\n";
+        return false;
     }
 
     return true;
 }
 
 void printUsage(const char* programName) {
-    std::cerr << "Usage: " << programName << " --var <symbol> --exec <path> [-- arg1 ... argN]\n";
+    std::cerr << "Usage: " << programName << " [--mode=...] [--when <cond>] --var <symbol> [--range] [[--mode=...] [--when <cond>] --var <symbol> ...]\n"
+              << "       [--addr <hex> --len <n> ...]\n"
+              << "       (--exec <path> | --pid <pid>)\n"
+              << "       [--backend=ptrace|perf] [--follow-children] [--profile[=<n>]] [--record <file>]\n"
+              << "       [--coalesce=<n>|<t>us [--coalesce-pause=<t>us]] [--overhead-budget=<p>%] [--backtrace=<n>]\n"
+              << "       [--only-in <function> ...] [--control <socket>] [--stats <file>]\n"
+              << "       [--queue=block|drop] [--queue-size=<n>] [-- arg1 ... argN]\n";
     std::cerr << "\nOptions:\n";
-    std::cerr << "  --var <symbol>    Symbol/variable to watch\n";
+    std::cerr << "  --var <symbol>    Symbol/variable to watch (repeat for up to 4 variables);\n";
+    std::cerr << "                    <lib.so>:<symbol> watches a global of a shared library, armed when it is loaded;\n";
+    std::cerr << "                    <symbol>.<field> and <symbol>[<index>] watch one member (needs -g debug info)\n";
+    std::cerr << "  --range           Watch every byte of the preceding '--var' whatever its size, split across\n";
+    std::cerr << "                    debug registers or, when too large, guarded with page protection (ptrace)\n";
+    std::cerr << "  --addr <hex>      Watch a raw range of the executable at a link-time address (as in 'nm')\n";
+    std::cerr << "  --len <n>         Length in bytes of the preceding '--addr'\n";
+    std::cerr << "  --mode=<mode>     Accesses reported for the '--var' options that follow it:\n";
+    std::cerr << "                    rw (default): reads and writes, write: writes only,\n";
+    std::cerr << "                    exec: execution of the instruction at the symbol (a function)\n";
+    std::cerr << "  --when <cond>     Report only accesses matching the condition, for the '--var' options that\n";
+    std::cerr << "                    follow it, e.g. 'new > 1000 && new != old'. Names: old, new, tid;\n";
+    std::cerr << "                    operators: || && == != < <= > >= + - * / % ! and parentheses\n";
     std::cerr << "  --exec <path>     Path to executable to run\n";
+    std::cerr << "  --pid <pid>       Attach to a running process; Ctrl-C detaches and leaves it running\n";
+    std::cerr << "  --backend=<kind>  ptrace (default): stop on every access and report values\n";
+    std::cerr << "                    perf: sample accesses into a ring buffer without stopping the target\n";
+    std::cerr << "  --follow-children Also watch forked children and what they exec, re-resolving the variables\n";
+    std::cerr << "                    in a different binary; events are tagged with the PID (ptrace backend)\n";
+    std::cerr << "  --profile[=<n>]   Count accesses per instruction instead of printing them and show the\n";
+    std::cerr << "                    n busiest as function+offset at exit (default 20; ptrace backend)\n";
+    std::cerr << "  --record <file>   Write compact binary event records to <file> (.gwt) instead of text lines;\n";
+    std::cerr << "                    read them back with gwatch-report\n";
+    std::cerr << "  --coalesce=<n>|<t>us\n";
+    std::cerr << "                    Print each run of accesses by one thread from one instruction as one line\n";
+    std::cerr << "                    with the count and duration: runs of at most n accesses, or runs ended by\n";
+    std::cerr << "                    a gap of t microseconds (default gap 10ms)\n";
+    std::cerr << "  --coalesce-pause=<t>us\n";
+    std::cerr << "                    Disarm the watchpoint of a run for t microseconds after every 16 accesses;\n";
+    std::cerr << "                    accesses in the pause are not counted (ptrace backend)\n";
+    std::cerr << "  --overhead-budget=<p>%\n";
+    std::cerr << "                    Keep the target stopped at most p% of the time: watchpoints are armed in\n";
+    std::cerr << "                    10ms windows and disarmed in between as needed; events carry the sampled\n";
+    std::cerr << "                    share and totals are scaled estimates (ptrace backend)\n";
+    std::cerr << "  --backtrace=<n>   Tag each event with its call stack of up to n frames, walked through frame\n";
+    std::cerr << "                    pointers; the distinct stacks are printed at exit (ptrace backend)\n";
+    std::cerr << "  --only-in <func>  Arm the watchpoints of a thread only while it is inside the function (repeat\n";
+    std::cerr << "                    for several); entry and return are caught with int3 breakpoints (ptrace)\n";
+    std::cerr << "  --control <socket>\n";
+    std::cerr << "                    Take commands on a Unix socket while tracing: add [--mode=...] <symbol>,\n";
+    std::cerr << "                    remove <symbol>, list, pause, resume, stats (ptrace backend)\n";
+    std::cerr << "  --stats <file>    Write what tracing costs as JSON to <file> at exit and on SIGUSR1: traps per\n";
+    std::cerr << "                    second and histograms of stopped time, ptrace calls, read latency, queue depth\n";
+    std::cerr << "  --queue=<policy>  block (default): stall the tracer when the output queue is full\n";
+    std::cerr << "                    drop: discard events when the output queue is full and count them\n";
+    std::cerr << "  --queue-size=<n>  Output queue capacity in events, a power of two (default 65536)\n";
     std::cerr << "  -- arg1 ... argN  Optional arguments to pass to the executable\n";
-}
\ No newline at end of file
+}
@@ -0,0 +1,98 @@
+#include "breakpoints.hpp"
+#include "ptrace_utils.hpp"
+
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr uint8_t INT3 = 0xcc;
+
+/**
+ * Replaces one byte of code, returning the one it held. The aligned word around it is
+ * patched so the access never crosses into a following unmapped page.
+ */
+uint8_t patchByte(pid_t tid, uintptr_t address, uint8_t byte) {
+    const uintptr_t word = address & ~(sizeof(long) - 1);
+    const unsigned shift = static_cast<unsigned>(address - word) * 8;
+
+    errno = 0;
+    const long data = ptraceRequest(PTRACE_PEEKTEXT, tid, reinterpret_cast<void*>(word), nullptr);
+    if (data == -1 && errno != 0)
+        throw std::runtime_error(std::string("Failed to read code for a breakpoint: ") + std::strerror(errno));
+
+    const auto value = static_cast<unsigned long>(data);
+    const auto patched = (value & ~(0xffUL << shift)) | (static_cast<unsigned long>(byte) << shift);
+    ptraceChecked(PTRACE_POKETEXT, tid, reinterpret_cast<void*>(word), reinterpret_cast<void*>(patched),
+                  "ptrace(PTRACE_POKETEXT) failed");
+    return static_cast<uint8_t>(value >> shift);
+}
+
+}
+
+void BreakpointSet::insertEntry(pid_t tid, uintptr_t address) {
+    const auto [it, added] = sites.try_emplace(address);
+    if (added)
+        it->second.original = patchByte(tid, address, INT3);
+    it->second.entry = true;
+}
+
+void BreakpointSet::insertReturn(pid_t tid, uintptr_t address) {
+    const auto [it, added] = sites.try_emplace(address);
+    if (added) {
+        try {
+            it->second.original = patchByte(tid, address, INT3);
+        } catch (...) {
+            sites.erase(it);
+            throw;
+        }
+    }
+    ++it->second.returns;
+}
+
+void BreakpointSet::releaseReturn(pid_t tid, uintptr_t address) {
+    const auto it = sites.find(address);
+    if (it == sites.end() || it->second.returns == 0)
+        return;
+    if (--it->second.returns > 0 || it->second.entry)
+        return;
+    patchByte(tid, address, it->second.original);
+    sites.erase(it);
+}
+
+const BreakpointSet::Site* BreakpointSet::find(uintptr_t address) const {
+    const auto it = sites.find(address);
+    return it != sites.end() ? &it->second : nullptr;
+}
+
+bool BreakpointSet::stepOver(pid_t tid, uintptr_t address, int& deferredSignal) {
+    user_regs_struct regs{};
+    ptraceChecked(PTRACE_GETREGS, tid, nullptr, &regs, "ptrace(PTRACE_GETREGS) failed");
+    regs.rip = address;
+    ptraceChecked(PTRACE_SETREGS, tid, nullptr, &regs, "ptrace(PTRACE_SETREGS) failed");
+
+    const auto it = sites.find(address);
+    if (it == sites.end())
+        return true;  // removed already: the original instruction simply runs on resume
+    patchByte(tid, address, it->second.original);
+    if (!singleStep(tid, deferredSignal)) {
+        // Its process may live on; the breakpoint stays off rather than be planted through a dead thread.
+        sites.erase(it);
+        return false;
+    }
+    patchByte(tid, address, INT3);
+    return true;
+}
+
+void BreakpointSet::restoreCode(pid_t tid) {
+    if (!planted)
+        return;
+    planted = false;
+    for (const auto& [address, site] : sites)
+        patchByte(tid, address, site.original);
+}
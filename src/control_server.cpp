@@ -0,0 +1,233 @@
+#include "control_server.hpp"
+#include "ptrace_utils.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+/** Interval at which a command that the tracer has not taken yet wakes it again. */
+constexpr auto WAKE_INTERVAL = std::chrono::milliseconds(10);
+
+/** Longest command line accepted; a client sending more is disconnected. */
+constexpr size_t MAX_LINE = 4096;
+
+/** Writes a whole reply, giving up when the client went away. */
+void writeAll(int fd, const std::string& text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        const ssize_t n = send(fd, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        written += static_cast<size_t>(n);
+    }
+}
+
+}
+
+ControlCommand parseControlCommand(const std::string& line) {
+    std::istringstream in(line);
+    std::vector<std::string> words;
+    for (std::string word; in >> word;)
+        words.push_back(word);
+    if (words.empty())
+        throw std::invalid_argument("empty command");
+
+    ControlCommand command;
+    const std::string& verb = words.front();
+    if (verb == "list" || verb == "pause" || verb == "resume" || verb == "stats") {
+        if (words.size() != 1)
+            throw std::invalid_argument("'" + verb + "' takes no arguments");
+        command.kind = verb == "list" ? ControlCommand::Kind::List
+                     : verb == "pause" ? ControlCommand::Kind::Pause
+                     : verb == "resume" ? ControlCommand::Kind::Resume
+                     : ControlCommand::Kind::Stats;
+        return command;
+    }
+
+    if (verb == "remove") {
+        if (words.size() != 2)
+            throw std::invalid_argument("usage: remove <symbol>");
+        command.kind = ControlCommand::Kind::Remove;
+        command.symbol = words[1];
+        return command;
+    }
+
+    if (verb == "add") {
+        command.kind = ControlCommand::Kind::Add;
+        size_t next = 1;
+        if (words.size() > next && words[next].starts_with("--mode=")) {
+            const std::string mode = words[next].substr(7);
+            if (mode == "write")
+                command.mode = WatchMode::Write;
+            else if (mode == "rw")
+                command.mode = WatchMode::ReadWrite;
+            else if (mode == "exec")
+                command.mode = WatchMode::Execute;
+            else
+                throw std::invalid_argument("unknown mode '" + mode + "' (expected write, rw or exec)");
+            ++next;
+        }
+        if (words.size() != next + 1)
+            throw std::invalid_argument("usage: add [--mode=write|rw|exec] <symbol>");
+        command.symbol = words[next];
+        return command;
+    }
+
+    throw std::invalid_argument("unknown command '" + verb + "'");
+}
+
+ControlServer::ControlServer(const std::string& path, pthread_t tracer) : path(path), tracer(tracer) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("Invalid control socket path '" + path + "'");
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // A socket left behind by an earlier run would make bind() fail; anything else is kept.
+    struct stat existing{};
+    if (lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode))
+        unlink(path.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener == -1)
+        throw std::runtime_error(std::string("socket() failed: ") + std::strerror(errno));
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1 ||
+        chmod(path.c_str(), 0600) == -1 || listen(listener, 4) == -1) {
+        const std::string error = std::strerror(errno);
+        close(listener);
+        throw std::runtime_error("Cannot listen on control socket '" + path + "': " + error);
+    }
+
+    stopEvent = eventfd(0, EFD_CLOEXEC);
+    if (stopEvent == -1) {
+        const std::string error = std::strerror(errno);
+        close(listener);
+        unlink(path.c_str());
+        throw std::runtime_error("eventfd() failed: " + error);
+    }
+    server = std::thread(&ControlServer::serve, this);
+}
+
+ControlServer::~ControlServer() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    answered.notify_all();
+    const uint64_t one = 1;
+    while (write(stopEvent, &one, sizeof(one)) == -1 && errno == EINTR) {
+    }
+    server.join();
+    close(stopEvent);
+    close(listener);
+    unlink(path.c_str());
+}
+
+bool ControlServer::take(std::string& line) {
+    std::lock_guard lock(mutex);
+    if (state != State::Waiting)
+        return false;
+    line = command;
+    state = State::Taken;
+    waiting.store(false, std::memory_order_release);
+    return true;
+}
+
+void ControlServer::answer(std::string text) {
+    {
+        std::lock_guard lock(mutex);
+        if (state != State::Taken)
+            return;
+        reply = std::move(text);
+        state = State::Answered;
+    }
+    answered.notify_all();
+}
+
+std::string ControlServer::dispatch(const std::string& line) {
+    std::unique_lock lock(mutex);
+    if (stopping)
+        return "error: the tracer has stopped\n";
+    command = line;
+    state = State::Waiting;
+    waiting.store(true, std::memory_order_release);
+
+    // The tracer may be blocked in waitpid(); a wakeup that lands before it blocks is lost,
+    // so it is repeated until the command has been taken.
+    while (state != State::Answered && !stopping) {
+        if (state == State::Waiting)
+            wakeTracer(tracer);
+        answered.wait_for(lock, WAKE_INTERVAL);
+    }
+
+    std::string text = state == State::Answered ? std::move(reply) : "error: the tracer has stopped\n";
+    state = State::Idle;
+    waiting.store(false, std::memory_order_release);
+    return text;
+}
+
+void ControlServer::serve() {
+    while (true) {
+        pollfd fds[] = { { listener, POLLIN, 0 }, { stopEvent, POLLIN, 0 } };
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents != 0)
+            return;
+
+        const int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client == -1)
+            continue;
+        serveClient(client);
+        close(client);
+    }
+}
+
+void ControlServer::serveClient(int client) {
+    std::string buffer;
+    char data[512];
+    while (true) {
+        pollfd fds[] = { { client, POLLIN, 0 }, { stopEvent, POLLIN, 0 } };
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents != 0)
+            return;
+
+        const ssize_t n = read(client, data, sizeof(data));
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        buffer.append(data, static_cast<size_t>(n));
+
+        size_t end;
+        while ((end = buffer.find('\n')) != std::string::npos) {
+            std::string line = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            writeAll(client, dispatch(line));
+        }
+        if (buffer.size() > MAX_LINE) {
+            writeAll(client, "error: command too long\n");
+            return;
+        }
+    }
+}
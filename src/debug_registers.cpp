@@ -0,0 +1,141 @@
+#include "debug_registers.hpp"
+#include "ptrace_utils.hpp"
+
+#include <sys/ptrace.h>
+#include <sys/user.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#include <stdexcept>
+#include <string>
+
+static void* debugRegOffset(int index) {
+    return reinterpret_cast<void*>(offsetof(user, u_debugreg) + index * sizeof(long));
+}
+
+long drLenCode(const size_t& size) {
+    switch (size) {
+        case 1: return 0b00;
+        case 2: return 0b01;
+        case 4: return 0b11;
+        case 8: return 0b10;
+        default: return -1;
+    }
+}
+
+uint64_t drRwCode(WatchMode mode) {
+    switch (mode) {
+        case WatchMode::Execute: return 0b00;
+        case WatchMode::Write: return 0b01;
+        case WatchMode::ReadWrite: return 0b11;
+    }
+    return 0b11;
+}
+
+std::vector<WatchChunk> planChunks(uintptr_t address, size_t size) {
+    std::vector<WatchChunk> chunks;
+    const uintptr_t end = address + size;
+    while (address < end) {
+        size_t chunk = 8;
+        while (address % chunk != 0 || chunk > end - address)
+            chunk /= 2;
+        chunks.push_back(WatchChunk{ address, chunk });
+        address += chunk;
+    }
+    return chunks;
+}
+
+int DebugRegisterState::allocate(uintptr_t address, size_t size, WatchMode mode) {
+    for (int slot = 0; slot < DEBUG_SLOT_COUNT; ++slot) {
+        if (isUsed(slot))
+            continue;
+        assign(slot, address, size, mode);
+        return slot;
+    }
+
+    throw std::runtime_error("No free debug register slot (at most " +
+                             std::to_string(DEBUG_SLOT_COUNT) + " watchpoints)");
+}
+
+void DebugRegisterState::assign(int slot, uintptr_t address, size_t size, WatchMode mode) {
+    if (mode == WatchMode::Execute)
+        size = 1;
+
+    const long lenCode = drLenCode(size);
+    if (lenCode < 0)
+        throw std::runtime_error("Unsupported variable size for watchpoint: " + std::to_string(size));
+    if (address % size != 0)
+        throw std::runtime_error("Watched address is not aligned to its size");
+
+    const int shift = 16 + slot * 4;
+    addresses[slot] = address;
+    dr7 &= ~(0xFUL << shift);
+    dr7 |= (drRwCode(mode) | (static_cast<uint64_t>(lenCode) << 2)) << shift;
+    dr7 |= 1UL << (slot * 2);
+}
+
+void DebugRegisterState::release(int slot) {
+    dr7 &= ~(0b11UL << (slot * 2));
+    dr7 &= ~(0xFUL << (16 + slot * 4));
+    addresses[slot] = 0;
+}
+
+int DebugRegisterState::freeSlots() const {
+    int count = 0;
+    for (int slot = 0; slot < DEBUG_SLOT_COUNT; ++slot) {
+        if (!isUsed(slot)) ++count;
+    }
+    return count;
+}
+
+static uint64_t peekDebugRegister(pid_t tid, int index) {
+    errno = 0;
+    const long value = ptraceRequest(PTRACE_PEEKUSER, tid, debugRegOffset(index), nullptr);
+    if (value == -1 && errno != 0)
+        throw std::runtime_error("Failed to read DR" + std::to_string(index) + ": " + std::strerror(errno));
+    return static_cast<uint64_t>(value);
+}
+
+DebugRegisterState DebugRegisterState::capture(pid_t tid) {
+    DebugRegisterState state;
+    for (int slot = 0; slot < DEBUG_SLOT_COUNT; ++slot)
+        state.addresses[slot] = peekDebugRegister(tid, slot);
+    state.dr7 = peekDebugRegister(tid, 7);
+    return state;
+}
+
+void DebugRegisterState::apply(pid_t tid) const {
+    // DR7 is cleared first so the kernel never sees an enabled slot paired with a stale address.
+    ptraceChecked(PTRACE_POKEUSER, tid, debugRegOffset(7), nullptr, "Failed to clear DR7");
+
+    for (int slot = 0; slot < DEBUG_SLOT_COUNT; ++slot) {
+        if (!isUsed(slot))
+            continue;
+        ptraceChecked(PTRACE_POKEUSER, tid, debugRegOffset(slot),
+                      reinterpret_cast<void*>(addresses[slot]),
+                      "Failed to set debug address register");
+    }
+
+    ptraceChecked(PTRACE_POKEUSER, tid, debugRegOffset(7),
+                  reinterpret_cast<void*>(dr7),
+                  "Failed to write DR7");
+}
+
+int decodeDr6(uint64_t dr6, std::array<int, DEBUG_SLOT_COUNT>& slots) {
+    int count = 0;
+    for (int slot = 0; slot < DEBUG_SLOT_COUNT; ++slot) {
+        if ((dr6 & (1UL << slot)) != 0)
+            slots[count++] = slot;
+    }
+    return count;
+}
+
+uint64_t readDebugStatus(pid_t tid) {
+    return peekDebugRegister(tid, 6);
+}
+
+void clearDebugStatus(pid_t tid) {
+    ptraceChecked(PTRACE_POKEUSER, tid, debugRegOffset(6), nullptr, "Failed to clear DR6");
+}
@@ -1,33 +1,130 @@
 #include "debugger.hpp"
+#include "debug_registers.hpp"
+#include "elf_utils.hpp"
+#include "event_writer.hpp"
 #include "memory_utils.hpp"
+#include "ptrace_utils.hpp"
+#include "trace_file.hpp"
+#include "watch_backend.hpp"
 
 #include <sys/ptrace.h>
 #include <sys/wait.h>
-#include <sys/user.h>
 #include <sys/types.h>
 
 #include <unistd.h>
 #include <cerrno>
+#include <csignal>
 #include <cstring>
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <set>
 #include <stdexcept>
 
-static void ptraceChecked(int request, const pid_t& pid, void* addr, void* data, const char* errMsg) {
-    errno = 0;
-    if (ptrace(static_cast<__ptrace_request>(request), pid, addr, data) == -1 && errno != 0) {
-        throw std::runtime_error(std::string(errMsg) + ": " + std::strerror(errno));
-    }
+void validateOptions(BackendKind backend, const TracerOptions& options) {
+    const bool perf = backend == BackendKind::Perf;
+    const bool profile = options.profileTop > 0;
+    const bool record = !options.recordPath.empty();
+
+    if (profile && perf)
+        throw std::invalid_argument("'--profile' is only supported by the ptrace backend");
+    if (profile && record)
+        throw std::invalid_argument("'--profile' and '--record' cannot be combined");
+    if (options.coalesce && (profile || record))
+        throw std::invalid_argument("'--coalesce' cannot be combined with '--profile' or '--record', which keep every access");
+    if ((options.coalesceEvents > 0 || options.coalesceGap > 0) && !options.coalesce)
+        throw std::invalid_argument("Coalescing limits need '--coalesce'");
+    if (options.coalescePause > 0 && !options.coalesce)
+        throw std::invalid_argument("'--coalesce-pause' needs '--coalesce'");
+    if (options.coalescePause > 0 && perf)
+        throw std::invalid_argument("'--coalesce-pause' is only supported by the ptrace backend");
+    if (options.overheadBudget > 0 && perf)
+        throw std::invalid_argument("'--overhead-budget' is only supported by the ptrace backend (perf never stops the target)");
+    if (options.backtraceDepth > 0 && perf)
+        throw std::invalid_argument("'--backtrace' is only supported by the ptrace backend");
+    if (options.backtraceDepth > 0 && (profile || record))
+        throw std::invalid_argument("'--backtrace' cannot be combined with '--profile' or '--record', which keep no stacks");
+    if (!options.scopeFunctions.empty() && perf)
+        throw std::invalid_argument("'--only-in' is only supported by the ptrace backend");
+    if (!options.controlPath.empty() && perf)
+        throw std::invalid_argument("'--control' is only supported by the ptrace backend");
+    if (!options.controlPath.empty() && record)
+        throw std::invalid_argument("'--control' cannot be combined with '--record', whose variable table is fixed");
+    if (options.followChildren && perf)
+        throw std::invalid_argument("'--follow-children' is only supported by the ptrace backend");
+}
+
+void validateVariable(const WatchedVariable& var, BackendKind backend, const TracerOptions& options) {
+    const bool perf = backend == BackendKind::Perf;
+
+    if (!var.library.empty() && perf)
+        throw std::invalid_argument("shared library variables are only supported by the ptrace backend (" + var.name + ")");
+    if (var.tls && perf)
+        throw std::invalid_argument("Thread-local variables need the ptrace backend to find each thread's instance (" +
+                                    var.name + ")");
+    if (var.range && !var.library.empty())
+        throw std::invalid_argument("'--range' is not supported for shared library variables (" + var.name + ")");
+    if (var.range && var.tls)
+        throw std::invalid_argument("'--range' is not supported for thread-local variables (" + var.name + ")");
+    if (var.range && var.mode == WatchMode::Execute)
+        throw std::invalid_argument("'--range' cannot be combined with '--mode=exec' (" + var.name + ")");
+    if (options.profileTop > 0 && var.mode == WatchMode::Execute)
+        throw std::invalid_argument("'--profile' cannot be combined with '--mode=exec' (" + var.name + ")");
+    if (var.condition != nullptr && perf)
+        throw std::invalid_argument("'--when' needs the values only the ptrace backend reads (" + var.name + ")");
+    if (var.condition != nullptr && var.mode == WatchMode::Execute)
+        throw std::invalid_argument("'--when' cannot be combined with '--mode=exec' (" + var.name + ")");
 }
 
-static long dr_len_code(const size_t& size) {
-    switch (size) {
-        case 1: return 0b00;
-        case 2: return 0b01;
-        case 4: return 0b11;
-        case 8: return 0b10;
-        default: return -1;
+std::vector<WatchedVariable> expandRanges(const std::vector<WatchedVariable>& vars, BackendKind backend) {
+    int freeSlots = DEBUG_SLOT_COUNT;
+    bool libraryVars = false;
+    for (const auto& var : vars) {
+        if (!var.range)
+            --freeSlots;
+        libraryVars = libraryVars || !var.library.empty();
+    }
+    if (libraryVars)
+        --freeSlots;  // dynamic linker hook
+
+    std::vector<WatchedVariable> expanded;
+    for (const auto& var : vars) {
+        if (!var.range) {
+            expanded.push_back(var);
+            continue;
+        }
+
+        if (var.size == 0)
+            throw std::invalid_argument("'" + var.name + "' has size 0; '--range' needs an object with a size");
+
+        // Debug registers cost nothing until the range is accessed, so they win whenever the
+        // chunks fit; page protection takes a fault, a step and two mprotect() calls per access.
+        const std::vector<WatchChunk> chunks = planChunks(var.symbolOffset, var.size);
+        const bool guarded = static_cast<int>(chunks.size()) > std::max(freeSlots, 0);
+        if (guarded && backend != BackendKind::Ptrace)
+            throw std::invalid_argument("'" + var.name + "' needs " + std::to_string(chunks.size()) +
+                                        " debug registers; larger ranges need the ptrace backend");
+        if (!guarded)
+            freeSlots -= static_cast<int>(chunks.size());
+
+        for (const WatchChunk& chunk : chunks) {
+            const uintptr_t offset = chunk.address - var.symbolOffset;
+            WatchedVariable piece = var;
+            piece.name = offset == 0 ? var.name : var.name + "+" + std::to_string(offset);
+            piece.symbolOffset = chunk.address;
+            piece.size = chunk.size;
+            piece.range = false;
+            piece.guarded = guarded;
+            if (chunks.size() > 1)
+                piece.type = nullptr;
+            expanded.push_back(std::move(piece));
+        }
     }
+
+    if (expanded.size() > UINT16_MAX)
+        throw std::invalid_argument("Too many variables and range chunks to watch (" + std::to_string(expanded.size()) + ")");
+    return expanded;
 }
 
 Debugger::Debugger(std::string programPath,
@@ -35,23 +132,47 @@ Debugger::Debugger(std::string programPath,
                    uintptr_t varAddress,
                    size_t varSize,
                    char** execArgs)
+    : Debugger(std::move(programPath),
+               std::vector<WatchedVariable>{ WatchedVariable{ std::move(varName), varAddress, varSize } },
+               execArgs) {}
+
+Debugger::Debugger(std::string programPath,
+                   std::vector<WatchedVariable> variables,
+                   char** execArgs,
+                   BackendKind backend,
+                   TracerOptions options)
     : programPath(std::move(programPath)),
-      varName(std::move(varName)),
-      symbolOffset(varAddress),
-      varSize(varSize),
-      execArgs(execArgs) {}
+      execArgs(execArgs),
+      backend(backend),
+      options(std::move(options)) {
+    if (variables.empty())
+        throw std::invalid_argument("Debugger needs at least one variable to watch");
+    validateOptions(backend, this->options);
+    for (const auto& var : variables)
+        validateVariable(var, backend, this->options);
+    this->variables = expandRanges(variables, backend);
+    if (std::ranges::count_if(this->variables, [](const WatchedVariable& var) { return !var.guarded; }) > DEBUG_SLOT_COUNT)
+        throw std::invalid_argument("At most " + std::to_string(DEBUG_SLOT_COUNT) + " variables can be watched");
+}
 
-void Debugger::run() const {
+/**
+ * Fork events to trace: every child with --follow-children; with --only-in also plain forks,
+ * whose copy of the code has to be rid of the breakpoints before they run on their own.
+ */
+static long forkTraceOptions(const TracerOptions& options) {
+    if (options.followChildren)
+        return PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK;
+    return options.scopeFunctions.empty() ? 0 : PTRACE_O_TRACEFORK;
+}
+
+Tracee Debugger::launch() const {
     pid_t pid = fork();
     if (pid == -1) {
         throw std::runtime_error(std::string("fork() failed: ") + std::strerror(errno));
     }
 
     if (pid == 0) {
-        if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) == -1) {
-            perror("ptrace(TRACEME)");
-            _exit(1);
-        }
+        // Stop before exec so the parent can seize us; nothing past this point runs untraced.
         raise(SIGSTOP);
 
         if (execArgs) {
@@ -66,126 +187,150 @@ void Debugger::run() const {
     }
 
     int status = 0;
-    if (waitpid(pid, &status, 0) == -1) {
+    if (waitpid(pid, &status, WUNTRACED) == -1) {
         throw std::runtime_error(std::string("waitpid failed: ") + std::strerror(errno));
     }
 
     if (!WIFSTOPPED(status)) {
-        throw std::runtime_error("Child did not stop as expected after exec/raise(SIGSTOP)");
+        throw std::runtime_error("Child did not stop as expected after raise(SIGSTOP)");
     }
 
-    std::string absPath = getAbsolutePath(programPath);
-    ptraceChecked(PTRACE_CONT, pid, nullptr, nullptr, "ptrace(PTRACE_CONT) failed after initial stop");
-    usleep(10000);
-
-    uintptr_t base = getBaseAddress(pid, absPath);
-    uintptr_t runtimeAddr = base + symbolOffset;
-
-    std::cerr << "Runtime variable address: 0x" << std::hex << runtimeAddr << std::dec
-              << " (process " << pid << ")\n";
-
-    watchVariable(pid, runtimeAddr);
-}
+    const long traceOptions = PTRACE_O_TRACEEXEC | PTRACE_O_TRACECLONE | PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL |
+                              forkTraceOptions(options);
+    ptraceChecked(PTRACE_SEIZE, pid, nullptr, reinterpret_cast<void*>(traceOptions), "ptrace(PTRACE_SEIZE) failed");
+    kill(pid, SIGCONT);
 
-void Debugger::setHardwareWatchpoint(pid_t pid, uintptr_t runtimeAddr) const {
-    ptraceChecked(PTRACE_POKEUSER, pid,
-                  reinterpret_cast<void*>(offsetof(user, u_debugreg[0])),
-                  reinterpret_cast<void*>(runtimeAddr),
-                  "Failed to set DR0");
+    // Run the child up to the exec event: the new image and its interpreter are mapped,
+    // but not a single user instruction has executed yet.
+    while (true) {
+        if (waitpid(pid, &status, __WALL) == -1) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("waitpid failed: ") + std::strerror(errno));
+        }
 
-    constexpr long ENABLE_LOCAL_DR0 = 1 << 0;
-    constexpr long RW_READWRITE = 0b11;
-    long len_code = dr_len_code(varSize);
-    if (len_code < 0) throw std::runtime_error("Unsupported variable size for watchpoint");
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            throw std::runtime_error("Child terminated before exec of " + programPath);
+        }
 
-    long dr7 = ENABLE_LOCAL_DR0 | (RW_READWRITE << 16) | (len_code << 18);
+        if (status >> 8 == (SIGTRAP | (PTRACE_EVENT_EXEC << 8))) {
+            return Tracee{ pid, { pid }, false };
+        }
 
-    ptraceChecked(PTRACE_POKEUSER, pid,
-                  reinterpret_cast<void*>(offsetof(user, u_debugreg[7])),
-                  reinterpret_cast<void*>(dr7),
-                  "Failed to write DR7");
+        // Group-stop/SIGCONT notifications of the pre-exec stop: resume without a signal.
+        const int sig = WSTOPSIG(status);
+        const bool forward = (status >> 16) == 0 && sig != SIGSTOP && sig != SIGCONT;
+        ptraceChecked(PTRACE_CONT, pid, nullptr, reinterpret_cast<void*>(static_cast<long>(forward ? sig : 0)),
+                      "ptrace(PTRACE_CONT) failed before exec");
+    }
 }
 
-void clearDebugStatus(pid_t pid) {
-    ptraceChecked(PTRACE_POKEUSER, pid,
-                  reinterpret_cast<void*>(offsetof(user, u_debugreg[6])),
-                  0,
-                  "Failed to clear DR6");
+Debugger::Debugger(pid_t attachPid,
+                   std::vector<WatchedVariable> variables,
+                   BackendKind backend,
+                   TracerOptions options)
+    : Debugger("/proc/" + std::to_string(attachPid) + "/exe", std::move(variables), nullptr, backend, std::move(options)) {
+    this->attachPid = attachPid;
 }
 
-void Debugger::watchVariable(pid_t pid, uintptr_t runtimeAddress) const  {
-    uint64_t lastValue = 0;
-    try {
-        lastValue = readProcessMemory(pid, runtimeAddress, varSize);
-    } catch (const std::exception &e) {
-        std::cerr << "Initial read failed: " << e.what() << "\n";
-        return;
-    }
-
-    std::cerr << varName << " initial=" << lastValue << "\n";
+Tracee Debugger::attach() const {
+    const long traceOptions = PTRACE_O_TRACEEXEC | PTRACE_O_TRACECLONE | PTRACE_O_TRACESYSGOOD |
+                              forkTraceOptions(options);
+    const std::string taskDir = "/proc/" + std::to_string(attachPid) + "/task";
+
+    Tracee tracee;
+    tracee.pid = attachPid;
+    tracee.attached = true;
+
+    // Threads may be spawned by not-yet-seized threads while we attach, so rescan until
+    // a pass finds nothing new. Clones of seized threads are auto-attached by TRACECLONE.
+    std::set<pid_t> seized;
+    bool foundNew = true;
+    while (foundNew) {
+        foundNew = false;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(taskDir, ec)) {
+            const pid_t tid = static_cast<pid_t>(std::stol(entry.path().filename().string()));
+            if (seized.contains(tid))
+                continue;
 
-    setHardwareWatchpoint(pid, runtimeAddress);
-    clearDebugStatus(pid);
-    ptraceChecked(PTRACE_CONT, pid, nullptr, nullptr, "ptrace(PTRACE_CONT) failed to start watch loop");
+            if (ptraceRequest(PTRACE_SEIZE, tid, nullptr, reinterpret_cast<void*>(traceOptions)) == -1) {
+                if (errno == ESRCH) continue;  // thread exited meanwhile
+                throw std::runtime_error("ptrace(PTRACE_SEIZE) of " + std::to_string(tid) + " failed: " + std::strerror(errno));
+            }
+            ptraceChecked(PTRACE_INTERRUPT, tid, nullptr, nullptr, "ptrace(PTRACE_INTERRUPT) failed");
+            seized.insert(tid);
+            foundNew = true;
+        }
+        if (ec && seized.empty()) {
+            throw std::runtime_error("Failed to list " + taskDir + ": " + ec.message());
+        }
+    }
 
-    while (true) {
+    for (const pid_t tid : seized) {
         int status = 0;
-        if (waitpid(pid, &status, 0) == -1) {
+        if (waitpid(tid, &status, __WALL) == -1) {
+            if (errno == ECHILD) continue;
             throw std::runtime_error(std::string("waitpid failed: ") + std::strerror(errno));
         }
+        if (WIFSTOPPED(status))
+            tracee.threads.push_back(tid);
+    }
 
-        if (WIFEXITED(status)) {
-            std::cerr << "Child exited (" << WEXITSTATUS(status) << ")\n";
-            break;
-        }
+    if (tracee.threads.empty()) {
+        throw std::runtime_error("Process " + std::to_string(attachPid) + " has no threads left to attach to");
+    }
+    std::cerr << "Attached to " << tracee.threads.size() << " thread(s) of process " << attachPid << "\n";
+    return tracee;
+}
 
-        if (WIFSTOPPED(status)) {
-            const int sig = WSTOPSIG(status);
-
-            if (sig == SIGTRAP) {
-                errno = 0;
-                long dr6 = ptrace(PTRACE_PEEKUSER, pid, reinterpret_cast<void*>(offsetof(user, u_debugreg[6])), nullptr);
-                if (dr6 == -1 && errno != 0) {
-                    std::cerr << "Warning: failed to read DR6: " << std::strerror(errno) << "\n";
-                }
-
-                if ( (dr6 & 0x1) != 0 ) {
-                    uint64_t currentValue = 0;
-                    try {
-                        currentValue = readProcessMemory(pid, runtimeAddress, varSize);
-                    } catch (const std::exception &e) {
-                        std::cerr << "Read during trap failed: " << e.what() << "\n";
-                        clearDebugStatus(pid);
-                        ptraceChecked(PTRACE_CONT, pid, nullptr, nullptr, "ptrace(PTRACE_CONT) failed after failed read");
-                        continue;
-                    }
-
-                    if (currentValue != lastValue) {
-                        std::cout << varName << "    write    " << lastValue << " -> " << currentValue << "\n";
-                        lastValue = currentValue;
-                    } else {
-                        std::cout << varName << "    read     " << currentValue << "\n";
-                    }
-
-                    clearDebugStatus(pid);
-                    ptraceChecked(PTRACE_CONT, pid, nullptr, nullptr, "ptrace(PTRACE_CONT) failed after trap handling");
-                    continue;
-                }
-
-                ptraceChecked(PTRACE_CONT, pid, nullptr, nullptr, "ptrace(PTRACE_CONT) failed for non-DR0 SIGTRAP");
-                continue;
-            }
+void Debugger::run() const {
+    installDetachHandler();
+    run(nullptr);
+}
 
-            try {
-                uint64_t currentValue = readProcessMemory(pid, runtimeAddress, varSize);
-                if (currentValue != lastValue) {
-                    std::cout << varName << "    write    " << lastValue << " -> " << currentValue << "\n";
-                    lastValue = currentValue;
-                }
-            } catch (...) {}
+void Debugger::run(std::unique_ptr<EventSink> sink) const {
+    const Tracee tracee = attachPid > 0 ? attach() : launch();
+    const pid_t pid = tracee.pid;
 
-            ptraceChecked(PTRACE_CONT, pid, nullptr, reinterpret_cast<void*>(static_cast<long>(sig)),
-                          "ptrace(PTRACE_CONT) failed when forwarding signal");
-        }
+    const std::string exePath = "/proc/" + std::to_string(pid) + "/exe";
+    uintptr_t entry = 0;
+    if (!getEntryPoint(exePath, entry)) {
+        // A launched child dies with us (PTRACE_O_EXITKILL); an attached one is released on exit.
+        throw std::runtime_error("Failed to read the ELF entry point of " + programPath);
+    }
+    const uintptr_t loadBias = getLoadBias(pid, entry);
+
+    std::vector<WatchedVariable> vars = variables;
+    for (auto& var : vars) {
+        if (!var.library.empty() || var.tls)
+            continue;  // placed by the backend when the library is loaded or per thread
+        var.runtimeAddress = loadBias + var.symbolOffset;
+        if (var.guarded)
+            continue;  // summarised by the backend when it guards the pages
+        std::cerr << "Runtime address of " << var.name << ": 0x" << std::hex << var.runtimeAddress << std::dec
+                  << " (process " << pid << ")\n";
+    }
+
+    std::vector<std::string> names;
+    std::vector<std::shared_ptr<const ValueType>> types;
+    for (const auto& var : vars) {
+        names.push_back(var.name);
+        types.push_back(var.type);
+    }
+
+    // Everything printed through iostreams so far must precede the writer thread's output.
+    std::cout.flush();
+    if (sink == nullptr && !options.recordPath.empty()) {
+        sink = std::make_unique<TraceFileSink>(options.recordPath, names, types);
+        std::cerr << "Recording events to " << options.recordPath << "\n";
+    } else if (sink == nullptr) {
+        sink = std::make_unique<TextEventSink>(std::move(names), STDOUT_FILENO, std::move(types), options.followChildren);
     }
-}
\ No newline at end of file
+    EventWriter events(std::move(sink), options.queuePolicy, options.queueCapacity);
+
+    createBackend(backend, options)->watch(tracee, vars, events);
+
+    events.close();
+    if (events.dropped() > 0)
+        std::cerr << "Warning: " << events.dropped() << " events dropped (output queue full)\n";
+}
@@ -0,0 +1,42 @@
+#include "duty_cycle.hpp"
+
+DutyCycle::DutyCycle(double budget, uint64_t now) : budget(budget), start(now), windowStart(now) {}
+
+bool DutyCycle::update(uint64_t now) {
+    if (isArmed) {
+        if (now < windowStart + WINDOW)
+            return false;
+        const uint64_t armedFor = now - windowStart;
+        totalArmed += armedFor;
+        // The cycle has to be long enough for the window's stopped time to be within the budget.
+        const double cycle = static_cast<double>(windowStopped) / budget;
+        windowStopped = 0;
+        windowStart = now;
+        if (cycle <= static_cast<double>(armedFor)) {
+            windowRatio = 1.0f;
+            return false;
+        }
+        pauseEnd = now + static_cast<uint64_t>(cycle) - armedFor;
+        isArmed = false;
+        return true;
+    }
+
+    if (now < pauseEnd)
+        return false;
+    // Stops charged during the pause (the interrupts that disarmed the threads) count against the next window.
+    windowRatio = static_cast<float>(static_cast<double>(WINDOW) / static_cast<double>(WINDOW + (now - windowStart)));
+    windowStart = now;
+    isArmed = true;
+    return true;
+}
+
+double DutyCycle::overhead(uint64_t now) const {
+    return now > start ? static_cast<double>(totalStopped) / static_cast<double>(now - start) : 0.0;
+}
+
+double DutyCycle::armedShare(uint64_t now) const {
+    if (now <= start)
+        return 1.0;
+    const uint64_t armedFor = totalArmed + (isArmed ? now - windowStart : 0);
+    return static_cast<double>(armedFor) / static_cast<double>(now - start);
+}
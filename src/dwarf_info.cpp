@@ -0,0 +1,886 @@
+#include "dwarf_info.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Subset of the DWARF 5 constants (dwarf.h is not always installed).
+constexpr uint16_t DW_TAG_array_type = 0x01;
+constexpr uint16_t DW_TAG_class_type = 0x02;
+constexpr uint16_t DW_TAG_enumeration_type = 0x04;
+constexpr uint16_t DW_TAG_member = 0x0d;
+constexpr uint16_t DW_TAG_pointer_type = 0x0f;
+constexpr uint16_t DW_TAG_reference_type = 0x10;
+constexpr uint16_t DW_TAG_compile_unit = 0x11;
+constexpr uint16_t DW_TAG_structure_type = 0x13;
+constexpr uint16_t DW_TAG_typedef = 0x16;
+constexpr uint16_t DW_TAG_union_type = 0x17;
+constexpr uint16_t DW_TAG_inheritance = 0x1c;
+constexpr uint16_t DW_TAG_subrange_type = 0x21;
+constexpr uint16_t DW_TAG_base_type = 0x24;
+constexpr uint16_t DW_TAG_const_type = 0x26;
+constexpr uint16_t DW_TAG_enumerator = 0x28;
+constexpr uint16_t DW_TAG_variable = 0x34;
+constexpr uint16_t DW_TAG_volatile_type = 0x35;
+constexpr uint16_t DW_TAG_restrict_type = 0x37;
+constexpr uint16_t DW_TAG_namespace = 0x39;
+constexpr uint16_t DW_TAG_partial_unit = 0x3c;
+constexpr uint16_t DW_TAG_rvalue_reference_type = 0x42;
+constexpr uint16_t DW_TAG_atomic_type = 0x47;
+
+constexpr uint16_t DW_AT_location = 0x02;
+constexpr uint16_t DW_AT_name = 0x03;
+constexpr uint16_t DW_AT_byte_size = 0x0b;
+constexpr uint16_t DW_AT_bit_size = 0x0d;
+constexpr uint16_t DW_AT_const_value = 0x1c;
+constexpr uint16_t DW_AT_lower_bound = 0x22;
+constexpr uint16_t DW_AT_upper_bound = 0x2f;
+constexpr uint16_t DW_AT_abstract_origin = 0x31;
+constexpr uint16_t DW_AT_count = 0x37;
+constexpr uint16_t DW_AT_data_member_location = 0x38;
+constexpr uint16_t DW_AT_declaration = 0x3c;
+constexpr uint16_t DW_AT_encoding = 0x3e;
+constexpr uint16_t DW_AT_specification = 0x47;
+constexpr uint16_t DW_AT_type = 0x49;
+constexpr uint16_t DW_AT_data_bit_offset = 0x6b;
+constexpr uint16_t DW_AT_linkage_name = 0x6e;
+constexpr uint16_t DW_AT_str_offsets_base = 0x72;
+constexpr uint16_t DW_AT_MIPS_linkage_name = 0x2007;
+
+constexpr uint16_t DW_FORM_addr = 0x01;
+constexpr uint16_t DW_FORM_block2 = 0x03;
+constexpr uint16_t DW_FORM_block4 = 0x04;
+constexpr uint16_t DW_FORM_data2 = 0x05;
+constexpr uint16_t DW_FORM_data4 = 0x06;
+constexpr uint16_t DW_FORM_data8 = 0x07;
+constexpr uint16_t DW_FORM_string = 0x08;
+constexpr uint16_t DW_FORM_block = 0x09;
+constexpr uint16_t DW_FORM_block1 = 0x0a;
+constexpr uint16_t DW_FORM_data1 = 0x0b;
+constexpr uint16_t DW_FORM_flag = 0x0c;
+constexpr uint16_t DW_FORM_sdata = 0x0d;
+constexpr uint16_t DW_FORM_strp = 0x0e;
+constexpr uint16_t DW_FORM_udata = 0x0f;
+constexpr uint16_t DW_FORM_ref_addr = 0x10;
+constexpr uint16_t DW_FORM_ref1 = 0x11;
+constexpr uint16_t DW_FORM_ref2 = 0x12;
+constexpr uint16_t DW_FORM_ref4 = 0x13;
+constexpr uint16_t DW_FORM_ref8 = 0x14;
+constexpr uint16_t DW_FORM_ref_udata = 0x15;
+constexpr uint16_t DW_FORM_indirect = 0x16;
+constexpr uint16_t DW_FORM_sec_offset = 0x17;
+constexpr uint16_t DW_FORM_exprloc = 0x18;
+constexpr uint16_t DW_FORM_flag_present = 0x19;
+constexpr uint16_t DW_FORM_strx = 0x1a;
+constexpr uint16_t DW_FORM_addrx = 0x1b;
+constexpr uint16_t DW_FORM_ref_sup4 = 0x1c;
+constexpr uint16_t DW_FORM_strp_sup = 0x1d;
+constexpr uint16_t DW_FORM_data16 = 0x1e;
+constexpr uint16_t DW_FORM_line_strp = 0x1f;
+constexpr uint16_t DW_FORM_ref_sig8 = 0x20;
+constexpr uint16_t DW_FORM_implicit_const = 0x21;
+constexpr uint16_t DW_FORM_loclistx = 0x22;
+constexpr uint16_t DW_FORM_rnglistx = 0x23;
+constexpr uint16_t DW_FORM_ref_sup8 = 0x24;
+constexpr uint16_t DW_FORM_strx1 = 0x25;
+constexpr uint16_t DW_FORM_strx2 = 0x26;
+constexpr uint16_t DW_FORM_strx3 = 0x27;
+constexpr uint16_t DW_FORM_strx4 = 0x28;
+constexpr uint16_t DW_FORM_addrx1 = 0x29;
+constexpr uint16_t DW_FORM_addrx2 = 0x2a;
+constexpr uint16_t DW_FORM_addrx3 = 0x2b;
+constexpr uint16_t DW_FORM_addrx4 = 0x2c;
+constexpr uint16_t DW_FORM_GNU_addr_index = 0x1f01;
+constexpr uint16_t DW_FORM_GNU_str_index = 0x1f02;
+constexpr uint16_t DW_FORM_GNU_ref_alt = 0x1f20;
+constexpr uint16_t DW_FORM_GNU_strp_alt = 0x1f21;
+
+constexpr uint8_t DW_UT_compile = 0x01;
+constexpr uint8_t DW_UT_partial = 0x03;
+
+constexpr uint8_t DW_ATE_address = 0x01;
+constexpr uint8_t DW_ATE_boolean = 0x02;
+constexpr uint8_t DW_ATE_float = 0x04;
+constexpr uint8_t DW_ATE_signed = 0x05;
+constexpr uint8_t DW_ATE_signed_char = 0x06;
+constexpr uint8_t DW_ATE_unsigned = 0x07;
+constexpr uint8_t DW_ATE_unsigned_char = 0x08;
+constexpr uint8_t DW_ATE_UTF = 0x10;
+
+constexpr uint8_t DW_OP_plus_uconst = 0x23;
+
+/** Types are nested at most this deep; deeper chains are treated as cycles. */
+constexpr int MAX_TYPE_DEPTH = 64;
+
+[[noreturn]] void malformed(const char* what) {
+    throw std::runtime_error(std::string("Malformed DWARF: ") + what);
+}
+
+/**
+ * Bounds-checked little-endian reader over a section.
+ */
+class Reader {
+public:
+    explicit Reader(std::string_view data, uint64_t pos = 0) : data(data), pos(pos) {
+        if (pos > data.size())
+            malformed("offset outside of section");
+    }
+
+    [[nodiscard]] uint64_t position() const { return pos; }
+    [[nodiscard]] bool atEnd() const { return pos >= data.size(); }
+
+    void seek(uint64_t offset) {
+        if (offset > data.size())
+            malformed("offset outside of section");
+        pos = offset;
+    }
+
+    uint64_t fixed(size_t bytes) {
+        need(bytes);
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(data[pos + i])) << (8 * i);
+        pos += bytes;
+        return value;
+    }
+
+    uint8_t u8() { return static_cast<uint8_t>(fixed(1)); }
+    uint16_t u16() { return static_cast<uint16_t>(fixed(2)); }
+    uint32_t u32() { return static_cast<uint32_t>(fixed(4)); }
+    uint64_t u64() { return fixed(8); }
+
+    uint64_t uleb() {
+        uint64_t value = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            const uint8_t byte = u8();
+            if (shift < 64)
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+    }
+
+    int64_t sleb() {
+        uint64_t value = 0;
+        unsigned shift = 0;
+        uint8_t byte = 0;
+        do {
+            byte = u8();
+            if (shift < 64)
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            shift += 7;
+        } while ((byte & 0x80) != 0);
+        if (shift < 64 && (byte & 0x40) != 0)
+            value |= ~0ULL << shift;
+        return static_cast<int64_t>(value);
+    }
+
+    std::string_view bytes(uint64_t count) {
+        need(count);
+        const std::string_view result = data.substr(pos, count);
+        pos += count;
+        return result;
+    }
+
+    std::string_view cstr() {
+        const size_t end = data.find('\0', pos);
+        if (end == std::string_view::npos)
+            malformed("unterminated string");
+        const std::string_view result = data.substr(pos, end - pos);
+        pos = end + 1;
+        return result;
+    }
+
+private:
+    void need(uint64_t count) const {
+        if (count > data.size() - pos)
+            malformed("truncated section");
+    }
+
+    std::string_view data;
+    uint64_t pos;
+};
+
+std::string_view stringAt(std::string_view section, uint64_t offset) {
+    if (offset >= section.size())
+        return {};
+    const size_t end = section.find('\0', offset);
+    return section.substr(offset, end == std::string_view::npos ? std::string_view::npos : end - offset);
+}
+
+bool isReferenceForm(uint16_t form) {
+    return form == DW_FORM_ref1 || form == DW_FORM_ref2 || form == DW_FORM_ref4 || form == DW_FORM_ref8 ||
+           form == DW_FORM_ref_udata || form == DW_FORM_ref_addr;
+}
+
+/** Reads a constant-class attribute; DWARF 2 member offsets may be DW_OP_plus_uconst blocks. */
+bool constantOf(uint16_t form, uint64_t value, std::string_view data, uint64_t& result) {
+    switch (form) {
+        case DW_FORM_data1: case DW_FORM_data2: case DW_FORM_data4: case DW_FORM_data8:
+        case DW_FORM_sdata: case DW_FORM_udata: case DW_FORM_implicit_const:
+            result = value;
+            return true;
+        case DW_FORM_exprloc: case DW_FORM_block: case DW_FORM_block1: case DW_FORM_block2: case DW_FORM_block4:
+            if (!data.empty() && static_cast<uint8_t>(data[0]) == DW_OP_plus_uconst) {
+                Reader expr(data, 1);
+                result = expr.uleb();
+                return expr.atEnd();
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+bool isScope(uint16_t tag) {
+    return tag == DW_TAG_compile_unit || tag == DW_TAG_partial_unit || tag == DW_TAG_namespace;
+}
+
+bool isRecord(uint16_t tag) {
+    return tag == DW_TAG_structure_type || tag == DW_TAG_class_type || tag == DW_TAG_union_type;
+}
+
+bool isIdentifierChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || c == ':';
+}
+
+/** One '.member' or '[index]' selector of a variable expression. */
+struct PathStep {
+    bool member;
+    std::string name;
+    uint64_t index;
+};
+
+std::vector<PathStep> parsePath(const std::string& expression, std::string& variable) {
+    const auto fail = [&](size_t pos, const std::string& what) -> void {
+        throw std::invalid_argument("Invalid variable expression '" + expression + "' at column " +
+                                    std::to_string(pos + 1) + ": " + what);
+    };
+    const auto identifier = [&](size_t& pos) {
+        const size_t start = pos;
+        while (pos < expression.size() && isIdentifierChar(expression[pos]))
+            ++pos;
+        if (pos == start || std::isdigit(static_cast<unsigned char>(expression[start])))
+            fail(start, "expected a name");
+        return expression.substr(start, pos - start);
+    };
+
+    size_t pos = 0;
+    variable = identifier(pos);
+
+    std::vector<PathStep> steps;
+    while (pos < expression.size()) {
+        if (expression[pos] == '.') {
+            ++pos;
+            steps.push_back(PathStep{ true, identifier(pos), 0 });
+        } else if (expression[pos] == '[') {
+            ++pos;
+            if (pos >= expression.size() || !std::isdigit(static_cast<unsigned char>(expression[pos])))
+                fail(pos, "expected an index");
+            const char* const begin = expression.c_str() + pos;
+            char* end = nullptr;
+            errno = 0;
+            const unsigned long long index = std::strtoull(begin, &end, 0);
+            if (errno == ERANGE)
+                fail(pos, "index out of range");
+            pos += end - begin;
+            if (pos >= expression.size() || expression[pos] != ']')
+                fail(pos, "expected ']'");
+            ++pos;
+            steps.push_back(PathStep{ false, {}, index });
+        } else {
+            fail(pos, "unexpected '" + std::string(1, expression[pos]) + "'");
+        }
+    }
+    return steps;
+}
+
+}
+
+std::string variableOfPath(const std::string& expression) {
+    return expression.substr(0, expression.find_first_of(".["));
+}
+
+bool isVariablePath(const std::string& expression) {
+    return expression.find_first_of(".[") != std::string::npos;
+}
+
+DwarfInfo::DwarfInfo(const std::string& path) : image(std::make_unique<ElfImage>(path)) {
+    info = image->section(".debug_info");
+    abbrev = image->section(".debug_abbrev");
+    str = image->section(".debug_str");
+    lineStr = image->section(".debug_line_str");
+    strOffsets = image->section(".debug_str_offsets");
+    if (abbrev.empty())
+        info = {};
+    scanUnits();
+}
+
+void DwarfInfo::scanUnits() {
+    uint64_t pos = 0;
+    while (pos < info.size()) {
+        Reader reader(info, pos);
+        Unit unit;
+        unit.offset = pos;
+
+        uint64_t length = reader.u32();
+        if (length == 0xffffffff) {
+            length = reader.u64();
+            unit.offsetSize = 8;
+        } else if (length >= 0xfffffff0) {
+            malformed("reserved unit length");
+        }
+        if (length > info.size() - reader.position())
+            malformed("unit extends past .debug_info");
+        unit.end = reader.position() + length;
+        pos = unit.end;
+
+        unit.version = reader.u16();
+        if (unit.version < 2 || unit.version > 5)
+            continue;
+
+        uint8_t unitType = DW_UT_compile;
+        if (unit.version >= 5) {
+            unitType = reader.u8();
+            unit.addressSize = reader.u8();
+            unit.abbrevOffset = reader.fixed(unit.offsetSize);
+        } else {
+            unit.abbrevOffset = reader.fixed(unit.offsetSize);
+            unit.addressSize = reader.u8();
+        }
+        // Type, skeleton and split units never define variables with a location.
+        if (unitType != DW_UT_compile && unitType != DW_UT_partial)
+            continue;
+
+        unit.dieOffset = reader.position();
+        units.push_back(std::move(unit));
+    }
+}
+
+const DwarfInfo::AbbrevTable& DwarfInfo::abbrevTable(uint64_t offset) {
+    if (const auto it = abbrevTables.find(offset); it != abbrevTables.end())
+        return it->second;
+
+    AbbrevTable table;
+    Reader reader(abbrev, offset);
+    while (true) {
+        const uint64_t code = reader.uleb();
+        if (code == 0)
+            break;
+
+        Abbrev entry;
+        entry.tag = static_cast<uint16_t>(reader.uleb());
+        entry.hasChildren = reader.u8() != 0;
+        while (true) {
+            const auto name = static_cast<uint16_t>(reader.uleb());
+            const auto form = static_cast<uint16_t>(reader.uleb());
+            const int64_t implicitConst = form == DW_FORM_implicit_const ? reader.sleb() : 0;
+            if (name == 0 && form == 0)
+                break;
+            entry.attributes.push_back(AbbrevAttribute{ name, form, implicitConst });
+        }
+        table.emplace(code, std::move(entry));
+    }
+    return abbrevTables.emplace(offset, std::move(table)).first->second;
+}
+
+void DwarfInfo::parseUnit(uint32_t unitIndex) {
+    Unit& unit = units[unitIndex];
+    if (unit.parsed)
+        return;
+    unit.parsed = true;
+
+    const AbbrevTable& table = abbrevTable(unit.abbrevOffset);
+    Reader reader(info.substr(0, unit.end), unit.dieOffset);
+
+    std::vector<uint32_t> parents;      // DIEs whose children are being read
+    std::vector<uint32_t> lastChildren; // Last child read at each open level
+    while (!reader.atEnd()) {
+        const uint64_t offset = reader.position();
+        const uint64_t code = reader.uleb();
+        if (code == 0) {
+            if (parents.empty())
+                continue;  // padding after the unit DIE
+            parents.pop_back();
+            lastChildren.pop_back();
+            continue;
+        }
+
+        const auto it = table.find(code);
+        if (it == table.end())
+            malformed("unknown abbreviation code");
+        const Abbrev& entry = it->second;
+
+        const auto index = static_cast<uint32_t>(unit.dies.size());
+        Die die{ offset, entry.tag, parents.empty() ? NONE : parents.back(), NONE,
+                 static_cast<uint32_t>(unit.attributes.size()), static_cast<uint32_t>(entry.attributes.size()),
+                 entry.hasChildren };
+
+        for (const AbbrevAttribute& spec : entry.attributes) {
+            Attribute attr{ spec.name, spec.form, 0, {} };
+            while (attr.form == DW_FORM_indirect)
+                attr.form = static_cast<uint16_t>(reader.uleb());
+
+            switch (attr.form) {
+                case DW_FORM_addr: attr.value = reader.fixed(unit.addressSize); break;
+                case DW_FORM_block1: attr.data = reader.bytes(reader.u8()); break;
+                case DW_FORM_block2: attr.data = reader.bytes(reader.u16()); break;
+                case DW_FORM_block4: attr.data = reader.bytes(reader.u32()); break;
+                case DW_FORM_block: case DW_FORM_exprloc: attr.data = reader.bytes(reader.uleb()); break;
+                case DW_FORM_data1: case DW_FORM_ref1: case DW_FORM_flag: case DW_FORM_strx1: case DW_FORM_addrx1:
+                    attr.value = reader.u8(); break;
+                case DW_FORM_data2: case DW_FORM_ref2: case DW_FORM_strx2: case DW_FORM_addrx2:
+                    attr.value = reader.u16(); break;
+                case DW_FORM_strx3: case DW_FORM_addrx3:
+                    attr.value = reader.fixed(3); break;
+                case DW_FORM_data4: case DW_FORM_ref4: case DW_FORM_strx4: case DW_FORM_addrx4: case DW_FORM_ref_sup4:
+                    attr.value = reader.u32(); break;
+                case DW_FORM_data8: case DW_FORM_ref8: case DW_FORM_ref_sig8: case DW_FORM_ref_sup8:
+                    attr.value = reader.u64(); break;
+                case DW_FORM_data16: attr.data = reader.bytes(16); break;
+                case DW_FORM_string: attr.data = reader.cstr(); break;
+                case DW_FORM_sdata: attr.value = static_cast<uint64_t>(reader.sleb()); break;
+                case DW_FORM_udata: case DW_FORM_ref_udata: case DW_FORM_strx: case DW_FORM_addrx:
+                case DW_FORM_loclistx: case DW_FORM_rnglistx: case DW_FORM_GNU_addr_index: case DW_FORM_GNU_str_index:
+                    attr.value = reader.uleb(); break;
+                case DW_FORM_strp: case DW_FORM_line_strp: case DW_FORM_sec_offset: case DW_FORM_strp_sup:
+                case DW_FORM_GNU_ref_alt: case DW_FORM_GNU_strp_alt:
+                    attr.value = reader.fixed(unit.offsetSize); break;
+                case DW_FORM_ref_addr:
+                    attr.value = reader.fixed(unit.version <= 2 ? unit.addressSize : unit.offsetSize); break;
+                case DW_FORM_flag_present: attr.value = 1; break;
+                case DW_FORM_implicit_const: attr.value = static_cast<uint64_t>(spec.implicitConst); break;
+                default: malformed("unknown attribute form");
+            }
+            // Unit-relative references become section offsets.
+            if (attr.form != DW_FORM_ref_addr && isReferenceForm(attr.form))
+                attr.value += unit.offset;
+            unit.attributes.push_back(attr);
+        }
+
+        if (!lastChildren.empty()) {
+            if (lastChildren.back() != NONE)
+                unit.dies[lastChildren.back()].nextSibling = index;
+            lastChildren.back() = index;
+        }
+        unit.dies.push_back(die);
+        if (entry.hasChildren) {
+            parents.push_back(index);
+            lastChildren.push_back(NONE);
+        }
+    }
+
+    if (!unit.dies.empty()) {
+        if (const Attribute* base = attribute(DieRef{ unitIndex, 0 }, DW_AT_str_offsets_base))
+            unit.strOffsetsBase = base->value;
+    }
+    indexVariables(unitIndex);
+}
+
+void DwarfInfo::indexVariables(uint32_t unitIndex) {
+    const auto count = static_cast<uint32_t>(units[unitIndex].dies.size());
+    for (uint32_t index = 0; index < count; ++index) {
+        const DieRef ref{ unitIndex, index };
+        // Definitions only: a declaration may only have an incomplete type.
+        if (die(ref).tag != DW_TAG_variable || attribute(ref, DW_AT_location) == nullptr)
+            continue;
+
+        bool global = true;
+        for (uint32_t parent = die(ref).parent; parent != NONE; parent = units[unitIndex].dies[parent].parent)
+            global = global && isScope(units[unitIndex].dies[parent].tag);
+        if (!global)
+            continue;  // function-local statics
+
+        // Out-of-class and namespace-scope definitions carry their name on the declaration.
+        DieRef declaration = ref;
+        if (nameOf(ref).empty())
+            referenceOf(ref, DW_AT_specification, declaration);
+
+        for (const uint16_t name : { DW_AT_linkage_name, DW_AT_MIPS_linkage_name, DW_AT_name }) {
+            const Attribute* attr = attribute(declaration, name);
+            const std::string_view text = attr != nullptr ? stringOf(declaration, *attr) : std::string_view{};
+            if (!text.empty())
+                variables.emplace(std::string(text), ref);
+        }
+    }
+}
+
+bool DwarfInfo::findInPubnames(std::string_view section, bool gnu, const std::string& name, uint64_t& unitOffset) const {
+    Reader reader(section);
+    while (!reader.atEnd()) {
+        uint64_t length = reader.u32();
+        size_t offsetSize = 4;
+        if (length == 0xffffffff) {
+            length = reader.u64();
+            offsetSize = 8;
+        }
+        const uint64_t start = reader.position();
+        if (length > section.size() - start)
+            malformed("name table extends past its section");
+        const uint64_t end = start + length;
+
+        reader.u16();  // version
+        const uint64_t unit = reader.fixed(offsetSize);
+        reader.fixed(offsetSize);  // unit length
+        while (reader.position() < end) {
+            if (reader.fixed(offsetSize) == 0)
+                break;
+            if (gnu)
+                reader.u8();  // symbol kind flags
+            if (reader.cstr() == name) {
+                unitOffset = unit;
+                return true;
+            }
+        }
+        reader.seek(end);
+    }
+    return false;
+}
+
+bool DwarfInfo::findVariable(const std::string& name, DieRef& ref) {
+    const auto lookup = [&] {
+        const auto it = variables.find(name);
+        if (it == variables.end())
+            return false;
+        ref = it->second;
+        return true;
+    };
+    if (lookup())
+        return true;
+
+    for (const auto& [section, gnu] : { std::pair{ ".debug_pubnames", false }, std::pair{ ".debug_gnu_pubnames", true } }) {
+        uint64_t unitOffset = 0;
+        if (!findInPubnames(image->section(section), gnu, name, unitOffset))
+            continue;
+        const auto unit = std::lower_bound(units.begin(), units.end(), unitOffset,
+                                           [](const Unit& u, uint64_t offset) { return u.offset < offset; });
+        if (unit != units.end() && unit->offset == unitOffset) {
+            parseUnit(static_cast<uint32_t>(unit - units.begin()));
+            if (lookup())
+                return true;
+        }
+    }
+
+    // No name index (or it missed a static): decode units in order until the variable turns up.
+    while (nextUnparsed < units.size()) {
+        parseUnit(static_cast<uint32_t>(nextUnparsed++));
+        if (lookup())
+            return true;
+    }
+    return false;
+}
+
+size_t DwarfInfo::parsedUnits() const {
+    return static_cast<size_t>(std::count_if(units.begin(), units.end(), [](const Unit& u) { return u.parsed; }));
+}
+
+const DwarfInfo::Attribute* DwarfInfo::attribute(DieRef ref, uint16_t name) const {
+    const Unit& unit = units[ref.unit];
+    const Die& entry = unit.dies[ref.index];
+    for (uint32_t i = 0; i < entry.attributeCount; ++i) {
+        const Attribute& attr = unit.attributes[entry.firstAttribute + i];
+        if (attr.name == name)
+            return &attr;
+    }
+    return nullptr;
+}
+
+std::string_view DwarfInfo::stringOf(DieRef ref, const Attribute& attr) const {
+    const Unit& unit = units[ref.unit];
+    switch (attr.form) {
+        case DW_FORM_string:
+            return attr.data;
+        case DW_FORM_strp:
+            return stringAt(str, attr.value);
+        case DW_FORM_line_strp:
+            return stringAt(lineStr, attr.value);
+        case DW_FORM_strx: case DW_FORM_strx1: case DW_FORM_strx2: case DW_FORM_strx3: case DW_FORM_strx4:
+        case DW_FORM_GNU_str_index: {
+            const uint64_t entry = unit.strOffsetsBase + attr.value * unit.offsetSize;
+            if (entry > strOffsets.size() || strOffsets.size() - entry < unit.offsetSize)
+                return {};
+            Reader reader(strOffsets, entry);
+            return stringAt(str, reader.fixed(unit.offsetSize));
+        }
+        default:
+            return {};  // supplementary object files are not followed
+    }
+}
+
+std::string_view DwarfInfo::nameOf(DieRef ref) const {
+    const Attribute* attr = attribute(ref, DW_AT_name);
+    return attr != nullptr ? stringOf(ref, *attr) : std::string_view{};
+}
+
+bool DwarfInfo::referenceOf(DieRef ref, uint16_t name, DieRef& target) {
+    const Attribute* attr = attribute(ref, name);
+    if (attr == nullptr || !isReferenceForm(attr->form))
+        return false;
+    target = dieAt(attr->value);
+    return true;
+}
+
+bool DwarfInfo::typeOf(DieRef ref, DieRef& type) {
+    for (int depth = 0; depth < MAX_TYPE_DEPTH; ++depth) {
+        if (referenceOf(ref, DW_AT_type, type))
+            return true;
+        if (!referenceOf(ref, DW_AT_specification, ref) && !referenceOf(ref, DW_AT_abstract_origin, ref))
+            return false;
+    }
+    return false;
+}
+
+uint32_t DwarfInfo::firstChild(DieRef ref) const {
+    const std::vector<Die>& dies = units[ref.unit].dies;
+    const uint32_t next = ref.index + 1;
+    return dies[ref.index].hasChildren && next < dies.size() && dies[next].parent == ref.index ? next : NONE;
+}
+
+DwarfInfo::DieRef DwarfInfo::dieAt(uint64_t offset) {
+    auto unit = std::upper_bound(units.begin(), units.end(), offset,
+                                 [](uint64_t value, const Unit& u) { return value < u.offset; });
+    if (unit == units.begin() || offset >= (--unit)->end)
+        malformed("reference outside of any unit");
+
+    const auto unitIndex = static_cast<uint32_t>(unit - units.begin());
+    parseUnit(unitIndex);
+
+    const std::vector<Die>& dies = units[unitIndex].dies;
+    const auto it = std::lower_bound(dies.begin(), dies.end(), offset,
+                                     [](const Die& d, uint64_t value) { return d.offset < value; });
+    if (it == dies.end() || it->offset != offset)
+        malformed("reference to a missing DIE");
+    return DieRef{ unitIndex, static_cast<uint32_t>(it - dies.begin()) };
+}
+
+DwarfInfo::DieRef DwarfInfo::stripQualifiers(DieRef type) {
+    for (int depth = 0; depth < MAX_TYPE_DEPTH; ++depth) {
+        const uint16_t tag = die(type).tag;
+        if (tag != DW_TAG_typedef && tag != DW_TAG_const_type && tag != DW_TAG_volatile_type &&
+            tag != DW_TAG_restrict_type && tag != DW_TAG_atomic_type)
+            return type;
+        if (!referenceOf(type, DW_AT_type, type))
+            return type;  // e.g. const void
+    }
+    malformed("type chain too deep");
+}
+
+uint64_t DwarfInfo::sizeOf(DieRef type, uint32_t dimension, int depth) {
+    if (depth > MAX_TYPE_DEPTH)
+        malformed("type chain too deep");
+    type = stripQualifiers(type);
+
+    uint64_t size = 0;
+    const Attribute* byteSize = attribute(type, DW_AT_byte_size);
+    if (dimension == 0 && byteSize != nullptr && constantOf(byteSize->form, byteSize->value, byteSize->data, size))
+        return size;
+
+    switch (die(type).tag) {
+        case DW_TAG_array_type: {
+            DieRef element{};
+            if (!typeOf(type, element))
+                return 0;
+            uint64_t total = sizeOf(element, 0, depth + 1);
+            uint32_t dimensions = 0;
+            for (uint32_t d = dimension;; ++d) {
+                uint64_t count = 0;
+                if (!arrayBounds(type, d, count, dimensions))
+                    return d < dimensions ? 0 : total;
+                total *= count;
+            }
+        }
+        case DW_TAG_pointer_type: case DW_TAG_reference_type: case DW_TAG_rvalue_reference_type:
+            return units[type.unit].addressSize;
+        default:
+            return 0;
+    }
+}
+
+bool DwarfInfo::arrayBounds(DieRef array, uint32_t dimension, uint64_t& count, uint32_t& dimensions) {
+    dimensions = 0;
+    bool known = false;
+    for (uint32_t child = firstChild(array); child != NONE; child = units[array.unit].dies[child].nextSibling) {
+        const DieRef subrange{ array.unit, child };
+        if (die(subrange).tag != DW_TAG_subrange_type)
+            continue;
+        if (dimensions++ != dimension)
+            continue;
+
+        uint64_t lower = 0;
+        uint64_t upper = 0;
+        const Attribute* countAttr = attribute(subrange, DW_AT_count);
+        const Attribute* upperAttr = attribute(subrange, DW_AT_upper_bound);
+        const Attribute* lowerAttr = attribute(subrange, DW_AT_lower_bound);
+        if (lowerAttr != nullptr && !constantOf(lowerAttr->form, lowerAttr->value, lowerAttr->data, lower))
+            continue;
+        if (countAttr != nullptr) {
+            known = constantOf(countAttr->form, countAttr->value, countAttr->data, count);
+        } else if (upperAttr != nullptr && constantOf(upperAttr->form, upperAttr->value, upperAttr->data, upper)) {
+            // A flexible array member is sometimes described as upper bound -1.
+            known = upper != UINT64_MAX && upper >= lower;
+            count = upper - lower + 1;
+        }
+    }
+    return known;
+}
+
+bool DwarfInfo::findMember(DieRef type, std::string_view name, uint64_t& offset, DieRef& member, int depth) {
+    if (depth > MAX_TYPE_DEPTH)
+        malformed("type chain too deep");
+
+    for (uint32_t child = firstChild(type); child != NONE; child = units[type.unit].dies[child].nextSibling) {
+        const DieRef field{ type.unit, child };
+        const uint16_t tag = die(field).tag;
+        if ((tag != DW_TAG_member && tag != DW_TAG_inheritance) || attribute(field, DW_AT_declaration) != nullptr)
+            continue;  // static members live elsewhere
+
+        uint64_t fieldOffset = 0;
+        if (const Attribute* location = attribute(field, DW_AT_data_member_location);
+            location != nullptr && !constantOf(location->form, location->value, location->data, fieldOffset))
+            continue;  // virtual base: the offset is only known at run time
+
+        const std::string_view fieldName = tag == DW_TAG_member ? nameOf(field) : std::string_view{};
+        if (!fieldName.empty()) {
+            if (fieldName != name)
+                continue;
+            offset = fieldOffset;
+            member = field;
+            return true;
+        }
+
+        // Base classes and anonymous structs/unions: their members are reachable directly.
+        DieRef nested{};
+        uint64_t nestedOffset = 0;
+        if (typeOf(field, nested) && isRecord(die(nested = stripQualifiers(nested)).tag) &&
+            findMember(nested, name, nestedOffset, member, depth + 1)) {
+            offset = fieldOffset + nestedOffset;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<const ValueType> DwarfInfo::valueType(DieRef type) {
+    type = stripQualifiers(type);
+    auto result = std::make_shared<ValueType>();
+    result->size = sizeOf(type);
+    if (result->size == 0 || result->size > sizeof(uint64_t))
+        return nullptr;
+
+    uint64_t encoding = 0;
+    const Attribute* encodingAttr = attribute(type, DW_AT_encoding);
+    switch (die(type).tag) {
+        case DW_TAG_base_type:
+            if (encodingAttr == nullptr || !constantOf(encodingAttr->form, encodingAttr->value, encodingAttr->data, encoding))
+                return nullptr;
+            switch (encoding) {
+                case DW_ATE_boolean: result->kind = ValueType::Kind::Bool; break;
+                case DW_ATE_signed: case DW_ATE_signed_char: result->kind = ValueType::Kind::Signed; break;
+                case DW_ATE_unsigned: case DW_ATE_unsigned_char: case DW_ATE_UTF: result->kind = ValueType::Kind::Unsigned; break;
+                case DW_ATE_address: result->kind = ValueType::Kind::Pointer; break;
+                case DW_ATE_float:
+                    if (result->size != sizeof(float) && result->size != sizeof(double))
+                        return nullptr;
+                    result->kind = ValueType::Kind::Float;
+                    break;
+                default:
+                    return nullptr;  // complex, decimal and fixed-point types print raw
+            }
+            break;
+
+        case DW_TAG_enumeration_type: {
+            result->kind = ValueType::Kind::Enum;
+            const uint64_t mask = result->size >= sizeof(uint64_t) ? ~0ULL : (1ULL << (8 * result->size)) - 1;
+            for (uint32_t child = firstChild(type); child != NONE; child = units[type.unit].dies[child].nextSibling) {
+                const DieRef enumerator{ type.unit, child };
+                const Attribute* value = attribute(enumerator, DW_AT_const_value);
+                uint64_t constant = 0;
+                if (die(enumerator).tag == DW_TAG_enumerator && value != nullptr &&
+                    constantOf(value->form, value->value, value->data, constant))
+                    result->enumerators.emplace_back(constant & mask, std::string(nameOf(enumerator)));
+            }
+            break;
+        }
+
+        case DW_TAG_pointer_type: case DW_TAG_reference_type: case DW_TAG_rvalue_reference_type:
+            result->kind = ValueType::Kind::Pointer;
+            break;
+
+        default:
+            return nullptr;
+    }
+    return result;
+}
+
+bool DwarfInfo::resolve(const std::string& expression, DwarfLocation& location) {
+    std::string name;
+    const std::vector<PathStep> steps = parsePath(expression, name);
+
+    DieRef variable{};
+    if (info.empty() || !findVariable(name, variable))
+        return false;
+
+    DieRef type{};
+    if (!typeOf(variable, type))
+        throw std::invalid_argument("'" + name + "' has no type in the debug information");
+
+    std::string prefix = name;
+    uint64_t offset = 0;
+    uint32_t dimension = 0;  // array dimensions already indexed in a multi-dimensional array
+    for (const PathStep& step : steps) {
+        const DieRef resolved = stripQualifiers(type);
+        const uint16_t tag = die(resolved).tag;
+
+        if (step.member) {
+            DieRef member{};
+            uint64_t memberOffset = 0;
+            if (dimension != 0 || !isRecord(tag))
+                throw std::invalid_argument("'" + prefix + "' is not a struct or union");
+            if (!findMember(resolved, step.name, memberOffset, member))
+                throw std::invalid_argument("'" + prefix + "' has no member '" + step.name + "'");
+            prefix += "." + step.name;
+            if (attribute(member, DW_AT_bit_size) != nullptr || attribute(member, DW_AT_data_bit_offset) != nullptr)
+                throw std::invalid_argument("'" + prefix + "' is a bit-field and cannot be watched");
+            if (!typeOf(member, type))
+                throw std::invalid_argument("'" + prefix + "' has no type in the debug information");
+            offset += memberOffset;
+            continue;
+        }
+
+        if (tag == DW_TAG_pointer_type)
+            throw std::invalid_argument("'" + prefix + "' is a pointer; only arrays stored in the variable can be indexed");
+        if (tag != DW_TAG_array_type)
+            throw std::invalid_argument("'" + prefix + "' is not an array");
+
+        uint64_t count = 0;
+        uint32_t dimensions = 0;
+        if (arrayBounds(resolved, dimension, count, dimensions) && step.index >= count)
+            throw std::invalid_argument("Index " + std::to_string(step.index) + " is out of bounds for '" + prefix +
+                                        "' (" + std::to_string(count) + " elements)");
+        prefix += "[" + std::to_string(step.index) + "]";
+
+        DieRef element{};
+        if (!typeOf(resolved, element))
+            throw std::invalid_argument("'" + prefix + "' has no type in the debug information");
+        const bool innermost = dimension + 1 >= dimensions;
+        offset += step.index * (innermost ? sizeOf(element) : sizeOf(resolved, dimension + 1));
+        if (innermost) {
+            type = element;
+            dimension = 0;
+        } else {
+            type = resolved;
+            ++dimension;
+        }
+    }
+
+    location.symbol = name;
+    location.offset = offset;
+    location.size = sizeOf(type, dimension);
+    location.type = dimension == 0 ? valueType(type) : nullptr;
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "elf_utils.hpp"
+#include "symbol_index.hpp"
 
 #include <elf.h>
 #include <fcntl.h>
@@ -6,40 +7,208 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 
-#include <iostream>
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
 #include <stdexcept>
 
-bool findSymbolAddress(const std::string& path, const std::string& symbol, uintptr_t& address, size_t& size) {
+/**
+ * Maps a whole file read-only. The descriptor is closed right away; the mapping stays valid.
+ */
+static void* mapFile(const std::string& path, size_t& length) {
     const int fd = open(path.c_str(), O_RDONLY);
     if (fd < 0) {
         perror("open");
-        return false;
+        return nullptr;
     }
 
     struct stat st{};
     if (fstat(fd, &st) < 0) {
         perror("fstat");
         close(fd);
-        return false;
+        return nullptr;
     }
 
     void* const data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
     if (data == MAP_FAILED) {
         perror("mmap");
-        close(fd);
+        return nullptr;
+    }
+
+    length = st.st_size;
+    return data;
+}
+
+bool findSymbolAddresses(const std::string& path, std::vector<SymbolLookup>& symbols) {
+    try {
+        const ElfImage image(path);
+
+        // Exported symbols are answered by the dynamic hash table without touching .symtab.
+        const DynamicSymbolTable dynamic(image);
+        size_t remaining = 0;
+        for (auto& lookup : symbols) {
+            Elf64_Sym symbol{};
+            lookup.found = dynamic.find(lookup.name, symbol);
+            if (lookup.found) {
+                lookup.address = symbol.st_value;
+                lookup.size = symbol.st_size;
+                lookup.tls = ELF64_ST_TYPE(symbol.st_info) == STT_TLS;
+            } else {
+                ++remaining;
+            }
+        }
+        if (remaining == 0)
+            return true;
+
+        std::vector<int> tables;
+        for (int i = 0; i < image.header().e_shnum; ++i) {
+            const auto type = image.sections()[i].sh_type;
+            if (type == SHT_SYMTAB || (type == SHT_DYNSYM && !dynamic.hashed()))
+                tables.push_back(i);
+        }
+
+        // The full index costs one pass over the symbol tables; it is kept on disk under the
+        // build ID so later runs against the same build only map it.
+        SymbolIndex index;
+        const std::string buildId = image.buildId();
+        const std::string cacheDir = symbolCacheDirectory();
+        if (!buildId.empty() && !cacheDir.empty()) {
+            const std::string cachePath = cacheDir + "/" + buildId + ".symidx";
+            if (!index.load(cachePath)) {
+                index = SymbolIndex::build(image, tables);
+                std::error_code ec;
+                std::filesystem::create_directories(cacheDir, ec);
+                if (!index.save(cachePath))
+                    std::cerr << "Warning: cannot write symbol cache '" << cachePath << "'\n";
+            }
+        } else {
+            index = SymbolIndex::build(image, tables);
+        }
+
+        for (auto& lookup : symbols) {
+            unsigned type = STT_NOTYPE;
+            if (!lookup.found && (lookup.found = index.find(lookup.name, lookup.address, lookup.size, type)))
+                lookup.tls = type == STT_TLS;
+        }
+        return true;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return false;
+    }
+}
+
+bool findSymbolAddress(const std::string& path, const std::string& symbol, uintptr_t& address, size_t& size) {
+    std::vector<SymbolLookup> lookups{ SymbolLookup{ symbol } };
+    if (!findSymbolAddresses(path, lookups))
+        return false;
+
+    if (!lookups.front().found) {
+        std::cerr << "Error: symbol '" << symbol << "' not found in ELF '" << path << "'\n";
+        return false;
+    }
+
+    address = lookups.front().address;
+    size = lookups.front().size;
+    return true;
+}
+
+bool getEntryPoint(const std::string& path, uintptr_t& entry) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return false;
+    }
+
+    Elf64_Ehdr ehdr{};
+    const ssize_t n = pread(fd, &ehdr, sizeof(ehdr), 0);
+    close(fd);
+
+    if (n != static_cast<ssize_t>(sizeof(ehdr)) || std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0) {
+        std::cerr << "Error: '" << path << "' is not an ELF file\n";
         return false;
     }
 
+    entry = ehdr.e_entry;
+    return true;
+}
+
+bool getInterpreter(const std::string& path, std::string& interpreter) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return false;
+    }
+
+    Elf64_Ehdr ehdr{};
+    bool found = false;
+    if (pread(fd, &ehdr, sizeof(ehdr), 0) == static_cast<ssize_t>(sizeof(ehdr)) &&
+        std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) == 0) {
+        for (int i = 0; i < ehdr.e_phnum && !found; ++i) {
+            Elf64_Phdr phdr{};
+            if (pread(fd, &phdr, sizeof(phdr), ehdr.e_phoff + i * sizeof(phdr)) != static_cast<ssize_t>(sizeof(phdr)))
+                break;
+            if (phdr.p_type != PT_INTERP || phdr.p_filesz == 0 || phdr.p_filesz > 4096)
+                continue;
+
+            std::string text(phdr.p_filesz, '\0');
+            if (pread(fd, text.data(), text.size(), phdr.p_offset) == static_cast<ssize_t>(text.size())) {
+                interpreter = text.c_str();
+                found = !interpreter.empty();
+            }
+        }
+    }
+
+    close(fd);
+    return found;
+}
+
+bool getTlsBlockOffset(const std::string& path, uintptr_t& offset) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return false;
+    }
+
+    Elf64_Ehdr ehdr{};
+    bool found = false;
+    if (pread(fd, &ehdr, sizeof(ehdr), 0) == static_cast<ssize_t>(sizeof(ehdr)) &&
+        std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) == 0) {
+        for (int i = 0; i < ehdr.e_phnum && !found; ++i) {
+            Elf64_Phdr phdr{};
+            if (pread(fd, &phdr, sizeof(phdr), ehdr.e_phoff + i * sizeof(phdr)) != static_cast<ssize_t>(sizeof(phdr)))
+                break;
+            if (phdr.p_type != PT_TLS)
+                continue;
+
+            // Same placement as the dynamic linker's first static TLS block: the block is aligned
+            // down from the thread pointer, keeping the segment's misalignment (firstbyte).
+            const uint64_t align = phdr.p_align != 0 ? phdr.p_align : 1;
+            const uint64_t firstbyte = (-phdr.p_vaddr) & (align - 1);
+            offset = ((phdr.p_memsz - firstbyte + align - 1) / align) * align + firstbyte;
+            found = true;
+        }
+    }
+
+    close(fd);
+    return found;
+}
+
+bool readFunctionSymbols(const std::string& path, std::vector<FunctionSymbol>& functions) {
+    size_t length = 0;
+    void* const data = mapFile(path, length);
+    if (data == nullptr)
+        return false;
+
     auto* const ehdr = reinterpret_cast<const Elf64_Ehdr*>(data);
     auto* const shdrs = reinterpret_cast<const Elf64_Shdr*>(static_cast<const char*>(data) + ehdr->e_shoff);
 
-    const char* const shstrtab = static_cast<const char*>(data) + shdrs[ehdr->e_shstrndx].sh_offset;
-
+    functions.clear();
     for (int i = 0; i < ehdr->e_shnum; ++i) {
-        const char* const sectionName = shstrtab + shdrs[i].sh_name;
-
-        if (std::strcmp(sectionName, ".symtab") != 0 && std::strcmp(sectionName, ".dynsym") != 0)
+        if (shdrs[i].sh_type != SHT_SYMTAB && shdrs[i].sh_type != SHT_DYNSYM)
             continue;
 
         const auto* symtab = reinterpret_cast<const Elf64_Sym*>(
@@ -50,21 +219,34 @@ bool findSymbolAddress(const std::string& path, const std::string& symbol, uintp
         const char* const strtab = static_cast<const char*>(data) + shdrs[shdrs[i].sh_link].sh_offset;
 
         for (int j = 0; j < symCount; ++j) {
-            const char* const name = strtab + symtab[j].st_name;
-            if (name && symbol == name) {
-                address = symtab[j].st_value;
-                size = symtab[j].st_size;
-
-                munmap(data, st.st_size);
-                close(fd);
-                return true;
-            }
+            if (ELF64_ST_TYPE(symtab[j].st_info) != STT_FUNC || symtab[j].st_value == 0)
+                continue;
+            functions.push_back(FunctionSymbol{ symtab[j].st_value, symtab[j].st_size, strtab + symtab[j].st_name });
         }
     }
 
-    munmap(data, st.st_size);
-    close(fd);
+    munmap(data, length);
+
+    // .symtab and .dynsym overlap; keep one entry per address.
+    std::ranges::sort(functions, {}, &FunctionSymbol::address);
+    const auto duplicates = std::ranges::unique(functions, {}, &FunctionSymbol::address);
+    functions.erase(duplicates.begin(), duplicates.end());
+    return true;
+}
+
+std::string describeAddress(const std::vector<FunctionSymbol>& functions, uintptr_t address) {
+    char text[32];
+
+    const auto next = std::ranges::upper_bound(functions, address, {}, &FunctionSymbol::address);
+    if (next != functions.begin()) {
+        const FunctionSymbol& function = *std::prev(next);
+        // An access trap reports the instruction after the access, which may be one past the end.
+        if (address - function.address <= function.size) {
+            std::snprintf(text, sizeof(text), "+0x%lx", static_cast<unsigned long>(address - function.address));
+            return function.name + text;
+        }
+    }
 
-    std::cerr << "Error: symbol '" << symbol << "' not found in ELF '" << path << "'\n";
-    return false;
-}
\ No newline at end of file
+    std::snprintf(text, sizeof(text), "0x%lx", static_cast<unsigned long>(address));
+    return text;
+}
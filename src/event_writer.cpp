@@ -0,0 +1,246 @@
+#include "event_writer.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+constexpr size_t BATCH_SIZE = 1024;
+constexpr auto FLUSH_DELAY = std::chrono::microseconds(500);
+
+char* appendText(char* out, const std::string& text) {
+    std::memcpy(out, text.data(), text.size());
+    return out + text.size();
+}
+
+template <size_t N>
+char* appendLiteral(char* out, const char (&literal)[N]) {
+    std::memcpy(out, literal, N - 1);
+    return out + N - 1;
+}
+
+char* appendNumber(char* out, uint64_t value, int base = 10) {
+    return std::to_chars(out, out + 20, value, base).ptr;
+}
+
+char* appendNumber(char* out, int64_t value) {
+    return std::to_chars(out, out + 20, value).ptr;
+}
+
+}
+
+TextEventSink::TextEventSink(std::vector<std::string> names, int fd,
+                             std::vector<std::shared_ptr<const ValueType>> types, bool showPid)
+    : fd(fd), showPid(showPid), buffer(std::make_unique<char[]>(BUFFER_SIZE)) {
+    types.resize(names.size());
+    for (size_t i = 0; i < names.size(); ++i)
+        addVariable(names[i], std::move(types[i]));
+}
+
+void TextEventSink::addVariable(const std::string& name, std::shared_ptr<const ValueType> type) {
+    // A write line holds two values; enumerator names are the only unbounded ones.
+    size_t longestValue = 0;
+    if (type != nullptr) {
+        for (const auto& enumerator : type->enumerators)
+            longestValue = std::max(longestValue, enumerator.second.size());
+    }
+    lineBudget.push_back(name.size() + 2 * longestValue + MAX_LINE);
+    names.push_back(name);
+    types.push_back(std::move(type));
+}
+
+char* TextEventSink::appendValue(char* out, uint64_t value, uint16_t varIndex) const {
+    const ValueType* type = types[varIndex].get();
+    if (type == nullptr)
+        return appendNumber(out, value);
+
+    switch (type->kind) {
+        case ValueType::Kind::Unsigned:
+            return appendNumber(out, value);
+        case ValueType::Kind::Signed: {
+            const unsigned shift = 64 - static_cast<unsigned>(type->size * 8);
+            return appendNumber(out, type->size >= 8 ? static_cast<int64_t>(value)
+                                                     : static_cast<int64_t>(value << shift) >> shift);
+        }
+        case ValueType::Kind::Float:
+            if (type->size == sizeof(float)) {
+                float f;
+                const auto bits = static_cast<uint32_t>(value);
+                std::memcpy(&f, &bits, sizeof(f));
+                return std::to_chars(out, out + 32, f).ptr;
+            } else {
+                double d;
+                std::memcpy(&d, &value, sizeof(d));
+                return std::to_chars(out, out + 32, d).ptr;
+            }
+        case ValueType::Kind::Bool:
+            return value != 0 ? appendLiteral(out, "true") : appendLiteral(out, "false");
+        case ValueType::Kind::Enum:
+            for (const auto& [enumValue, enumName] : type->enumerators) {
+                if (enumValue == value)
+                    return appendText(out, enumName);
+            }
+            return appendNumber(out, value);
+        case ValueType::Kind::Pointer:
+            out = appendLiteral(out, "0x");
+            return appendNumber(out, value, 16);
+    }
+    return appendNumber(out, value);
+}
+
+char* TextEventSink::appendThread(char* out, const WatchEvent& event) const {
+    out = appendLiteral(out, "    tid=");
+    out = appendNumber(out, static_cast<int64_t>(event.tid));
+    if (showPid) {
+        out = appendLiteral(out, "    pid=");
+        out = appendNumber(out, static_cast<int64_t>(event.pid));
+    }
+    return out;
+}
+
+char* TextEventSink::appendRun(char* out, const WatchEvent& event) {
+    out = appendLiteral(out, "    count=");
+    out = appendNumber(out, static_cast<uint64_t>(event.count));
+    if (event.kind == EventKind::Read || event.kind == EventKind::Write) {
+        out = appendLiteral(out, "    ip=0x");
+        out = appendNumber(out, event.ip, 16);
+    }
+    out = appendLiteral(out, "    duration=");
+    out = appendNumber(out, event.duration / 1000);
+    return appendLiteral(out, "us");
+}
+
+void TextEventSink::consume(std::span<const WatchEvent> events) {
+    for (const WatchEvent& event : events) {
+        const std::string& name = names[event.varIndex];
+        if (used + lineBudget[event.varIndex] > BUFFER_SIZE)
+            flush();
+
+        char* out = buffer.get() + used;
+        out = appendText(out, name);
+        switch (event.kind) {
+            case EventKind::Write:
+                out = appendLiteral(out, "    write    ");
+                out = appendValue(out, event.oldValue, event.varIndex);
+                out = appendLiteral(out, " -> ");
+                out = appendValue(out, event.newValue, event.varIndex);
+                out = appendThread(out, event);
+                break;
+            case EventKind::Read:
+                out = appendLiteral(out, "    read     ");
+                out = appendValue(out, event.newValue, event.varIndex);
+                out = appendThread(out, event);
+                break;
+            case EventKind::Access:
+                out = appendLiteral(out, "    access    ip=0x");
+                out = appendNumber(out, event.ip, 16);
+                out = appendThread(out, event);
+                out = appendLiteral(out, "    time=");
+                out = appendNumber(out, event.time);
+                break;
+            case EventKind::Execute:
+                out = appendLiteral(out, "    exec");
+                out = appendThread(out, event);
+                break;
+        }
+        if (event.count > 0)
+            out = appendRun(out, event);
+        if (event.sampleRatio > 0) {
+            out = appendLiteral(out, "    sampled=");
+            out = std::to_chars(out, out + 16, event.sampleRatio * 100, std::chars_format::fixed, 1).ptr;
+            *out++ = '%';
+        }
+        if (event.stack != 0) {
+            out = appendLiteral(out, "    stack=#");
+            out = appendNumber(out, static_cast<uint64_t>(event.stack));
+        }
+        *out++ = '\n';
+        used = out - buffer.get();
+    }
+}
+
+void TextEventSink::flush() {
+    size_t written = 0;
+    while (written < used) {
+        const ssize_t n = write(fd, buffer.get() + written, used - written);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            break;  // reader went away; nothing sensible left to do with the output
+        }
+        written += static_cast<size_t>(n);
+    }
+    used = 0;
+}
+
+EventWriter::EventWriter(std::unique_ptr<EventSink> sink, QueuePolicy policy, size_t capacity)
+    : sink(std::move(sink)), policy(policy), queue(capacity) {
+    writer = std::thread(&EventWriter::drainLoop, this);
+}
+
+EventWriter::~EventWriter() {
+    close();
+}
+
+void EventWriter::close() {
+    if (!writer.joinable())
+        return;
+    stopping.store(true, std::memory_order_seq_cst);
+    queue.wake();
+    writer.join();
+}
+
+void EventWriter::declareVariable(std::string name, std::shared_ptr<const ValueType> type) {
+    {
+        std::lock_guard lock(declarationsMutex);
+        declarations.emplace_back(std::move(name), std::move(type));
+    }
+    // Published before the events using the variable, which the writer pops with acquire.
+    declared.store(true, std::memory_order_release);
+}
+
+void EventWriter::applyDeclarations() {
+    std::lock_guard lock(declarationsMutex);
+    for (auto& [name, type] : declarations)
+        sink->addVariable(name, std::move(type));
+    declarations.clear();
+    declared.store(false, std::memory_order_relaxed);
+}
+
+void EventWriter::drainLoop() {
+    auto batch = std::make_unique<WatchEvent[]>(BATCH_SIZE);
+    bool unflushed = false;
+
+    while (true) {
+        const size_t count = queue.popBatch(batch.get(), BATCH_SIZE);
+        if (count > 0) {
+            if (declared.load(std::memory_order_acquire))
+                applyDeclarations();
+            sink->consume(std::span<const WatchEvent>(batch.get(), count));
+            unflushed = true;
+            continue;
+        }
+
+        if (stopping.load(std::memory_order_seq_cst) && queue.size() == 0)
+            break;
+
+        // The queue ran dry. Give the tracer a moment to produce more so the output keeps
+        // going out in large batches, but never hold it back once the tracee goes quiet.
+        if (unflushed) {
+            std::this_thread::sleep_for(FLUSH_DELAY);
+            if (queue.size() == 0) {
+                sink->flush();
+                unflushed = false;
+            }
+            continue;
+        }
+
+        queue.waitForData(stopping);
+    }
+
+    sink->flush();
+}
@@ -0,0 +1,79 @@
+#include "library_tracker.hpp"
+#include "elf_utils.hpp"
+#include "memory_utils.hpp"
+
+#include <elf.h>
+#include <link.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+LibraryTracker::LibraryTracker(pid_t pid) : pid(pid) {
+    const std::string exePath = "/proc/" + std::to_string(pid) + "/exe";
+    std::string interpreter;
+    if (!getInterpreter(exePath, interpreter))
+        throw std::runtime_error("Process " + std::to_string(pid) + " has no dynamic linker (static executable?)");
+
+    const uintptr_t linkerBase = getAuxvValue(pid, AT_BASE);
+
+    std::vector<SymbolLookup> lookups{ { "_r_debug" }, { "_dl_debug_state" } };
+    if (!findSymbolAddresses(hostPath(interpreter), lookups) || !lookups[0].found || !lookups[1].found)
+        throw std::runtime_error("Dynamic linker " + interpreter + " does not export _r_debug/_dl_debug_state");
+
+    rDebug = linkerBase + lookups[0].address;
+    hook = linkerBase + lookups[1].address;
+}
+
+bool LibraryTracker::loadedObjects(std::vector<LoadedObject>& objects) const {
+    objects.clear();
+
+    r_debug debug{};
+    readProcessMemory(pid, rDebug, &debug, sizeof(debug));
+    if (debug.r_state != r_debug::RT_CONSISTENT || debug.r_map == nullptr)
+        return false;
+
+    // Bounded walk: a corrupt list must not hang the tracer.
+    constexpr int MAX_OBJECTS = 65536;
+    auto next = reinterpret_cast<uintptr_t>(debug.r_map);
+    for (int i = 0; next != 0 && i < MAX_OBJECTS; ++i) {
+        link_map entry{};
+        readProcessMemory(pid, next, &entry, sizeof(entry));
+
+        std::string name;
+        auto nameAddress = reinterpret_cast<uintptr_t>(entry.l_name);
+        char chunk[64];
+        while (nameAddress != 0 && name.size() < 4096) {
+            // Never read across a page boundary: the string may end right before an unmapped page.
+            const size_t length = std::min<size_t>(sizeof(chunk), 4096 - (nameAddress & 4095));
+            readProcessMemory(pid, nameAddress, chunk, length);
+            const std::string_view part(chunk, length);
+            const size_t end = part.find('\0');
+            name.append(part.substr(0, end));
+            if (end != std::string_view::npos)
+                break;
+            nameAddress += length;
+        }
+
+        objects.push_back(LoadedObject{ std::move(name), entry.l_addr });
+        next = reinterpret_cast<uintptr_t>(entry.l_next);
+    }
+    return true;
+}
+
+std::string LibraryTracker::hostPath(const std::string& targetPath) const {
+    // Resolve through the target's root so tracing into a container still opens the right file.
+    return "/proc/" + std::to_string(pid) + "/root" + targetPath;
+}
+
+bool matchesLibrary(const std::string& request, const std::string& path) {
+    if (path.empty())
+        return false;
+    if (request == path)
+        return true;
+
+    const std::string fileName = path.substr(path.rfind('/') + 1);
+    return fileName == request ||
+           (fileName.size() > request.size() && fileName.compare(0, request.size(), request) == 0 &&
+            fileName[request.size()] == '.');
+}
@@ -1,9 +1,10 @@
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "args.hpp"
-#include "elf_utils.hpp"
-#include "debugger.hpp"
+#include "gwatch.hpp"
 
 int main(int argc, char** argv) {
     Arguments args;
@@ -12,7 +13,16 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    std::cout << "Symbol to watch: " << args.symbol << "\n";
+    for (const auto& spec : args.variables) {
+        std::cout << "Symbol to watch: " << spec.symbol;
+        if (!spec.library.empty())
+            std::cout << " (in " << spec.library << ")";
+        std::cout << "\n";
+    }
+    if (args.attachPid != 0) {
+        args.execPath = "/proc/" + std::to_string(args.attachPid) + "/exe";
+        std::cout << "Attaching to process: " << args.attachPid << "\n";
+    }
     std::cout << "Executable path: " << args.execPath << "\n";
     if (args.execArgs != nullptr) {
         std::cout << "Executable arguments:\n";
@@ -21,21 +31,40 @@ int main(int argc, char** argv) {
         }
     }
 
-    uintptr_t symbolOffset = 0;
-    size_t symbolSize = 0;
-    if (!findSymbolAddress(args.execPath, args.symbol, symbolOffset, symbolSize)) {
-        std::cerr << "Error: symbol '" << args.symbol << "' not found in " << args.execPath << "\n";
-        return 2;
+    std::unique_ptr<WatchSession> session;
+    if (args.attachPid != 0) {
+        session = std::make_unique<WatchSession>(args.attachPid, args.backend, args.options);
+    } else {
+        std::vector<std::string> execArgs;
+        for (char** a = args.execArgs; a != nullptr && *a != nullptr; ++a)
+            execArgs.emplace_back(*a);
+        session = std::make_unique<WatchSession>(args.execPath, std::move(execArgs), args.backend, args.options);
     }
 
-    std::cout << "Symbol " << args.symbol << " found at 0x"
-              << std::hex << symbolOffset << std::dec
-              << " (size=" << symbolSize << " bytes)\n";
+    std::vector<size_t> ids;
+    try {
+        ids = session->addWatches(args.variables);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
 
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const VariableSpec& spec = args.variables[i];
+        const WatchedVariable& var = session->watch(ids[i]);
+        if (!spec.library.empty())
+            continue;
+        if (spec.address != 0) {
+            std::cout << "Range 0x" << std::hex << var.symbolOffset << std::dec << " (size=" << var.size << " bytes)\n";
+            continue;
+        }
+        std::cout << "Symbol " << var.name << " found at 0x"
+                  << std::hex << var.symbolOffset << std::dec
+                  << " (size=" << var.size << " bytes" << (var.tls ? ", thread-local" : "") << ")\n";
+    }
 
-    Debugger dbg(args.execPath, args.symbol, symbolOffset, symbolSize, args.execArgs);
     try {
-        dbg.run();
+        session->run();
     } catch (const std::exception &e) {
         std::cerr << "Error: " << e.what() << "\n";
         return 3;
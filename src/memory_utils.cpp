@@ -1,9 +1,13 @@
 #include "memory_utils.hpp"
+#include "ptrace_utils.hpp"
 
+#include <elf.h>
 #include <sys/ptrace.h>
+#include <sys/uio.h>
 #include <cerrno>
 #include <climits>
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
@@ -31,15 +35,107 @@ uintptr_t getBaseAddress(pid_t pid, const std::string& programPath) {
     throw std::runtime_error("Could not find base address for " + programPath);
 }
 
-uint64_t readProcessMemory(const pid_t& pid, const uintptr_t& addr, const size_t& size) {
-    errno = 0;
-    unsigned long data = ptrace(PTRACE_PEEKDATA, pid, reinterpret_cast<void*>(addr), nullptr);
+uintptr_t getAuxvValue(pid_t pid, unsigned long type) {
+    std::ifstream auxv("/proc/" + std::to_string(pid) + "/auxv", std::ios::binary);
+    if (!auxv.is_open())
+        throw std::runtime_error("Failed to open /proc/<pid>/auxv");
+
+    Elf64_auxv_t entry{};
+    while (auxv.read(reinterpret_cast<char*>(&entry), sizeof(entry)) && entry.a_type != AT_NULL) {
+        if (entry.a_type == type)
+            return entry.a_un.a_val;
+    }
+
+    throw std::runtime_error("Auxiliary vector entry " + std::to_string(type) + " not found");
+}
 
-    if (data == static_cast<unsigned long>(-1) && errno != 0) {
+uintptr_t getLoadBias(pid_t pid, uintptr_t elfEntry) {
+    return getAuxvValue(pid, AT_ENTRY) - elfEntry;
+}
+
+static void peekProcessMemory(const pid_t& pid, const uintptr_t& addr, void* buffer, const size_t& size) {
+    auto* out = static_cast<unsigned char*>(buffer);
+    const uintptr_t alignedStart = addr & ~(sizeof(long) - 1);
+
+    for (uintptr_t word = alignedStart; word < addr + size; word += sizeof(long)) {
+        errno = 0;
+        const long data = ptraceRequest(PTRACE_PEEKDATA, pid, reinterpret_cast<void*>(word), nullptr);
+        if (data == -1 && errno != 0) {
+            throw std::runtime_error(std::string("Failed to read memory: ") + std::strerror(errno));
+        }
+
+        const uintptr_t from = std::max(word, addr);
+        const uintptr_t to = std::min(word + sizeof(long), addr + size);
+        std::memcpy(out + (from - addr), reinterpret_cast<const unsigned char*>(&data) + (from - word), to - from);
+    }
+}
+
+void readProcessMemory(const pid_t& pid, const uintptr_t& addr, void* buffer, const size_t& size) {
+    iovec local{ buffer, size };
+    iovec remote{ reinterpret_cast<void*>(addr), size };
+
+    const ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+    if (n == static_cast<ssize_t>(size))
+        return;
+
+    // EFAULT may only mean the pages are inaccessible (a page guard); PEEKDATA still reads them.
+    if (n == -1 && errno != ENOSYS && errno != EPERM && errno != EFAULT) {
         throw std::runtime_error(std::string("Failed to read memory: ") + std::strerror(errno));
     }
-    uint64_t val = data;
-    if (size == 4) val &= 0xFFFFFFFFULL;
+    peekProcessMemory(pid, addr, buffer, size);
+}
+
+void readProcessMemory(const pid_t& pid, std::span<const MemoryRegion> regions) {
+    constexpr size_t MAX_IOV = IOV_MAX;
+    iovec local[MAX_IOV];
+    iovec remote[MAX_IOV];
+
+    while (!regions.empty()) {
+        const size_t count = std::min(regions.size(), MAX_IOV);
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            local[i] = iovec{ regions[i].buffer, regions[i].size };
+            remote[i] = iovec{ reinterpret_cast<void*>(regions[i].address), regions[i].size };
+            total += regions[i].size;
+        }
+
+        const ssize_t n = process_vm_readv(pid, local, count, remote, count, 0);
+        if (n == static_cast<ssize_t>(total)) {
+            regions = regions.subspan(count);
+            continue;
+        }
+
+        // The vectored read stops at the first region it cannot complete; skip the ones
+        // that were fully read and retry the rest individually.
+        size_t done = 0;
+        size_t bytes = n > 0 ? static_cast<size_t>(n) : 0;
+        while (done < count && bytes >= regions[done].size) {
+            bytes -= regions[done].size;
+            ++done;
+        }
+        for (size_t i = done; i < count; ++i) {
+            readProcessMemory(pid, regions[i].address, regions[i].buffer, regions[i].size);
+        }
+        regions = regions.subspan(count);
+    }
+}
+
+size_t readProcessMemoryPrefix(const pid_t& pid, const uintptr_t& addr, void* buffer, const size_t& size) {
+    iovec local{ buffer, size };
+    iovec remote{ reinterpret_cast<void*>(addr), size };
+
+    // A single remote iovec is transferred page by page up to the first fault.
+    const ssize_t n = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+    return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+uint64_t readProcessMemory(const pid_t& pid, const uintptr_t& addr, const size_t& size) {
+    if (size > sizeof(uint64_t)) {
+        throw std::runtime_error("Cannot read " + std::to_string(size) + " bytes into a 64-bit value");
+    }
+
+    uint64_t val = 0;
+    readProcessMemory(pid, addr, &val, size);
     return val;
 }
 
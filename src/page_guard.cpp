@@ -0,0 +1,125 @@
+#include "page_guard.hpp"
+#include "memory_utils.hpp"
+#include "ptrace_utils.hpp"
+
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+/** One line of /proc/<pid>/maps. */
+struct Mapping {
+    uintptr_t start;
+    uintptr_t end;
+    int prot;
+};
+
+std::vector<Mapping> readMappings(pid_t pid) {
+    std::ifstream maps("/proc/" + std::to_string(pid) + "/maps");
+    if (!maps.is_open())
+        throw std::runtime_error("Failed to open /proc/<pid>/maps");
+
+    std::vector<Mapping> mappings;
+    std::string line;
+    while (std::getline(maps, line)) {
+        std::istringstream iss(line);
+        std::string range;
+        std::string perms;
+        iss >> range >> perms;
+        const size_t dash = range.find('-');
+        if (dash == std::string::npos || perms.size() < 3)
+            continue;
+
+        Mapping mapping{ std::stoull(range.substr(0, dash), nullptr, 16),
+                         std::stoull(range.substr(dash + 1), nullptr, 16), PROT_NONE };
+        if (perms[0] == 'r') mapping.prot |= PROT_READ;
+        if (perms[1] == 'w') mapping.prot |= PROT_WRITE;
+        if (perms[2] == 'x') mapping.prot |= PROT_EXEC;
+        mappings.push_back(mapping);
+    }
+    return mappings;
+}
+
+}
+
+PageGuard::PageGuard(pid_t pid, const std::vector<std::pair<uintptr_t, size_t>>& ranges, bool writesOnly)
+    : keepReadable(writesOnly) {
+    const auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+
+    // Page-aligned, merged spans of the requested ranges.
+    std::vector<std::pair<uintptr_t, uintptr_t>> spans;
+    for (const auto& [address, size] : ranges) {
+        if (size == 0)
+            continue;
+        spans.emplace_back(address & ~(pageSize - 1), (address + size + pageSize - 1) & ~(pageSize - 1));
+    }
+    std::ranges::sort(spans);
+
+    const std::vector<Mapping> mappings = readMappings(pid);
+    uintptr_t covered = 0;  // end of the pages already turned into segments
+    for (auto [start, end] : spans) {
+        start = std::max(start, covered);
+        while (start < end) {
+            const auto mapping = std::ranges::find_if(mappings, [&](const Mapping& m) { return m.start <= start && start < m.end; });
+            if (mapping == mappings.end()) {
+                std::ostringstream message;
+                message << "Address 0x" << std::hex << start << " is not mapped in process " << std::dec << pid;
+                throw std::runtime_error(message.str());
+            }
+            const uintptr_t segmentEnd = std::min(end, mapping->end);
+            if (!segments.empty() && segments.back().start + segments.back().length == start &&
+                segments.back().originalProt == mapping->prot) {
+                segments.back().length += segmentEnd - start;
+            } else {
+                segments.push_back(Segment{ start, segmentEnd - start, mapping->prot });
+            }
+            start = segmentEnd;
+        }
+        covered = std::max(covered, end);
+    }
+
+    // _start runs once, long before any guard fault: its first bytes can host the syscall.
+    scratch = getAuxvValue(pid, AT_ENTRY);
+}
+
+void PageGuard::applyProtections(pid_t tid, bool guard, int& deferredSignal) {
+    for (const Segment& segment : segments) {
+        const int prot = !guard ? segment.originalProt
+                       : keepReadable ? (segment.originalProt & ~PROT_WRITE)
+                       : PROT_NONE;
+        const long result = injectSyscall(tid, scratch, SYS_mprotect, { segment.start, segment.length,
+                                          static_cast<uint64_t>(prot) }, deferredSignal);
+        if (result < 0)
+            throw std::runtime_error(std::string("mprotect() in the target failed: ") + std::strerror(static_cast<int>(-result)));
+    }
+    protectedNow = guard;
+}
+
+void PageGuard::protect(pid_t tid, int& deferredSignal) {
+    applyProtections(tid, true, deferredSignal);
+}
+
+void PageGuard::unprotect(pid_t tid, int& deferredSignal) {
+    applyProtections(tid, false, deferredSignal);
+}
+
+bool PageGuard::covers(uintptr_t address) const {
+    return std::ranges::any_of(segments, [&](const Segment& s) { return s.start <= address && address - s.start < s.length; });
+}
+
+size_t PageGuard::pageCount() const {
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t pages = 0;
+    for (const Segment& segment : segments)
+        pages += segment.length / pageSize;
+    return pages;
+}
@@ -0,0 +1,329 @@
+#include "perf_backend.hpp"
+#include "access_coalescer.hpp"
+#include "memory_utils.hpp"
+#include "ptrace_utils.hpp"
+#include "trace_file.hpp"
+#include "tracer_stats.hpp"
+
+#include <linux/hw_breakpoint.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+constexpr size_t RING_DATA_PAGES = 256;  // must be a power of two
+constexpr int POLL_TIMEOUT_MS = 100;
+
+/** Layout of PERF_RECORD_SAMPLE for IDENTIFIER | IP | TID | TIME. */
+struct Sample {
+    perf_event_header header;
+    uint64_t id;
+    uint64_t ip;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t time;
+};
+
+/** Layout of PERF_RECORD_LOST. */
+struct LostRecord {
+    perf_event_header header;
+    uint64_t id;
+    uint64_t lost;
+};
+
+/** One mmap'd ring buffer; all events on the same CPU are redirected into it. */
+struct RingBuffer {
+    int fd = -1;
+    perf_event_mmap_page* meta = nullptr;
+    char* data = nullptr;
+    size_t size = 0;
+};
+
+long perfEventOpen(perf_event_attr* attr, pid_t pid, int cpu) {
+    return syscall(SYS_perf_event_open, attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+std::vector<int> onlineCpus() {
+    std::vector<int> cpus;
+    std::ifstream online("/sys/devices/system/cpu/online");
+    std::string range;
+    while (std::getline(online, range, ',')) {
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+
+    if (cpus.empty()) {
+        const long count = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < count; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+perf_event_attr breakpointAttr(const WatchedVariable& var) {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_BREAKPOINT;
+    attr.size = sizeof(attr);
+    switch (var.mode) {
+        case WatchMode::Write: attr.bp_type = HW_BREAKPOINT_W; break;
+        case WatchMode::ReadWrite: attr.bp_type = HW_BREAKPOINT_RW; break;
+        case WatchMode::Execute: attr.bp_type = HW_BREAKPOINT_X; break;
+    }
+    attr.bp_addr = var.runtimeAddress;
+    // The kernel only accepts sizeof(long) for execute breakpoints.
+    attr.bp_len = var.mode == WatchMode::Execute ? sizeof(long) : var.size;
+    attr.sample_period = 1;
+    attr.sample_type = PERF_SAMPLE_IDENTIFIER | PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME;
+    // Same time base as the ptrace backend and the --record header.
+    attr.use_clockid = 1;
+    attr.clockid = CLOCK_MONOTONIC;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.watermark = 1;
+    attr.wakeup_watermark = RING_DATA_PAGES * 4096 / 4;
+    return attr;
+}
+
+/**
+ * Copies one record out of the ring, handling records that wrap around its end.
+ */
+void copyRecord(const RingBuffer& ring, uint64_t offset, void* out, size_t len) {
+    const size_t start = offset & (ring.size - 1);
+    const size_t first = std::min(len, ring.size - start);
+    std::memcpy(out, ring.data + start, first);
+    std::memcpy(static_cast<char*>(out) + first, ring.data, len - first);
+}
+
+}
+
+void PerfBackend::watch(const Tracee& tracee, std::vector<WatchedVariable>& vars, EventWriter& events) {
+    const pid_t pid = tracee.pid;
+    for (auto& var : vars) {
+        if (var.mode == WatchMode::Execute)
+            continue;
+        try {
+            var.lastValue = readProcessMemory(pid, var.runtimeAddress, var.size);
+            std::cerr << var.name << " initial=" << var.lastValue << "\n";
+        } catch (const std::exception &e) {
+            std::cerr << "Initial read of " << var.name << " failed: " << e.what() << "\n";
+        }
+    }
+
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    const size_t mapLength = (RING_DATA_PAGES + 1) * pageSize;
+
+    std::vector<int> fds;
+    std::vector<RingBuffer> rings;
+    std::unordered_map<uint64_t, size_t> idToVar;
+
+    auto cleanup = [&] {
+        for (auto& ring : rings) munmap(ring.meta, mapLength);
+        for (int fd : fds) close(fd);
+    };
+
+    // Per-task inherited events cannot be mmap'd, so one event per (thread, variable, CPU)
+    // is opened and every CPU gets a single ring buffer shared by all its events. Threads
+    // created later inherit the events of the thread that spawned them.
+    try {
+        for (int cpu : onlineCpus()) {
+            int ringFd = -1;
+            for (const pid_t tid : tracee.threads) {
+                for (size_t i = 0; i < vars.size(); ++i) {
+                    perf_event_attr attr = breakpointAttr(vars[i]);
+                    const int fd = static_cast<int>(perfEventOpen(&attr, tid, cpu));
+                    if (fd < 0) {
+                        if (errno == ENODEV || errno == ESRCH) continue;  // CPU offline or thread gone
+                        throw std::runtime_error("perf_event_open(" + vars[i].name + ") failed: " + std::strerror(errno));
+                    }
+                    fds.push_back(fd);
+
+                    uint64_t id = 0;
+                    if (ioctl(fd, PERF_EVENT_IOC_ID, &id) == -1)
+                        throw std::runtime_error(std::string("PERF_EVENT_IOC_ID failed: ") + std::strerror(errno));
+                    idToVar[id] = i;
+
+                    if (ringFd >= 0) {
+                        if (ioctl(fd, PERF_EVENT_IOC_SET_OUTPUT, ringFd) == -1)
+                            throw std::runtime_error(std::string("PERF_EVENT_IOC_SET_OUTPUT failed: ") + std::strerror(errno));
+                        continue;
+                    }
+
+                    void* const map = mmap(nullptr, mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    if (map == MAP_FAILED)
+                        throw std::runtime_error(std::string("mmap of perf ring buffer failed: ") + std::strerror(errno));
+
+                    RingBuffer ring;
+                    ring.fd = fd;
+                    ring.meta = static_cast<perf_event_mmap_page*>(map);
+                    ring.data = static_cast<char*>(map) + pageSize;
+                    ring.size = RING_DATA_PAGES * pageSize;
+                    rings.push_back(ring);
+                    ringFd = fd;
+                }
+            }
+        }
+    } catch (...) {
+        cleanup();
+        throw;
+    }
+
+    // Exit of the target is observed through a pidfd, which also works for attached processes.
+    const int pidFd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (pidFd < 0) {
+        cleanup();
+        throw std::runtime_error(std::string("pidfd_open failed: ") + std::strerror(errno));
+    }
+    fds.push_back(pidFd);
+
+    // From here on the target runs freely.
+    for (const pid_t tid : tracee.threads) {
+        ptraceChecked(PTRACE_DETACH, tid, nullptr, nullptr, "ptrace(PTRACE_DETACH) failed");
+    }
+
+    std::vector<uint64_t> accessCounts(vars.size(), 0);
+    uint64_t lost = 0;
+
+    // Samples are timestamped with CLOCK_MONOTONIC, so runs expire against the same clock.
+    std::optional<AccessCoalescer> coalescer;
+    if (options.coalesce)
+        coalescer.emplace(options.coalesceEvents, options.coalesceGap);
+
+    // The target never stops: a trap is a sample, and only the output side has a cost to show.
+    std::optional<TracerStats> stats;
+    if (!options.statsPath.empty()) {
+        stats.emplace("perf", monotonicNanos());
+        installStatsHandler(pthread_self());
+    }
+    const auto writeStats = [&] {
+        TracerStats::Totals totals;
+        for (const uint64_t count : accessCounts)
+            totals.accesses += count;
+        totals.dropped = events.dropped();
+        totals.lost = lost;
+        try {
+            stats->writeFile(options.statsPath, monotonicNanos(), totals);
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: " << e.what() << "\n";
+        }
+    };
+
+    auto drain = [&] {
+        for (auto& ring : rings) {
+            const uint64_t head = __atomic_load_n(&ring.meta->data_head, __ATOMIC_ACQUIRE);
+            uint64_t tail = ring.meta->data_tail;
+
+            while (tail < head) {
+                perf_event_header header{};
+                copyRecord(ring, tail, &header, sizeof(header));
+
+                if (header.type == PERF_RECORD_SAMPLE && header.size >= sizeof(Sample)) {
+                    Sample sample{};
+                    copyRecord(ring, tail, &sample, sizeof(sample));
+                    const auto it = idToVar.find(sample.id);
+                    if (it != idToVar.end()) {
+                        ++accessCounts[it->second];
+                        if (stats)
+                            ++stats->traps;
+                        WatchEvent event{};
+                        event.ip = sample.ip;
+                        event.time = sample.time;
+                        event.pid = static_cast<int32_t>(sample.pid);
+                        event.tid = static_cast<int32_t>(sample.tid);
+                        event.varIndex = static_cast<uint16_t>(it->second);
+                        event.kind = EventKind::Access;
+                        if (coalescer)
+                            coalescer->add(event, events);
+                        else
+                            events.emit(event);
+                    }
+                } else if (header.type == PERF_RECORD_LOST && header.size >= sizeof(LostRecord)) {
+                    LostRecord record{};
+                    copyRecord(ring, tail, &record, sizeof(record));
+                    lost += record.lost;
+                }
+
+                tail += header.size;
+            }
+
+            __atomic_store_n(&ring.meta->data_tail, tail, __ATOMIC_RELEASE);
+        }
+        if (stats)
+            stats->queueDepth.record(events.depth());
+    };
+
+    std::vector<pollfd> pollFds;
+    for (const auto& ring : rings)
+        pollFds.push_back(pollfd{ ring.fd, POLLIN, 0 });
+    pollFds.push_back(pollfd{ pidFd, POLLIN, 0 });
+
+    while (true) {
+        if (poll(pollFds.data(), pollFds.size(), POLL_TIMEOUT_MS) == -1 && errno != EINTR) {
+            cleanup();
+            throw std::runtime_error(std::string("poll failed: ") + std::strerror(errno));
+        }
+        drain();
+        if (coalescer)
+            coalescer->expire(monotonicNanos(), events);
+        if (stats && statsRequested())
+            writeStats();
+
+        if (detachRequested()) {
+            // Closing the events removes the breakpoints; the target was detached already.
+            std::cerr << "Detached; target keeps running\n";
+            break;
+        }
+
+        if ((pollFds.back().revents & POLLIN) == 0)
+            continue;
+
+        if (tracee.attached) {
+            std::cerr << "Process " << pid << " exited\n";
+            break;
+        }
+
+        int status = 0;
+        if (waitpid(pid, &status, 0) == -1) {
+            cleanup();
+            throw std::runtime_error(std::string("waitpid failed: ") + std::strerror(errno));
+        }
+        if (WIFEXITED(status)) {
+            std::cerr << "Child exited (" << WEXITSTATUS(status) << ")\n";
+        } else if (WIFSIGNALED(status)) {
+            std::cerr << "Child killed by signal " << WTERMSIG(status) << "\n";
+        }
+        break;
+    }
+
+    drain();
+    cleanup();
+    if (coalescer)
+        coalescer->flush(events);
+    if (stats)
+        writeStats();
+
+    for (size_t i = 0; i < vars.size(); ++i)
+        std::cerr << vars[i].name << ": " << accessCounts[i] << " accesses\n";
+    if (lost > 0)
+        std::cerr << "Warning: " << lost << " samples lost (ring buffer overflow)\n";
+}
@@ -0,0 +1,243 @@
+#include "predicate.hpp"
+
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+
+/**
+ * Recursive-descent parser emitting postfix bytecode while tracking the stack depth.
+ */
+class PredicateParser {
+public:
+    explicit PredicateParser(const std::string& source) : src(source) {}
+
+    Predicate parse() {
+        Predicate predicate;
+        predicate.text = src;
+        out = &predicate.code;
+
+        parseOr();
+        skipSpace();
+        if (pos != src.size())
+            fail("unexpected '" + std::string(1, src[pos]) + "'");
+        return predicate;
+    }
+
+private:
+    using Op = Predicate::Op;
+
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::invalid_argument("Invalid condition '" + src + "' at column " + std::to_string(pos + 1) + ": " + what);
+    }
+
+    void skipSpace() {
+        while (pos < src.size() && std::isspace(static_cast<unsigned char>(src[pos])))
+            ++pos;
+    }
+
+    /** Consumes the token if it comes next. */
+    bool accept(const char* token) {
+        skipSpace();
+        const size_t len = std::char_traits<char>::length(token);
+        if (src.compare(pos, len, token) != 0)
+            return false;
+        pos += len;
+        return true;
+    }
+
+    void emit(Op op, int64_t operand = 0) {
+        switch (op) {
+            case Op::Push: case Op::LoadOld: case Op::LoadNew: case Op::LoadTid:
+                if (++depth > Predicate::MAX_STACK)
+                    fail("expression too deeply nested");
+                break;
+            case Op::Neg: case Op::Not:
+                break;
+            default:
+                --depth;
+                break;
+        }
+        out->push_back(Predicate::Instruction{ op, operand });
+    }
+
+    void parseOr() {
+        parseAnd();
+        while (accept("||")) {
+            parseAnd();
+            emit(Op::Or);
+        }
+    }
+
+    void parseAnd() {
+        parseComparison();
+        while (accept("&&")) {
+            parseComparison();
+            emit(Op::And);
+        }
+    }
+
+    void parseComparison() {
+        parseSum();
+        // Two-character operators first so "<=" is not read as "<".
+        static constexpr std::array<std::pair<const char*, Op>, 6> operators{{
+            { "==", Op::Eq }, { "!=", Op::Ne }, { "<=", Op::Le }, { ">=", Op::Ge }, { "<", Op::Lt }, { ">", Op::Gt }
+        }};
+        for (const auto& [token, op] : operators) {
+            if (accept(token)) {
+                parseSum();
+                emit(op);
+                return;
+            }
+        }
+    }
+
+    void parseSum() {
+        parseTerm();
+        while (true) {
+            if (accept("+")) {
+                parseTerm();
+                emit(Op::Add);
+            } else if (accept("-")) {
+                parseTerm();
+                emit(Op::Sub);
+            } else {
+                return;
+            }
+        }
+    }
+
+    void parseTerm() {
+        parseUnary();
+        while (true) {
+            if (accept("*")) {
+                parseUnary();
+                emit(Op::Mul);
+            } else if (accept("/")) {
+                parseUnary();
+                emit(Op::Div);
+            } else if (accept("%")) {
+                parseUnary();
+                emit(Op::Mod);
+            } else {
+                return;
+            }
+        }
+    }
+
+    /** Enters one more level of recursion; fail() unwinds the rest, so only success leaves it. */
+    void nest() {
+        if (++nesting > Predicate::MAX_NESTING)
+            fail("expression nested too deeply");
+    }
+
+    void parseUnary() {
+        skipSpace();
+        if (pos < src.size() && src[pos] == '!' && src.compare(pos, 2, "!=") != 0) {
+            ++pos;
+            nest();
+            parseUnary();
+            --nesting;
+            emit(Op::Not);
+        } else if (accept("-")) {
+            nest();
+            parseUnary();
+            --nesting;
+            emit(Op::Neg);
+        } else {
+            parsePrimary();
+        }
+    }
+
+    void parsePrimary() {
+        skipSpace();
+        if (pos >= src.size())
+            fail("unexpected end of expression");
+
+        if (accept("(")) {
+            nest();
+            parseOr();
+            if (!accept(")"))
+                fail("expected ')'");
+            --nesting;
+            return;
+        }
+
+        if (std::isdigit(static_cast<unsigned char>(src[pos]))) {
+            const char* const begin = src.c_str() + pos;
+            char* end = nullptr;
+            errno = 0;
+            const unsigned long long value = std::strtoull(begin, &end, 0);
+            if (errno == ERANGE)
+                fail("number out of range");
+            pos += end - begin;
+            emit(Op::Push, static_cast<int64_t>(value));
+            return;
+        }
+
+        const size_t start = pos;
+        while (pos < src.size() && (std::isalnum(static_cast<unsigned char>(src[pos])) || src[pos] == '_'))
+            ++pos;
+        const std::string name = src.substr(start, pos - start);
+        if (name == "old") {
+            emit(Op::LoadOld);
+        } else if (name == "new") {
+            emit(Op::LoadNew);
+        } else if (name == "tid") {
+            emit(Op::LoadTid);
+        } else {
+            pos = start;
+            fail(name.empty() ? "expected a value" : "unknown name '" + name + "' (expected old, new or tid)");
+        }
+    }
+
+    const std::string& src;
+    size_t pos = 0;
+    size_t depth = 0;
+    size_t nesting = 0;
+    std::vector<Predicate::Instruction>* out = nullptr;
+};
+
+Predicate Predicate::compile(const std::string& source) {
+    return PredicateParser(source).parse();
+}
+
+bool Predicate::evaluate(const PredicateInput& input) const {
+    std::array<int64_t, MAX_STACK> stack;
+    size_t top = 0;
+
+    // Arithmetic wraps like the target's own integers instead of being undefined on overflow.
+    const auto wrap = [](uint64_t value) { return static_cast<int64_t>(value); };
+
+    for (const Instruction& ins : code) {
+        if (ins.op == Op::Push) { stack[top++] = ins.operand; continue; }
+        if (ins.op == Op::LoadOld) { stack[top++] = input.oldValue; continue; }
+        if (ins.op == Op::LoadNew) { stack[top++] = input.newValue; continue; }
+        if (ins.op == Op::LoadTid) { stack[top++] = input.tid; continue; }
+
+        int64_t& a = stack[top - (ins.op == Op::Neg || ins.op == Op::Not ? 1 : 2)];
+        const int64_t b = stack[top - 1];
+        switch (ins.op) {
+            case Op::Neg: a = wrap(0 - static_cast<uint64_t>(a)); continue;
+            case Op::Not: a = !a; continue;
+            case Op::Add: a = wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)); break;
+            case Op::Sub: a = wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)); break;
+            case Op::Mul: a = wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)); break;
+            case Op::Div: a = b == 0 ? 0 : b == -1 ? wrap(0 - static_cast<uint64_t>(a)) : a / b; break;
+            case Op::Mod: a = (b == 0 || b == -1) ? 0 : a % b; break;
+            case Op::Eq: a = a == b; break;
+            case Op::Ne: a = a != b; break;
+            case Op::Lt: a = a < b; break;
+            case Op::Le: a = a <= b; break;
+            case Op::Gt: a = a > b; break;
+            case Op::Ge: a = a >= b; break;
+            case Op::And: a = a && b; break;
+            case Op::Or: a = a || b; break;
+            default: break;
+        }
+        --top;
+    }
+
+    return top > 0 && stack[top - 1] != 0;
+}
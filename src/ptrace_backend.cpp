@@ -0,0 +1,1414 @@
+#include "ptrace_backend.hpp"
+#include "elf_utils.hpp"
+#include "memory_utils.hpp"
+#include "predicate.hpp"
+#include "ptrace_utils.hpp"
+#include "trace_file.hpp"
+
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/stat.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+/** Bytes of stack copied per requested frame for the frame-pointer walk. */
+static constexpr size_t STACK_BYTES_PER_FRAME = 512;
+
+/**
+ * Reads the values of address-ordered chunks with one read per contiguous run.
+ */
+static void readChunks(pid_t tid, std::span<WatchedVariable* const> chunks, std::vector<uint64_t>& values) {
+    values.assign(chunks.size(), 0);
+    std::vector<uint8_t> buffer;
+    for (size_t first = 0, last = 0; first < chunks.size(); first = last) {
+        last = first + 1;
+        while (last < chunks.size() && chunks[last]->runtimeAddress == chunks[last - 1]->runtimeAddress + chunks[last - 1]->size)
+            ++last;
+
+        const uintptr_t start = chunks[first]->runtimeAddress;
+        buffer.resize(chunks[last - 1]->runtimeAddress + chunks[last - 1]->size - start);
+        readProcessMemory(tid, start, buffer.data(), buffer.size());
+        for (size_t i = first; i < last; ++i)
+            std::memcpy(&values[i], buffer.data() + (chunks[i]->runtimeAddress - start), chunks[i]->size);
+    }
+}
+
+void PtraceBackend::setHardwareWatchpoint(const Tracee& tracee, std::vector<WatchedVariable>& vars) {
+    rootPid = tracee.pid;
+    ProcessState& process = processes[tracee.pid];
+    process.addresses.resize(vars.size());
+    process.lastValues.resize(vars.size());
+
+    bool libraryVars = false;
+    size_t slotVars = 0;
+    for (auto& var : vars) {
+        const size_t index = &var - vars.data();
+        process.addresses[index] = var.tls ? static_cast<uintptr_t>(var.tpOffset) : var.runtimeAddress;
+        process.lastValues[index] = var.lastValue;
+        if (var.guarded) {
+            guardedVars.push_back(&var);
+            continue;
+        }
+        ++slotVars;
+        if (!var.library.empty()) {
+            libraryVars = true;
+            continue;
+        }
+        // A thread-local slot is re-pointed per thread; the offset has the instances' alignment.
+        var.slot = process.debugRegs.allocate(var.tls ? static_cast<uintptr_t>(var.tpOffset) : var.runtimeAddress, var.size, var.mode);
+        if (var.tls)
+            tlsVars.push_back(&var);
+    }
+
+    if (libraryVars) {
+        if (slotVars >= DEBUG_SLOT_COUNT)
+            throw std::runtime_error("Shared library variables need a spare debug register for the dynamic linker hook "
+                                     "(watch at most " + std::to_string(DEBUG_SLOT_COUNT - 1) + " variables)");
+        libraries = std::make_unique<LibraryTracker>(tracee.pid);
+        hookSlot = process.debugRegs.allocate(libraries->hookAddress(), 1, WatchMode::Execute);
+        // Libraries already mapped (attach, or a rendezvous that happened before us) are placed now.
+        resolveLibraries(tracee.pid, process, vars);
+    }
+
+    int pending = 0;
+    if (!guardedVars.empty()) {
+        std::ranges::sort(guardedVars, {}, &WatchedVariable::runtimeAddress);
+        std::vector<uint64_t> values;
+        readChunks(tracee.pid, guardedVars, values);
+        for (size_t i = 0; i < guardedVars.size(); ++i)
+            process.lastValues[guardedVars[i] - vars.data()] = values[i];
+
+        std::vector<std::pair<uintptr_t, size_t>> ranges;
+        size_t bytes = 0;
+        for (const WatchedVariable* var : guardedVars) {
+            ranges.emplace_back(var->runtimeAddress, var->size);
+            bytes += var->size;
+        }
+        // Read-only pages are enough when nothing needs its reads reported.
+        const bool writesOnly = std::ranges::all_of(guardedVars, [](const WatchedVariable* var) { return var->mode == WatchMode::Write; });
+        process.pageGuard.emplace(tracee.pid, ranges, writesOnly);
+
+        process.pageGuard->protect(tracee.threads.front(), pending);
+        std::cerr << "Guarding " << bytes << " bytes with page protection (" << process.pageGuard->pageCount() << " pages)\n";
+    }
+
+    for (const pid_t tid : tracee.threads) {
+        ThreadState state;
+        state.process = tracee.pid;
+        if (tid == tracee.threads.front())
+            state.pendingSignal = pending;
+        resolveThreadPointer(tid, state, vars);
+        if (tracee.attached)
+            state.original = DebugRegisterState::capture(tid);
+        armThread(tid, state, vars);
+        threads.emplace(tid, state);
+    }
+}
+
+void PtraceBackend::armThread(pid_t tid, ThreadState& state, const std::vector<WatchedVariable>& vars) const {
+    const ProcessState& process = processes.at(state.process);
+    uint8_t disabled = state.pausedSlots;
+    if ((dutyCycle && !dutyCycle->armed()) || paused || (!options.scopeFunctions.empty() && state.scope.empty()))
+        disabled |= static_cast<uint8_t>(((1u << DEBUG_SLOT_COUNT) - 1) & ~(hookSlot >= 0 ? 1u << hookSlot : 0u));
+    if (tlsVars.empty() && disabled == 0) {
+        process.debugRegs.apply(tid);
+    } else {
+        DebugRegisterState regs = process.debugRegs;
+        for (const WatchedVariable* var : tlsVars) {
+            const uintptr_t tpOffset = process.addresses[var - vars.data()];
+            if (state.threadPointer == 0 || tpOffset == 0)
+                regs.release(var->slot);
+            else
+                regs.setAddress(var->slot, state.threadPointer + tpOffset);
+        }
+        for (int slot = 0; slot < DEBUG_SLOT_COUNT; ++slot) {
+            if ((disabled & (1u << slot)) != 0)
+                regs.release(slot);
+        }
+        regs.apply(tid);
+    }
+    clearDebugStatus(tid);
+    state.armedVars = {};
+    for (size_t i = 0; i < vars.size(); ++i) {
+        if (vars[i].slot >= 0)
+            state.armedVars[vars[i].slot] = static_cast<uint16_t>(i + 1);
+    }
+    state.generation = generation;
+}
+
+void PtraceBackend::resolveThreadPointer(pid_t tid, ThreadState& state, const std::vector<WatchedVariable>& vars) {
+    if (tlsVars.empty() || state.threadPointer != 0)
+        return;
+
+    user_regs_struct regs{};
+    ptraceChecked(PTRACE_GETREGS, tid, nullptr, &regs, "ptrace(PTRACE_GETREGS) failed");
+    if (regs.fs_base == 0)
+        return;  // the dynamic linker or the libc start code has not run arch_prctl(ARCH_SET_FS) yet
+
+    state.threadPointer = regs.fs_base;
+    const ProcessState& process = processes.at(state.process);
+    for (const WatchedVariable* var : tlsVars) {
+        const uintptr_t tpOffset = process.addresses[var - vars.data()];
+        if (tpOffset == 0)
+            continue;  // not in this process' image
+        const uintptr_t address = state.threadPointer + tpOffset;
+        std::cerr << "Runtime address of " << var->name << ": 0x" << std::hex << address << std::dec
+                  << " (thread " << tid << ")\n";
+        if (var->mode == WatchMode::Execute)
+            continue;
+        try {
+            state.tlsValues[var->slot] = readProcessMemory(tid, address, var->size);
+        } catch (const std::exception &e) {
+            std::cerr << "Warning: initial read of " << var->name << " in thread " << tid << " failed: " << e.what() << "\n";
+        }
+    }
+}
+
+int PtraceBackend::resumeRequest(const ThreadState& state) const {
+    return !tlsVars.empty() && state.threadPointer == 0 ? PTRACE_SYSCALL : PTRACE_CONT;
+}
+
+bool PtraceBackend::resolveLibraries(pid_t pid, ProcessState& process, std::vector<WatchedVariable>& vars) {
+    std::vector<LoadedObject> objects;
+    try {
+        if (!libraries->loadedObjects(objects))
+            return false;
+    } catch (const std::exception &e) {
+        std::cerr << "Warning: cannot read the link map: " << e.what() << "\n";
+        return false;
+    }
+
+    bool changed = false;
+    for (auto& var : vars) {
+        const size_t index = &var - vars.data();
+        if (var.library.empty() || var.removed || process.addresses[index] != 0)
+            continue;
+
+        // Only a library that was asked for is ever opened, and only once it is actually mapped.
+        const auto object = std::ranges::find_if(objects, [&](const LoadedObject& o) { return matchesLibrary(var.library, o.path); });
+        if (object == objects.end())
+            continue;
+
+        std::vector<SymbolLookup> lookup{ SymbolLookup{ var.name } };
+        if (!findSymbolAddresses(libraries->hostPath(object->path), lookup) || !lookup.front().found) {
+            std::cerr << "Warning: symbol '" << var.name << "' not found in " << object->path << "\n";
+            continue;
+        }
+        if (lookup.front().tls) {
+            // Their blocks are placed by the dynamic linker (dtv), not at a fixed offset from fs_base.
+            std::cerr << "Warning: cannot watch " << var.name << " in " << object->path
+                      << ": thread-local variables of shared libraries are not supported\n";
+            continue;
+        }
+
+        const uintptr_t address = object->base + lookup.front().address;
+        try {
+            var.slot = process.debugRegs.allocate(address, lookup.front().size, var.mode);
+            if (var.mode != WatchMode::Execute)
+                process.lastValues[index] = readProcessMemory(pid, address, lookup.front().size);
+        } catch (const std::exception &e) {
+            if (var.slot >= 0)
+                process.debugRegs.release(var.slot);
+            var.slot = -1;
+            std::cerr << "Warning: cannot watch " << var.name << " in " << object->path << ": " << e.what() << "\n";
+            continue;
+        }
+
+        var.symbolOffset = lookup.front().address;
+        var.size = lookup.front().size;
+        process.addresses[index] = address;
+        std::cerr << "Runtime address of " << var.name << ": 0x" << std::hex << address << std::dec
+                  << " (" << object->path << ")\n";
+        if (var.mode != WatchMode::Execute)
+            std::cerr << var.name << " initial=" << process.lastValues[index] << "\n";
+        changed = true;
+    }
+    return changed;
+}
+
+void PtraceBackend::resolveAfterExec(pid_t pid, ProcessState& process, const std::vector<WatchedVariable>& vars) {
+    // The old address space went away with its page protections, breakpoints and link map.
+    process.pageGuard.reset();
+    process.breakpoints.forget();
+    process.debugRegs = DebugRegisterState{};
+    std::ranges::fill(process.addresses, 0);
+    std::ranges::fill(process.lastValues, 0);
+    if (pid == rootPid)
+        libraries.reset();
+
+    const std::string exePath = "/proc/" + std::to_string(pid) + "/exe";
+    uintptr_t entry = 0;
+    if (!getEntryPoint(exePath, entry)) {
+        std::cerr << "Warning: cannot read the new image of process " << pid << "; nothing is watched in it\n";
+        return;
+    }
+    const uintptr_t loadBias = getLoadBias(pid, entry);
+    if (!options.scopeFunctions.empty())
+        placeScope(pid, process, exePath, loadBias, false);
+
+    struct stat image{};
+    const bool sameImage = stat(exePath.c_str(), &image) == 0 && image.st_dev == imageDevice && image.st_ino == imageInode;
+    std::cerr << "Process " << pid << " called exec" << (sameImage ? "" : " into another binary") << "\n";
+
+    // Another binary is searched by name; its thread-local variables also need its TLS block.
+    std::vector<SymbolLookup> lookups;
+    uintptr_t tlsBlockOffset = 0;
+    bool tlsBlock = false;
+    if (!sameImage) {
+        for (const auto& var : vars)
+            lookups.push_back(SymbolLookup{ var.name });
+        findSymbolAddresses(exePath, lookups);
+        if (std::ranges::any_of(lookups, [](const SymbolLookup& lookup) { return lookup.found && lookup.tls; }))
+            tlsBlock = getTlsBlockOffset(exePath, tlsBlockOffset);
+    }
+
+    if (!guardedVars.empty())
+        std::cerr << "Warning: ranges guarded with page protection are not guarded again in process " << pid << "\n";
+
+    for (size_t i = 0; i < vars.size(); ++i) {
+        const WatchedVariable& var = vars[i];
+        if (var.guarded || var.removed)
+            continue;
+        if (!var.library.empty()) {
+            std::cerr << "Warning: " << var.name << " is not followed into the new image of process " << pid << "\n";
+            continue;
+        }
+
+        uintptr_t address = 0;
+        if (sameImage) {
+            address = var.tls ? static_cast<uintptr_t>(var.tpOffset) : loadBias + var.symbolOffset;
+        } else if (const SymbolLookup& lookup = lookups[i]; lookup.found && lookup.size == var.size &&
+                   lookup.tls == var.tls && (!var.tls || tlsBlock)) {
+            address = var.tls ? lookup.address - tlsBlockOffset : loadBias + lookup.address;
+        }
+        if (address == 0) {
+            std::cerr << "Warning: " << var.name << " (" << var.size << " bytes) not found in the new image of process "
+                      << pid << "\n";
+            continue;
+        }
+
+        try {
+            process.debugRegs.assign(var.slot, address, var.size, var.mode);
+            if (!var.tls && var.mode != WatchMode::Execute)
+                process.lastValues[i] = readProcessMemory(pid, address, var.size);
+        } catch (const std::exception &e) {
+            process.debugRegs.release(var.slot);
+            std::cerr << "Warning: cannot watch " << var.name << " in process " << pid << ": " << e.what() << "\n";
+            continue;
+        }
+        process.addresses[i] = address;
+        if (var.tls)
+            continue;  // placed in each thread once it has a thread pointer
+        std::cerr << "Runtime address of " << var.name << ": 0x" << std::hex << address << std::dec
+                  << " (process " << pid << ")\n";
+    }
+}
+
+void PtraceBackend::placeScope(pid_t pid, ProcessState& process, const std::string& exePath, uintptr_t loadBias,
+                               bool required) {
+    std::vector<SymbolLookup> lookups;
+    for (const auto& function : options.scopeFunctions)
+        lookups.push_back(SymbolLookup{ function });
+    findSymbolAddresses(exePath, lookups);
+
+    // Checked up front so that nothing is left planted when giving up.
+    for (const SymbolLookup& lookup : lookups) {
+        if (required && (!lookup.found || lookup.tls))
+            throw std::runtime_error("--only-in: function '" + lookup.name + "' not found in " + exePath);
+    }
+    for (const SymbolLookup& lookup : lookups) {
+        if (!lookup.found || lookup.tls) {
+            std::cerr << "Warning: function '" << lookup.name << "' not found in process " << pid << "\n";
+            continue;
+        }
+        const uintptr_t address = loadBias + lookup.address;
+        process.breakpoints.insertEntry(pid, address);
+        std::cerr << "Watching only inside " << lookup.name << " at 0x" << std::hex << address << std::dec
+                  << " (process " << pid << ")\n";
+    }
+}
+
+bool PtraceBackend::crossScope(pid_t tid, ThreadState& thread, ProcessState& process, const user_regs_struct& regs,
+                               const std::vector<WatchedVariable>& vars, int& deferredSignal) {
+    const uintptr_t site = regs.rip - 1;
+    const BreakpointSet::Site* const hit = process.breakpoints.find(site);
+    const bool entry = hit->entry;
+    const bool inside = !thread.scope.empty();
+
+    // After the ret the stack pointer is back where the call left it; frames at or below
+    // it have returned, or were unwound past.
+    if (hit->returns > 0) {
+        while (!thread.scope.empty() && thread.scope.back().stackPointer <= regs.rsp) {
+            process.breakpoints.releaseReturn(tid, thread.scope.back().returnAddress);
+            thread.scope.pop_back();
+        }
+    }
+    if (entry) {
+        // The first instruction has not run yet: the return address is on top of the stack.
+        const uintptr_t returnAddress = readProcessMemory(tid, regs.rsp, sizeof(uint64_t));
+        process.breakpoints.insertReturn(tid, returnAddress);
+        thread.scope.push_back(ScopeFrame{ returnAddress, regs.rsp + sizeof(uint64_t) });
+    }
+
+    if (inside != !thread.scope.empty())
+        armThread(tid, thread, vars);
+    return process.breakpoints.stepOver(tid, site, deferredSignal);
+}
+
+void PtraceBackend::releaseChild(pid_t child, const ProcessState& parent) {
+    int status = 0;
+    while (waitpid(child, &status, __WALL) == -1) {
+        if (errno != EINTR)
+            return;
+    }
+    if (!WIFSTOPPED(status))
+        return;
+    try {
+        BreakpointSet breakpoints = parent.breakpoints;
+        breakpoints.restoreCode(child);
+    } catch (const std::exception &e) {
+        std::cerr << "Warning: cannot remove breakpoints from process " << child << ": " << e.what() << "\n";
+    }
+    if (ptraceRequest(PTRACE_DETACH, child, nullptr, nullptr) == -1 && errno != ESRCH)
+        std::cerr << "Warning: PTRACE_DETACH of " << child << " failed: " << std::strerror(errno) << "\n";
+}
+
+/**
+ * Reads a numeric field ("Tgid", "PPid") of /proc/<tid>/status, 0 if it cannot be read.
+ */
+static pid_t readStatusField(pid_t tid, const std::string& field) {
+    std::ifstream status("/proc/" + std::to_string(tid) + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.size() > field.size() && line.compare(0, field.size(), field) == 0 && line[field.size()] == ':')
+            return static_cast<pid_t>(std::strtol(line.c_str() + field.size() + 1, nullptr, 10));
+    }
+    return 0;
+}
+
+pid_t PtraceBackend::processOf(pid_t tid) {
+    if (!options.followChildren)
+        return rootPid;
+
+    pid_t tgid = readStatusField(tid, "Tgid");
+    if (tgid == 0)
+        tgid = tid;  // already gone; its exit is all that is left to see
+    if (!processes.contains(tgid)) {
+        const auto parent = processes.find(readStatusField(tgid, "PPid"));
+        processes.emplace(tgid, parent != processes.end() ? parent->second : processes.at(rootPid));
+    }
+    return tgid;
+}
+
+void PtraceBackend::detachAll() {
+    for (const auto& [tid, state] : threads) {
+        if (ptraceRequest(PTRACE_INTERRUPT, tid, nullptr, nullptr) == -1 && errno != ESRCH)
+            std::cerr << "Warning: PTRACE_INTERRUPT of " << tid << " failed: " << std::strerror(errno) << "\n";
+    }
+
+    std::vector<pid_t> pending;
+    for (const auto& [tid, state] : threads)
+        pending.push_back(tid);
+
+    while (!pending.empty()) {
+        const pid_t tid = pending.back();
+        pending.pop_back();
+
+        int status = 0;
+        if (waitpid(tid, &status, __WALL) == -1 || !WIFSTOPPED(status)) {
+            threads.erase(tid);
+            continue;
+        }
+
+        const int sig = WSTOPSIG(status);
+        const int event = status >> 16;
+
+        ThreadState& state = threads[tid];
+        if (state.process == 0)
+            state.process = processOf(tid);
+
+        if (sig == SIGTRAP && (event == PTRACE_EVENT_CLONE || event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK)) {
+            // A thread or process created while detaching is auto-attached and must be released
+            // too; a forked child also inherited the guarded pages.
+            unsigned long newTid = 0;
+            if (ptraceRequest(PTRACE_GETEVENTMSG, tid, nullptr, &newTid) == 0 && !threads.contains(static_cast<pid_t>(newTid))) {
+                ThreadState child;
+                if (event != PTRACE_EVENT_CLONE) {
+                    processes.try_emplace(static_cast<pid_t>(newTid), processes.at(state.process));
+                    child.process = static_cast<pid_t>(newTid);
+                }
+                threads.emplace(static_cast<pid_t>(newTid), child);
+                pending.push_back(static_cast<pid_t>(newTid));
+            }
+        }
+
+        // A thread that trapped on an --only-in breakpoint resumes at the original instruction,
+        // which the first thread of its process to stop puts back.
+        BreakpointSet& breakpoints = processes.at(state.process).breakpoints;
+        if (!breakpoints.empty()) {
+            try {
+                user_regs_struct regs{};
+                ptraceChecked(PTRACE_GETREGS, tid, nullptr, &regs, "ptrace(PTRACE_GETREGS) failed");
+                if (sig == SIGTRAP && event == 0 && breakpoints.find(regs.rip - 1) != nullptr) {
+                    --regs.rip;
+                    ptraceChecked(PTRACE_SETREGS, tid, nullptr, &regs, "ptrace(PTRACE_SETREGS) failed");
+                }
+                breakpoints.restoreCode(tid);
+            } catch (const std::exception &e) {
+                std::cerr << "Warning: failed to remove breakpoints: " << e.what() << "\n";
+            }
+        }
+
+        // A signal-delivery-stop caught on the way must still reach the target, unless it is
+        // a guard fault: the faulting instruction simply runs again once the pages are restored.
+        std::optional<PageGuard>& pageGuard = processes.at(state.process).pageGuard;
+        int deliver = (event == 0 && sig != SIGTRAP) ? sig : 0;
+        if (deliver == SIGSEGV && pageGuard && pageGuard->active()) {
+            siginfo_t info{};
+            if (ptraceRequest(PTRACE_GETSIGINFO, tid, nullptr, &info) == 0 && info.si_code == SEGV_ACCERR &&
+                pageGuard->covers(reinterpret_cast<uintptr_t>(info.si_addr)))
+                deliver = 0;
+        }
+
+        // The first thread of each process to stop gives the pages back their protections.
+        if (pageGuard && pageGuard->active()) {
+            int deferred = 0;
+            try {
+                pageGuard->unprotect(tid, deferred);
+            } catch (const std::exception &e) {
+                std::cerr << "Warning: failed to restore page protections: " << e.what() << "\n";
+            }
+            if (deliver == 0)
+                deliver = deferred;
+        }
+
+        try {
+            if (state.generation != 0)
+                state.original.apply(tid);
+            clearDebugStatus(tid);
+        } catch (const std::exception &e) {
+            std::cerr << "Warning: failed to restore debug registers of " << tid << ": " << e.what() << "\n";
+        }
+
+        if (ptraceRequest(PTRACE_DETACH, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(deliver))) == -1 && errno != ESRCH)
+            std::cerr << "Warning: PTRACE_DETACH of " << tid << " failed: " << std::strerror(errno) << "\n";
+        threads.erase(tid);
+    }
+
+    std::cerr << "Detached; target keeps running\n";
+}
+
+/**
+ * Sign-extends a value read from a variable of the given size.
+ */
+static int64_t signExtend(uint64_t value, size_t size) {
+    const unsigned shift = 64 - static_cast<unsigned>(size * 8);
+    return size >= 8 ? static_cast<int64_t>(value) : static_cast<int64_t>(value << shift) >> shift;
+}
+
+/**
+ * Converts a raw value to the integer a condition sees: unsigned types are zero-extended,
+ * floating-point values truncated, everything else (including untyped variables) sign-extended.
+ */
+static int64_t conditionValue(uint64_t value, const WatchedVariable& var) {
+    if (var.type == nullptr)
+        return signExtend(value, var.size);
+
+    switch (var.type->kind) {
+        case ValueType::Kind::Unsigned: case ValueType::Kind::Bool: case ValueType::Kind::Pointer:
+            return static_cast<int64_t>(value);
+        case ValueType::Kind::Float: {
+            double d;
+            if (var.type->size == sizeof(float)) {
+                float f;
+                const auto bits = static_cast<uint32_t>(value);
+                std::memcpy(&f, &bits, sizeof(f));
+                d = f;
+            } else {
+                std::memcpy(&d, &value, sizeof(d));
+            }
+            // NaN and out-of-range values compare as 0 rather than being undefined.
+            return std::isfinite(d) && std::fabs(d) < 9.2e18 ? static_cast<int64_t>(d) : 0;
+        }
+        default:
+            return signExtend(value, var.size);
+    }
+}
+
+/**
+ * Reads the instruction pointer of a stopped thread.
+ */
+static uint64_t readIp(pid_t tid) {
+    user_regs_struct regs{};
+    ptraceChecked(PTRACE_GETREGS, tid, nullptr, &regs, "ptrace(PTRACE_GETREGS) failed");
+    return regs.rip;
+}
+
+bool PtraceBackend::reportChange(EventWriter& events, uint16_t varIndex, const WatchedVariable& var, uint64_t& lastValue,
+                                 uint64_t currentValue, pid_t pid, pid_t tid) {
+    ++accessCounts[varIndex];
+    if (var.condition != nullptr) {
+        const PredicateInput input{ conditionValue(lastValue, var), conditionValue(currentValue, var), tid };
+        if (!var.condition->evaluate(input)) {
+            lastValue = currentValue;
+            return false;
+        }
+    }
+
+    WatchEvent event{};
+    event.oldValue = lastValue;
+    event.newValue = currentValue;
+    event.time = monotonicNanos();
+    event.pid = pid;
+    event.tid = tid;
+    event.varIndex = varIndex;
+    event.kind = (var.mode == WatchMode::Write || currentValue != lastValue) ? EventKind::Write : EventKind::Read;
+    lastValue = currentValue;
+
+    if (options.profileTop > 0) {
+        uint64_t weight = 1;
+        if (dutyCycle) {
+            weight = static_cast<uint64_t>(std::llround(1.0 / dutyCycle->ratio()));
+            estimates[varIndex] += 1.0 / dutyCycle->ratio();
+            ++windowAccesses[varIndex];
+        }
+        profile.record(readIp(tid), varIndex, event.kind == EventKind::Write, weight);
+        return false;
+    }
+    return emitEvent(events, event);
+}
+
+bool PtraceBackend::emitEvent(EventWriter& events, WatchEvent& event) {
+    if (dutyCycle) {
+        event.sampleRatio = dutyCycle->ratio();
+        estimates[event.varIndex] += 1.0 / event.sampleRatio;
+        ++windowAccesses[event.varIndex];
+    }
+    if (stacks) {
+        uint64_t ip = 0;
+        event.stack = captureStack(event.tid, ip);
+        if (event.ip == 0)
+            event.ip = ip;
+    }
+    if (!coalescer) {
+        events.emit(event);
+        return false;
+    }
+    // Runs are told apart by instruction; after a data trap RIP is the one following the access.
+    if (event.ip == 0)
+        event.ip = readIp(event.tid);
+    return coalescer->add(event, events);
+}
+
+uint32_t PtraceBackend::captureStack(pid_t tid, uint64_t& ip) {
+    user_regs_struct regs{};
+    ptraceChecked(PTRACE_GETREGS, tid, nullptr, &regs, "ptrace(PTRACE_GETREGS) failed");
+    ip = regs.rip;
+    // The copy ends early at the top of the stack; the walk stops where the copy does.
+    const size_t copied = readProcessMemoryPrefix(tid, regs.rsp, stackWindow.data(), stackWindow.size());
+    const size_t depth = walkFramePointers(regs.rip, regs.rbp, regs.rsp, std::span(stackWindow.data(), copied),
+                                           stackFrames);
+    return stacks->intern(std::span(stackFrames.data(), depth));
+}
+
+void PtraceBackend::pauseSlot(pid_t tid, ThreadState& state, const WatchedVariable& var,
+                              const std::vector<WatchedVariable>& vars) {
+    const uint64_t until = monotonicNanos() + options.coalescePause;
+    state.pausedSlots |= static_cast<uint8_t>(1u << var.slot);
+    armThread(tid, state, vars);
+    coalescer->hold(tid, static_cast<uint16_t>(&var - vars.data()), until);
+    pauses.emplace_back(until, tid);
+}
+
+void PtraceBackend::serviceTimers(EventWriter& events, uint64_t now) {
+    while (!pauses.empty() && pauses.front().first <= now) {
+        const auto it = threads.find(pauses.front().second);
+        pauses.pop_front();
+        if (it == threads.end() || it->second.pausedSlots == 0)
+            continue;
+        // The thread is running: it is re-armed on the stop the interrupt causes, or on any earlier one.
+        it->second.pausedSlots = 0;
+        it->second.generation = 0;
+        if (ptraceRequest(PTRACE_INTERRUPT, it->first, nullptr, nullptr) == -1 && errno != ESRCH)
+            std::cerr << "Warning: PTRACE_INTERRUPT of " << it->first << " failed: " << std::strerror(errno) << "\n";
+    }
+
+    if (dutyCycle && dutyCycle->update(now)) {
+        // The window ended or the pause is over: every thread takes the new DR7.
+        if (dutyCycle->armed())
+            std::fill(windowAccesses.begin(), windowAccesses.end(), 0);
+        rearmAll();
+    }
+
+    uint64_t next = UINT64_MAX;
+    if (coalescer) {
+        coalescer->expire(now, events);
+        next = coalescer->nextExpiry();
+    }
+    if (dutyCycle)
+        next = std::min(next, dutyCycle->nextChange());
+    if (!pauses.empty())
+        next = std::min(next, pauses.front().first);
+    // The timer only moves when something falls due before it fires; waking up early is harmless.
+    if (next != UINT64_MAX && (wakeupAt <= now || next < wakeupAt)) {
+        scheduleWakeup(next);
+        wakeupAt = next;
+    }
+}
+
+void PtraceBackend::rearmAll() {
+    ++generation;
+    for (const auto& [tid, state] : threads) {
+        if (ptraceRequest(PTRACE_INTERRUPT, tid, nullptr, nullptr) == -1 && errno != ESRCH)
+            std::cerr << "Warning: PTRACE_INTERRUPT of " << tid << " failed: " << std::strerror(errno) << "\n";
+    }
+}
+
+void PtraceBackend::writeStats(const EventWriter& events) const {
+    TracerStats::Totals totals;
+    totals.stops = stopCount;
+    for (const uint64_t count : accessCounts)
+        totals.accesses += count;
+    totals.ptraceRequests = ptraceRequestCount() - requestsAtStart;
+    totals.dropped = events.dropped();
+    try {
+        stats->writeFile(options.statsPath, monotonicNanos(), totals);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: " << e.what() << "\n";
+    }
+}
+
+/**
+ * Name of a watch mode as --mode takes it.
+ */
+static const char* modeName(WatchMode mode) {
+    switch (mode) {
+        case WatchMode::Write: return "write";
+        case WatchMode::Execute: return "exec";
+        default: return "rw";
+    }
+}
+
+void PtraceBackend::runCommand(std::vector<WatchedVariable>& vars, EventWriter& events) {
+    std::string line;
+    if (!control->take(line))
+        return;
+
+    std::ostringstream reply;
+    try {
+        const ControlCommand command = parseControlCommand(line);
+        switch (command.kind) {
+            case ControlCommand::Kind::Add:
+                reply << addWatch(command, vars, events);
+                break;
+            case ControlCommand::Kind::Remove:
+                removeWatch(command, vars);
+                break;
+            case ControlCommand::Kind::List:
+                for (size_t i = 0; i < vars.size(); ++i) {
+                    const WatchedVariable& var = vars[i];
+                    if (var.removed)
+                        continue;
+                    reply << var.name << "    " << modeName(var.mode) << "    ";
+                    if (var.tls)
+                        reply << "thread-local";
+                    else if (processes.at(rootPid).addresses[i] == 0)
+                        reply << "pending";
+                    else
+                        reply << "0x" << std::hex << processes.at(rootPid).addresses[i] << std::dec;
+                    reply << "    size=" << var.size << "    accesses=" << accessCounts[i] << "\n";
+                }
+                break;
+            case ControlCommand::Kind::Pause:
+            case ControlCommand::Kind::Resume:
+                paused = command.kind == ControlCommand::Kind::Pause;
+                rearmAll();
+                break;
+            case ControlCommand::Kind::Stats: {
+                uint64_t accesses = 0;
+                for (const uint64_t count : accessCounts)
+                    accesses += count;
+                reply << "stops=" << stopCount << "    accesses=" << accesses << "    dropped=" << events.dropped()
+                      << "    queued=" << events.depth() << "    threads=" << threads.size()
+                      << "    processes=" << processes.size() << "    paused=" << (paused ? "yes" : "no") << "\n";
+                break;
+            }
+        }
+        reply << "ok\n";
+    } catch (const std::exception &e) {
+        reply << "error: " << e.what() << "\n";
+    }
+    control->answer(reply.str());
+}
+
+std::string PtraceBackend::addWatch(const ControlCommand& command, std::vector<WatchedVariable>& vars,
+                                    EventWriter& events) {
+    if (std::ranges::any_of(vars, [&](const WatchedVariable& var) { return !var.removed && var.name == command.symbol; }))
+        throw std::runtime_error(command.symbol + " is already watched");
+    if (vars.size() >= UINT16_MAX)
+        throw std::runtime_error("too many variables");
+
+    // The slot has to be free in every process, as exec and forked children reuse it.
+    int slot = -1;
+    for (int candidate = 0; candidate < DEBUG_SLOT_COUNT && slot < 0; ++candidate) {
+        bool used = candidate == hookSlot ||
+                    std::ranges::any_of(vars, [&](const WatchedVariable& var) { return var.slot == candidate; });
+        for (const auto& [pid, process] : processes)
+            used = used || process.debugRegs.isUsed(candidate);
+        if (!used)
+            slot = candidate;
+    }
+    if (slot < 0)
+        throw std::runtime_error("no free debug register; remove a variable first");
+
+    // Looked up in each image, which may be another binary after exec; nothing changes until all are done.
+    struct Placement {
+        pid_t pid;
+        uintptr_t address;
+        uint64_t value;
+        DebugRegisterState debugRegs;
+    };
+    std::vector<Placement> placements;
+    SymbolLookup symbol{ command.symbol };
+    for (const auto& [pid, process] : processes) {
+        const std::string exePath = "/proc/" + std::to_string(pid) + "/exe";
+        std::vector<SymbolLookup> lookup{ SymbolLookup{ command.symbol } };
+        uintptr_t entry = 0;
+        if (!getEntryPoint(exePath, entry) || !findSymbolAddresses(exePath, lookup) || !lookup.front().found)
+            continue;  // gone, or another binary without the variable
+        if (lookup.front().tls)
+            throw std::runtime_error("thread-local variables can only be watched from the start");
+
+        Placement placement{ pid, getLoadBias(pid, entry) + lookup.front().address, 0, process.debugRegs };
+        placement.debugRegs.assign(slot, placement.address, lookup.front().size, command.mode);
+        if (command.mode != WatchMode::Execute)
+            placement.value = readProcessMemory(pid, placement.address, lookup.front().size);
+        placements.push_back(placement);
+        if (pid == rootPid || !symbol.found)
+            symbol = lookup.front();
+    }
+    if (placements.empty())
+        throw std::runtime_error("symbol '" + command.symbol + "' not found in the traced processes");
+
+    // Appending may move the variables; the pointers into them follow.
+    std::vector<size_t> guardedIndices;
+    std::vector<size_t> tlsIndices;
+    for (const WatchedVariable* var : guardedVars)
+        guardedIndices.push_back(var - vars.data());
+    for (const WatchedVariable* var : tlsVars)
+        tlsIndices.push_back(var - vars.data());
+
+    WatchedVariable added{ command.symbol, symbol.address, symbol.size };
+    added.slot = slot;
+    added.mode = command.mode;
+    vars.push_back(std::move(added));
+    for (size_t i = 0; i < guardedIndices.size(); ++i)
+        guardedVars[i] = &vars[guardedIndices[i]];
+    for (size_t i = 0; i < tlsIndices.size(); ++i)
+        tlsVars[i] = &vars[tlsIndices[i]];
+
+    WatchedVariable& var = vars.back();
+    const size_t index = vars.size() - 1;
+    for (auto& [pid, process] : processes) {
+        process.addresses.resize(vars.size());
+        process.lastValues.resize(vars.size());
+    }
+    std::ostringstream reply;
+    for (const Placement& placement : placements) {
+        ProcessState& process = processes.at(placement.pid);
+        process.debugRegs = placement.debugRegs;
+        process.addresses[index] = placement.address;
+        process.lastValues[index] = placement.value;
+        if (placement.pid == rootPid) {
+            var.runtimeAddress = placement.address;
+            var.lastValue = placement.value;
+        }
+        reply << "Runtime address of " << var.name << ": 0x" << std::hex << placement.address << std::dec
+              << " (process " << placement.pid << ")\n";
+        if (var.mode != WatchMode::Execute)
+            reply << var.name << " initial=" << placement.value << "\n";
+    }
+    std::cerr << reply.str();
+
+    accessCounts.push_back(0);
+    if (dutyCycle) {
+        estimates.push_back(0.0);
+        windowAccesses.push_back(0);
+    }
+    events.declareVariable(var.name, nullptr);
+    rearmAll();
+    return reply.str();
+}
+
+void PtraceBackend::removeWatch(const ControlCommand& command, std::vector<WatchedVariable>& vars) {
+    const auto var = std::ranges::find_if(vars, [&](const WatchedVariable& v) { return !v.removed && v.name == command.symbol; });
+    if (var == vars.end())
+        throw std::runtime_error(command.symbol + " is not watched");
+    if (var->guarded)
+        throw std::runtime_error("ranges guarded with page protection cannot be removed");
+
+    const size_t index = var - vars.begin();
+    for (auto& [pid, process] : processes) {
+        if (var->slot >= 0 && process.addresses[index] != 0)
+            process.debugRegs.release(var->slot);
+        process.addresses[index] = 0;
+    }
+    std::erase(tlsVars, &*var);
+    var->slot = -1;
+    var->removed = true;
+    // Written at once: the writer thread may be printing events to the same file.
+    std::cerr << "Stopped watching " + var->name + "\n";
+    rearmAll();
+}
+
+bool PtraceBackend::handleGuardFault(pid_t tid, pid_t pid, uintptr_t address, std::vector<WatchedVariable>& vars,
+                                     EventWriter& events, uint64_t& dr6, int& deferredSignal) {
+    // Widest single access: an AVX-512 load or store.
+    constexpr uintptr_t MAX_ACCESS = 64;
+
+    ProcessState& process = processes.at(pid);
+    std::optional<PageGuard>& pageGuard = process.pageGuard;
+    pageGuard->unprotect(tid, deferredSignal);
+    if (!singleStep(tid, deferredSignal))
+        return false;
+
+    // Chunks from the one at the fault address up to the end of the widest possible access.
+    const auto first = std::ranges::partition_point(guardedVars, [&](const WatchedVariable* var) {
+        return var->runtimeAddress + var->size <= address;
+    });
+    auto last = first;
+    while (last != guardedVars.end() && (*last)->runtimeAddress < address + MAX_ACCESS)
+        ++last;
+    const std::span<WatchedVariable* const> touched(first, last);
+
+    // Read before the pages are guarded again; the step may also have hit a debug register.
+    std::vector<uint64_t> values;
+    bool read = true;
+    try {
+        readChunks(tid, touched, values);
+        dr6 = readDebugStatus(tid);
+    } catch (const std::exception &e) {
+        std::cerr << "Read during guard fault failed: " << e.what() << "\n";
+        read = false;
+    }
+    pageGuard->protect(tid, deferredSignal);
+    if (!read)
+        return true;
+
+    for (size_t i = 0; i < touched.size(); ++i) {
+        WatchedVariable& var = *touched[i];
+        const auto index = static_cast<uint16_t>(&var - vars.data());
+        // An unchanged chunk was accessed only if the fault address lies in it; a write-mode
+        // chunk counts it as a write only when reads do not fault.
+        const bool faulted = var.runtimeAddress <= address && address < var.runtimeAddress + var.size;
+        const bool accessed = faulted && (var.mode != WatchMode::Write || pageGuard->writesOnly());
+        if (values[i] != process.lastValues[index] || accessed)
+            reportChange(events, index, var, process.lastValues[index], values[i], pid, tid);
+    }
+    return true;
+}
+
+/**
+ * Reads the current values of several variables with one vectored read, at their addresses in
+ * the thread's process; thread-local ones are read from the instance of the thread with the
+ * given thread pointer.
+ */
+static void readValues(pid_t tid, std::span<WatchedVariable* const> hits, const std::vector<WatchedVariable>& vars,
+                       const std::vector<uintptr_t>& addresses, uintptr_t threadPointer,
+                       std::array<uint64_t, DEBUG_SLOT_COUNT>& values) {
+    std::array<MemoryRegion, DEBUG_SLOT_COUNT> regions{};
+    for (size_t i = 0; i < hits.size(); ++i) {
+        values[i] = 0;
+        const uintptr_t address = addresses[hits[i] - vars.data()];
+        regions[i] = MemoryRegion{ hits[i]->tls ? threadPointer + address : address, hits[i]->size, &values[i] };
+    }
+    readProcessMemory(tid, std::span<const MemoryRegion>(regions.data(), hits.size()));
+}
+
+void PtraceBackend::watch(const Tracee& tracee, std::vector<WatchedVariable>& vars, EventWriter& events) {
+    const pid_t pid = tracee.pid;
+    for (auto& var : vars) {
+        if (var.mode == WatchMode::Execute || !var.library.empty() || var.guarded || var.tls)
+            continue;  // guarded chunks are read in bulk when the pages are guarded, thread-local ones per thread
+        try {
+            var.lastValue = readProcessMemory(pid, var.runtimeAddress, var.size);
+        } catch (const std::exception &e) {
+            std::cerr << "Initial read of " << var.name << " failed: " << e.what() << "\n";
+            return;
+        }
+        std::cerr << var.name << " initial=" << var.lastValue << "\n";
+    }
+
+    const std::string exePath = "/proc/" + std::to_string(pid) + "/exe";
+    std::vector<FunctionSymbol> functions;
+    if (options.profileTop > 0 && !readFunctionSymbols(exePath, functions))
+        std::cerr << "Warning: no function symbols; the profile shows raw addresses\n";
+
+    // Stacks are symbolized at exit, when the executable may be gone: load its symbols now.
+    uintptr_t stackLoadBias = 0;
+    if (options.backtraceDepth > 0) {
+        stacks.emplace();
+        stackWindow.resize(options.backtraceDepth * STACK_BYTES_PER_FRAME);
+        stackFrames.resize(options.backtraceDepth);
+        uintptr_t entry = 0;
+        if (getEntryPoint(exePath, entry))
+            stackLoadBias = getLoadBias(pid, entry);
+        if (!readFunctionSymbols(exePath, functions))
+            std::cerr << "Warning: no function symbols; stacks show raw addresses\n";
+    }
+
+    struct stat image{};
+    if (stat(exePath.c_str(), &image) == 0) {
+        imageDevice = image.st_dev;
+        imageInode = image.st_ino;
+    }
+
+    if (options.coalesce)
+        coalescer.emplace(options.coalesceEvents, options.coalesceGap);
+
+    setHardwareWatchpoint(tracee, vars);
+    if (!options.scopeFunctions.empty()) {
+        uintptr_t entry = 0;
+        if (!getEntryPoint(exePath, entry))
+            throw std::runtime_error("--only-in: cannot read the executable of process " + std::to_string(pid));
+        placeScope(pid, processes.at(pid), exePath, getLoadBias(pid, entry), true);
+    }
+    if (options.overheadBudget > 0) {
+        if (!guardedVars.empty())
+            throw std::runtime_error("--overhead-budget cannot duty-cycle ranges watched through page protection");
+        dutyCycle.emplace(options.overheadBudget, monotonicNanos());
+        estimates.assign(vars.size(), 0.0);
+        windowAccesses.assign(vars.size(), 0);
+    }
+    accessCounts.assign(vars.size(), 0);
+    if (!options.controlPath.empty()) {
+        control.emplace(options.controlPath, pthread_self());
+        std::cerr << "Listening for commands on " << options.controlPath << "\n";
+    }
+    if (!options.statsPath.empty()) {
+        stats.emplace("ptrace", monotonicNanos());
+        requestsAtStart = ptraceRequestCount();
+        installStatsHandler(pthread_self());
+    }
+    watchVariable(pid, vars, events);
+    control.reset();
+
+    if (coalescer)
+        coalescer->flush(events);
+    if (stats)
+        writeStats(events);
+    if (coalescer || dutyCycle)
+        scheduleWakeup(0);
+
+    if (dutyCycle) {
+        const uint64_t now = monotonicNanos();
+        // The tracee may end while disarmed; the last window stands for that pause as well.
+        const double paused = static_cast<double>(dutyCycle->pausedFor(now)) / DutyCycle::WINDOW;
+        for (size_t i = 0; i < vars.size(); ++i)
+            estimates[i] += static_cast<double>(windowAccesses[i]) * paused;
+        // Written at once: the writer thread may still be printing events to the same file.
+        std::ostringstream report;
+        report << std::fixed << std::setprecision(1) << "Sampling: watchpoints armed "
+               << dutyCycle->armedShare(now) * 100 << "% of the time, tracee stopped " << dutyCycle->overhead(now) * 100
+               << "% (budget " << options.overheadBudget * 100 << "%)\n";
+        for (size_t i = 0; i < vars.size(); ++i) {
+            if (estimates[i] > 0)
+                report << vars[i].name << ": ~" << std::llround(estimates[i]) << " accesses (estimated)\n";
+        }
+        std::cerr << report.str();
+    }
+
+    if (options.profileTop > 0) {
+        std::vector<std::string> names;
+        for (const auto& var : vars)
+            names.push_back(var.name);
+        // Any variable of the executable gives its load bias; library code shows as raw addresses.
+        const auto exeVar = std::ranges::find_if(vars, [](const WatchedVariable& var) { return var.library.empty() && !var.tls; });
+        const uintptr_t loadBias = exeVar != vars.end() ? exeVar->runtimeAddress - exeVar->symbolOffset : 0;
+        if (exeVar == vars.end())
+            functions.clear();
+        printProfile(std::cout, profile.top(options.profileTop), names, functions, loadBias);
+        std::cout.flush();
+    }
+
+    if (stacks) {
+        // Every event naming a stack goes out before the table.
+        events.close();
+        std::cout << "Stacks:\n";
+        printStacks(std::cout, *stacks, functions, stackLoadBias);
+        std::cout.flush();
+    }
+}
+
+void PtraceBackend::watchVariable(pid_t pid, std::vector<WatchedVariable>& vars, EventWriter& events) {
+    std::array<WatchedVariable*, DEBUG_SLOT_COUNT> slotToVar{};
+    std::array<WatchedVariable*, DEBUG_SLOT_COUNT> dataVars{};
+    size_t dataCount = 0;
+    const auto indexVariables = [&] {
+        slotToVar.fill(nullptr);
+        dataCount = 0;
+        for (auto& var : vars) {
+            if (var.slot < 0)
+                continue;  // library not loaded yet
+            slotToVar[var.slot] = &var;
+            if (var.mode != WatchMode::Execute)
+                dataVars[dataCount++] = &var;
+        }
+    };
+    indexVariables();
+
+    for (const auto& [tid, state] : threads)
+        resumeThread(resumeRequest(state), tid, state.pendingSignal);
+
+    std::array<int, DEBUG_SLOT_COUNT> fired{};
+    std::array<WatchedVariable*, DEBUG_SLOT_COUNT> hits{};
+    std::array<uint64_t, DEBUG_SLOT_COUNT> values{};
+
+    // Thread-local variables keep one last value per thread, the others one per process.
+    const auto lastValueOf = [&](WatchedVariable& var, ThreadState& thread, ProcessState& process) -> uint64_t& {
+        return var.tls ? thread.tlsValues[var.slot] : process.lastValues[&var - vars.data()];
+    };
+
+    // Reports the slots that fired in a debug exception; returns true if the dynamic linker
+    // hook of the root process was among them.
+    const auto reportHits = [&](pid_t tid, ThreadState& thread, uint64_t dr6) {
+        ProcessState& process = processes.at(thread.process);
+        const int firedCount = decodeDr6(dr6, fired);
+        size_t hitCount = 0;
+        bool rendezvous = false;
+        for (int i = 0; i < firedCount; ++i) {
+            if (fired[i] == hookSlot) {
+                // Forked children inherit the hook, but their link maps are not tracked.
+                rendezvous = thread.process == pid && libraries != nullptr;
+                continue;
+            }
+            // A trap of an older configuration only counts if the slot still watches the same variable.
+            WatchedVariable* const var = slotToVar[fired[i]];
+            if (var == nullptr || thread.armedVars[fired[i]] != var - vars.data() + 1)
+                continue;
+            if (var->mode == WatchMode::Execute) {
+                // Instruction breakpoints fault before the instruction runs; the kernel sets
+                // RF on return so resuming does not trap again.
+                WatchEvent hit{};
+                hit.ip = process.addresses[var - vars.data()];
+                hit.time = monotonicNanos();
+                hit.pid = thread.process;
+                hit.tid = tid;
+                hit.varIndex = static_cast<uint16_t>(var - vars.data());
+                hit.kind = EventKind::Execute;
+                ++accessCounts[hit.varIndex];
+                if (emitEvent(events, hit) && options.coalescePause > 0)
+                    pauseSlot(tid, thread, *var, vars);
+            } else {
+                hits[hitCount++] = var;
+            }
+        }
+
+        if (hitCount > 0) {
+            try {
+                const uint64_t readStart = stats ? monotonicNanos() : 0;
+                readValues(tid, std::span(hits.data(), hitCount), vars, process.addresses, thread.threadPointer, values);
+                if (stats)
+                    stats->readNanos.record(monotonicNanos() - readStart);
+                for (size_t i = 0; i < hitCount; ++i) {
+                    const bool hot = reportChange(events, static_cast<uint16_t>(hits[i] - vars.data()), *hits[i],
+                                                  lastValueOf(*hits[i], thread, process), values[i], thread.process, tid);
+                    if (hot && options.coalescePause > 0)
+                        pauseSlot(tid, thread, *hits[i], vars);
+                }
+            } catch (const std::exception &e) {
+                std::cerr << "Read during trap failed: " << e.what() << "\n";
+            }
+        }
+
+        if (firedCount > 0) {
+            clearDebugStatus(tid);
+            if (stats) {
+                trapStop = true;
+                stats->queueDepth.record(events.depth());
+            }
+        }
+        return rendezvous;
+    };
+
+    // The dynamic linker changed its link map: place newly loaded library variables, arm them
+    // in the stopped thread right away and in every other thread as soon as it is interrupted.
+    const auto placeLibraries = [&](pid_t tid, ThreadState& thread) {
+        if (!resolveLibraries(pid, processes.at(pid), vars))
+            return;
+        indexVariables();
+        ++generation;
+        armThread(tid, thread, vars);
+        for (const auto& [other, state] : threads) {
+            if (other != tid && state.process == pid && ptraceRequest(PTRACE_INTERRUPT, other, nullptr, nullptr) == -1 &&
+                errno != ESRCH)
+                std::cerr << "Warning: PTRACE_INTERRUPT of " << other << " failed: " << std::strerror(errno) << "\n";
+        }
+    };
+
+    // Reports the end of a process ("exited (0)", "killed by signal 9"); returns true if the loop is over.
+    const auto processExited = [&](pid_t tid, const std::string& how) {
+        if (tid == pid) {
+            std::cerr << "Child " << how << "\n";
+            // The root's state stays around as the template of processes seen late.
+            return !options.followChildren;
+        }
+        if (processes.erase(tid) > 0)
+            std::cerr << "Process " << tid << " " << how << "\n";
+        return false;
+    };
+
+    // Every traced process and thread reports through the one waitpid(-1) below, which
+    // costs the same however many of them there are.
+    while (!threads.empty()) {
+        if (detachRequested()) {
+            detachAll();
+            return;
+        }
+        if (control && control->pending()) {
+            runCommand(vars, events);
+            indexVariables();
+        }
+        if (coalescer || dutyCycle || stats) {
+            // The previous stop lasted from its report until now, when its thread has been resumed.
+            const uint64_t now = monotonicNanos();
+            if (dutyCycle && stopReported != 0)
+                dutyCycle->charge(now - stopReported + DutyCycle::STOP_ALLOWANCE);
+            if (stats && stopReported != 0 && trapStop) {
+                ++stats->traps;
+                stats->stoppedNanos.record(now - stopReported);
+                stats->ptracePerTrap.record(ptraceRequestCount() - requestsAtStop);
+            }
+            stopReported = 0;
+            if (coalescer || dutyCycle)
+                serviceTimers(events, now);
+        }
+        if (stats && statsRequested())
+            writeStats(events);
+
+        int status = 0;
+        const pid_t tid = waitpid(-1, &status, __WALL);
+        if (tid == -1) {
+            if (errno == EINTR) continue;
+            if (errno == ECHILD) break;
+            throw std::runtime_error(std::string("waitpid failed: ") + std::strerror(errno));
+        }
+        if (dutyCycle || stats) {
+            stopReported = monotonicNanos();
+            requestsAtStop = ptraceRequestCount();
+            trapStop = false;
+        }
+
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            threads.erase(tid);
+            const std::string how = WIFEXITED(status) ? "exited (" + std::to_string(WEXITSTATUS(status)) + ")"
+                                                      : "killed by signal " + std::to_string(WTERMSIG(status));
+            if (processExited(tid, how))
+                break;
+            continue;
+        }
+
+        if (!WIFSTOPPED(status))
+            continue;
+        ++stopCount;
+
+        const int sig = WSTOPSIG(status);
+        const int event = status >> 16;
+
+        // Debug registers are per-thread: every thread reported through PTRACE_EVENT_CLONE (or
+        // forked) gets its process' configuration on its first stop (PTRACE_EVENT_STOP), which
+        // is swallowed. The same happens to threads interrupted after the configuration changed.
+        // New threads already run on their own TLS (CLONE_SETTLS), so they are armed complete.
+        auto& thread = threads[tid];
+        if (thread.process == 0)
+            thread.process = processOf(tid);
+        if (thread.generation != generation) {
+            // A watchpoint of the configuration being replaced may have fired, and its SIGTRAP may
+            // even be reported after this stop: DR6 is decoded before re-arming clears it.
+            bool rendezvous = false;
+            const bool armed = hookSlot >= 0 || std::ranges::any_of(thread.armedVars, [](uint16_t var) { return var != 0; });
+            if (armed && event != PTRACE_EVENT_EXEC) {
+                try {
+                    rendezvous = reportHits(tid, thread, readDebugStatus(tid));
+                } catch (const std::exception &e) {
+                    std::cerr << "Warning: " << e.what() << "\n";
+                }
+            }
+            resolveThreadPointer(tid, thread, vars);
+            armThread(tid, thread, vars);
+            if (rendezvous)
+                placeLibraries(tid, thread);
+            if (event == PTRACE_EVENT_STOP) {
+                resumeThread(resumeRequest(thread), tid, 0);
+                continue;
+            }
+        }
+        ProcessState& process = processes.at(thread.process);
+
+        if (event == PTRACE_EVENT_STOP) {
+            // Group-stop of a seized tracee: keep it stopped until SIGCONT, as without a tracer.
+            // Any other PTRACE_EVENT_STOP (e.g. PTRACE_INTERRUPT) is simply resumed.
+            const bool groupStop = sig == SIGSTOP || sig == SIGTSTP || sig == SIGTTIN || sig == SIGTTOU;
+            resumeThread(groupStop ? PTRACE_LISTEN : resumeRequest(thread), tid, 0);
+            continue;
+        }
+
+        if (sig == (SIGTRAP | 0x80)) {
+            // Syscall stops only happen while the thread's TLS is pending: its thread-local
+            // watchpoints are armed right after the system call that installs the thread pointer.
+            resolveThreadPointer(tid, thread, vars);
+            if (thread.threadPointer != 0)
+                armThread(tid, thread, vars);
+            resumeThread(resumeRequest(thread), tid, 0);
+            continue;
+        }
+
+        if (sig == SIGTRAP && event == PTRACE_EVENT_EXEC) {
+            // exec drops the debug registers, the other threads and the address space: the
+            // variables are placed again in the new image and the thread armed from scratch.
+            unsigned long formerTid = 0;
+            if (ptraceRequest(PTRACE_GETEVENTMSG, tid, nullptr, &formerTid) == 0 && static_cast<pid_t>(formerTid) != tid)
+                threads.erase(static_cast<pid_t>(formerTid));
+            thread.threadPointer = 0;
+            thread.tlsValues = {};
+            thread.scope.clear();
+            resolveAfterExec(thread.process, process, vars);
+            armThread(tid, thread, vars);
+            resumeThread(resumeRequest(thread), tid, 0);
+            continue;
+        }
+
+        if (sig == SIGTRAP && (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK)) {
+            // The child shares or copies the parent's memory but none of its debug registers:
+            // it starts from the parent's watch state and is armed on its first stop.
+            unsigned long child = 0;
+            ptraceChecked(PTRACE_GETEVENTMSG, tid, nullptr, &child, "ptrace(PTRACE_GETEVENTMSG) failed");
+            if (!options.followChildren) {
+                // Only traced because its copy of the code has our int3s (--only-in).
+                releaseChild(static_cast<pid_t>(child), process);
+                resumeThread(resumeRequest(thread), tid, 0);
+                continue;
+            }
+            processes.try_emplace(static_cast<pid_t>(child), process);
+            ThreadState& forked = threads[static_cast<pid_t>(child)];
+            forked.process = static_cast<pid_t>(child);
+            // It runs on a copy of the parent's stack, inside the same --only-in calls. If it
+            // was armed already, on a first stop reported before this event, it is armed again.
+            forked.scope = thread.scope;
+            if (!forked.scope.empty() && forked.generation != 0) {
+                forked.generation = 0;
+                if (ptraceRequest(PTRACE_INTERRUPT, static_cast<pid_t>(child), nullptr, nullptr) == -1 && errno != ESRCH)
+                    std::cerr << "Warning: PTRACE_INTERRUPT of " << child << " failed: " << std::strerror(errno) << "\n";
+            }
+            std::cerr << "Following process " << child << " (forked by " << thread.process << ")\n";
+            resumeThread(resumeRequest(thread), tid, 0);
+            continue;
+        }
+
+        if (sig == SIGTRAP && event == PTRACE_EVENT_CLONE) {
+            unsigned long newTid = 0;
+            ptraceChecked(PTRACE_GETEVENTMSG, tid, nullptr, &newTid, "ptrace(PTRACE_GETEVENTMSG) failed");
+            threads.try_emplace(static_cast<pid_t>(newTid));
+            resumeThread(resumeRequest(thread), tid, 0);
+            continue;
+        }
+
+        if (sig == SIGTRAP && !process.breakpoints.empty()) {
+            // int3 reports SI_KERNEL, unlike the debug register and single-step traps.
+            siginfo_t info{};
+            user_regs_struct regs{};
+            if (ptraceRequest(PTRACE_GETSIGINFO, tid, nullptr, &info) == 0 && info.si_code == SI_KERNEL &&
+                ptraceRequest(PTRACE_GETREGS, tid, nullptr, &regs) == 0 && process.breakpoints.find(regs.rip - 1) != nullptr) {
+                int deferred = 0;
+                if (!crossScope(tid, thread, process, regs, vars, deferred)) {
+                    const pid_t owner = thread.process;
+                    threads.erase(tid);
+                    if (tid == owner && processExited(tid, "exited"))
+                        break;
+                    continue;
+                }
+                // A debug register watching data on the stepped instruction may have fired.
+                uint64_t dr6 = 0;
+                try {
+                    dr6 = readDebugStatus(tid);
+                } catch (const std::exception &e) {
+                    std::cerr << "Warning: " << e.what() << "\n";
+                }
+                reportHits(tid, thread, dr6);
+                resumeThread(resumeRequest(thread), tid, deferred);
+                continue;
+            }
+        }
+
+        if (sig == SIGTRAP) {
+            uint64_t dr6 = 0;
+            try {
+                dr6 = readDebugStatus(tid);
+            } catch (const std::exception &e) {
+                std::cerr << "Warning: " << e.what() << "\n";
+            }
+
+            if (reportHits(tid, thread, dr6))
+                placeLibraries(tid, thread);
+            resumeThread(resumeRequest(thread), tid, 0);
+            continue;
+        }
+
+        if (sig == SIGSEGV && process.pageGuard && process.pageGuard->active()) {
+            siginfo_t info{};
+            ptraceChecked(PTRACE_GETSIGINFO, tid, nullptr, &info, "ptrace(PTRACE_GETSIGINFO) failed");
+            const auto address = reinterpret_cast<uintptr_t>(info.si_addr);
+            if (info.si_code == SEGV_ACCERR && process.pageGuard->covers(address)) {
+                uint64_t dr6 = 0;
+                int deferred = 0;
+                trapStop = true;
+                if (!handleGuardFault(tid, thread.process, address, vars, events, dr6, deferred)) {
+                    // The exit itself was consumed by the step.
+                    const pid_t owner = thread.process;
+                    threads.erase(tid);
+                    if (tid == owner && processExited(tid, "exited"))
+                        break;
+                    continue;
+                }
+                // A debug register watching data on the same instruction fired during the step.
+                reportHits(tid, thread, dr6);
+                resumeThread(resumeRequest(thread), tid, deferred);
+                continue;
+            }
+        }
+
+        try {
+            // Thread-local instances of a thread without TLS yet do not exist, and an exec may
+            // have left variables out of the process.
+            size_t count = 0;
+            for (size_t i = 0; i < dataCount; ++i) {
+                if (process.addresses[dataVars[i] - vars.data()] != 0 && (!dataVars[i]->tls || thread.threadPointer != 0))
+                    hits[count++] = dataVars[i];
+            }
+            readValues(tid, std::span(hits.data(), count), vars, process.addresses, thread.threadPointer, values);
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t& lastValue = lastValueOf(*hits[i], thread, process);
+                if (values[i] != lastValue)
+                    reportChange(events, static_cast<uint16_t>(hits[i] - vars.data()), *hits[i], lastValue, values[i],
+                                 thread.process, tid);
+            }
+        } catch (...) {}
+
+        resumeThread(resumeRequest(thread), tid, sig);
+    }
+}
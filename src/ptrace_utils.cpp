@@ -0,0 +1,215 @@
+#include "ptrace_utils.hpp"
+
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+
+// Requests issued by each tracer thread; only ever touched by that thread.
+static thread_local uint64_t ptraceRequests = 0;
+
+long ptraceRequest(int request, pid_t pid, void* addr, void* data) {
+    ++ptraceRequests;
+    return ptrace(static_cast<__ptrace_request>(request), pid, addr, data);
+}
+
+uint64_t ptraceRequestCount() {
+    return ptraceRequests;
+}
+
+void ptraceChecked(int request, const pid_t& pid, void* addr, void* data, const char* errMsg) {
+    errno = 0;
+    if (ptraceRequest(request, pid, addr, data) == -1 && errno != 0) {
+        throw std::runtime_error(std::string(errMsg) + ": " + std::strerror(errno));
+    }
+}
+
+void resumeThread(int request, pid_t tid, int sig) {
+    errno = 0;
+    if (ptraceRequest(request, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(sig))) == -1
+        && errno != ESRCH) {
+        throw std::runtime_error("Failed to resume thread " + std::to_string(tid) + ": " + std::strerror(errno));
+    }
+}
+
+bool singleStep(pid_t tid, int& deferredSignal) {
+    resumeThread(PTRACE_SINGLESTEP, tid, 0);
+    while (true) {
+        int status = 0;
+        if (waitpid(tid, &status, __WALL) == -1) {
+            if (errno == EINTR) continue;
+            if (errno == ECHILD) return false;
+            throw std::runtime_error(std::string("waitpid failed: ") + std::strerror(errno));
+        }
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+            return false;
+        if (!WIFSTOPPED(status))
+            continue;
+
+        const int sig = WSTOPSIG(status);
+        const int event = status >> 16;
+        if (sig == SIGTRAP && event == 0)
+            return true;
+        if (event == 0)
+            deferredSignal = sig;  // signal-delivery-stop before the step
+        resumeThread(PTRACE_SINGLESTEP, tid, 0);
+    }
+}
+
+long injectSyscall(pid_t tid, uintptr_t scratch, long number, std::initializer_list<uint64_t> args, int& deferredSignal) {
+    if (args.size() > 6)
+        throw std::invalid_argument("A system call takes at most six arguments");
+
+    user_regs_struct saved{};
+    ptraceChecked(PTRACE_GETREGS, tid, nullptr, &saved, "ptrace(PTRACE_GETREGS) failed");
+
+    errno = 0;
+    auto* const code = reinterpret_cast<void*>(scratch);
+    const long original = ptraceRequest(PTRACE_PEEKTEXT, tid, code, nullptr);
+    if (original == -1 && errno != 0)
+        throw std::runtime_error(std::string("Failed to read code for syscall injection: ") + std::strerror(errno));
+
+    constexpr long SYSCALL_INSN = 0x050f;  // 0f 05, little-endian
+    ptraceChecked(PTRACE_POKETEXT, tid, code, reinterpret_cast<void*>((original & ~0xffffL) | SYSCALL_INSN),
+                  "ptrace(PTRACE_POKETEXT) failed");
+
+    user_regs_struct regs = saved;
+    regs.rip = scratch;
+    regs.rax = static_cast<unsigned long long>(number);
+    regs.orig_rax = static_cast<unsigned long long>(-1);  // no syscall restart on our registers
+    unsigned long long* const argRegs[] = { &regs.rdi, &regs.rsi, &regs.rdx, &regs.r10, &regs.r8, &regs.r9 };
+    size_t index = 0;
+    for (const uint64_t arg : args)
+        *argRegs[index++] = arg;
+    const user_regs_struct call = regs;
+
+    // A thread stopped inside a system call (e.g. at PTRACE_EVENT_EXEC) first finishes that
+    // call, which overwrites rax and reports the step at the syscall exit without running
+    // anything: set the registers again until the instruction has really executed. The
+    // interrupted call's result is what the thread sees once its registers are restored.
+    bool alive = true;
+    for (int attempt = 0; attempt < 2 && alive; ++attempt) {
+        regs = call;
+        ptraceChecked(PTRACE_SETREGS, tid, nullptr, &regs, "ptrace(PTRACE_SETREGS) failed");
+        alive = singleStep(tid, deferredSignal);
+        if (alive)
+            ptraceChecked(PTRACE_GETREGS, tid, nullptr, &regs, "ptrace(PTRACE_GETREGS) failed");
+        if (regs.rip == scratch + 2)
+            break;
+        saved.rax = regs.rax;
+    }
+    const long result = static_cast<long>(regs.rax);
+
+    // Best effort if the thread died; the other threads share the patched code.
+    ptraceRequest(PTRACE_POKETEXT, tid, code, reinterpret_cast<void*>(original));
+    if (!alive)
+        throw std::runtime_error("Thread " + std::to_string(tid) + " exited during an injected system call");
+    ptraceChecked(PTRACE_SETREGS, tid, nullptr, &saved, "ptrace(PTRACE_SETREGS) failed");
+    if (regs.rip != scratch + 2)
+        throw std::runtime_error("Injected system call did not run in thread " + std::to_string(tid));
+    return result;
+}
+
+// Set from signal handlers and from other threads; lock-free, hence async-signal-safe.
+static std::atomic<bool> detachFlag{false};
+
+static void onDetachSignal(int) {
+    detachFlag.store(true);
+}
+
+void installDetachHandler() {
+    struct sigaction action{};
+    action.sa_handler = onDetachSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+
+bool detachRequested() {
+    return detachFlag.load();
+}
+
+static std::atomic<bool> statsFlag{false};
+static pthread_t statsThread;
+
+static void onStatsSignal(int sig) {
+    statsFlag.store(true);
+    // A process-directed signal may land on the writer or control thread instead.
+    if (!pthread_equal(pthread_self(), statsThread))
+        pthread_kill(statsThread, sig);
+}
+
+void installStatsHandler(pthread_t tracer) {
+    statsThread = tracer;
+    struct sigaction action{};
+    action.sa_handler = onStatsSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGUSR1, &action, nullptr);
+}
+
+bool statsRequested() {
+    return statsFlag.exchange(false);
+}
+
+// Older glibc only exposes the SIGEV_THREAD_ID target under its internal name.
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+static void onWakeupSignal(int) {}
+
+static void installWakeupHandler() {
+    struct sigaction action{};
+    action.sa_handler = onWakeupSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGALRM, &action, nullptr);
+}
+
+void wakeTracer(pthread_t tracer) {
+    installWakeupHandler();
+    pthread_kill(tracer, SIGALRM);
+}
+
+void requestDetach(pthread_t tracer) {
+    detachFlag.store(true);
+    wakeTracer(tracer);
+}
+
+void clearDetachRequest() {
+    detachFlag.store(false);
+}
+
+void scheduleWakeup(uint64_t deadline) {
+    // Each tracer thread has its own timer, so sessions run one after another on different threads.
+    static thread_local timer_t timer;
+    static thread_local bool created = false;
+    if (!created) {
+        installWakeupHandler();
+
+        sigevent event{};
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGALRM;
+        event.sigev_notify_thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+        if (timer_create(CLOCK_MONOTONIC, &event, &timer) == -1)
+            throw std::runtime_error(std::string("timer_create failed: ") + std::strerror(errno));
+        created = true;
+    }
+
+    itimerspec when{};
+    when.it_value.tv_sec = static_cast<time_t>(deadline / 1'000'000'000);
+    when.it_value.tv_nsec = static_cast<long>(deadline % 1'000'000'000);
+    timer_settime(timer, TIMER_ABSTIME, &when, nullptr);
+}
@@ -0,0 +1,148 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "event_writer.hpp"
+#include "trace_file.hpp"
+
+/**
+ * @brief Command line of gwatch-report.
+ */
+struct ReportArguments {
+    std::string path;
+    double from = -1;       ///< Seconds from the start of the recording, -1 for the beginning
+    double to = -1;         ///< Seconds from the start of the recording, -1 for the end
+    std::string variable;   ///< Only this variable, empty for all
+    int32_t tid = 0;        ///< Only this thread, 0 for all
+    bool summary = false;   ///< Print per-variable totals instead of the events
+};
+
+static bool parseSeconds(const char* text, double& seconds) {
+    char* end = nullptr;
+    seconds = std::strtod(text, &end);
+    return end != text && *end == '\0' && seconds >= 0;
+}
+
+static bool parseReportArguments(int argc, char** argv, ReportArguments& args) {
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--from") == 0 || std::strcmp(argv[i], "--to") == 0) {
+            double& seconds = argv[i][2] == 'f' ? args.from : args.to;
+            if (!hasValue || !parseSeconds(argv[i + 1], seconds)) {
+                std::cerr << "Error: '" << argv[i] << "' expects seconds from the start of the recording\n";
+                return false;
+            }
+            ++i;
+        } else if (std::strcmp(argv[i], "--var") == 0) {
+            if (!hasValue) {
+                std::cerr << "Error: '--var' expects a variable name\n";
+                return false;
+            }
+            args.variable = argv[++i];
+        } else if (std::strcmp(argv[i], "--tid") == 0) {
+            char* end = nullptr;
+            const long tid = hasValue ? std::strtol(argv[i + 1], &end, 10) : 0;
+            if (tid <= 0 || *end != '\0') {
+                std::cerr << "Error: '--tid' expects a positive thread ID\n";
+                return false;
+            }
+            args.tid = static_cast<int32_t>(tid);
+            ++i;
+        } else if (std::strcmp(argv[i], "--summary") == 0) {
+            args.summary = true;
+        } else if (argv[i][0] != '-' && args.path.empty()) {
+            args.path = argv[i];
+        } else {
+            std::cerr << "Error: Unknown argument '" << argv[i] << "'\n";
+            return false;
+        }
+    }
+
+    if (args.path.empty()) {
+        std::cerr << "Error: Expected a trace file\n";
+        return false;
+    }
+    return true;
+}
+
+static void printReportUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " <trace.gwt> [--from <s>] [--to <s>] [--var <name>] [--tid <tid>] [--summary]\n";
+    std::cerr << "\nOptions:\n";
+    std::cerr << "  --from <s>        Skip events before <s> seconds from the start of the recording\n";
+    std::cerr << "  --to <s>          Skip events after <s> seconds from the start of the recording\n";
+    std::cerr << "  --var <name>      Only events of this variable\n";
+    std::cerr << "  --tid <tid>       Only events of this thread\n";
+    std::cerr << "  --summary         Print per-variable totals instead of the events\n";
+}
+
+int main(int argc, char** argv) {
+    ReportArguments args;
+    if (!parseReportArguments(argc, argv, args)) {
+        printReportUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        const TraceReader trace(args.path);
+        if (!trace.complete())
+            std::cerr << "Warning: the recording was interrupted; the index was rebuilt from the records\n";
+
+        TraceFilter filter;
+        const uint64_t start = trace.header().startTime;
+        if (args.from >= 0)
+            filter.from = start + static_cast<uint64_t>(args.from * 1e9);
+        if (args.to >= 0)
+            filter.to = start + static_cast<uint64_t>(args.to * 1e9);
+        filter.tid = args.tid;
+        if (!args.variable.empty()) {
+            const auto& names = trace.names();
+            const auto it = std::find(names.begin(), names.end(), args.variable);
+            if (it == names.end()) {
+                std::cerr << "Error: '" << args.variable << "' is not in " << args.path << "\n";
+                return 2;
+            }
+            filter.varIndex = static_cast<int>(it - names.begin());
+        }
+
+        if (args.summary) {
+            printTraceSummary(std::cout, trace, summarizeTrace(trace, filter));
+            return 0;
+        }
+
+        // Events print as gwatch prints them, with times relative to the start of the recording.
+        TextEventSink sink(trace.names(), STDOUT_FILENO, trace.types(), true);
+        std::vector<WatchEvent> batch;
+        batch.reserve(4096);
+        const size_t decoded = trace.forEach(filter, [&](const TraceRecord& record) {
+            if (record.varIndex >= trace.names().size())
+                return;
+            WatchEvent event{};
+            event.oldValue = record.oldValue;
+            event.newValue = record.newValue;
+            event.ip = record.ip;
+            event.time = record.time >= start ? record.time - start : 0;
+            event.pid = record.pid;
+            event.tid = record.tid;
+            event.varIndex = record.varIndex;
+            event.kind = static_cast<EventKind>(record.kind);
+            event.sampleRatio = record.sampleRatio;
+            batch.push_back(event);
+            if (batch.size() == batch.capacity()) {
+                sink.consume(batch);
+                batch.clear();
+            }
+        });
+        sink.consume(batch);
+        sink.flush();
+        std::cerr << decoded << " of " << trace.chunks().size() << " chunks decoded\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "stack_table.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+
+static uint64_t hashFrames(std::span<const uint64_t> frames) {
+    uint64_t hash = frames.size();
+    for (const uint64_t frame : frames)
+        hash = (hash ^ frame) * 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 32);
+}
+
+static size_t bucketOf(uint64_t hash, size_t mask) {
+    return static_cast<size_t>(hash) & mask;
+}
+
+StackTable::StackTable(size_t capacity)
+    : buckets(std::make_unique<Bucket[]>(std::bit_ceil(std::max<size_t>(capacity, 16)))),
+      mask(std::bit_ceil(std::max<size_t>(capacity, 16)) - 1) {}
+
+uint32_t StackTable::intern(std::span<const uint64_t> frames) {
+    if (frames.empty())
+        return 0;
+
+    const uint64_t hash = hashFrames(frames);
+    size_t i = bucketOf(hash, mask);
+    while (buckets[i].id != 0) {
+        if (buckets[i].hash == hash && std::ranges::equal(this->frames(buckets[i].id), frames))
+            return buckets[i].id;
+        i = (i + 1) & mask;
+    }
+
+    // Keep the load factor under one half so probe sequences stay short.
+    if ((size() + 1) * 2 > mask + 1) {
+        grow();
+        return intern(frames);
+    }
+    frameData.insert(frameData.end(), frames.begin(), frames.end());
+    offsets.push_back(static_cast<uint32_t>(frameData.size()));
+    buckets[i] = { hash, static_cast<uint32_t>(size()) };
+    return buckets[i].id;
+}
+
+std::span<const uint64_t> StackTable::frames(uint32_t id) const {
+    if (id == 0 || id > size())
+        return {};
+    return std::span<const uint64_t>(frameData).subspan(offsets[id - 1], offsets[id] - offsets[id - 1]);
+}
+
+void StackTable::grow() {
+    const size_t oldSize = mask + 1;
+    auto old = std::move(buckets);
+    mask = oldSize * 2 - 1;
+    buckets = std::make_unique<Bucket[]>(oldSize * 2);
+
+    for (size_t j = 0; j < oldSize; ++j) {
+        if (old[j].id == 0)
+            continue;
+        size_t i = bucketOf(old[j].hash, mask);
+        while (buckets[i].id != 0)
+            i = (i + 1) & mask;
+        buckets[i] = old[j];
+    }
+}
+
+size_t walkFramePointers(uint64_t ip, uint64_t framePointer, uint64_t stackAddress,
+                         std::span<const uint8_t> stack, std::span<uint64_t> frames) {
+    if (frames.empty())
+        return 0;
+    size_t depth = 0;
+    frames[depth++] = ip;
+
+    while (depth < frames.size()) {
+        if (framePointer < stackAddress || framePointer % sizeof(uint64_t) != 0 ||
+            framePointer - stackAddress + 2 * sizeof(uint64_t) > stack.size())
+            break;
+        uint64_t saved[2];
+        std::memcpy(saved, stack.data() + (framePointer - stackAddress), sizeof(saved));
+        if (saved[1] == 0)
+            break;
+        frames[depth++] = saved[1];
+        // The stack grows down, so callers' frames lie strictly above.
+        if (saved[0] <= framePointer)
+            break;
+        framePointer = saved[0];
+    }
+    return depth;
+}
+
+void printStacks(std::ostream& out, const StackTable& stacks, const std::vector<FunctionSymbol>& functions,
+                 uintptr_t loadBias) {
+    char text[32];
+    for (uint32_t id = 1; id <= stacks.size(); ++id) {
+        out << "#" << id << "\n";
+        for (const uint64_t frame : stacks.frames(id)) {
+            std::string location = describeAddress(functions, frame - loadBias);
+            // Outside the executable's functions, e.g. in a shared library: keep the runtime address.
+            if (location.starts_with("0x")) {
+                std::snprintf(text, sizeof(text), "0x%lx", static_cast<unsigned long>(frame));
+                location = text;
+            }
+            out << "    " << location << "\n";
+        }
+    }
+}
@@ -0,0 +1,379 @@
+#include "symbol_index.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+/** FNV-1a, the hash stored in the index. */
+uint64_t nameHash(std::string_view name) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint32_t gnuHashOf(std::string_view name) {
+    uint32_t hash = 5381;
+    for (const char c : name)
+        hash = hash * 33 + static_cast<unsigned char>(c);
+    return hash;
+}
+
+uint32_t sysvHashOf(std::string_view name) {
+    uint32_t hash = 0;
+    for (const char c : name) {
+        hash = (hash << 4) + static_cast<unsigned char>(c);
+        const uint32_t high = hash & 0xf0000000;
+        if (high != 0)
+            hash ^= high >> 24;
+        hash &= ~high;
+    }
+    return hash;
+}
+
+bool isDefined(const Elf64_Sym& symbol) {
+    const unsigned type = ELF64_ST_TYPE(symbol.st_info);
+    return symbol.st_shndx != SHN_UNDEF && symbol.st_name != 0 && type != STT_SECTION && type != STT_FILE;
+}
+
+const char* mapReadOnly(const std::string& path, size_t& length) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    void* const data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    length = st.st_size;
+    return static_cast<const char*>(data);
+}
+
+}
+
+ElfImage::ElfImage(const std::string& path) {
+    data = mapReadOnly(path, length);
+    if (data == nullptr)
+        throw std::runtime_error("Cannot map '" + path + "': " + std::strerror(errno));
+
+    const auto& ehdr = header();
+    if (length < sizeof(Elf64_Ehdr) || std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr.e_ident[EI_CLASS] != ELFCLASS64 ||
+        !contains(ehdr.e_shoff, static_cast<uint64_t>(ehdr.e_shnum) * sizeof(Elf64_Shdr))) {
+        munmap(const_cast<char*>(data), length);
+        throw std::runtime_error("'" + path + "' is not a 64-bit ELF file");
+    }
+}
+
+ElfImage::~ElfImage() {
+    munmap(const_cast<char*>(data), length);
+}
+
+std::string_view ElfImage::section(std::string_view name) const {
+    const Elf64_Ehdr& ehdr = header();
+    if (ehdr.e_shstrndx >= ehdr.e_shnum)
+        return {};
+    const Elf64_Shdr& names = sections()[ehdr.e_shstrndx];
+
+    for (int i = 0; i < ehdr.e_shnum; ++i) {
+        const Elf64_Shdr& section = sections()[i];
+        if (section.sh_name >= names.sh_size || name != at(names.sh_offset + section.sh_name))
+            continue;
+        if (section.sh_type == SHT_NOBITS || (section.sh_flags & SHF_COMPRESSED) != 0 ||
+            !contains(section.sh_offset, section.sh_size))
+            return {};
+        return { at(section.sh_offset), section.sh_size };
+    }
+    return {};
+}
+
+std::string ElfImage::buildId() const {
+    for (int i = 0; i < header().e_shnum; ++i) {
+        const Elf64_Shdr& section = sections()[i];
+        if (section.sh_type != SHT_NOTE || !contains(section.sh_offset, section.sh_size))
+            continue;
+
+        uint64_t offset = 0;
+        while (offset + sizeof(Elf64_Nhdr) <= section.sh_size) {
+            Elf64_Nhdr note;
+            std::memcpy(&note, at(section.sh_offset + offset), sizeof(note));
+            const uint64_t nameStart = offset + sizeof(note);
+            const uint64_t descStart = nameStart + ((note.n_namesz + 3) & ~3U);
+            const uint64_t next = descStart + ((note.n_descsz + 3) & ~3U);
+            if (next > section.sh_size)
+                break;
+
+            if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 &&
+                std::memcmp(at(section.sh_offset + nameStart), "GNU", 4) == 0) {
+                static constexpr char DIGITS[] = "0123456789abcdef";
+                std::string id;
+                const auto* bytes = reinterpret_cast<const unsigned char*>(at(section.sh_offset + descStart));
+                for (uint32_t b = 0; b < note.n_descsz; ++b) {
+                    id += DIGITS[bytes[b] >> 4];
+                    id += DIGITS[bytes[b] & 0xF];
+                }
+                return id;
+            }
+            offset = next;
+        }
+    }
+    return {};
+}
+
+DynamicSymbolTable::DynamicSymbolTable(const ElfImage& image) {
+    const Elf64_Shdr* const sections = image.sections();
+    const int count = image.header().e_shnum;
+
+    for (int i = 0; i < count; ++i) {
+        const Elf64_Shdr& section = sections[i];
+        if (section.sh_type != SHT_GNU_HASH && section.sh_type != SHT_HASH)
+            continue;
+        if (section.sh_link >= static_cast<unsigned>(count) || !image.contains(section.sh_offset, section.sh_size))
+            continue;
+
+        const Elf64_Shdr& dynsym = sections[section.sh_link];
+        if (dynsym.sh_link >= static_cast<unsigned>(count))
+            continue;
+
+        symbols = reinterpret_cast<const Elf64_Sym*>(image.at(dynsym.sh_offset));
+        strings = image.at(sections[dynsym.sh_link].sh_offset);
+        const auto* words = reinterpret_cast<const uint32_t*>(image.at(section.sh_offset));
+        if (section.sh_type == SHT_GNU_HASH)
+            gnuHash = words;
+        else
+            sysvHash = words;
+    }
+}
+
+bool DynamicSymbolTable::find(std::string_view name, Elf64_Sym& symbol) const {
+    if (gnuHash != nullptr)
+        return findGnu(name, symbol);
+    if (sysvHash != nullptr)
+        return findSysv(name, symbol);
+    return false;
+}
+
+bool DynamicSymbolTable::findGnu(std::string_view name, Elf64_Sym& symbol) const {
+    const uint32_t bucketCount = gnuHash[0];
+    const uint32_t symbolOffset = gnuHash[1];
+    const uint32_t bloomSize = gnuHash[2];
+    const uint32_t bloomShift = gnuHash[3];
+    if (bucketCount == 0 || bloomSize == 0)
+        return false;
+
+    const auto* bloom = reinterpret_cast<const uint64_t*>(gnuHash + 4);
+    const uint32_t* buckets = reinterpret_cast<const uint32_t*>(bloom + bloomSize);
+    const uint32_t* chain = buckets + bucketCount;
+
+    const uint32_t hash = gnuHashOf(name);
+    const uint64_t word = bloom[(hash / 64) % bloomSize];
+    const uint64_t mask = (1ULL << (hash % 64)) | (1ULL << ((hash >> bloomShift) % 64));
+    if ((word & mask) != mask)
+        return false;
+
+    uint32_t index = buckets[hash % bucketCount];
+    if (index < symbolOffset)
+        return false;
+
+    for (;; ++index) {
+        const uint32_t chainHash = chain[index - symbolOffset];
+        if ((chainHash | 1) == (hash | 1) && name == strings + symbols[index].st_name && isDefined(symbols[index])) {
+            symbol = symbols[index];
+            return true;
+        }
+        if ((chainHash & 1) != 0)
+            return false;
+    }
+}
+
+bool DynamicSymbolTable::findSysv(std::string_view name, Elf64_Sym& symbol) const {
+    const uint32_t bucketCount = sysvHash[0];
+    if (bucketCount == 0)
+        return false;
+    const uint32_t* buckets = sysvHash + 2;
+    const uint32_t* chain = buckets + bucketCount;
+
+    for (uint32_t index = buckets[sysvHashOf(name) % bucketCount]; index != STN_UNDEF; index = chain[index]) {
+        if (name == strings + symbols[index].st_name && isDefined(symbols[index])) {
+            symbol = symbols[index];
+            return true;
+        }
+    }
+    return false;
+}
+
+SymbolIndex::~SymbolIndex() {
+    reset();
+}
+
+SymbolIndex::SymbolIndex(SymbolIndex&& other) noexcept {
+    *this = std::move(other);
+}
+
+SymbolIndex& SymbolIndex::operator=(SymbolIndex&& other) noexcept {
+    if (this == &other)
+        return *this;
+    reset();
+    owned = std::move(other.owned);
+    mapped = other.mapped;
+    length = other.length;
+    data = mapped ? other.data : owned.data();
+    other.data = nullptr;
+    other.length = 0;
+    other.mapped = false;
+    return *this;
+}
+
+void SymbolIndex::reset() {
+    if (mapped)
+        munmap(const_cast<char*>(data), length);
+    owned.clear();
+    data = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+SymbolIndex SymbolIndex::build(const ElfImage& image, const std::vector<int>& tables) {
+    std::vector<Entry> entries;
+    std::string names;
+
+    for (const int table : tables) {
+        const Elf64_Shdr& section = image.sections()[table];
+        if (!image.contains(section.sh_offset, section.sh_size))
+            continue;
+        const auto* symbols = reinterpret_cast<const Elf64_Sym*>(image.at(section.sh_offset));
+        const size_t count = section.sh_size / sizeof(Elf64_Sym);
+        const char* const strings = image.at(image.sections()[section.sh_link].sh_offset);
+
+        for (size_t j = 0; j < count; ++j) {
+            if (!isDefined(symbols[j]))
+                continue;
+            const std::string_view name = strings + symbols[j].st_name;
+            entries.push_back(Entry{ nameHash(name), symbols[j].st_value, symbols[j].st_size,
+                                     static_cast<uint32_t>(names.size()), static_cast<uint32_t>(name.size()),
+                                     ELF64_ST_TYPE(symbols[j].st_info) });
+            names += name;
+        }
+    }
+
+    // Stable, so the first definition of a name stays first among equal hashes.
+    std::ranges::stable_sort(entries, {}, &Entry::hash);
+
+    SymbolIndex index;
+    const Header header{ { MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3], MAGIC[4], MAGIC[5], MAGIC[6], MAGIC[7] },
+                         entries.size(), names.size() };
+    index.owned.resize(sizeof(Header) + entries.size() * sizeof(Entry) + names.size());
+    char* out = index.owned.data();
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(Header), entries.data(), entries.size() * sizeof(Entry));
+    std::memcpy(out + sizeof(Header) + entries.size() * sizeof(Entry), names.data(), names.size());
+    index.data = index.owned.data();
+    index.length = index.owned.size();
+    return index;
+}
+
+bool SymbolIndex::load(const std::string& path) {
+    size_t fileLength = 0;
+    const char* const file = mapReadOnly(path, fileLength);
+    if (file == nullptr)
+        return false;
+
+    Header header{};
+    const bool valid = fileLength >= sizeof(Header) && (std::memcpy(&header, file, sizeof(header)), true) &&
+                       std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                       header.count <= (fileLength - sizeof(Header)) / sizeof(Entry) &&
+                       sizeof(Header) + header.count * sizeof(Entry) + header.stringBytes == fileLength;
+    if (!valid) {
+        munmap(const_cast<char*>(file), fileLength);
+        return false;
+    }
+
+    reset();
+    data = file;
+    length = fileLength;
+    mapped = true;
+    return true;
+}
+
+bool SymbolIndex::save(const std::string& path) const {
+    const std::string temporary = path + ".tmp." + std::to_string(getpid());
+    const int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    size_t written = 0;
+    while (written < length) {
+        const ssize_t n = write(fd, data + written, length - written);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        written += static_cast<size_t>(n);
+    }
+
+    const bool ok = close(fd) == 0 && written == length && rename(temporary.c_str(), path.c_str()) == 0;
+    if (!ok)
+        unlink(temporary.c_str());
+    return ok;
+}
+
+uint64_t SymbolIndex::size() const {
+    if (data == nullptr)
+        return 0;
+    Header header{};
+    std::memcpy(&header, data, sizeof(header));
+    return header.count;
+}
+
+bool SymbolIndex::find(std::string_view name, uintptr_t& address, size_t& size, unsigned& type) const {
+    if (data == nullptr)
+        return false;
+
+    Header header{};
+    std::memcpy(&header, data, sizeof(header));
+    const auto* entries = reinterpret_cast<const Entry*>(data + sizeof(Header));
+    const char* const names = data + sizeof(Header) + header.count * sizeof(Entry);
+
+    const uint64_t hash = nameHash(name);
+    const Entry* it = std::lower_bound(entries, entries + header.count, hash,
+                                       [](const Entry& entry, uint64_t value) { return entry.hash < value; });
+    for (; it != entries + header.count && it->hash == hash; ++it) {
+        if (static_cast<uint64_t>(it->nameOffset) + it->nameLength > header.stringBytes)
+            return false;
+        if (std::string_view(names + it->nameOffset, it->nameLength) == name) {
+            address = it->address;
+            size = it->size;
+            type = it->type;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string symbolCacheDirectory() {
+    if (const char* dir = std::getenv("GWATCH_CACHE_DIR"); dir != nullptr && *dir != '\0')
+        return dir;
+    if (const char* dir = std::getenv("XDG_CACHE_HOME"); dir != nullptr && *dir != '\0')
+        return std::string(dir) + "/gwatch";
+    if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0')
+        return std::string(home) + "/.cache/gwatch";
+    return {};
+}
@@ -0,0 +1,332 @@
+#include "trace_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+constexpr char MAGIC[8] = { 'G', 'W', 'T', 'R', 'A', 'C', 'E', '1' };
+constexpr uint32_t VERSION = 1;
+
+/** Records per chunk must be a multiple of this for chunks to start on page boundaries. */
+constexpr size_t CHUNK_ALIGNMENT = 256;
+
+uint64_t clockNanos(clockid_t clock) {
+    timespec ts{};
+    clock_gettime(clock, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+size_t pageAlign(size_t bytes) {
+    const auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return (bytes + pageSize - 1) & ~(pageSize - 1);
+}
+
+/** Adds one record to a chunk's index entry. */
+void indexRecord(TraceChunk& entry, const TraceRecord& record) {
+    if (entry.records == 0 || record.time < entry.firstTime)
+        entry.firstTime = record.time;
+    entry.lastTime = std::max(entry.lastTime, record.time);
+    entry.varMask |= 1ULL << (record.varIndex % 64);
+    entry.tidMask |= 1ULL << (static_cast<uint32_t>(record.tid) % 64);
+    ++entry.records;
+}
+
+}
+
+uint64_t monotonicNanos() {
+    return clockNanos(CLOCK_MONOTONIC);
+}
+
+TraceFileSink::TraceFileSink(const std::string& path, const std::vector<std::string>& names,
+                             const std::vector<std::shared_ptr<const ValueType>>& types, size_t chunkRecords)
+    : chunkRecords(chunkRecords) {
+    if (chunkRecords == 0 || chunkRecords % CHUNK_ALIGNMENT != 0 || chunkRecords > UINT32_MAX)
+        throw std::invalid_argument("Trace chunks must hold a positive multiple of 256 records");
+
+    std::string blob;
+    std::vector<TraceVariable> variables;
+    for (size_t i = 0; i < names.size(); ++i) {
+        const ValueType* type = i < types.size() ? types[i].get() : nullptr;
+        variables.push_back(TraceVariable{ static_cast<uint32_t>(blob.size()),
+                                           static_cast<uint16_t>(std::min<size_t>(names[i].size(), UINT16_MAX)),
+                                           type != nullptr ? static_cast<uint8_t>(type->kind) : TRACE_UNTYPED,
+                                           static_cast<uint8_t>(type != nullptr ? type->size : 0) });
+        blob.append(names[i], 0, variables.back().nameLength);
+    }
+    headerBytes = pageAlign(sizeof(TraceHeader) + variables.size() * sizeof(TraceVariable) + blob.size());
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        throw systemError("Cannot create " + path);
+    if (ftruncate(fd, static_cast<off_t>(headerBytes)) == -1) {
+        ::close(fd);
+        throw systemError("Cannot size " + path);
+    }
+    void* mapped = mmap(nullptr, headerBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        ::close(fd);
+        throw systemError("Cannot map " + path);
+    }
+
+    header = static_cast<TraceHeader*>(mapped);
+    std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    header->version = VERSION;
+    header->recordSize = sizeof(TraceRecord);
+    header->chunkRecords = static_cast<uint32_t>(chunkRecords);
+    header->variableCount = static_cast<uint32_t>(variables.size());
+    header->dataOffset = headerBytes;
+    header->startTime = monotonicNanos();
+    header->startRealtime = clockNanos(CLOCK_REALTIME);
+    char* table = static_cast<char*>(mapped) + sizeof(TraceHeader);
+    std::memcpy(table, variables.data(), variables.size() * sizeof(TraceVariable));
+    std::memcpy(table + variables.size() * sizeof(TraceVariable), blob.data(), blob.size());
+}
+
+TraceFileSink::~TraceFileSink() {
+    const size_t chunkBytes = chunkRecords * sizeof(TraceRecord);
+    if (chunk != nullptr)
+        munmap(chunk, chunkBytes);
+
+    // The index goes right after the last record; the unused tail of the last chunk is cut off.
+    const uint64_t indexOffset = header->dataOffset + recordCount * sizeof(TraceRecord);
+    const size_t indexBytes = index.size() * sizeof(TraceChunk);
+    bool written = ftruncate(fd, static_cast<off_t>(indexOffset + indexBytes)) == 0;
+    for (size_t done = 0; written && done < indexBytes;) {
+        const ssize_t n = pwrite(fd, reinterpret_cast<const char*>(index.data()) + done, indexBytes - done,
+                                 static_cast<off_t>(indexOffset + done));
+        if (n == -1 && errno == EINTR)
+            continue;
+        written = n > 0;
+        done += written ? static_cast<size_t>(n) : 0;
+    }
+    if (written) {
+        header->recordCount = recordCount;
+        header->chunkCount = index.size();
+        header->indexOffset = indexOffset;
+    } else {
+        std::cerr << "Warning: cannot write the trace index (" << std::strerror(errno) << "); gwatch-report rebuilds it\n";
+    }
+
+    munmap(header, headerBytes);
+    ::close(fd);
+}
+
+void TraceFileSink::nextChunk() {
+    const size_t chunkBytes = chunkRecords * sizeof(TraceRecord);
+    if (chunk != nullptr)
+        munmap(chunk, chunkBytes);
+    chunk = nullptr;
+
+    const off_t offset = static_cast<off_t>(header->dataOffset + index.size() * chunkBytes);
+    if (ftruncate(fd, offset + static_cast<off_t>(chunkBytes)) == -1)
+        throw systemError("Cannot extend the trace");
+    void* mapped = mmap(nullptr, chunkBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+    if (mapped == MAP_FAILED)
+        throw systemError("Cannot map the trace");
+
+    chunk = static_cast<TraceRecord*>(mapped);
+    chunkUsed = 0;
+    index.push_back(TraceChunk{});
+}
+
+void TraceFileSink::consume(std::span<const WatchEvent> events) {
+    if (failed)
+        return;
+    for (const WatchEvent& event : events) {
+        if (chunk == nullptr || chunkUsed == chunkRecords) {
+            try {
+                nextChunk();
+            } catch (const std::exception& e) {
+                // The writer thread has nobody to throw to: keep what was recorded so far.
+                std::cerr << "Warning: recording stopped: " << e.what() << "\n";
+                failed = true;
+                return;
+            }
+        }
+
+        TraceRecord& record = chunk[chunkUsed++];
+        ++recordCount;
+        record.time = event.time;
+        record.ip = event.ip;
+        record.oldValue = event.oldValue;
+        record.newValue = event.newValue;
+        record.pid = event.pid;
+        record.tid = event.tid;
+        record.varIndex = event.varIndex;
+        record.kind = static_cast<uint8_t>(event.kind);
+        record.sampleRatio = event.sampleRatio;
+        indexRecord(index.back(), record);
+    }
+}
+
+void TraceFileSink::flush() {
+    // The records already sit in the page cache; publishing the count makes them readable.
+    header->recordCount = recordCount;
+}
+
+bool TraceFilter::mayMatch(const TraceChunk& chunk) const {
+    return chunk.records > 0 && chunk.lastTime >= from && chunk.firstTime <= to &&
+           (varIndex < 0 || (chunk.varMask & (1ULL << (varIndex % 64))) != 0) &&
+           (tid == 0 || (chunk.tidMask & (1ULL << (static_cast<uint32_t>(tid) % 64))) != 0);
+}
+
+TraceReader::TraceReader(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        throw systemError("Cannot open " + path);
+    struct stat st{};
+    if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(TraceHeader)) {
+        ::close(fd);
+        throw std::runtime_error(path + " is not a gwatch trace");
+    }
+    size = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        throw systemError("Cannot map " + path);
+    base = static_cast<const char*>(mapped);
+    fileHeader = reinterpret_cast<const TraceHeader*>(base);
+
+    const TraceHeader& h = *fileHeader;
+    const auto invalid = [&](const std::string& why) {
+        munmap(const_cast<char*>(base), size);
+        return std::runtime_error(path + ": " + why);
+    };
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw invalid("not a gwatch trace");
+    if (h.version != VERSION || h.recordSize != sizeof(TraceRecord))
+        throw invalid("unsupported trace version " + std::to_string(h.version));
+    const size_t tableBytes = static_cast<size_t>(h.variableCount) * sizeof(TraceVariable);
+    // Counts are checked against the space left after their offset, which cannot wrap.
+    if (h.chunkRecords == 0 || sizeof(TraceHeader) + tableBytes > h.dataOffset || h.dataOffset > size ||
+        h.recordCount > (size - h.dataOffset) / sizeof(TraceRecord))
+        throw invalid("truncated trace");
+
+    const auto* table = reinterpret_cast<const TraceVariable*>(base + sizeof(TraceHeader));
+    const char* blob = base + sizeof(TraceHeader) + tableBytes;
+    for (uint32_t i = 0; i < h.variableCount; ++i) {
+        if (sizeof(TraceHeader) + tableBytes + table[i].nameOffset + table[i].nameLength > h.dataOffset)
+            throw invalid("corrupt variable table");
+        variableNames.emplace_back(blob + table[i].nameOffset, table[i].nameLength);
+        std::shared_ptr<ValueType> type;
+        if (table[i].typeKind != TRACE_UNTYPED) {
+            type = std::make_shared<ValueType>();
+            type->kind = static_cast<ValueType::Kind>(table[i].typeKind);
+            type->size = table[i].typeSize;
+        }
+        variableTypes.push_back(std::move(type));
+    }
+
+    if (h.indexOffset != 0) {
+        if (h.indexOffset > size || h.chunkCount > (size - h.indexOffset) / sizeof(TraceChunk))
+            throw invalid("truncated chunk index");
+        // records() finds chunk i at record i * chunkRecords: all chunks but the last must be full.
+        if (h.chunkCount != (h.recordCount + h.chunkRecords - 1) / h.chunkRecords)
+            throw invalid("corrupt chunk index");
+        const auto* entries = reinterpret_cast<const TraceChunk*>(base + h.indexOffset);
+        chunkIndex.assign(entries, entries + h.chunkCount);
+        for (size_t i = 0; i < chunkIndex.size(); ++i) {
+            const uint64_t expected = i + 1 < chunkIndex.size() ? h.chunkRecords
+                                                                 : h.recordCount - i * uint64_t{h.chunkRecords};
+            if (chunkIndex[i].records != expected)
+                throw invalid("corrupt chunk index");
+        }
+        return;
+    }
+
+    // Interrupted recording: the only full pass over the records, to rebuild the index.
+    const auto* records = reinterpret_cast<const TraceRecord*>(base + h.dataOffset);
+    for (uint64_t i = 0; i < h.recordCount; ++i) {
+        if (i % h.chunkRecords == 0)
+            chunkIndex.push_back(TraceChunk{});
+        indexRecord(chunkIndex.back(), records[i]);
+    }
+}
+
+TraceReader::~TraceReader() {
+    munmap(const_cast<char*>(base), size);
+}
+
+std::span<const TraceRecord> TraceReader::records(size_t chunk) const {
+    const auto* first = reinterpret_cast<const TraceRecord*>(base + fileHeader->dataOffset) +
+                        chunk * fileHeader->chunkRecords;
+    return { first, chunkIndex[chunk].records };
+}
+
+std::vector<TraceSummary> summarizeTrace(const TraceReader& trace, const TraceFilter& filter) {
+    std::vector<TraceSummary> summaries(trace.names().size());
+    std::vector<std::unordered_set<int32_t>> threads(summaries.size());
+    trace.forEach(filter, [&](const TraceRecord& record) {
+        if (record.varIndex >= summaries.size())
+            return;
+        TraceSummary& summary = summaries[record.varIndex];
+        switch (static_cast<EventKind>(record.kind)) {
+            case EventKind::Write: ++summary.writes; break;
+            case EventKind::Read: ++summary.reads; break;
+            case EventKind::Access: ++summary.accesses; break;
+            case EventKind::Execute: ++summary.executions; break;
+        }
+        if (record.sampleRatio > 0) {
+            summary.estimated += 1.0 / record.sampleRatio;
+            summary.sampled = true;
+        } else {
+            summary.estimated += 1.0;
+        }
+        if (summary.firstTime == 0 || record.time < summary.firstTime)
+            summary.firstTime = record.time;
+        summary.lastTime = std::max(summary.lastTime, record.time);
+        threads[record.varIndex].insert(record.tid);
+    });
+    for (size_t i = 0; i < summaries.size(); ++i)
+        summaries[i].threads = threads[i].size();
+    return summaries;
+}
+
+void printTraceSummary(std::ostream& out, const TraceReader& trace, const std::vector<TraceSummary>& summaries) {
+    size_t nameWidth = 8;
+    for (const auto& name : trace.names())
+        nameWidth = std::max(nameWidth, name.size());
+
+    const auto seconds = [&](uint64_t time) {
+        return time < trace.header().startTime ? 0.0 : static_cast<double>(time - trace.header().startTime) / 1e9;
+    };
+    const bool sampled = std::any_of(summaries.begin(), summaries.end(),
+                                     [](const TraceSummary& summary) { return summary.sampled; });
+    out << std::left << std::setw(static_cast<int>(nameWidth)) << "variable" << std::right
+        << "  " << std::setw(12) << "writes" << "  " << std::setw(12) << "reads" << "  " << std::setw(12) << "accesses"
+        << "  " << std::setw(8) << "threads" << "  " << std::setw(12) << "first(s)" << "  " << std::setw(12) << "last(s)";
+    if (sampled)
+        out << "  " << std::setw(12) << "estimated";
+    out << "\n";
+    for (size_t i = 0; i < summaries.size(); ++i) {
+        const TraceSummary& summary = summaries[i];
+        if (summary.total() == 0)
+            continue;
+        out << std::left << std::setw(static_cast<int>(nameWidth)) << trace.names()[i] << std::right
+            << "  " << std::setw(12) << summary.writes << "  " << std::setw(12) << summary.reads
+            << "  " << std::setw(12) << summary.accesses + summary.executions << "  " << std::setw(8) << summary.threads
+            << std::fixed << std::setprecision(6)
+            << "  " << std::setw(12) << seconds(summary.firstTime) << "  " << std::setw(12) << seconds(summary.lastTime)
+            << std::defaultfloat;
+        if (sampled)
+            out << "  " << std::setw(12) << std::llround(summary.estimated);
+        out << "\n";
+    }
+}
@@ -0,0 +1,76 @@
+#include "tracer_stats.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+// Top of a bucket: the largest value of its bit width.
+static uint64_t bucketTop(size_t bucket) {
+    return bucket == 0 ? 0 : bucket == 64 ? UINT64_MAX : (uint64_t{1} << bucket) - 1;
+}
+
+uint64_t LogHistogram::quantile(double q) const {
+    if (total == 0)
+        return 0;
+    const auto rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(bucketTop(i), maximum);
+    }
+    return maximum;
+}
+
+void LogHistogram::writeJson(std::ostream& out) const {
+    out << "{\"count\": " << total << ", \"min\": " << (total == 0 ? 0 : minimum) << ", \"mean\": " << std::fixed
+        << std::setprecision(1) << mean() << ", \"p50\": " << quantile(0.5) << ", \"p90\": " << quantile(0.9)
+        << ", \"p99\": " << quantile(0.99) << ", \"max\": " << maximum << ", \"buckets\": [";
+    const char* separator = "";
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        if (buckets[i] == 0)
+            continue;
+        out << separator << "{\"le\": " << bucketTop(i) << ", \"count\": " << buckets[i] << "}";
+        separator = ", ";
+    }
+    out << "]}";
+}
+
+void TracerStats::writeJson(std::ostream& out, uint64_t now, const Totals& totals) const {
+    const double seconds = static_cast<double>(now - start) / 1e9;
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"backend\": \"" << backend << "\",\n"
+        << "  \"elapsed_seconds\": " << seconds << ",\n"
+        << "  \"stops\": " << totals.stops << ",\n"
+        << "  \"traps\": " << traps << ",\n"
+        << "  \"traps_per_second\": " << (seconds > 0 ? static_cast<double>(traps) / seconds : 0.0) << ",\n"
+        << "  \"accesses\": " << totals.accesses << ",\n"
+        << "  \"ptrace_requests\": " << totals.ptraceRequests << ",\n"
+        << "  \"dropped_events\": " << totals.dropped << ",\n"
+        << "  \"lost_samples\": " << totals.lost << ",\n"
+        << "  \"stopped_ns_per_trap\": ";
+    stoppedNanos.writeJson(out);
+    out << ",\n  \"ptrace_requests_per_trap\": ";
+    ptracePerTrap.writeJson(out);
+    out << ",\n  \"memory_read_ns\": ";
+    readNanos.writeJson(out);
+    out << ",\n  \"queue_depth\": ";
+    queueDepth.writeJson(out);
+    out << "\n}\n";
+}
+
+void TracerStats::writeFile(const std::string& path, uint64_t now, const Totals& totals) const {
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        writeJson(out, now, totals);
+        if (!out.flush())
+            throw std::runtime_error("Cannot write statistics to " + temporary);
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("Cannot replace " + path + ": " + std::strerror(errno));
+}
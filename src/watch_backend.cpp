@@ -0,0 +1,11 @@
+#include "watch_backend.hpp"
+#include "perf_backend.hpp"
+#include "ptrace_backend.hpp"
+
+std::unique_ptr<WatchBackend> createBackend(BackendKind kind, const TracerOptions& options) {
+    switch (kind) {
+        case BackendKind::Perf: return std::make_unique<PerfBackend>(options);
+        case BackendKind::Ptrace: break;
+    }
+    return std::make_unique<PtraceBackend>(options);
+}
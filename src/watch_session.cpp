@@ -0,0 +1,251 @@
+#include "gwatch.hpp"
+#include "debugger.hpp"
+#include "dwarf_info.hpp"
+#include "elf_utils.hpp"
+#include "ptrace_utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+WatchSession::WatchSession(std::string programPath, std::vector<std::string> args, BackendKind backend,
+                           TracerOptions options)
+    : programPath(std::move(programPath)), args(std::move(args)), backend(backend), options(std::move(options)) {}
+
+WatchSession::WatchSession(pid_t attachPid, BackendKind backend, TracerOptions options)
+    : programPath("/proc/" + std::to_string(attachPid) + "/exe"),
+      attachPid(attachPid),
+      backend(backend),
+      options(std::move(options)) {}
+
+WatchSession::~WatchSession() {
+    if (interrupter.joinable())
+        interrupter.join();
+}
+
+void WatchSession::checkIdle() const {
+    if (running.load())
+        throw std::runtime_error("Watches cannot change while the session runs");
+}
+
+DwarfInfo* WatchSession::debugInfo() {
+    if (!dwarfTried) {
+        dwarfTried = true;
+        try {
+            dwarf = std::make_unique<DwarfInfo>(programPath);
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: cannot read debug information: " << e.what() << "\n";
+        }
+    }
+    return dwarf != nullptr && dwarf->hasDebugInfo() ? dwarf.get() : nullptr;
+}
+
+size_t WatchSession::addWatch(const VariableSpec& spec) {
+    return addWatches(std::span(&spec, 1)).front();
+}
+
+std::vector<size_t> WatchSession::addWatches(std::span<const VariableSpec> specs) {
+    checkIdle();
+
+    // Library symbols are looked up by the tracer once their library is mapped; --addr ranges
+    // need no lookup at all.
+    std::vector<SymbolLookup> lookups;
+    for (const auto& spec : specs) {
+        if (spec.library.empty() && spec.address == 0)
+            lookups.push_back(SymbolLookup{ spec.symbol });
+    }
+    if (!lookups.empty() && !findSymbolAddresses(programPath, lookups))
+        throw std::runtime_error("Cannot read the symbols of " + programPath);
+
+    // "config.limits.max_conns" or "table[17]" that is not a symbol itself selects part of a
+    // variable; the variable's symbol gives the address, DWARF the offset and width.
+    std::vector<SymbolLookup> bases;
+    for (const auto& symbol : lookups) {
+        if (!symbol.found && isVariablePath(symbol.name))
+            bases.push_back(SymbolLookup{ variableOfPath(symbol.name) });
+    }
+    if (!bases.empty() && !findSymbolAddresses(programPath, bases))
+        throw std::runtime_error("Cannot read the symbols of " + programPath);
+
+    // Thread-local symbols hold offsets into the TLS block, placed per thread below fs_base.
+    uintptr_t tlsBlockOffset = 0;
+    const auto threadLocal = [&](const SymbolLookup& symbol) { return symbol.found && symbol.tls; };
+    if ((std::ranges::any_of(lookups, threadLocal) || std::ranges::any_of(bases, threadLocal)) &&
+        !getTlsBlockOffset(programPath, tlsBlockOffset))
+        throw std::invalid_argument("thread-local symbols but no PT_TLS segment in " + programPath);
+
+    std::vector<WatchedVariable> resolved;
+    auto lookup = lookups.begin();
+    auto base = bases.begin();
+    for (const auto& spec : specs) {
+        if (!spec.library.empty()) {
+            WatchedVariable var{ spec.symbol };
+            var.library = spec.library;
+            var.mode = spec.mode;
+            var.condition = spec.condition;
+            var.range = spec.range;
+            resolved.push_back(std::move(var));
+            continue;
+        }
+
+        if (spec.address != 0) {
+            WatchedVariable var{ spec.symbol, spec.address, spec.length };
+            var.mode = spec.mode;
+            var.condition = spec.condition;
+            var.range = true;
+            resolved.push_back(std::move(var));
+            continue;
+        }
+
+        SymbolLookup symbol = *lookup++;
+        std::shared_ptr<const ValueType> type;
+        if (!symbol.found && isVariablePath(symbol.name)) {
+            const SymbolLookup& variable = *base++;
+            if (!variable.found)
+                throw std::invalid_argument("symbol '" + variable.name + "' not found in " + programPath);
+
+            DwarfInfo* info = debugInfo();
+            if (info == nullptr)
+                throw std::invalid_argument("'" + symbol.name + "' needs debug information (.debug_info) in " +
+                                            programPath);
+            DwarfLocation location;
+            if (!info->resolve(symbol.name, location))
+                throw std::invalid_argument("no debug information for '" + variable.name + "'");
+            symbol.address = variable.address + location.offset;
+            symbol.size = location.size;
+            symbol.found = true;
+            symbol.tls = variable.tls;
+            type = location.type;
+        } else if (symbol.found) {
+            // Plain variables print by their DWARF type when there is one; failures just leave them raw.
+            if (DwarfInfo* info = debugInfo()) {
+                DwarfLocation location;
+                try {
+                    if (info->resolve(symbol.name, location) && location.size == symbol.size)
+                        type = location.type;
+                } catch (const std::exception&) {
+                }
+            }
+        }
+
+        if (!symbol.found)
+            throw std::invalid_argument("symbol '" + symbol.name + "' not found in " + programPath);
+
+        WatchedVariable var{ symbol.name, symbol.address, symbol.size };
+        if (symbol.tls) {
+            var.tls = true;
+            var.tpOffset = static_cast<int64_t>(symbol.address) - static_cast<int64_t>(tlsBlockOffset);
+        }
+        var.type = std::move(type);
+        var.mode = spec.mode;
+        var.condition = spec.condition;
+        var.range = spec.range;
+        resolved.push_back(std::move(var));
+    }
+
+    for (const auto& var : resolved)
+        validateVariable(var, backend, options);
+
+    std::vector<size_t> ids;
+    for (auto& var : resolved) {
+        ids.push_back(watches.size());
+        watches.emplace_back(std::move(var));
+    }
+    return ids;
+}
+
+void WatchSession::removeWatch(size_t id) {
+    checkIdle();
+    if (id >= watches.size() || !watches[id])
+        throw std::invalid_argument("No watch " + std::to_string(id));
+    watches[id].reset();
+}
+
+const WatchedVariable& WatchSession::watch(size_t id) const {
+    if (id >= watches.size() || !watches[id])
+        throw std::invalid_argument("No watch " + std::to_string(id));
+    return *watches[id];
+}
+
+std::vector<WatchedVariable> WatchSession::variables() const {
+    std::vector<WatchedVariable> vars;
+    for (const auto& watch : watches) {
+        if (watch)
+            vars.push_back(*watch);
+    }
+    return expandRanges(vars, backend);
+}
+
+void WatchSession::run(EventCallback onEvents) {
+    trace(std::make_unique<CallbackEventSink>(std::move(onEvents)), false);
+}
+
+void WatchSession::run(std::unique_ptr<EventSink> sink) {
+    trace(std::move(sink), false);
+}
+
+void WatchSession::run() {
+    trace(nullptr, true);
+}
+
+void WatchSession::trace(std::unique_ptr<EventSink> sink, bool defaultSignals) {
+    std::vector<WatchedVariable> vars;
+    for (const auto& watch : watches) {
+        if (watch)
+            vars.push_back(*watch);
+    }
+
+    {
+        std::lock_guard lock(stopMutex);
+        if (running.load())
+            throw std::runtime_error("The session is already running");
+        tracer = pthread_self();
+        running.store(true);
+    }
+    clearDetachRequest();
+
+    // Marks the run as over, then waits for a stop() that raced with its end.
+    const auto finish = [this] {
+        {
+            std::lock_guard lock(stopMutex);
+            running.store(false);
+        }
+        if (interrupter.joinable())
+            interrupter.join();
+    };
+
+    try {
+        std::vector<char*> argv;
+        for (auto& arg : args)
+            argv.push_back(arg.data());
+        argv.push_back(nullptr);
+
+        if (attachPid != 0) {
+            const Debugger dbg(attachPid, std::move(vars), backend, options);
+            defaultSignals ? dbg.run() : dbg.run(std::move(sink));
+        } else {
+            const Debugger dbg(programPath, std::move(vars), args.empty() ? nullptr : argv.data(), backend, options);
+            defaultSignals ? dbg.run() : dbg.run(std::move(sink));
+        }
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+}
+
+void WatchSession::stop() {
+    std::lock_guard lock(stopMutex);
+    if (!running.load() || interrupter.joinable())
+        return;
+
+    // One signal may land just before the tracer blocks in waitpid(), so it is repeated.
+    interrupter = std::thread([this, thread = tracer] {
+        while (running.load()) {
+            requestDetach(thread);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    });
+}
@@ -0,0 +1,234 @@
+#include <benchmark/benchmark.h>
+#include "elf_utils.hpp"
+#include "gwatch.hpp"
+#include "trace_file.hpp"
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Paths of the targets, set by CMake.
+#ifndef BENCH_WORKLOAD
+#define BENCH_WORKLOAD "bench_workload"
+#endif
+#ifndef BENCH_SYMBOLS
+#define BENCH_SYMBOLS "bench_symbols"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/** Accesses per thread of a traced run: long enough to amortise start-up, short enough to repeat. */
+constexpr int64_t TRACED_ITERATIONS = 20000;
+
+/** argv of bench_workload. */
+std::vector<std::string> workloadArgs(int64_t iterations, int64_t threads, int64_t readsPerWrite, int64_t size) {
+    return { BENCH_WORKLOAD, std::to_string(iterations), std::to_string(threads), std::to_string(readsPerWrite),
+             std::to_string(size) };
+}
+
+/** The global of bench_workload that a run of the given size accesses. */
+VariableSpec workloadVariable(int64_t size) {
+    return VariableSpec{ .symbol = "bench_u" + std::to_string(size * 8), .mode = WatchMode::ReadWrite };
+}
+
+/** Sends stderr to /dev/null while alive: the tracer prints addresses and exit codes on every run. */
+class QuietStderr {
+public:
+    QuietStderr() : saved(dup(STDERR_FILENO)) {
+        const int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDERR_FILENO);
+        close(null);
+    }
+    ~QuietStderr() {
+        dup2(saved, STDERR_FILENO);
+        close(saved);
+    }
+    QuietStderr(const QuietStderr&) = delete;
+    QuietStderr& operator=(const QuietStderr&) = delete;
+
+private:
+    int saved;
+};
+
+/** Runs a program without gwatch and returns its wall time in nanoseconds. */
+uint64_t runAlone(const std::vector<std::string>& args) {
+    std::vector<char*> argv;
+    for (const auto& arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    const uint64_t start = monotonicNanos();
+    const pid_t child = fork();
+    if (child == -1)
+        throw std::runtime_error("fork failed");
+    if (child == 0) {
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    const uint64_t end = monotonicNanos();
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        throw std::runtime_error(args[0] + " failed");
+    return end - start;
+}
+
+/** Result of one run under gwatch. */
+struct TracedRun {
+    uint64_t nanos = 0;       ///< Wall time from run() to the end of tracing
+    uint64_t firstEvent = 0;  ///< From run() to the first access, i.e. launch until armed, 0 if none
+    uint64_t events = 0;      ///< Events reported
+};
+
+/** Runs the workload under a session watching its variable. */
+TracedRun runTraced(const std::vector<std::string>& args, int64_t size) {
+    WatchSession session(args[0], args);
+    session.addWatch(workloadVariable(size));
+
+    TracedRun result;
+    const QuietStderr quiet;
+    const uint64_t start = monotonicNanos();
+    session.run([&](std::span<const WatchEvent> batch) {
+        if (result.events == 0 && !batch.empty())
+            result.firstEvent = batch.front().time - start;
+        result.events += batch.size();
+    });
+    result.nanos = monotonicNanos() - start;
+    return result;
+}
+
+/** Points the symbol index cache at a directory of its own, emptied on request. */
+class SymbolCache {
+public:
+    SymbolCache() : dir(fs::temp_directory_path() / ("gwatch-bench-cache-" + std::to_string(getpid()))) {
+        setenv("GWATCH_CACHE_DIR", dir.c_str(), 1);
+    }
+    ~SymbolCache() {
+        std::error_code ignored;
+        fs::remove_all(dir, ignored);
+        unsetenv("GWATCH_CACHE_DIR");
+    }
+    SymbolCache(const SymbolCache&) = delete;
+    SymbolCache& operator=(const SymbolCache&) = delete;
+
+    void clear() const {
+        std::error_code ignored;
+        fs::remove_all(dir, ignored);
+    }
+
+private:
+    fs::path dir;
+};
+
+}
+
+/**
+ * Symbol lookup in the small workload (0) or the generated executable with a very large
+ * .symtab (1), with the index cache empty (cold, 0) or filled by an earlier run (warm, 1).
+ */
+void BM_FindSymbolAddress(benchmark::State& state) {
+    const bool large = state.range(0) != 0;
+    const bool warm = state.range(1) != 0;
+    const std::string path = large ? BENCH_SYMBOLS : BENCH_WORKLOAD;
+    const std::string symbol = large ? "bench_target" : "bench_u64";
+
+    const SymbolCache cache;
+    uintptr_t address = 0;
+    size_t size = 0;
+    if (warm && !findSymbolAddress(path, symbol, address, size)) {
+        state.SkipWithError("symbol not found");
+        return;
+    }
+    for (auto _ : state) {
+        if (!warm) {
+            state.PauseTiming();
+            cache.clear();
+            state.ResumeTiming();
+        }
+        if (!findSymbolAddress(path, symbol, address, size)) {
+            state.SkipWithError("symbol not found");
+            return;
+        }
+        benchmark::DoNotOptimize(address);
+    }
+}
+BENCHMARK(BM_FindSymbolAddress)->ArgNames({ "large", "warm" })->ArgsProduct({ { 0, 1 }, { 0, 1 } })
+    ->Unit(benchmark::kMicrosecond);
+
+/** Time from starting a session until the target's first access is reported. */
+void BM_StartupToArmed(benchmark::State& state) {
+    const auto args = workloadArgs(0, 1, 0, 8);
+    for (auto _ : state) {
+        const TracedRun run = runTraced(args, 8);
+        if (run.events == 0) {
+            state.SkipWithError("no event reported");
+            return;
+        }
+        state.SetIterationTime(static_cast<double>(run.firstEvent) / 1e9);
+    }
+}
+BENCHMARK(BM_StartupToArmed)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+/**
+ * Events reported per second of tracing, by thread count, reads per write and variable size.
+ * Every access traps: the variable is watched for reads and writes.
+ */
+void BM_TracedEvents(benchmark::State& state) {
+    const int64_t threads = state.range(0);
+    const int64_t readsPerWrite = state.range(1);
+    const int64_t size = state.range(2);
+    const auto args = workloadArgs(TRACED_ITERATIONS, threads, readsPerWrite, size);
+
+    uint64_t events = 0;
+    for (auto _ : state) {
+        const TracedRun run = runTraced(args, size);
+        events += run.events;
+        state.SetIterationTime(static_cast<double>(run.nanos) / 1e9);
+    }
+    state.counters["events"] = benchmark::Counter(static_cast<double>(events), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_TracedEvents)
+    ->ArgNames({ "threads", "reads", "size" })
+    ->Args({ 1, 0, 8 })
+    ->Args({ 1, 1, 8 })
+    ->Args({ 1, 4, 8 })
+    ->Args({ 4, 0, 8 })
+    ->Args({ 4, 1, 8 })
+    ->Args({ 1, 0, 1 })
+    ->Args({ 1, 0, 2 })
+    ->Args({ 1, 0, 4 })
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+/** Wall time of the workload under gwatch, with its slowdown against running it alone. */
+void BM_Slowdown(benchmark::State& state) {
+    const int64_t threads = state.range(0);
+    const int64_t readsPerWrite = state.range(1);
+    const auto args = workloadArgs(TRACED_ITERATIONS, threads, readsPerWrite, 8);
+
+    double slowdown = 0;
+    for (auto _ : state) {
+        const uint64_t alone = runAlone(args);
+        const TracedRun traced = runTraced(args, 8);
+        slowdown += static_cast<double>(traced.nanos) / static_cast<double>(alone);
+        state.SetIterationTime(static_cast<double>(traced.nanos) / 1e9);
+    }
+    state.counters["slowdown"] = benchmark::Counter(slowdown, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_Slowdown)
+    ->ArgNames({ "threads", "reads" })
+    ->Args({ 1, 0 })
+    ->Args({ 1, 4 })
+    ->Args({ 4, 0 })
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,31 @@
+// Executable with BENCH_SYMBOL_COUNT generated data symbols (bench_sym_<n>) ahead of bench_target,
+// for timing symbol lookups in very large symbol tables. The symbols are expanded by the
+// assembler, so the source stays small however many there are. None is exported: lookups go
+// through .symtab as they do for ordinary executables.
+
+#define BENCH_STRINGIFY(x) #x
+#define BENCH_EXPAND(x) BENCH_STRINGIFY(x)
+
+asm(R"(
+    .pushsection .data
+    .altmacro
+    .macro bench_symbol n
+    .globl bench_sym_\n
+    .type bench_sym_\n, @object
+    .size bench_sym_\n, 4
+bench_sym_\n: .long \n
+    .endm
+    .set bench_index, 0
+    .rept )" BENCH_EXPAND(BENCH_SYMBOL_COUNT) R"(
+    bench_symbol %bench_index
+    .set bench_index, bench_index + 1
+    .endr
+    .noaltmacro
+    .popsection
+)");
+
+int bench_target = 1;
+
+int main() {
+    return bench_target - 1;
+}
@@ -0,0 +1,53 @@
+// Synthetic target of gwatch_bench: threads accessing one global of a chosen width with a
+// chosen read/write mix.
+//
+// Usage: bench_workload [iterations per thread] [threads] [reads per write] [size: 1, 2, 4 or 8]
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <vector>
+
+std::atomic<uint8_t> bench_u8;
+std::atomic<uint16_t> bench_u16;
+std::atomic<uint32_t> bench_u32;
+std::atomic<uint64_t> bench_u64;
+
+template <typename T>
+static void work(std::atomic<T>& var, long iterations, int readsPerWrite) {
+    T seen = 0;
+    for (long i = 0; i < iterations; ++i) {
+        for (int r = 0; r < readsPerWrite; ++r)
+            seen += var.load(std::memory_order_relaxed);
+        var.store(static_cast<T>(i + seen), std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+static void run(std::atomic<T>& var, long iterations, int threads, int readsPerWrite) {
+    // The first access, before any thread starts, tells the benchmark the watchpoint is armed.
+    var.store(1, std::memory_order_relaxed);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; ++t)
+        workers.emplace_back(work<T>, std::ref(var), iterations, readsPerWrite);
+    work(var, iterations, readsPerWrite);
+    for (auto& worker : workers)
+        worker.join();
+}
+
+int main(int argc, char** argv) {
+    const long iterations = argc > 1 ? std::atol(argv[1]) : 100000;
+    const int threads = argc > 2 ? std::atoi(argv[2]) : 1;
+    const int readsPerWrite = argc > 3 ? std::atoi(argv[3]) : 0;
+    const int size = argc > 4 ? std::atoi(argv[4]) : 8;
+
+    switch (size) {
+        case 1: run(bench_u8, iterations, threads, readsPerWrite); break;
+        case 2: run(bench_u16, iterations, threads, readsPerWrite); break;
+        case 4: run(bench_u32, iterations, threads, readsPerWrite); break;
+        default: run(bench_u64, iterations, threads, readsPerWrite); break;
+    }
+    return 0;
+}
@@ -1,9 +1,25 @@
 #include <gtest/gtest.h>
 
+#include <sys/ptrace.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -30,4 +46,796 @@ TEST(Integration, GWatchDetectsWrites) {
 
     EXPECT_NE(content.find("global_var"), std::string::npos);
     EXPECT_NE(content.find("write"), std::string::npos);
-}
\ No newline at end of file
+}
+
+TEST(Integration, GWatchWatchesSeveralVariables) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_multi.txt").string();
+    const std::string cmd = gwatchPath + " --var global_var --var second_var --exec " + testProgramPath +
+                            " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::stringstream buffer;
+    buffer << output.rdbuf();
+    std::string content = buffer.str();
+
+    EXPECT_NE(content.find("global_var    write    99999 -> 100000"), std::string::npos);
+    EXPECT_NE(content.find("second_var    write    0 -> 42"), std::string::npos);
+}
+
+TEST(Integration, GWatchFollowsThreads) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog_threads").string();
+
+    ASSERT_TRUE(fs::exists(testProgramPath)) << "testprog_threads binary not found";
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_threads.txt").string();
+    const std::string cmd = gwatchPath + " --var thread_var --exec " + testProgramPath + " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::set<std::string> tids;
+    size_t events = 0;
+    bool sawFinalValue = false;
+    std::string line;
+    while (std::getline(output, line)) {
+        if (line.rfind("thread_var    ", 0) != 0)
+            continue;
+        ++events;
+        tids.insert(line.substr(line.find("tid=")));
+        sawFinalValue |= line.find("-> 10000 ") != std::string::npos;
+    }
+
+    // 4 workers x 1000 atomic increments, each one trapping in a worker thread
+    EXPECT_EQ(events, 4000u);
+    EXPECT_EQ(tids.size(), 4u);
+    EXPECT_TRUE(sawFinalValue);
+}
+
+TEST(Integration, GWatchWatchesEachThreadsInstanceOfThreadLocals) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog_threads").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_tls.txt").string();
+    const std::string cmd = gwatchPath + " --var tls_counter --exec " + testProgramPath + " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::set<std::string> tids;
+    std::vector<std::string> events;
+    std::string line;
+    while (std::getline(output, line)) {
+        // glibc clearing the main thread's static TLS block shows up as reads of an unchanged 0.
+        if (line.rfind("tls_counter    write    ", 0) != 0)
+            continue;
+        events.push_back(line.substr(0, line.find("    tid=")));
+        tids.insert(line.substr(line.find("tid=")));
+    }
+
+    // The main thread's store, then three increments per worker, each in its own instance.
+    ASSERT_EQ(events.size(), 13u);
+    EXPECT_EQ(tids.size(), 5u);
+    EXPECT_EQ(events[0], "tls_counter    write    0 -> 100");
+    for (int t = 1; t <= 4; t++) {
+        const std::string last = "tls_counter    write    " + std::to_string(2 * t) + " -> " + std::to_string(3 * t);
+        EXPECT_EQ(std::ranges::count(events, last), 1) << last;
+    }
+}
+
+TEST(Integration, GWatchPerfBackendRecordsEveryAccess) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_perf.txt").string();
+    const std::string cmd = gwatchPath + " --backend=perf --var global_var --exec " + testProgramPath +
+                            " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+
+    std::ifstream output(output_file);
+    std::stringstream buffer;
+    buffer << output.rdbuf();
+    std::string content = buffer.str();
+
+    if (ret != 0 && content.find("perf_event_open") != std::string::npos) {
+        GTEST_SKIP() << "perf_event_open unavailable: restricted by perf_event_paranoid or missing PMU support";
+    }
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    // 100000 increments, each one a load and a store
+    EXPECT_NE(content.find("global_var: 200000 accesses"), std::string::npos);
+    EXPECT_NE(content.find("global_var    access    ip=0x"), std::string::npos);
+}
+
+TEST(Integration, GWatchWatchesNarrowVariables) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_narrow.txt").string();
+    const std::string cmd = gwatchPath + " --var small_var --var char_var --exec " + testProgramPath +
+                            " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::stringstream buffer;
+    buffer << output.rdbuf();
+    std::string content = buffer.str();
+
+    // char_var sits next to small_var; neither may pick up the other's bytes
+    EXPECT_NE(content.find("char_var    write    0 -> 5"), std::string::npos);
+    EXPECT_NE(content.find("small_var    write    0 -> 300"), std::string::npos);
+}
+
+TEST(Integration, GWatchArmsBeforeFirstUserInstruction) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_early.txt").string();
+    const std::string cmd = gwatchPath + " --var early_var --exec " + testProgramPath + " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::stringstream buffer;
+    buffer << output.rdbuf();
+    std::string content = buffer.str();
+
+    // Written by a constructor that runs before main()
+    EXPECT_NE(content.find("early_var    write    0 -> 7"), std::string::npos);
+}
+
+TEST(Integration, GWatchWriteAndExecModes) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_modes.txt").string();
+    const std::string cmd = gwatchPath + " --mode=write --var global_var --mode=exec --var finish --exec " +
+                            testProgramPath + " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::string line;
+    int writes = 0;
+    int reads = 0;
+    int execs = 0;
+    while (std::getline(output, line)) {
+        if (line.rfind("global_var    write", 0) == 0) ++writes;
+        if (line.rfind("global_var    read", 0) == 0) ++reads;
+        if (line.rfind("finish    exec    tid=", 0) == 0) ++execs;
+    }
+
+    // Only the store of each increment traps; the load no longer does
+    EXPECT_EQ(writes, 100000);
+    EXPECT_EQ(reads, 0);
+    EXPECT_EQ(execs, 1);
+}
+
+TEST(Integration, GWatchReportsOnlyMatchingAccesses) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_when.txt").string();
+    const std::string cmd = gwatchPath + " --when 'new != old && new % 25000 == 0' --var global_var --exec " +
+                            testProgramPath + " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::string line;
+    std::vector<std::string> events;
+    while (std::getline(output, line)) {
+        if (line.rfind("global_var    ", 0) == 0 && line.find("initial") == std::string::npos)
+            events.push_back(line.substr(0, line.find("    tid=")));
+    }
+
+    const std::vector<std::string> expected{
+        "global_var    write    24999 -> 25000",
+        "global_var    write    49999 -> 50000",
+        "global_var    write    74999 -> 75000",
+        "global_var    write    99999 -> 100000",
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST(Integration, GWatchProfilesAccessingInstructions) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_profile.txt").string();
+    const std::string cmd = gwatchPath + " --profile=5 --var global_var --exec " + testProgramPath +
+                            " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::string line;
+    bool header = false;
+    std::vector<std::string> rows;
+    while (std::getline(output, line)) {
+        EXPECT_EQ(line.find("global_var    write"), std::string::npos) << "events printed in profile mode";
+        if (line.rfind("location", 0) == 0)
+            header = true;
+        else if (header && line.rfind("main+0x", 0) == 0)
+            rows.push_back(line);
+    }
+
+    // The load and the store of the increment, each hit 100000 times
+    ASSERT_TRUE(header);
+    ASSERT_EQ(rows.size(), 2u);
+    for (const auto& row : rows)
+        EXPECT_NE(row.find("100000"), std::string::npos) << row;
+}
+
+TEST(Integration, GWatchWatchesSharedLibraryVariables) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog_libs").string();
+    const std::string pluginPath = (fs::path(build_dir) / "libgwatch_testplugin.so").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_libs.txt").string();
+    const std::string cmd = gwatchPath + " --mode=write --var libgwatch_testlib.so:linked_counter" +
+                            " --var libgwatch_testplugin.so:plugin_counter --exec " + testProgramPath +
+                            " -- " + testProgramPath + " " + pluginPath + " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::stringstream buffer;
+    buffer << output.rdbuf();
+    std::string content = buffer.str();
+
+    // Linked at startup: armed at the initial rendezvous, before main runs
+    EXPECT_NE(content.find("linked_counter    write    0 -> 1    tid="), std::string::npos) << content;
+    EXPECT_NE(content.find("linked_counter    write    9 -> 10    tid="), std::string::npos);
+    // dlopen()ed later: armed when the linker reports the new library
+    EXPECT_NE(content.find("plugin_counter    write    0 -> 1    tid="), std::string::npos);
+    EXPECT_NE(content.find("plugin_counter    write    4 -> 5    tid="), std::string::npos);
+}
+
+TEST(Integration, GWatchWatchesStructFieldsAndArrayElements) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_fields.txt").string();
+    const std::string cmd = gwatchPath + " --var config.limits.max_conns --var 'config.table[2]' --exec " +
+                            testProgramPath + " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::string line;
+    std::vector<std::string> events;
+    while (std::getline(output, line)) {
+        if (line.rfind("config.", 0) == 0 && line.find("initial=") == std::string::npos)
+            events.push_back(line);
+    }
+
+    // Neighbouring fields share the watched words but do not trap; the int prints signed.
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].rfind("config.limits.max_conns    write    0 -> -5    tid=", 0), 0u) << events[0];
+    EXPECT_EQ(events[1].rfind("config.table[2]    write    0 -> 9    tid=", 0), 0u) << events[1];
+}
+
+TEST(Integration, GWatchWatchesRangesWithDebugRegistersAndPageProtection) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    // history takes all four debug registers, so the 8 KiB buffer falls back to page protection.
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_ranges.txt").string();
+    const std::string cmd = gwatchPath + " --var history --range --var buffer --range --exec " +
+                            testProgramPath + " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::string line;
+    std::vector<std::string> events;
+    bool guarded = false;
+    while (std::getline(output, line)) {
+        guarded = guarded || line.rfind("Guarding 8192 bytes with page protection (2 pages)", 0) == 0;
+        if ((line.rfind("history", 0) == 0 || line.rfind("buffer", 0) == 0) && line.find("initial=") == std::string::npos)
+            events.push_back(line);
+    }
+
+    EXPECT_TRUE(guarded);
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].rfind("history+24    write    0 -> 11    tid=", 0), 0u) << events[0];
+    EXPECT_EQ(events[1].rfind("buffer+5000    write    0 -> 120    tid=", 0), 0u) << events[1];
+}
+
+TEST(Integration, GWatchAttachesToRunningProcessAndDetaches) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string servicePath = (fs::path(build_dir) / "testprog_service").string();
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_attach.txt").string();
+
+    ASSERT_TRUE(fs::exists(servicePath)) << "testprog_service binary not found";
+
+    const pid_t service = fork();
+    ASSERT_NE(service, -1);
+    if (service == 0) {
+        execl(servicePath.c_str(), servicePath.c_str(), nullptr);
+        _exit(127);
+    }
+    usleep(100000);
+
+    const std::string servicePid = std::to_string(service);
+    const pid_t gwatch = fork();
+    ASSERT_NE(gwatch, -1);
+    if (gwatch == 0) {
+        std::freopen(output_file.c_str(), "w", stdout);
+        // Share one file offset so the writer thread's stdout output cannot overwrite stderr lines
+        dup2(STDOUT_FILENO, STDERR_FILENO);
+        execl(gwatchPath.c_str(), gwatchPath.c_str(), "--var", "service_var", "--pid", servicePid.c_str(), nullptr);
+        _exit(127);
+    }
+    usleep(300000);
+
+    kill(gwatch, SIGINT);
+    int status = 0;
+    waitpid(gwatch, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << "gwatch did not exit cleanly";
+
+    // The service must still be alive, untraced, and without any debug register left enabled
+    EXPECT_EQ(waitpid(service, &status, WNOHANG), 0) << "service died while being watched";
+
+    std::ifstream procStatus("/proc/" + servicePid + "/status");
+    std::string line;
+    while (std::getline(procStatus, line)) {
+        if (line.rfind("TracerPid:", 0) == 0) {
+            EXPECT_EQ(line.substr(line.find_first_not_of(" \t", 10)), "0");
+        }
+    }
+
+    ASSERT_EQ(ptrace(PTRACE_SEIZE, service, nullptr, nullptr), 0);
+    ASSERT_EQ(ptrace(PTRACE_INTERRUPT, service, nullptr, nullptr), 0);
+    waitpid(service, &status, __WALL);
+    errno = 0;
+    const long dr7 = ptrace(PTRACE_PEEKUSER, service, reinterpret_cast<void*>(offsetof(user, u_debugreg) + 7 * sizeof(long)), nullptr);
+    EXPECT_EQ(errno, 0);
+    EXPECT_EQ(dr7, 0);
+    ptrace(PTRACE_DETACH, service, nullptr, nullptr);
+
+    kill(service, SIGKILL);
+    waitpid(service, &status, 0);
+
+    std::ifstream output(output_file);
+    std::stringstream buffer;
+    buffer << output.rdbuf();
+    const std::string content = buffer.str();
+    EXPECT_NE(content.find("service_var    write"), std::string::npos);
+    EXPECT_NE(content.find("Detached; target keeps running"), std::string::npos);
+}
+
+TEST(Integration, GWatchFollowsForkedAndExecdChildren) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog_fork").string();
+
+    ASSERT_TRUE(fs::exists(testProgramPath)) << "testprog_fork binary not found";
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_fork.txt").string();
+    const std::string cmd = gwatchPath + " --follow-children --var worker_counter --exec " + testProgramPath +
+                            " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::vector<std::string> events;
+    std::vector<std::string> pids;
+    std::string line;
+    while (std::getline(output, line)) {
+        if (line.rfind("worker_counter    write    ", 0) != 0)
+            continue;
+        events.push_back(line.substr(0, line.find("    tid=")));
+        pids.push_back(line.substr(line.find("pid=") + 4));
+    }
+
+    // The root, then each worker's own write: the second worker re-execs the same image, the
+    // third one a different binary, and both count again in the new image's variable.
+    const std::vector<std::string> expected = {
+        "worker_counter    write    0 -> 1",
+        "worker_counter    write    1 -> 101",
+        "worker_counter    write    1 -> 201",
+        "worker_counter    write    0 -> 10",
+        "worker_counter    write    10 -> 20",
+        "worker_counter    write    1 -> 301",
+        "worker_counter    write    0 -> 10",
+        "worker_counter    write    10 -> 20",
+        "worker_counter    write    1 -> 7",
+    };
+    ASSERT_EQ(events, expected);
+    EXPECT_EQ(pids[0], pids[8]);
+    EXPECT_EQ(std::set<std::string>(pids.begin(), pids.end()).size(), 4u);
+    EXPECT_EQ(pids[2], pids[4]);
+    EXPECT_EQ(pids[5], pids[7]);
+}
+
+TEST(Integration, GWatchRecordsTracesForGWatchReport) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string reportPath = (fs::path(build_dir) / "gwatch-report").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    ASSERT_TRUE(fs::exists(reportPath)) << "gwatch-report binary not found";
+
+    const std::string trace_file = (fs::path(build_dir) / "gwatch_trace.gwt").string();
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_record.txt").string();
+    std::string cmd = gwatchPath + " --record " + trace_file + " --var global_var --var second_var --exec " +
+                      testProgramPath + " > " + output_file + " 2>&1";
+    ASSERT_EQ(std::system(cmd.c_str()), 0) << "gwatch exited with nonzero code";
+
+    // Nothing but the recording notice goes to the terminal.
+    std::ifstream output(output_file);
+    std::string line;
+    while (std::getline(output, line))
+        EXPECT_EQ(line.find("    write    "), std::string::npos) << line;
+
+    const std::string summary_file = (fs::path(build_dir) / "gwatch_output_report_summary.txt").string();
+    cmd = reportPath + " " + trace_file + " --summary > " + summary_file + " 2>&1";
+    ASSERT_EQ(std::system(cmd.c_str()), 0) << "gwatch-report exited with nonzero code";
+    std::ifstream summary(summary_file);
+    std::stringstream buffer;
+    buffer << summary.rdbuf();
+    EXPECT_NE(buffer.str().find("global_var"), std::string::npos);
+    EXPECT_NE(buffer.str().find("100000"), std::string::npos);
+
+    const std::string events_file = (fs::path(build_dir) / "gwatch_output_report.txt").string();
+    cmd = reportPath + " " + trace_file + " --var second_var > " + events_file + " 2>&1";
+    ASSERT_EQ(std::system(cmd.c_str()), 0) << "gwatch-report exited with nonzero code";
+    std::ifstream events(events_file);
+    std::vector<std::string> writes;
+    while (std::getline(events, line)) {
+        EXPECT_EQ(line.rfind("global_var", 0), std::string::npos) << line;
+        if (line.rfind("second_var    write    ", 0) == 0)
+            writes.push_back(line.substr(0, line.find("    tid=")));
+    }
+    EXPECT_EQ(writes, std::vector<std::string>{ "second_var    write    0 -> 42" });
+}
+
+TEST(Integration, GWatchCoalescesHotLoops) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_coalesce.txt").string();
+    const std::string cmd = gwatchPath + " --coalesce=40000 --mode=write --var global_var --exec " + testProgramPath +
+                            " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    // Runs may be split by scheduling hiccups longer than the gap, but every write is counted once.
+    std::ifstream output(output_file);
+    std::string line;
+    size_t lines = 0;
+    uint64_t writes = 0;
+    std::string last;
+    while (std::getline(output, line)) {
+        if (line.rfind("global_var    write    ", 0) != 0)
+            continue;
+        ++lines;
+        const size_t count = line.find("count=");
+        writes += count == std::string::npos ? 1 : std::stoull(line.substr(count + 6));
+        EXPECT_EQ(count == std::string::npos, line.find("duration=") == std::string::npos) << line;
+        last = line;
+    }
+    EXPECT_EQ(writes, 100000u);
+    EXPECT_LT(lines, 100u);
+    EXPECT_EQ(last.rfind("global_var    write    ", 0), 0u);
+    EXPECT_NE(last.find(" -> 100000    tid="), std::string::npos) << last;
+}
+
+TEST(Integration, GWatchStaysWithinAnOverheadBudget) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_budget.txt").string();
+    const std::string cmd = gwatchPath + " --overhead-budget=2% --mode=write --var global_var --exec " + testProgramPath +
+                            " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    // How much is sampled depends on the machine; only the bookkeeping is checked.
+    std::ifstream output(output_file);
+    std::string line;
+    size_t writes = 0;
+    size_t sampled = 0;
+    bool summary = false;
+    uint64_t estimate = 0;
+    while (std::getline(output, line)) {
+        if (line.rfind("global_var    write    ", 0) == 0) {
+            ++writes;
+            if (line.find("    sampled=") != std::string::npos)
+                ++sampled;
+        } else if (line.rfind("Sampling: watchpoints armed ", 0) == 0) {
+            summary = line.find("(budget 2.0%)") != std::string::npos;
+        } else if (line.rfind("global_var: ~", 0) == 0) {
+            estimate = std::stoull(line.substr(13));
+        }
+    }
+    EXPECT_TRUE(summary);
+    EXPECT_GT(writes, 0u);
+    EXPECT_LE(writes, 100000u);
+    EXPECT_EQ(sampled, writes);
+    EXPECT_GE(estimate, writes);
+}
+
+TEST(Integration, GWatchCapturesCallStacks) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_backtrace.txt").string();
+    const std::string cmd = gwatchPath + " --backtrace=4 --mode=write --var second_var --exec " + testProgramPath +
+                            " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::stringstream buffer;
+    buffer << output.rdbuf();
+    const std::string content = buffer.str();
+
+    // testprog is built without optimisation, so finish() and main() keep their frame pointers.
+    EXPECT_NE(content.find("second_var    write    0 -> 42    tid="), std::string::npos) << content;
+    EXPECT_NE(content.find("    stack=#1\n"), std::string::npos) << content;
+    EXPECT_NE(content.find("Stacks:\n#1\n    finish+0x"), std::string::npos) << content;
+    EXPECT_NE(content.find("\n    main+0x"), std::string::npos) << content;
+}
+
+TEST(Integration, GWatchWatchesOnlyInsideAFunction) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog_scope").string();
+
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_only_in.txt").string();
+    const std::string cmd = gwatchPath + " --only-in work --mode=write --var scoped_var --exec " + testProgramPath +
+                            " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream output(output_file);
+    std::string line;
+    std::string content;
+    std::set<std::string> tids;
+    int writes = 0;
+    while (std::getline(output, line)) {
+        content += line + "\n";
+        if (line.rfind("scoped_var    write", 0) != 0)
+            continue;
+        ++writes;
+        tids.insert(line.substr(line.find("tid=")));
+    }
+
+    // work(3) writes twice on each of its four levels, ten times over, all in the worker thread;
+    // the 3000 writes of housekeeping() around it are outside the scope.
+    EXPECT_NE(content.find("Watching only inside work at 0x"), std::string::npos) << content;
+    EXPECT_EQ(writes, 80) << content;
+    EXPECT_EQ(tids.size(), 1u) << content;
+}
+
+TEST(Integration, GWatchTakesCommandsOnAControlSocket) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string servicePath = (fs::path(build_dir) / "testprog_service").string();
+    const std::string socketPath = (fs::path(build_dir) / "gwatch_control.sock").string();
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_control.txt").string();
+
+    ASSERT_TRUE(fs::exists(servicePath)) << "testprog_service binary not found";
+
+    const pid_t service = fork();
+    ASSERT_NE(service, -1);
+    if (service == 0) {
+        execl(servicePath.c_str(), servicePath.c_str(), nullptr);
+        _exit(127);
+    }
+    usleep(100000);
+
+    const std::string servicePid = std::to_string(service);
+    const pid_t gwatch = fork();
+    ASSERT_NE(gwatch, -1);
+    if (gwatch == 0) {
+        std::freopen(output_file.c_str(), "w", stdout);
+        dup2(STDOUT_FILENO, STDERR_FILENO);
+        execl(gwatchPath.c_str(), gwatchPath.c_str(), "--control", socketPath.c_str(), "--mode=write", "--var",
+              "service_var", "--pid", servicePid.c_str(), nullptr);
+        _exit(127);
+    }
+
+    // The socket appears once gwatch has attached.
+    const int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_NE(client, -1);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    bool connected = false;
+    for (int attempt = 0; attempt < 200 && !connected; ++attempt) {
+        connected = connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        if (!connected)
+            usleep(10000);
+    }
+    ASSERT_TRUE(connected) << "cannot connect to " << socketPath;
+
+    // Sends one command and returns its reply, up to the closing "ok" or "error:" line.
+    const auto request = [&](const std::string& command) {
+        const std::string line = command + "\n";
+        EXPECT_EQ(write(client, line.data(), line.size()), static_cast<ssize_t>(line.size()));
+        std::string reply;
+        char data[256];
+        while (reply.find("ok\n") == std::string::npos && reply.find("error") == std::string::npos) {
+            const ssize_t n = read(client, data, sizeof(data));
+            if (n <= 0)
+                break;
+            reply.append(data, static_cast<size_t>(n));
+        }
+        return reply;
+    };
+
+    EXPECT_NE(request("list").find("service_var    write"), std::string::npos);
+    EXPECT_NE(request("add --mode=write service_ticks").find("ok"), std::string::npos);
+    EXPECT_NE(request("add no_such_var").find("error:"), std::string::npos);
+    usleep(300000);
+    EXPECT_NE(request("remove service_var").find("ok"), std::string::npos);
+    const std::string stats = request("stats");
+    EXPECT_NE(stats.find("stops="), std::string::npos) << stats;
+    EXPECT_NE(stats.find("paused=no"), std::string::npos) << stats;
+    close(client);
+
+    kill(gwatch, SIGINT);
+    int status = 0;
+    waitpid(gwatch, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << "gwatch did not exit cleanly";
+    EXPECT_EQ(waitpid(service, &status, WNOHANG), 0) << "service died while being watched";
+    kill(service, SIGKILL);
+    waitpid(service, &status, 0);
+
+    std::ifstream output(output_file);
+    std::stringstream buffer;
+    buffer << output.rdbuf();
+    const std::string content = buffer.str();
+    EXPECT_NE(content.find("service_ticks    write"), std::string::npos) << content;
+    EXPECT_NE(content.find("Stopped watching service_var"), std::string::npos) << content;
+    EXPECT_FALSE(fs::exists(socketPath)) << "the control socket was left behind";
+}
+
+TEST(Integration, GWatchKeepsEveryHitWhileWatchesChange) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string churnPath = (fs::path(build_dir) / "testprog_churn").string();
+    const std::string socketPath = (fs::path(build_dir) / "gwatch_churn.sock").string();
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_churn.txt").string();
+
+    ASSERT_TRUE(fs::exists(churnPath)) << "testprog_churn binary not found";
+
+    const pid_t gwatch = fork();
+    ASSERT_NE(gwatch, -1);
+    if (gwatch == 0) {
+        std::freopen(output_file.c_str(), "w", stdout);
+        dup2(STDOUT_FILENO, STDERR_FILENO);
+        execl(gwatchPath.c_str(), gwatchPath.c_str(), "--control", socketPath.c_str(), "--mode=write", "--var",
+              "churn_counter", "--exec", churnPath.c_str(), nullptr);
+        _exit(127);
+    }
+
+    const int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_NE(client, -1);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    bool connected = false;
+    for (int attempt = 0; attempt < 200 && !connected; ++attempt) {
+        connected = connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        if (!connected)
+            usleep(10000);
+    }
+    ASSERT_TRUE(connected) << "cannot connect to " << socketPath;
+
+    // Each add and remove re-arms every thread while churn_counter keeps trapping; the target
+    // exits, and gwatch with it, after its last write.
+    int changes = 0;
+    for (int round = 0; round < 200; ++round) {
+        const std::string line = round % 2 == 0 ? "add --mode=write churn_other\n" : "remove churn_other\n";
+        if (write(client, line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+            break;
+        std::string reply;
+        char data[256];
+        while (reply.find("ok\n") == std::string::npos && reply.find("error") == std::string::npos) {
+            const ssize_t n = read(client, data, sizeof(data));
+            if (n <= 0)
+                break;
+            reply.append(data, static_cast<size_t>(n));
+        }
+        if (reply.find("ok\n") == std::string::npos)
+            break;
+        ++changes;
+    }
+    close(client);
+
+    int status = 0;
+    waitpid(gwatch, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << "gwatch did not exit cleanly";
+    EXPECT_GE(changes, 10) << "the target finished before the watches could change";
+
+    // Every write shows up, each one step from the one before.
+    std::ifstream output(output_file);
+    std::string line;
+    long writes = 0;
+    long broken = 0;
+    while (std::getline(output, line)) {
+        if (line.rfind("churn_counter    write    ", 0) != 0)
+            continue;
+        ++writes;
+        long before = 0;
+        long after = 0;
+        if (std::sscanf(line.c_str() + 26, "%ld -> %ld", &before, &after) != 2 || after != before + 1)
+            ++broken;
+    }
+    EXPECT_EQ(writes, 100000);
+    EXPECT_EQ(broken, 0);
+}
+
+TEST(Integration, GWatchWritesTracerStatistics) {
+    const std::string build_dir = fs::current_path();
+    const std::string gwatchPath = (fs::path(build_dir) / "gwatch").string();
+    const std::string testProgramPath = (fs::path(build_dir) / "testprog").string();
+
+    const std::string stats_file = (fs::path(build_dir) / "gwatch_stats.json").string();
+    const std::string output_file = (fs::path(build_dir) / "gwatch_output_stats.txt").string();
+    fs::remove(stats_file);
+    const std::string cmd = gwatchPath + " --stats " + stats_file + " --mode=write --var second_var --exec " +
+                            testProgramPath + " > " + output_file + " 2>&1";
+
+    int ret = std::system(cmd.c_str());
+    ASSERT_EQ(ret, 0) << "gwatch exited with nonzero code";
+
+    std::ifstream stats(stats_file);
+    ASSERT_TRUE(stats.is_open()) << "no statistics written";
+    std::stringstream buffer;
+    buffer << stats.rdbuf();
+    const std::string content = buffer.str();
+
+    // testprog writes second_var once: one trap, which needs a few ptrace requests and one read.
+    EXPECT_NE(content.find("\"backend\": \"ptrace\""), std::string::npos) << content;
+    EXPECT_NE(content.find("\"traps\": 1,"), std::string::npos) << content;
+    EXPECT_NE(content.find("\"accesses\": 1,"), std::string::npos) << content;
+    EXPECT_NE(content.find("\"stopped_ns_per_trap\": {\"count\": 1,"), std::string::npos) << content;
+    EXPECT_NE(content.find("\"memory_read_ns\": {\"count\": 1,"), std::string::npos) << content;
+    EXPECT_EQ(content.find("\"ptrace_requests_per_trap\": {\"count\": 0,"), std::string::npos) << content;
+    EXPECT_FALSE(fs::exists(stats_file + ".tmp"));
+}
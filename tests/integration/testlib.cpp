@@ -0,0 +1,6 @@
+// Linked into testprog_libs: mapped by the dynamic linker at startup.
+int linked_counter = 0;
+
+extern "C" void bump_linked() {
+    linked_counter++;
+}
@@ -0,0 +1,6 @@
+// Loaded by testprog_libs with dlopen().
+int plugin_counter = 0;
+
+extern "C" void bump_plugin() {
+    plugin_counter++;
+}
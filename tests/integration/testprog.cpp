@@ -1,8 +1,47 @@
 long long global_var = 0;
+int second_var = 0;
+short small_var = 0;
+char char_var = 0;
+int early_var = 0;
+
+// Watched field by field through DWARF by the integration tests.
+struct Limits {
+    short min_conns;
+    int max_conns;
+};
+struct Config {
+    char tag;
+    Limits limits;
+    int table[4];
+} config;
+
+// Watched as whole ranges: split across debug registers, or page-guarded when too large.
+// The buffer fills its own pages so the counting loop never faults on them.
+long long history[4];
+alignas(4096) char buffer[8192];
+
+// Runs before main(): only observed if the watchpoint is armed before any user code.
+__attribute__((constructor)) static void initEarly() {
+    early_var = 7;
+}
+
+// Watched with --mode=exec by the integration tests.
+extern "C" __attribute__((noinline)) void finish() {
+    second_var = 42;
+    small_var = 300;
+    config.limits.min_conns = 1;
+    config.limits.max_conns = -5;
+    config.table[1] = 8;
+    config.table[2] = 9;
+    history[3] = 11;
+    buffer[5000] = 'x';
+}
 
 int main() {
+    char_var = 5;
     for (int i = 0; i < 100000; i++) {
         global_var++;
     }
+    finish();
     return 0;
-}
\ No newline at end of file
+}
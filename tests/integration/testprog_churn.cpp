@@ -0,0 +1,16 @@
+#include <cstdlib>
+
+volatile long churn_counter = 0;
+volatile long churn_other = 0;
+
+// Target for the --control churn test: writes churn_counter in a tight loop while watches of
+// churn_other come and go, so every write must still be reported exactly once.
+int main(int argc, char** argv) {
+    const long writes = argc > 1 ? std::atol(argv[1]) : 100000;
+    for (long i = 0; i < writes; ++i) {
+        churn_counter = churn_counter + 1;
+        if (i % 64 == 0)
+            churn_other = i;
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#ifdef WORKER_IMAGE
+// A different binary, with the watched variable at another address.
+long long padding[64];
+#endif
+long long worker_counter = 0;
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        // Image exec'd by a worker: counts in its own, fresh copy of the variable.
+        for (int i = 0; i < 2; i++) {
+            worker_counter += 10;
+        }
+        return 0;
+    }
+
+    worker_counter = 1;
+    const std::string self = argv[0];
+    const std::string images[] = { "", self, self + "_worker" };
+    for (int w = 0; w < 3; w++) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            worker_counter += 100 * (w + 1);
+            if (!images[w].empty()) {
+                execl(images[w].c_str(), images[w].c_str(), "worker", nullptr);
+            }
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    worker_counter = 7;
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include <dlfcn.h>
+
+#include <cstdio>
+
+extern "C" void bump_linked();
+
+// Usage: testprog_libs <path to libgwatch_testplugin.so>
+int main(int argc, char** argv) {
+    for (int i = 0; i < 10; i++)
+        bump_linked();
+
+    if (argc < 2)
+        return 1;
+    void* const plugin = dlopen(argv[1], RTLD_NOW);
+    if (plugin == nullptr) {
+        std::fprintf(stderr, "%s\n", dlerror());
+        return 1;
+    }
+
+    auto bump = reinterpret_cast<void (*)()>(dlsym(plugin, "bump_plugin"));
+    for (int i = 0; i < 5; i++)
+        bump();
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include <thread>
+
+long long scoped_var = 0;
+
+// Hammers the variable outside the scope: none of these writes may be reported.
+__attribute__((noinline)) void housekeeping() {
+    for (int i = 0; i < 1000; i++) {
+        __atomic_fetch_add(&scoped_var, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// The scope: two writes per level, the second after the inner call has returned.
+extern "C" __attribute__((noinline)) void work(int depth) {
+    __atomic_fetch_add(&scoped_var, 1, __ATOMIC_RELAXED);
+    if (depth > 0) {
+        work(depth - 1);
+    }
+    __atomic_fetch_add(&scoped_var, 1, __ATOMIC_RELAXED);
+}
+
+int main() {
+    housekeeping();
+    // Only this thread enters the scope, while the main thread keeps writing outside it.
+    std::thread worker([] {
+        for (int i = 0; i < 10; i++) {
+            work(3);
+        }
+    });
+    housekeeping();
+    worker.join();
+    housekeeping();
+    return 0;
+}
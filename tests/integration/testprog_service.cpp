@@ -0,0 +1,14 @@
+#include <unistd.h>
+
+long long service_var = 0;
+int service_ticks = 0;
+
+// Long-running target for --pid and --control tests: keeps updating globals until killed.
+int main() {
+    while (true) {
+        service_var++;
+        if (service_var % 10 == 0)
+            service_ticks++;
+        usleep(1000);
+    }
+}
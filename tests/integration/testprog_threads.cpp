@@ -0,0 +1,26 @@
+#include <thread>
+#include <vector>
+
+long long thread_var = 0;
+thread_local long long tls_counter = 0;
+
+int main() {
+    tls_counter = 100;
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t <= 4; t++) {
+        workers.emplace_back([t] {
+            // Each thread counts in its own instance, starting from the initial 0.
+            for (int i = 0; i < 3; i++) {
+                __atomic_fetch_add(&tls_counter, t, __ATOMIC_RELAXED);
+            }
+            for (int i = 0; i < 1000; i++) {
+                __atomic_fetch_add(&thread_var, t, __ATOMIC_RELAXED);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return 0;
+}
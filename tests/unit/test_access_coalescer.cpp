@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include "access_coalescer.hpp"
+
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Sink that records every event it receives. */
+class RecordingSink : public EventSink {
+public:
+    explicit RecordingSink(std::vector<WatchEvent>& out) : out(out) {}
+
+    void consume(std::span<const WatchEvent> events) override {
+        out.insert(out.end(), events.begin(), events.end());
+    }
+    void flush() override {}
+
+private:
+    std::vector<WatchEvent>& out;
+};
+
+/** Access of variable 0 by thread 10 from the given instruction. */
+WatchEvent access(uint64_t ip, uint64_t time, uint64_t oldValue, uint64_t newValue) {
+    return { .oldValue = oldValue, .newValue = newValue, .ip = ip, .time = time, .pid = 10, .tid = 10, .varIndex = 0,
+             .kind = oldValue == newValue ? EventKind::Read : EventKind::Write };
+}
+
+/** Feeds a read-modify-write loop: a load at 0x100 and a store at 0x108 per iteration, 1µs apart. */
+std::vector<WatchEvent> coalesceLoop(AccessCoalescer& coalescer, uint64_t iterations, bool expireAtEnd) {
+    std::vector<WatchEvent> received;
+    {
+        EventWriter writer(std::make_unique<RecordingSink>(received), QueuePolicy::Block, 64);
+        uint64_t time = 1000;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            coalescer.add(access(0x100, time, i, i), writer);
+            coalescer.add(access(0x108, time + 500, i, i + 1), writer);
+            time += 1000;
+        }
+        if (expireAtEnd)
+            coalescer.expire(time + 1'000'000'000, writer);
+        else
+            coalescer.flush(writer);
+        writer.close();
+    }
+    return received;
+}
+
+}
+
+TEST(AccessCoalescer, CollapsesEachInstructionsRun) {
+    AccessCoalescer coalescer(0, 0);
+    const std::vector<WatchEvent> runs = coalesceLoop(coalescer, 1000, true);
+    EXPECT_EQ(coalescer.size(), 0u);
+
+    ASSERT_EQ(runs.size(), 2u);
+    EXPECT_EQ(runs[0].ip, 0x100u);
+    EXPECT_EQ(runs[0].kind, EventKind::Read);
+    EXPECT_EQ(runs[0].count, 1000u);
+    EXPECT_EQ(runs[0].newValue, 999u);
+    EXPECT_EQ(runs[0].time, 1000u);
+    EXPECT_EQ(runs[0].duration, 999'000u);
+
+    EXPECT_EQ(runs[1].ip, 0x108u);
+    EXPECT_EQ(runs[1].kind, EventKind::Write);
+    EXPECT_EQ(runs[1].oldValue, 0u);
+    EXPECT_EQ(runs[1].newValue, 1000u);
+    EXPECT_EQ(runs[1].count, 1000u);
+}
+
+TEST(AccessCoalescer, CapsRunsAtTheEventLimit) {
+    AccessCoalescer coalescer(300, 0);
+    const std::vector<WatchEvent> runs = coalesceLoop(coalescer, 1000, false);
+
+    // Three full runs per instruction, then the remaining 100 accesses of each on flush.
+    ASSERT_EQ(runs.size(), 8u);
+    EXPECT_EQ(runs[1].count, 300u);
+    EXPECT_EQ(runs[1].oldValue, 0u);
+    EXPECT_EQ(runs[1].newValue, 300u);
+    EXPECT_EQ(runs[3].oldValue, 300u);
+    EXPECT_EQ(runs[7].count, 100u);
+    EXPECT_EQ(runs[7].newValue, 1000u);
+}
+
+TEST(AccessCoalescer, GapEndsARunAndHoldKeepsItOpen) {
+    std::vector<WatchEvent> received;
+    EventWriter writer(std::make_unique<RecordingSink>(received), QueuePolicy::Block, 64);
+    AccessCoalescer coalescer(0, 10'000);
+
+    for (uint64_t i = 0; i < AccessCoalescer::HOT_RUN - 1; ++i)
+        EXPECT_FALSE(coalescer.add(access(0x100, 1000 * (i + 1), i, i + 1), writer));
+    EXPECT_TRUE(coalescer.add(access(0x100, 16'000, 15, 16), writer));
+    EXPECT_EQ(coalescer.nextExpiry(), 26'001u);
+
+    // Paused: the run survives a silence longer than the gap.
+    coalescer.hold(10, 0, 100'000);
+    coalescer.expire(50'000, writer);
+    EXPECT_EQ(coalescer.size(), 1u);
+    EXPECT_FALSE(coalescer.add(access(0x100, 100'500, 200, 201), writer));
+    for (uint64_t i = 0; i < AccessCoalescer::HOT_RUN - 2; ++i)
+        EXPECT_FALSE(coalescer.add(access(0x100, 100'600 + i, 201, 201), writer));
+    EXPECT_TRUE(coalescer.add(access(0x100, 100'700, 201, 201), writer));
+
+    // A single access after a gap is passed on as it is.
+    coalescer.add(access(0x200, 200'000, 201, 201), writer);
+    coalescer.expire(300'000, writer);
+    EXPECT_EQ(coalescer.nextExpiry(), UINT64_MAX);
+    writer.close();
+
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(received[0].count, 32u);
+    EXPECT_EQ(received[0].newValue, 201u);
+    EXPECT_EQ(received[0].duration, 99'700u);
+    EXPECT_EQ(received[1].count, 0u);
+    EXPECT_EQ(received[1].duration, 0u);
+    EXPECT_EQ(received[1].ip, 0x200u);
+}
+
+TEST(AccessCoalescer, KeepsThreadsAndVariablesApart) {
+    std::vector<WatchEvent> received;
+    EventWriter writer(std::make_unique<RecordingSink>(received), QueuePolicy::Block, 64);
+    AccessCoalescer coalescer(0, 0);
+
+    WatchEvent other = access(0x100, 2000, 1, 2);
+    other.tid = 11;
+    WatchEvent second = access(0x100, 3000, 1, 2);
+    second.varIndex = 1;
+    coalescer.add(access(0x100, 1000, 1, 2), writer);
+    coalescer.add(other, writer);
+    coalescer.add(second, writer);
+    coalescer.add(access(0x100, 4000, 2, 3), writer);
+    EXPECT_EQ(coalescer.size(), 3u);
+    coalescer.flush(writer);
+    writer.close();
+
+    ASSERT_EQ(received.size(), 3u);
+    EXPECT_EQ(received[0].count, 2u);
+    EXPECT_EQ(received[1].tid, 11);
+    EXPECT_EQ(received[2].varIndex, 1);
+}
+
+TEST(AccessCoalescer, PrintsRunsWithCountAndDuration) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    {
+        TextEventSink sink({"alpha"}, fds[1]);
+        WatchEvent events[2]{};
+        events[0] = {.oldValue = 0, .newValue = 100000, .ip = 0x4011b7, .time = 5, .duration = 4'125'466'000, .tid = 10,
+                     .varIndex = 0, .kind = EventKind::Write, .count = 100000};
+        events[1] = {.ip = 0x4011ac, .time = 5, .duration = 1500, .tid = 10, .varIndex = 0, .kind = EventKind::Access,
+                     .count = 2};
+        sink.consume(events);
+        sink.flush();
+    }
+    close(fds[1]);
+    std::string output;
+    char buf[512];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+        output.append(buf, static_cast<size_t>(n));
+    close(fds[0]);
+
+    EXPECT_EQ(output,
+              "alpha    write    0 -> 100000    tid=10    count=100000    ip=0x4011b7    duration=4125466us\n"
+              "alpha    access    ip=0x4011ac    tid=10    time=5    count=2    duration=1us\n");
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include "access_profile.hpp"
+
+#include <sstream>
+
+TEST(AccessProfile, CountsPerIpAndVariable) {
+    AccessProfile profile;
+    for (int i = 0; i < 5; ++i)
+        profile.record(0x1010, 0, true);
+    profile.record(0x1010, 1, false);
+    profile.record(0x2020, 0, false);
+    profile.record(0x2020, 0, false);
+
+    EXPECT_EQ(profile.size(), 3u);
+    const auto top = profile.top(2);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].ip, 0x1010u);
+    EXPECT_EQ(top[0].varIndex, 0);
+    EXPECT_EQ(top[0].writes, 5u);
+    EXPECT_EQ(top[0].reads, 0u);
+    EXPECT_EQ(top[1].ip, 0x2020u);
+    EXPECT_EQ(top[1].reads, 2u);
+}
+
+TEST(AccessProfile, GrowsPastInitialCapacity) {
+    AccessProfile profile(16);
+    for (uint64_t ip = 1; ip <= 10000; ++ip)
+        profile.record(ip * 4, 0, ip % 2 == 0);
+    profile.record(4 * 777, 0, true);
+
+    EXPECT_EQ(profile.size(), 10000u);
+    const auto top = profile.top(1);
+    ASSERT_EQ(top.size(), 1u);
+    EXPECT_EQ(top[0].ip, 4u * 777);
+    EXPECT_EQ(top[0].total(), 2u);
+}
+
+TEST(AccessProfile, PrintsFunctionPlusOffset) {
+    const std::vector<FunctionSymbol> functions{ { 0x1000, 0x40, "worker" }, { 0x1100, 0x10, "main" } };
+    AccessProfile profile;
+    profile.record(0x5555000 + 0x1013, 0, true);
+    profile.record(0x5555000 + 0x2000, 0, false);
+
+    std::ostringstream out;
+    printProfile(out, profile.top(10), { "counter" }, functions, 0x5555000);
+    const std::string table = out.str();
+
+    EXPECT_NE(table.find("location"), std::string::npos);
+    EXPECT_NE(table.find("worker+0x13  counter"), std::string::npos);
+    EXPECT_NE(table.find("0x2000"), std::string::npos);
+}
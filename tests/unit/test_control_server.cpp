@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "control_server.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+/** Connects to a control socket, sends one command and returns the reply up to its last line. */
+std::string request(const std::string& path, const std::string& line) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1) {
+        close(fd);
+        return "connect failed";
+    }
+    const std::string text = line + "\n";
+    EXPECT_EQ(write(fd, text.data(), text.size()), static_cast<ssize_t>(text.size()));
+
+    std::string reply;
+    char data[256];
+    while (reply.find("ok\n") == std::string::npos && reply.find("error") == std::string::npos) {
+        const ssize_t n = read(fd, data, sizeof(data));
+        if (n <= 0)
+            break;
+        reply.append(data, static_cast<size_t>(n));
+    }
+    close(fd);
+    return reply;
+}
+
+std::string socketPath(const char* name) {
+    return (std::filesystem::temp_directory_path() / (std::string(name) + "-" + std::to_string(getpid()))).string();
+}
+
+}
+
+TEST(ControlServer, ParsesCommands) {
+    EXPECT_EQ(parseControlCommand("list").kind, ControlCommand::Kind::List);
+    EXPECT_EQ(parseControlCommand("  stats ").kind, ControlCommand::Kind::Stats);
+    EXPECT_EQ(parseControlCommand("pause").kind, ControlCommand::Kind::Pause);
+    EXPECT_EQ(parseControlCommand("resume").kind, ControlCommand::Kind::Resume);
+
+    const ControlCommand add = parseControlCommand("add --mode=write counter");
+    EXPECT_EQ(add.kind, ControlCommand::Kind::Add);
+    EXPECT_EQ(add.symbol, "counter");
+    EXPECT_EQ(add.mode, WatchMode::Write);
+    EXPECT_EQ(parseControlCommand("add counter").mode, WatchMode::ReadWrite);
+
+    const ControlCommand remove = parseControlCommand("remove counter");
+    EXPECT_EQ(remove.kind, ControlCommand::Kind::Remove);
+    EXPECT_EQ(remove.symbol, "counter");
+
+    EXPECT_THROW(parseControlCommand(""), std::invalid_argument);
+    EXPECT_THROW(parseControlCommand("list all"), std::invalid_argument);
+    EXPECT_THROW(parseControlCommand("add"), std::invalid_argument);
+    EXPECT_THROW(parseControlCommand("add --mode=fast counter"), std::invalid_argument);
+    EXPECT_THROW(parseControlCommand("remove a b"), std::invalid_argument);
+    EXPECT_THROW(parseControlCommand("frobnicate"), std::invalid_argument);
+}
+
+TEST(ControlServer, HandsCommandsToTheTracerThread) {
+    const std::string path = socketPath("gwatch-control-test");
+    {
+        ControlServer server(path, pthread_self());
+        std::string reply;
+        std::thread client([&] { reply = request(path, "stats"); });
+
+        // The tracer side: poll between "stops" as the backend does.
+        std::string line;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!server.take(line) && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        EXPECT_EQ(line, "stats");
+        EXPECT_FALSE(server.pending());
+        server.answer("stops=1\nok\n");
+        client.join();
+        EXPECT_EQ(reply, "stops=1\nok\n");
+    }
+    // The socket goes away with the server.
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST(ControlServer, FailsCommandsWhenTheTracerStops) {
+    const std::string path = socketPath("gwatch-control-stop");
+    std::string reply;
+    std::thread client;
+    {
+        ControlServer server(path, pthread_self());
+        client = std::thread([&] { reply = request(path, "list"); });
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!server.pending() && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        EXPECT_TRUE(server.pending());
+    }
+    client.join();
+    EXPECT_EQ(reply, "error: the tracer has stopped\n");
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "debug_registers.hpp"
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+TEST(DebugRegisters, LenCodes) {
+    EXPECT_EQ(drLenCode(1), 0b00);
+    EXPECT_EQ(drLenCode(2), 0b01);
+    EXPECT_EQ(drLenCode(4), 0b11);
+    EXPECT_EQ(drLenCode(8), 0b10);
+    EXPECT_EQ(drLenCode(3), -1);
+}
+
+TEST(DebugRegisters, AllocatesSlotsInOrder) {
+    DebugRegisterState state;
+    EXPECT_EQ(state.allocate(0x1000, 8), 0);
+    EXPECT_EQ(state.allocate(0x2004, 4), 1);
+    EXPECT_EQ(state.allocate(0x3002, 2), 2);
+    EXPECT_EQ(state.allocate(0x4001, 1), 3);
+    EXPECT_EQ(state.freeSlots(), 0);
+    EXPECT_THROW(state.allocate(0x5000, 8), std::runtime_error);
+
+    // L0..L3 enabled, RW=11 for every slot, LEN=10/11/01/00
+    EXPECT_EQ(state.control(), 0x37FB0055UL);
+    EXPECT_EQ(state.address(2), 0x3002UL);
+}
+
+TEST(DebugRegisters, EncodesWatchModes) {
+    EXPECT_EQ(drRwCode(WatchMode::Execute), 0b00UL);
+    EXPECT_EQ(drRwCode(WatchMode::Write), 0b01UL);
+    EXPECT_EQ(drRwCode(WatchMode::ReadWrite), 0b11UL);
+
+    DebugRegisterState state;
+    EXPECT_EQ(state.allocate(0x1000, 8, WatchMode::Write), 0);
+    // Execute slots always use LEN=00, whatever the symbol size
+    EXPECT_EQ(state.allocate(0x401123, 64, WatchMode::Execute), 1);
+    // L0, L1; slot 0: RW=01 LEN=10, slot 1: RW=00 LEN=00
+    EXPECT_EQ(state.control(), 0x00090005UL);
+}
+
+TEST(DebugRegisters, ReleasedSlotIsReused) {
+    DebugRegisterState state;
+    state.allocate(0x1000, 8);
+    state.allocate(0x2000, 8);
+    state.release(0);
+    EXPECT_FALSE(state.isUsed(0));
+    EXPECT_TRUE(state.isUsed(1));
+    EXPECT_EQ(state.allocate(0x3000, 4), 0);
+}
+
+TEST(DebugRegisters, AssignsAGivenSlot) {
+    DebugRegisterState state;
+    state.assign(2, 0x1000, 4, WatchMode::Write);
+    EXPECT_FALSE(state.isUsed(0));
+    EXPECT_TRUE(state.isUsed(2));
+    EXPECT_EQ(state.address(2), 0x1000u);
+    EXPECT_EQ(state.allocate(0x2000, 8), 0);
+
+    // Reprogramming an allocated slot replaces its RW and LEN fields.
+    state.assign(2, 0x3000, 8, WatchMode::ReadWrite);
+    EXPECT_EQ(state.control() >> 24 & 0xF, 0b1011u);
+    EXPECT_THROW(state.assign(1, 0x1002, 4, WatchMode::Write), std::runtime_error);
+}
+
+TEST(DebugRegisters, RejectsUnalignedAndOddSizes) {
+    DebugRegisterState state;
+    EXPECT_THROW(state.allocate(0x1004, 8), std::runtime_error);
+    EXPECT_THROW(state.allocate(0x1000, 16), std::runtime_error);
+    EXPECT_EQ(state.freeSlots(), DEBUG_SLOT_COUNT);
+}
+
+TEST(DebugRegisters, DecodesEverySlotThatFired) {
+    std::array<int, DEBUG_SLOT_COUNT> slots{};
+    EXPECT_EQ(decodeDr6(0xFFFF0FF0UL, slots), 0);
+    ASSERT_EQ(decodeDr6(0xFFFF0FF5UL, slots), 2);
+    EXPECT_EQ(slots[0], 0);
+    EXPECT_EQ(slots[1], 2);
+    ASSERT_EQ(decodeDr6(0xFUL, slots), 4);
+    EXPECT_EQ(slots[3], 3);
+}
+
+TEST(DebugRegisters, PlansFewestAlignedChunks) {
+    // 8-aligned 24 bytes: three 8-byte slots
+    const std::vector<WatchChunk> aligned = planChunks(0x1000, 24);
+    ASSERT_EQ(aligned.size(), 3u);
+    EXPECT_EQ(aligned[2].address, 0x1010u);
+    EXPECT_EQ(aligned[2].size, 8u);
+
+    // 0x1003..0x100e: 1 @3, 4 @4, 4 @8, 2 @c, 1 @e
+    const std::vector<WatchChunk> odd = planChunks(0x1003, 12);
+    ASSERT_EQ(odd.size(), 5u);
+    const std::pair<uintptr_t, size_t> expected[] = { { 0x1003, 1 }, { 0x1004, 4 }, { 0x1008, 4 }, { 0x100c, 2 }, { 0x100e, 1 } };
+    for (size_t i = 0; i < odd.size(); ++i) {
+        EXPECT_EQ(odd[i].address, expected[i].first) << i;
+        EXPECT_EQ(odd[i].size, expected[i].second) << i;
+    }
+
+    EXPECT_TRUE(planChunks(0x1000, 0).empty());
+}
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <cerrno>
+#include <stdexcept>
+#include <vector>
 
 class DebuggerTest : public ::testing::Test {
 protected:
@@ -26,3 +28,69 @@ TEST_F(DebuggerTest, ConstructorInitializesMembers) {
     EXPECT_EQ(dbg->getSymbolOffset(), 0x1234);
     EXPECT_EQ(dbg->getVarSize(), 8);
 }
+
+static WatchedVariable rangeVariable(const std::string& name, uintptr_t offset, size_t size) {
+    WatchedVariable var{ name, offset, size };
+    var.range = true;
+    return var;
+}
+
+TEST(ExpandRanges, SplitsRangesThatFitIntoDebugRegisters) {
+    const std::vector<WatchedVariable> vars = { WatchedVariable{ "counter", 0x4000, 8 }, rangeVariable("header", 0x4010, 20) };
+    const std::vector<WatchedVariable> expanded = expandRanges(vars, BackendKind::Ptrace);
+
+    ASSERT_EQ(expanded.size(), 4u);
+    EXPECT_EQ(expanded[0].name, "counter");
+    EXPECT_EQ(expanded[1].name, "header");
+    EXPECT_EQ(expanded[2].name, "header+8");
+    EXPECT_EQ(expanded[3].name, "header+16");
+    EXPECT_EQ(expanded[3].symbolOffset, 0x4020u);
+    EXPECT_EQ(expanded[3].size, 4u);
+    for (const auto& var : expanded) {
+        EXPECT_FALSE(var.range);
+        EXPECT_FALSE(var.guarded);
+    }
+}
+
+TEST(ExpandRanges, GuardsRangesThatDoNotFit) {
+    const std::vector<WatchedVariable> vars = { rangeVariable("small", 0x4000, 16), rangeVariable("buffer", 0x5000, 4096),
+                                                WatchedVariable{ "counter", 0x4010, 4 } };
+    const std::vector<WatchedVariable> expanded = expandRanges(vars, BackendKind::Ptrace);
+
+    // counter takes a slot first; small still fits in two of the remaining three.
+    ASSERT_EQ(expanded.size(), 2u + 512u + 1u);
+    EXPECT_FALSE(expanded[0].guarded);
+    EXPECT_FALSE(expanded[1].guarded);
+    EXPECT_TRUE(expanded[2].guarded);
+    EXPECT_TRUE(expanded[513].guarded);
+    EXPECT_EQ(expanded[513].name, "buffer+4088");
+    EXPECT_FALSE(expanded[514].guarded);
+
+    // The debugger only counts debug register slots against the limit.
+    EXPECT_NO_THROW(Debugger("/bin/ls", vars, nullptr));
+}
+
+TEST(ExpandRanges, PerfBackendCannotGuardPages) {
+    const std::vector<WatchedVariable> vars = { rangeVariable("buffer", 0x5000, 64) };
+    EXPECT_THROW(expandRanges(vars, BackendKind::Perf), std::invalid_argument);
+    EXPECT_EQ(expandRanges({ rangeVariable("pair", 0x5000, 16) }, BackendKind::Perf).size(), 2u);
+}
+
+TEST(ExpandRanges, RejectsEmptyRanges) {
+    // A symbol without a size would otherwise have no chunks and be dropped silently.
+    const std::vector<WatchedVariable> vars = { WatchedVariable{ "counter", 0x4000, 8 }, rangeVariable("marker", 0x4010, 0) };
+    try {
+        (void)expandRanges(vars, BackendKind::Ptrace);
+        FAIL() << "an empty range was accepted";
+    } catch (const std::invalid_argument& e) {
+        EXPECT_NE(std::string(e.what()).find("'marker'"), std::string::npos) << e.what();
+    }
+}
+
+TEST(DebuggerThreadLocals, NeedThePtraceBackend) {
+    WatchedVariable counter{ "tls_counter", 0x10, 8 };
+    counter.tls = true;
+    counter.tpOffset = -8;
+    EXPECT_THROW(Debugger("/bin/ls", { counter }, nullptr, BackendKind::Perf), std::invalid_argument);
+    EXPECT_NO_THROW(Debugger("/bin/ls", { counter }, nullptr, BackendKind::Ptrace));
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "duty_cycle.hpp"
+#include "event_writer.hpp"
+
+#include <unistd.h>
+
+#include <string>
+
+TEST(DutyCycle, StaysArmedWithinTheBudget) {
+    DutyCycle cycle(0.01, 0);
+    EXPECT_TRUE(cycle.armed());
+    EXPECT_EQ(cycle.nextChange(), DutyCycle::WINDOW);
+
+    // 50µs stopped in a 10ms window is 0.5%, below the 1% budget.
+    cycle.charge(50'000);
+    EXPECT_FALSE(cycle.update(DutyCycle::WINDOW - 1));
+    EXPECT_FALSE(cycle.update(DutyCycle::WINDOW));
+    EXPECT_TRUE(cycle.armed());
+    EXPECT_FLOAT_EQ(cycle.ratio(), 1.0f);
+    EXPECT_EQ(cycle.nextChange(), 2 * DutyCycle::WINDOW);
+    EXPECT_DOUBLE_EQ(cycle.armedShare(DutyCycle::WINDOW), 1.0);
+}
+
+TEST(DutyCycle, PausesUntilTheCycleMeetsTheBudget) {
+    DutyCycle cycle(0.01, 0);
+
+    // 1ms stopped at a 1% budget needs a 100ms cycle: 90ms off after the 10ms window.
+    cycle.charge(1'000'000);
+    EXPECT_TRUE(cycle.update(DutyCycle::WINDOW));
+    EXPECT_FALSE(cycle.armed());
+    EXPECT_EQ(cycle.nextChange(), 100'000'000u);
+    EXPECT_FALSE(cycle.update(50'000'000));
+    EXPECT_EQ(cycle.pausedFor(50'000'000), 40'000'000u);
+
+    EXPECT_TRUE(cycle.update(100'000'000));
+    EXPECT_TRUE(cycle.armed());
+    EXPECT_EQ(cycle.pausedFor(100'000'000), 0u);
+    EXPECT_FLOAT_EQ(cycle.ratio(), 0.1f);
+    EXPECT_EQ(cycle.nextChange(), 110'000'000u);
+    EXPECT_DOUBLE_EQ(cycle.overhead(100'000'000), 0.01);
+    EXPECT_DOUBLE_EQ(cycle.armedShare(100'000'000), 0.1);
+
+    // A quiet window afterwards is not scaled any more.
+    EXPECT_FALSE(cycle.update(110'000'000));
+    EXPECT_FLOAT_EQ(cycle.ratio(), 1.0f);
+}
+
+TEST(DutyCycle, PrintsTheSamplingRatio) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    {
+        TextEventSink sink({"alpha"}, fds[1]);
+        WatchEvent events[2]{};
+        events[0] = {.oldValue = 1, .newValue = 2, .tid = 10, .varIndex = 0, .kind = EventKind::Write,
+                     .sampleRatio = 0.125f};
+        events[1] = {.oldValue = 2, .newValue = 3, .tid = 10, .varIndex = 0, .kind = EventKind::Write};
+        sink.consume(events);
+        sink.flush();
+    }
+    close(fds[1]);
+    std::string output;
+    char buf[512];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+        output.append(buf, static_cast<size_t>(n));
+    close(fds[0]);
+
+    EXPECT_EQ(output,
+              "alpha    write    1 -> 2    tid=10    sampled=12.5%\n"
+              "alpha    write    2 -> 3    tid=10\n");
+}
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "dwarf_info.hpp"
+
+using namespace std;
+
+// Helper: compile one or more C files into one binary; each source becomes its own unit.
+static string buildDwarfBinary(const string& name, const vector<string>& sources, const string& flags = "-g") {
+    string cmd = "gcc -O0 " + flags + " -o /tmp/" + name;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const string srcFile = "/tmp/" + name + "_" + to_string(i) + ".c";
+        ofstream out(srcFile);
+        out << sources[i];
+        out.close();
+        cmd += " " + srcFile;
+    }
+
+    if (system(cmd.c_str()) != 0)
+        throw runtime_error("Failed to compile test ELF binary");
+    return "/tmp/" + name;
+}
+
+static const char* const LAYOUT_SOURCE = R"(
+    #include <stdbool.h>
+
+    enum State { IDLE, RUNNING = 2, STOPPED = -1 };
+    typedef struct { short min_conns; int max_conns; } Limits;
+    struct Config {
+        char tag;
+        Limits limits;
+        const volatile long counters[4];
+        struct { unsigned char low, high; } pair[2][3];
+        union { float ratio; unsigned raw; };
+        unsigned flags : 3;
+        int* next;
+    };
+
+    struct Config config;
+    int table[32];
+    double weight;
+    bool ready;
+    enum State state;
+    signed char delta;
+
+    int main() { return config.tag + table[0] + ready + state + delta; }
+)";
+
+// ---------------------------------------------------------------------------
+// Test suite for DwarfInfo::resolve()
+// ---------------------------------------------------------------------------
+
+class DwarfInfoLayout : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        exe = buildDwarfBinary("dwarf_test_layout", { LAYOUT_SOURCE });
+    }
+
+    DwarfLocation resolve(const string& expression) {
+        DwarfInfo info(exe);
+        DwarfLocation location;
+        EXPECT_TRUE(info.resolve(expression, location)) << expression;
+        return location;
+    }
+
+    static string exe;
+};
+
+string DwarfInfoLayout::exe;
+
+TEST_F(DwarfInfoLayout, ResolvesNestedStructField) {
+    const DwarfLocation field = resolve("config.limits.max_conns");
+    EXPECT_EQ(field.symbol, "config");
+    EXPECT_EQ(field.offset, 8u);
+    EXPECT_EQ(field.size, 4u);
+    ASSERT_NE(field.type, nullptr);
+    EXPECT_EQ(field.type->kind, ValueType::Kind::Signed);
+}
+
+TEST_F(DwarfInfoLayout, ResolvesArrayElements) {
+    const DwarfLocation element = resolve("table[17]");
+    EXPECT_EQ(element.offset, 17u * sizeof(int));
+    EXPECT_EQ(element.size, sizeof(int));
+
+    // Qualified element type, hexadecimal index.
+    const DwarfLocation counter = resolve("config.counters[0x2]");
+    EXPECT_EQ(counter.offset, 16u + 2 * sizeof(long));
+    EXPECT_EQ(counter.size, sizeof(long));
+
+    // Multi-dimensional array of anonymous structs.
+    const DwarfLocation high = resolve("config.pair[1][2].high");
+    EXPECT_EQ(high.offset, 48u + 3 * 2 + 2 * 2 + 1);
+    EXPECT_EQ(high.size, 1u);
+    ASSERT_NE(high.type, nullptr);
+    EXPECT_EQ(high.type->kind, ValueType::Kind::Unsigned);
+
+    // A partially indexed array is an aggregate: it has a size but no scalar type.
+    const DwarfLocation row = resolve("config.pair[1]");
+    EXPECT_EQ(row.offset, 48u + 3 * 2);
+    EXPECT_EQ(row.size, 6u);
+    EXPECT_EQ(row.type, nullptr);
+}
+
+TEST_F(DwarfInfoLayout, ResolvesAnonymousUnionMembers) {
+    const DwarfLocation ratio = resolve("config.ratio");
+    EXPECT_EQ(ratio.offset, 60u);
+    ASSERT_NE(ratio.type, nullptr);
+    EXPECT_EQ(ratio.type->kind, ValueType::Kind::Float);
+
+    const DwarfLocation raw = resolve("config.raw");
+    EXPECT_EQ(raw.offset, 60u);
+    EXPECT_EQ(raw.type->kind, ValueType::Kind::Unsigned);
+
+    const DwarfLocation next = resolve("config.next");
+    EXPECT_EQ(next.offset, 72u);
+    EXPECT_EQ(next.type->kind, ValueType::Kind::Pointer);
+}
+
+TEST_F(DwarfInfoLayout, ReportsScalarTypes) {
+    EXPECT_EQ(resolve("weight").type->kind, ValueType::Kind::Float);
+    EXPECT_EQ(resolve("weight").size, sizeof(double));
+    EXPECT_EQ(resolve("ready").type->kind, ValueType::Kind::Bool);
+    EXPECT_EQ(resolve("delta").type->kind, ValueType::Kind::Signed);
+    EXPECT_EQ(resolve("config").type, nullptr);
+
+    const DwarfLocation state = resolve("state");
+    ASSERT_NE(state.type, nullptr);
+    EXPECT_EQ(state.type->kind, ValueType::Kind::Enum);
+    ASSERT_EQ(state.type->enumerators.size(), 3u);
+    EXPECT_EQ(state.type->enumerators[1], (pair<uint64_t, string>{ 2, "RUNNING" }));
+    // Negative enumerators are truncated to the enum's size, like the values read from memory.
+    EXPECT_EQ(state.type->enumerators[2].first, 0xFFFFFFFFu);
+}
+
+TEST_F(DwarfInfoLayout, RejectsInvalidPaths) {
+    DwarfInfo info(exe);
+    DwarfLocation location;
+    EXPECT_THROW(info.resolve("config.limits.missing", location), invalid_argument);
+    EXPECT_THROW(info.resolve("table[32]", location), invalid_argument);
+    EXPECT_THROW(info.resolve("config.flags", location), invalid_argument);
+    EXPECT_THROW(info.resolve("config.next[0]", location), invalid_argument);
+    EXPECT_THROW(info.resolve("config.tag.x", location), invalid_argument);
+    EXPECT_THROW(info.resolve("table[", location), invalid_argument);
+    EXPECT_THROW(info.resolve("config..tag", location), invalid_argument);
+    EXPECT_FALSE(info.resolve("not_a_variable.field", location));
+}
+
+TEST(DwarfInfo, ResolvesDwarf4) {
+    const string exe = buildDwarfBinary("dwarf_test_v4", { LAYOUT_SOURCE }, "-gdwarf-4");
+    DwarfInfo info(exe);
+    DwarfLocation location;
+    ASSERT_TRUE(info.resolve("config.pair[1][2].high", location));
+    EXPECT_EQ(location.offset, 48u + 3 * 2 + 2 * 2 + 1);
+    ASSERT_TRUE(info.resolve("config.limits.max_conns", location));
+    EXPECT_EQ(location.offset, 8u);
+}
+
+TEST(DwarfInfo, ParsesOnlyTheDefiningUnitWithNameIndex) {
+    const vector<string> sources = {
+        "int first_var; int main() { return 0; }",
+        "struct Pair { int a, b; } second_var;",
+        "long third_var[4];",
+    };
+    const string exe = buildDwarfBinary("dwarf_test_units", sources, "-g -gpubnames");
+
+    DwarfInfo info(exe);
+    ASSERT_GE(info.unitCount(), 3u);
+    EXPECT_EQ(info.parsedUnits(), 0u);
+
+    DwarfLocation location;
+    ASSERT_TRUE(info.resolve("third_var[3]", location));
+    EXPECT_EQ(location.offset, 3 * sizeof(long));
+    EXPECT_EQ(info.parsedUnits(), 1u);
+
+    ASSERT_TRUE(info.resolve("second_var.b", location));
+    EXPECT_EQ(location.offset, sizeof(int));
+    EXPECT_EQ(info.parsedUnits(), 2u);
+}
+
+TEST(DwarfInfo, StopsScanningAtTheDefiningUnitWithoutNameIndex) {
+    const vector<string> sources = {
+        "int first_var; int main() { return 0; }",
+        "int second_var;",
+        "int third_var;",
+    };
+    const string exe = buildDwarfBinary("dwarf_test_scan", sources);
+
+    DwarfInfo info(exe);
+    DwarfLocation location;
+    ASSERT_TRUE(info.resolve("first_var", location));
+    EXPECT_LT(info.parsedUnits(), info.unitCount());
+}
+
+TEST(DwarfInfo, HandlesBinariesWithoutDebugInfo) {
+    const string exe = buildDwarfBinary("dwarf_test_nodebug", { "int plain_var; int main() { return 0; }" }, "-g0");
+    DwarfInfo info(exe);
+    EXPECT_FALSE(info.hasDebugInfo());
+    DwarfLocation location;
+    EXPECT_FALSE(info.resolve("plain_var", location));
+}
+
+TEST(DwarfInfo, SplitsVariablePaths) {
+    EXPECT_EQ(variableOfPath("config.limits.max_conns"), "config");
+    EXPECT_EQ(variableOfPath("table[17]"), "table");
+    EXPECT_EQ(variableOfPath("plain"), "plain");
+    EXPECT_TRUE(isVariablePath("table[17]"));
+    EXPECT_FALSE(isVariablePath("plain"));
+}
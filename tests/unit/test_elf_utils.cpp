@@ -6,11 +6,12 @@
 
 #include "elf_utils.hpp"
 #include "memory_utils.hpp"
+#include "symbol_index.hpp"
 
 using namespace std;
 
 // Helper: build a minimal C file and compile it to an ELF binary for testing
-static string buildTestBinary(const string& name, const string& sourceCode) {
+static string buildTestBinary(const string& name, const string& sourceCode, const string& flags = "-no-pie") {
     string srcFile = "/tmp/" + name + ".c";
     string exeFile = "/tmp/" + name;
 
@@ -18,7 +19,7 @@ static string buildTestBinary(const string& name, const string& sourceCode) {
     out << sourceCode;
     out.close();
 
-    string cmd = "gcc -g -O0 -no-pie -o " + exeFile + " " + srcFile;
+    string cmd = "gcc -g -O0 " + flags + " -o " + exeFile + " " + srcFile;
     int ret = system(cmd.c_str());
     if (ret != 0)
         throw runtime_error("Failed to compile test ELF binary");
@@ -71,3 +72,179 @@ TEST(ELFUtils, FindsFunctionSymbol) {
     EXPECT_GT(size, 0);
 }
 
+TEST(ELFUtils, ReadsEntryPoint) {
+    string exe = buildTestBinary("elf_test_entry", R"(
+        int main() { return 0; }
+    )");
+
+    uintptr_t entry = 0;
+    ASSERT_TRUE(getEntryPoint(exe, entry));
+    // -no-pie binaries are linked at 0x400000
+    EXPECT_GT(entry, 0x400000u);
+}
+
+TEST(ELFUtils, EntryPointFailsOnNonElf) {
+    uintptr_t entry = 0;
+    EXPECT_FALSE(getEntryPoint("/proc/self/status", entry));
+}
+
+TEST(ELFUtils, ResolvesAddressesToFunctions) {
+    string exe = buildTestBinary("elf_test_functions", R"(
+        int helper(int x) { return x * 2; }
+        int main() { return helper(3); }
+    )");
+
+    uintptr_t helperAddr = 0;
+    size_t helperSize = 0;
+    ASSERT_TRUE(findSymbolAddress(exe, "helper", helperAddr, helperSize));
+
+    vector<FunctionSymbol> functions;
+    ASSERT_TRUE(readFunctionSymbols(exe, functions));
+    EXPECT_EQ(describeAddress(functions, helperAddr), "helper+0x0");
+    EXPECT_EQ(describeAddress(functions, helperAddr + 4), "helper+0x4");
+    EXPECT_EQ(describeAddress(functions, 0x10), "0x10");
+}
+
+// ---------------------------------------------------------------------------
+// Test suite for the symbol index
+// ---------------------------------------------------------------------------
+
+static const char* const INDEX_TEST_SOURCE = R"(
+    int exported_var = 1;
+    static int local_var = 2;
+    long other_var = 3;
+    int main() { return exported_var + local_var + (int)other_var; }
+)";
+
+// Points the symbol index cache at a fresh directory while alive, then removes it and restores
+// GWATCH_CACHE_DIR, so no test writes into the user's real cache even when an assertion bails out.
+class ScopedCacheDir {
+public:
+    explicit ScopedCacheDir(string dir) : dir(std::move(dir)) {
+        if (const char* previous = getenv("GWATCH_CACHE_DIR"))
+            saved = previous;
+        filesystem::remove_all(this->dir);
+        setenv("GWATCH_CACHE_DIR", this->dir.c_str(), 1);
+    }
+    ~ScopedCacheDir() {
+        if (saved.empty())
+            unsetenv("GWATCH_CACHE_DIR");
+        else
+            setenv("GWATCH_CACHE_DIR", saved.c_str(), 1);
+        error_code ignored;
+        filesystem::remove_all(dir, ignored);
+    }
+    ScopedCacheDir(const ScopedCacheDir&) = delete;
+    ScopedCacheDir& operator=(const ScopedCacheDir&) = delete;
+
+private:
+    string dir;
+    string saved;
+};
+
+TEST(ELFUtils, ResolvesSeveralSymbolsAtOnce) {
+    string exe = buildTestBinary("elf_test_batch", INDEX_TEST_SOURCE);
+    const ScopedCacheDir cache("/tmp/gwatch_test_cache_batch");
+
+    vector<SymbolLookup> lookups{ { "exported_var" }, { "local_var" }, { "other_var" }, { "missing_var" } };
+    ASSERT_TRUE(findSymbolAddresses(exe, lookups));
+
+    EXPECT_TRUE(lookups[0].found);
+    EXPECT_EQ(lookups[0].size, 4u);
+    EXPECT_TRUE(lookups[1].found);
+    EXPECT_TRUE(lookups[2].found);
+    EXPECT_EQ(lookups[2].size, 8u);
+    EXPECT_FALSE(lookups[3].found);
+
+    uintptr_t addr = 0;
+    size_t size = 0;
+    ASSERT_TRUE(findSymbolAddress(exe, "other_var", addr, size));
+    EXPECT_EQ(addr, lookups[2].address);
+}
+
+TEST(ELFUtils, FindsExportedSymbolsThroughGnuHash) {
+    string exe = buildTestBinary("elf_test_gnuhash", INDEX_TEST_SOURCE, "-rdynamic -Wl,--hash-style=gnu");
+    const ElfImage image(exe);
+    const DynamicSymbolTable dynamic(image);
+    ASSERT_TRUE(dynamic.hashed());
+
+    Elf64_Sym symbol{};
+    ASSERT_TRUE(dynamic.find("exported_var", symbol));
+    EXPECT_EQ(symbol.st_size, 4u);
+    // Static symbols are never exported
+    EXPECT_FALSE(dynamic.find("local_var", symbol));
+    EXPECT_FALSE(dynamic.find("missing_var", symbol));
+}
+
+TEST(ELFUtils, FindsExportedSymbolsThroughSysvHash) {
+    string exe = buildTestBinary("elf_test_sysvhash", INDEX_TEST_SOURCE, "-rdynamic -Wl,--hash-style=sysv");
+    const ElfImage image(exe);
+    const DynamicSymbolTable dynamic(image);
+    ASSERT_TRUE(dynamic.hashed());
+
+    Elf64_Sym symbol{};
+    ASSERT_TRUE(dynamic.find("other_var", symbol));
+    EXPECT_EQ(symbol.st_size, 8u);
+    EXPECT_FALSE(dynamic.find("missing_var", symbol));
+}
+
+TEST(ELFUtils, CachesSymbolIndexByBuildId) {
+    string exe = buildTestBinary("elf_test_cache", INDEX_TEST_SOURCE, "-no-pie -Wl,--build-id");
+    const string cacheDir = "/tmp/gwatch_test_cache";
+    const ScopedCacheDir cache(cacheDir);
+
+    const string buildId = ElfImage(exe).buildId();
+    ASSERT_FALSE(buildId.empty());
+    const string cachePath = cacheDir + "/" + buildId + ".symidx";
+
+    vector<SymbolLookup> first{ { "local_var" } };
+    ASSERT_TRUE(findSymbolAddresses(exe, first));
+    ASSERT_TRUE(filesystem::exists(cachePath));
+
+    vector<SymbolLookup> second{ { "local_var" } };
+    ASSERT_TRUE(findSymbolAddresses(exe, second));
+    EXPECT_TRUE(second[0].found);
+    EXPECT_EQ(second[0].address, first[0].address);
+
+    SymbolIndex cached;
+    ASSERT_TRUE(cached.load(cachePath));
+    uintptr_t addr = 0;
+    size_t size = 0;
+    unsigned type = 0;
+    ASSERT_TRUE(cached.find("local_var", addr, size, type));
+    EXPECT_EQ(addr, first[0].address);
+    EXPECT_EQ(type, static_cast<unsigned>(STT_OBJECT));
+    EXPECT_FALSE(cached.find("missing_var", addr, size, type));
+}
+
+TEST(ELFUtils, RejectsCorruptSymbolCache) {
+    const string path = "/tmp/gwatch_test_corrupt.symidx";
+    ofstream(path) << "GWSYMIX1 not really an index";
+    SymbolIndex index;
+    EXPECT_FALSE(index.load(path));
+}
+
+TEST(ELFUtils, FlagsThreadLocalSymbolsAndFindsTheirBlock) {
+    const string exe = buildTestBinary("elf_test_tls", R"(
+        __thread long tls_counter;
+        __thread char tls_tag[3] = { 1, 2, 3 };
+        int plain_var;
+        int main() { return tls_counter + tls_tag[0] + plain_var; }
+    )", "");
+
+    vector<SymbolLookup> lookups{ { "tls_counter" }, { "tls_tag" }, { "plain_var" } };
+    ASSERT_TRUE(findSymbolAddresses(exe, lookups));
+    ASSERT_TRUE(lookups[0].found && lookups[1].found && lookups[2].found);
+    EXPECT_TRUE(lookups[0].tls);
+    EXPECT_TRUE(lookups[1].tls);
+    EXPECT_FALSE(lookups[2].tls);
+
+    // Both variables lie inside the block, which ends 8-aligned at the thread pointer.
+    uintptr_t offset = 0;
+    ASSERT_TRUE(getTlsBlockOffset(exe, offset));
+    EXPECT_EQ(offset % 8, 0u);
+    EXPECT_LE(lookups[0].address + 8, offset);
+    EXPECT_LE(lookups[1].address + 3, offset);
+
+    EXPECT_FALSE(getTlsBlockOffset(buildTestBinary("elf_test_no_tls", "int main() { return 0; }"), offset));
+}
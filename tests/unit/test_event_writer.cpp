@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+#include "event_writer.hpp"
+#include "spsc_ring.hpp"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** Sink that records every event it receives. */
+class RecordingSink : public EventSink {
+public:
+    explicit RecordingSink(std::vector<WatchEvent>& out) : out(out) {}
+
+    void consume(std::span<const WatchEvent> events) override {
+        out.insert(out.end(), events.begin(), events.end());
+    }
+    void flush() override {}
+
+private:
+    std::vector<WatchEvent>& out;
+};
+
+/** Sink that never returns until released, so the queue fills up. */
+class StallingSink : public EventSink {
+public:
+    explicit StallingSink(std::atomic<bool>& release) : release(release) {}
+
+    void consume(std::span<const WatchEvent>) override {
+        while (!release.load())
+            std::this_thread::yield();
+    }
+    void flush() override {}
+
+private:
+    std::atomic<bool>& release;
+};
+
+std::string readAll(int fd) {
+    std::string result;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        result.append(buf, static_cast<size_t>(n));
+    return result;
+}
+
+}
+
+TEST(SpscRing, PushPopPreservesOrder) {
+    SpscRing<int> ring(4);
+    EXPECT_EQ(ring.capacity(), 4u);
+    for (int i = 0; i < 4; ++i)
+        EXPECT_TRUE(ring.tryPush(i));
+    EXPECT_FALSE(ring.tryPush(4));
+    EXPECT_EQ(ring.size(), 4u);
+
+    int out[8];
+    ASSERT_EQ(ring.popBatch(out, 8), 4u);
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(out[i], i);
+    EXPECT_EQ(ring.size(), 0u);
+}
+
+TEST(SpscRing, BlockingPushAcrossThreads) {
+    SpscRing<int> ring(8);
+    constexpr int COUNT = 100000;
+    std::thread producer([&] {
+        for (int i = 0; i < COUNT; ++i)
+            ring.push(i);
+    });
+
+    std::atomic<bool> cancel{false};
+    int expected = 0;
+    int out[16];
+    while (expected < COUNT) {
+        const size_t n = ring.popBatch(out, 16);
+        if (n == 0) {
+            ring.waitForData(cancel);
+            continue;
+        }
+        for (size_t i = 0; i < n; ++i)
+            ASSERT_EQ(out[i], expected++);
+    }
+    producer.join();
+}
+
+TEST(EventWriter, DeliversEveryEventInOrder) {
+    std::vector<WatchEvent> received;
+    {
+        EventWriter writer(std::make_unique<RecordingSink>(received), QueuePolicy::Block, 16);
+        for (uint64_t i = 0; i < 1000; ++i) {
+            WatchEvent event{};
+            event.newValue = i;
+            EXPECT_TRUE(writer.emit(event));
+        }
+        writer.close();
+        EXPECT_EQ(writer.dropped(), 0u);
+    }
+    ASSERT_EQ(received.size(), 1000u);
+    for (uint64_t i = 0; i < received.size(); ++i)
+        EXPECT_EQ(received[i].newValue, i);
+}
+
+TEST(EventWriter, DropPolicyCountsDiscardedEvents) {
+    std::atomic<bool> release{false};
+    EventWriter writer(std::make_unique<StallingSink>(release), QueuePolicy::Drop, 4);
+
+    // The writer thread takes at most one batch before stalling; afterwards the queue fills.
+    size_t accepted = 0;
+    for (int i = 0; i < 100; ++i)
+        accepted += writer.emit(WatchEvent{}) ? 1 : 0;
+
+    EXPECT_GT(writer.dropped(), 0u);
+    EXPECT_EQ(accepted + writer.dropped(), 100u);
+    release = true;
+    writer.close();
+}
+
+TEST(TextEventSink, FormatsEventKinds) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    {
+        TextEventSink sink({"alpha", "beta"}, fds[1]);
+        WatchEvent events[3]{};
+        events[0] = {.oldValue = 1, .newValue = 2, .tid = 10, .varIndex = 0, .kind = EventKind::Write};
+        events[1] = {.oldValue = 7, .newValue = 7, .tid = 11, .varIndex = 1, .kind = EventKind::Read};
+        events[2] = {.ip = 0x401000, .time = 123, .tid = 12, .varIndex = 0, .kind = EventKind::Access};
+        sink.consume(events);
+        sink.flush();
+    }
+    close(fds[1]);
+    const std::string output = readAll(fds[0]);
+    close(fds[0]);
+
+    EXPECT_EQ(output,
+              "alpha    write    1 -> 2    tid=10\n"
+              "beta    read     7    tid=11\n"
+              "alpha    access    ip=0x401000    tid=12    time=123\n");
+}
+
+TEST(TextEventSink, FormatsTypedValues) {
+    const auto typeOf = [](ValueType::Kind kind, size_t size) {
+        auto type = std::make_shared<ValueType>();
+        type->kind = kind;
+        type->size = size;
+        return type;
+    };
+    auto state = typeOf(ValueType::Kind::Enum, 4);
+    state->enumerators = { { 0, "IDLE" }, { 2, "RUNNING" } };
+
+    const float ratio = 1.5f;
+    uint32_t ratioBits;
+    std::memcpy(&ratioBits, &ratio, sizeof(ratio));
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    {
+        TextEventSink sink({"delta", "ratio", "ready", "state", "next", "raw"}, fds[1],
+                           { typeOf(ValueType::Kind::Signed, 2), typeOf(ValueType::Kind::Float, 4),
+                             typeOf(ValueType::Kind::Bool, 1), state, typeOf(ValueType::Kind::Pointer, 8) });
+        WatchEvent events[6]{};
+        events[0] = {.oldValue = 5, .newValue = 0xFFFD, .tid = 1, .varIndex = 0, .kind = EventKind::Write};
+        events[1] = {.oldValue = ratioBits, .newValue = ratioBits, .tid = 1, .varIndex = 1, .kind = EventKind::Read};
+        events[2] = {.oldValue = 0, .newValue = 1, .tid = 1, .varIndex = 2, .kind = EventKind::Write};
+        events[3] = {.oldValue = 0, .newValue = 3, .tid = 1, .varIndex = 3, .kind = EventKind::Write};
+        events[4] = {.oldValue = 0, .newValue = 0x1000, .tid = 1, .varIndex = 4, .kind = EventKind::Write};
+        events[5] = {.oldValue = 0, .newValue = 0xFFFF, .tid = 1, .varIndex = 5, .kind = EventKind::Write};
+        sink.consume(events);
+        sink.flush();
+    }
+    close(fds[1]);
+    const std::string output = readAll(fds[0]);
+    close(fds[0]);
+
+    EXPECT_EQ(output,
+              "delta    write    5 -> -3    tid=1\n"
+              "ratio    read     1.5    tid=1\n"
+              "ready    write    false -> true    tid=1\n"
+              "state    write    IDLE -> 3    tid=1\n"
+              "next    write    0x0 -> 0x1000    tid=1\n"
+              "raw    write    0 -> 65535    tid=1\n");
+}
+
+TEST(TextEventSink, TagsEventsWithTheProcessWhenAsked) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    {
+        TextEventSink sink({"alpha"}, fds[1], {}, true);
+        WatchEvent events[2]{};
+        events[0] = {.oldValue = 1, .newValue = 2, .pid = 40, .tid = 41, .varIndex = 0, .kind = EventKind::Write};
+        events[1] = {.pid = 50, .tid = 50, .varIndex = 0, .kind = EventKind::Execute};
+        sink.consume(events);
+        sink.flush();
+    }
+    close(fds[1]);
+    const std::string output = readAll(fds[0]);
+    close(fds[0]);
+
+    EXPECT_EQ(output,
+              "alpha    write    1 -> 2    tid=41    pid=40\n"
+              "alpha    exec    tid=50    pid=50\n");
+}
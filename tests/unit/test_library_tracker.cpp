@@ -0,0 +1,33 @@
+#include <gtest/gtest.h>
+#include "elf_utils.hpp"
+#include "library_tracker.hpp"
+
+#include <unistd.h>
+
+TEST(LibraryTracker, MatchesRequestedLibraryNames) {
+    EXPECT_TRUE(matchesLibrary("libfoo.so", "/usr/lib/libfoo.so"));
+    EXPECT_TRUE(matchesLibrary("libfoo.so", "/usr/lib/libfoo.so.1.2"));
+    EXPECT_TRUE(matchesLibrary("/opt/app/libfoo.so", "/opt/app/libfoo.so"));
+    EXPECT_FALSE(matchesLibrary("libfoo.so", "/usr/lib/libfoobar.so"));
+    EXPECT_FALSE(matchesLibrary("libfoo.so", "/usr/lib/libfoo.so_old"));
+    EXPECT_FALSE(matchesLibrary("libfoo.so", ""));
+}
+
+TEST(LibraryTracker, ReadsOwnLinkMap) {
+    // The test binary itself is dynamically linked: its own rendezvous must be readable.
+    const LibraryTracker tracker(getpid());
+    EXPECT_NE(tracker.hookAddress(), 0u);
+
+    std::vector<LoadedObject> objects;
+    ASSERT_TRUE(tracker.loadedObjects(objects));
+    bool libc = false;
+    for (const auto& object : objects)
+        libc = libc || matchesLibrary("libc.so", object.path);
+    EXPECT_TRUE(libc);
+}
+
+TEST(LibraryTracker, FindsInterpreterOfDynamicExecutable) {
+    std::string interpreter;
+    ASSERT_TRUE(getInterpreter("/proc/self/exe", interpreter));
+    EXPECT_NE(interpreter.find("ld-"), std::string::npos);
+}
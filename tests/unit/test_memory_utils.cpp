@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
+#include "elf_utils.hpp"
 #include "memory_utils.hpp"
 
+#include <elf.h>
+#include <sys/mman.h>
 #include <sys/ptrace.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -46,4 +49,77 @@ TEST(MemoryUtils, ReadProcessMemory_Self) {
     EXPECT_EQ(value, static_cast<uint64_t>(localVar));
 
     ptrace(PTRACE_DETACH, pid, nullptr, nullptr);
-}
\ No newline at end of file
+}
+
+TEST(MemoryUtils, ReadProcessMemory_NarrowSizesDoNotLeakNeighbours) {
+    alignas(8) unsigned char bytes[8] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
+    const auto address = reinterpret_cast<uintptr_t>(bytes);
+
+    EXPECT_EQ(readProcessMemory(getpid(), address, 1), 0x11u);
+    EXPECT_EQ(readProcessMemory(getpid(), address + 2, 2), 0x4433u);
+    EXPECT_EQ(readProcessMemory(getpid(), address + 4, 4), 0x88776655u);
+    EXPECT_EQ(readProcessMemory(getpid(), address, 8), 0x8877665544332211ULL);
+}
+
+TEST(MemoryUtils, ReadProcessMemory_ArbitraryLength) {
+    std::string source(1000, 'x');
+    source[999] = 'y';
+    std::string target(1000, '\0');
+
+    readProcessMemory(getpid(), reinterpret_cast<uintptr_t>(source.data()), target.data(), source.size());
+    EXPECT_EQ(target, source);
+}
+
+TEST(MemoryUtils, ReadProcessMemory_BatchedRegions) {
+    short a = 7;
+    long long b = -3;
+    char c[3] = { 'g', 'w', 't' };
+
+    short outA = 0;
+    long long outB = 0;
+    char outC[3] = {};
+    const MemoryRegion regions[] = {
+        { reinterpret_cast<uintptr_t>(&a), sizeof(a), &outA },
+        { reinterpret_cast<uintptr_t>(&b), sizeof(b), &outB },
+        { reinterpret_cast<uintptr_t>(c), sizeof(c), outC },
+    };
+
+    readProcessMemory(getpid(), regions);
+    EXPECT_EQ(outA, a);
+    EXPECT_EQ(outB, b);
+    EXPECT_EQ(std::string(outC, 3), "gwt");
+}
+
+TEST(MemoryUtils, ReadProcessMemoryPrefix_StopsAtAnUnreadablePage) {
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    void* map = mmap(nullptr, 2 * pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(map, MAP_FAILED);
+    char* pages = static_cast<char*>(map);
+    pages[pageSize - 1] = 'z';
+    ASSERT_EQ(mprotect(pages + pageSize, pageSize, PROT_NONE), 0);
+
+    std::string target(256, '\0');
+    const auto start = reinterpret_cast<uintptr_t>(pages + pageSize - 128);
+    EXPECT_EQ(readProcessMemoryPrefix(getpid(), start, target.data(), target.size()), 128u);
+    EXPECT_EQ(target[127], 'z');
+    EXPECT_EQ(readProcessMemoryPrefix(getpid(), 0x10, target.data(), target.size()), 0u);
+    munmap(map, 2 * pageSize);
+}
+
+TEST(MemoryUtils, ReadProcessMemory_UnmappedAddressThrows) {
+    char out[4];
+    EXPECT_THROW(readProcessMemory(getpid(), 0x10, out, sizeof(out)), std::runtime_error);
+}
+
+TEST(MemoryUtils, GetLoadBias_Self) {
+    uintptr_t entry = 0;
+    ASSERT_TRUE(getEntryPoint("/proc/self/exe", entry));
+
+    const uintptr_t bias = getLoadBias(getpid(), entry);
+    EXPECT_EQ(bias % 0x1000, 0);
+    EXPECT_EQ(bias + entry, getAuxvValue(getpid(), AT_ENTRY));
+}
+
+TEST(MemoryUtils, GetAuxvValue_MissingEntryThrows) {
+    EXPECT_THROW(getAuxvValue(getpid(), 0xdead), std::runtime_error);
+}
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "predicate.hpp"
+
+#include <stdexcept>
+
+static bool eval(const char* source, int64_t oldValue, int64_t newValue, int64_t tid = 1) {
+    return Predicate::compile(source).evaluate(PredicateInput{ oldValue, newValue, tid });
+}
+
+TEST(Predicate, ComparesOldAndNew) {
+    EXPECT_TRUE(eval("new > 1000 && new != old", 5, 1001));
+    EXPECT_FALSE(eval("new > 1000 && new != old", 1001, 1001));
+    EXPECT_FALSE(eval("new > 1000 && new != old", 5, 1000));
+    EXPECT_TRUE(eval("old == 0x10 || tid == 7", 0, 0, 7));
+    EXPECT_TRUE(eval("new <= -1", 0, -5));
+}
+
+TEST(Predicate, FollowsCPrecedence) {
+    EXPECT_TRUE(eval("1 + 2 * 3 == 7", 0, 0));
+    EXPECT_TRUE(eval("(1 + 2) * 3 == 9", 0, 0));
+    EXPECT_TRUE(eval("10 - 4 - 3 == 3", 0, 0));
+    EXPECT_TRUE(eval("1 || 0 && 0", 0, 0));
+    EXPECT_TRUE(eval("!(new % 2) && -new < 0", 0, 4));
+    EXPECT_FALSE(eval("!new", 0, 4));
+}
+
+TEST(Predicate, DivisionByZeroIsZero) {
+    EXPECT_TRUE(eval("new / old == 0", 0, 10));
+    EXPECT_TRUE(eval("new % old == 0", 0, 10));
+}
+
+TEST(Predicate, RejectsMalformedExpressions) {
+    EXPECT_THROW(Predicate::compile(""), std::invalid_argument);
+    EXPECT_THROW(Predicate::compile("new >"), std::invalid_argument);
+    EXPECT_THROW(Predicate::compile("(new > 1"), std::invalid_argument);
+    EXPECT_THROW(Predicate::compile("value > 1"), std::invalid_argument);
+    EXPECT_THROW(Predicate::compile("new > 1 1"), std::invalid_argument);
+    EXPECT_THROW(Predicate::compile("new & 1"), std::invalid_argument);
+}
+
+TEST(Predicate, RejectsExpressionsDeeperThanTheStack) {
+    std::string deep = "new";
+    for (size_t i = 0; i < Predicate::MAX_STACK; ++i)
+        deep = "1 + (" + deep + ")";
+    EXPECT_THROW(Predicate::compile(deep), std::invalid_argument);
+}
+
+TEST(Predicate, RejectsNestingBeforeRecursingTooDeep) {
+    // Parentheses and unary operators need no stack slots, only parser recursion.
+    const size_t levels = 60000;
+    EXPECT_THROW(Predicate::compile(std::string(levels, '(') + "new" + std::string(levels, ')')), std::invalid_argument);
+    EXPECT_THROW(Predicate::compile(std::string(levels, '!') + "new"), std::invalid_argument);
+    EXPECT_THROW(Predicate::compile(std::string(levels, '-') + "new"), std::invalid_argument);
+
+    const size_t allowed = Predicate::MAX_NESTING;
+    EXPECT_NO_THROW(Predicate::compile(std::string(allowed, '(') + "new" + std::string(allowed, ')')));
+    try {
+        Predicate::compile(std::string(allowed + 1, '(') + "new" + std::string(allowed + 1, ')'));
+        FAIL() << "nesting past the limit was accepted";
+    } catch (const std::invalid_argument& e) {
+        EXPECT_NE(std::string(e.what()).find("nested too deeply"), std::string::npos) << e.what();
+    }
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "stack_table.hpp"
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+/** Stores a 64-bit word at a byte offset of a fake stack. */
+void put(std::vector<uint8_t>& stack, size_t offset, uint64_t value) {
+    std::memcpy(stack.data() + offset, &value, sizeof(value));
+}
+
+}
+
+TEST(StackTable, InternsIdenticalStacksOnce) {
+    StackTable stacks(16);
+    const std::vector<uint64_t> a = { 0x401000, 0x401100, 0x401200 };
+    const std::vector<uint64_t> b = { 0x401000, 0x401100 };
+
+    EXPECT_EQ(stacks.intern({}), 0u);
+    EXPECT_EQ(stacks.intern(a), 1u);
+    EXPECT_EQ(stacks.intern(b), 2u);
+    EXPECT_EQ(stacks.intern(a), 1u);
+    EXPECT_EQ(stacks.size(), 2u);
+    EXPECT_TRUE(std::ranges::equal(stacks.frames(2), b));
+    EXPECT_TRUE(stacks.frames(3).empty());
+
+    // Growing the table keeps every ID.
+    for (uint64_t i = 0; i < 100; ++i) {
+        const uint64_t frames[] = { 0x500000 + i, 0x401200 };
+        EXPECT_EQ(stacks.intern(frames), i + 3);
+    }
+    EXPECT_EQ(stacks.intern(a), 1u);
+    EXPECT_EQ(stacks.frames(50)[0], 0x500000u + 47);
+}
+
+TEST(StackTable, WalksTheFramePointerChain) {
+    // rsp = 0x7000; frames at 0x7010 and 0x7040, the outermost saving a null return address.
+    std::vector<uint8_t> stack(0x100, 0);
+    put(stack, 0x10, 0x7040);
+    put(stack, 0x18, 0x401234);
+    put(stack, 0x40, 0x7080);
+    put(stack, 0x48, 0x401500);
+    put(stack, 0x80, 0x70c0);
+    put(stack, 0x88, 0);
+
+    std::vector<uint64_t> frames(8);
+    ASSERT_EQ(walkFramePointers(0x401010, 0x7010, 0x7000, stack, frames), 3u);
+    EXPECT_EQ(frames[0], 0x401010u);
+    EXPECT_EQ(frames[1], 0x401234u);
+    EXPECT_EQ(frames[2], 0x401500u);
+
+    // The depth limits the walk.
+    std::vector<uint64_t> two(2);
+    EXPECT_EQ(walkFramePointers(0x401010, 0x7010, 0x7000, stack, two), 2u);
+
+    // A frame pointer that does not move up, or leaves the copy, ends the stack.
+    put(stack, 0x40, 0x7010);
+    EXPECT_EQ(walkFramePointers(0x401010, 0x7010, 0x7000, stack, frames), 3u);
+    EXPECT_EQ(walkFramePointers(0x401010, 0x1234, 0x7000, stack, frames), 1u);
+    EXPECT_EQ(walkFramePointers(0x401010, 0x7010, 0x7000, std::span(stack.data(), 0x20), frames), 2u);
+}
+
+TEST(StackTable, PrintsFramesAsFunctionOffsets) {
+    StackTable stacks;
+    const uint64_t frames[] = { 0x555555555010, 0x555555555134, 0x7ffff7829d90 };
+    stacks.intern(frames);
+    const std::vector<FunctionSymbol> functions = { { 0x1000, 0x40, "finish" }, { 0x1100, 0x80, "main" } };
+
+    std::ostringstream out;
+    printStacks(out, stacks, functions, 0x555555554000);
+    EXPECT_EQ(out.str(), "#1\n    finish+0x10\n    main+0x34\n    0x7ffff7829d90\n");
+}
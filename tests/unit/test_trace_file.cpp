@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+#include "trace_file.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+/** Event of variable varIndex in thread tid at the given time. */
+WatchEvent eventAt(uint64_t time, uint16_t varIndex, int32_t tid, uint64_t value) {
+    WatchEvent event{};
+    event.oldValue = value - 1;
+    event.newValue = value;
+    event.time = time;
+    event.pid = 100;
+    event.tid = tid;
+    event.varIndex = varIndex;
+    event.kind = EventKind::Write;
+    return event;
+}
+
+std::string tracePath(const std::string& name) {
+    return "/tmp/gwatch_test_" + name + ".gwt";
+}
+
+}
+
+TEST(TraceFile, RoundTripsRecordsAndVariables) {
+    const std::string path = tracePath("roundtrip");
+    auto type = std::make_shared<ValueType>();
+    type->kind = ValueType::Kind::Signed;
+    type->size = 4;
+    {
+        TraceFileSink sink(path, { "alpha", "config.limits.max_conns" }, { nullptr, type });
+        const WatchEvent events[] = { eventAt(10, 0, 7, 1), eventAt(20, 1, 8, 2) };
+        sink.consume(events);
+        sink.flush();
+    }
+
+    const TraceReader trace(path);
+    EXPECT_TRUE(trace.complete());
+    ASSERT_EQ(trace.names(), (std::vector<std::string>{ "alpha", "config.limits.max_conns" }));
+    EXPECT_EQ(trace.types()[0], nullptr);
+    ASSERT_NE(trace.types()[1], nullptr);
+    EXPECT_EQ(trace.types()[1]->kind, ValueType::Kind::Signed);
+    EXPECT_EQ(trace.types()[1]->size, 4u);
+
+    ASSERT_EQ(trace.chunks().size(), 1u);
+    const auto records = trace.records(0);
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[1].time, 20u);
+    EXPECT_EQ(records[1].varIndex, 1);
+    EXPECT_EQ(records[1].tid, 8);
+    EXPECT_EQ(records[1].pid, 100);
+    EXPECT_EQ(records[1].oldValue, 1u);
+    EXPECT_EQ(records[1].newValue, 2u);
+    EXPECT_EQ(records[1].kind, static_cast<uint8_t>(EventKind::Write));
+
+    // Only the records and the index are left after the data offset.
+    struct stat st{};
+    ASSERT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_EQ(static_cast<uint64_t>(st.st_size), trace.header().dataOffset + 2 * sizeof(TraceRecord) + sizeof(TraceChunk));
+    unlink(path.c_str());
+}
+
+TEST(TraceFile, SkipsChunksOutsideTheFilter) {
+    const std::string path = tracePath("chunks");
+    {
+        // Four chunks of 256 records: variable 0 throughout, variable 1 and thread 9 only in the third.
+        TraceFileSink sink(path, { "alpha", "beta" }, {}, 256);
+        std::vector<WatchEvent> events;
+        for (uint64_t i = 0; i < 1024; ++i) {
+            const bool third = i / 256 == 2;
+            events.push_back(eventAt(1000 + i, third && i % 2 ? 1 : 0, third && i % 2 ? 9 : 7, i + 1));
+        }
+        sink.consume(events);
+    }
+
+    const TraceReader trace(path);
+    ASSERT_EQ(trace.chunks().size(), 4u);
+    EXPECT_EQ(trace.chunks()[1].firstTime, 1256u);
+    EXPECT_EQ(trace.chunks()[1].lastTime, 1511u);
+
+    size_t count = 0;
+    TraceFilter byTime;
+    byTime.from = 1300;
+    byTime.to = 1309;
+    EXPECT_EQ(trace.forEach(byTime, [&](const TraceRecord&) { ++count; }), 1u);
+    EXPECT_EQ(count, 10u);
+
+    count = 0;
+    TraceFilter byVariable;
+    byVariable.varIndex = 1;
+    EXPECT_EQ(trace.forEach(byVariable, [&](const TraceRecord& record) { count += record.tid == 9; }), 1u);
+    EXPECT_EQ(count, 128u);
+
+    TraceFilter byThread;
+    byThread.tid = 9;
+    EXPECT_EQ(trace.forEach(byThread, [](const TraceRecord&) {}), 1u);
+    unlink(path.c_str());
+}
+
+TEST(TraceFile, SummarizesPerVariable) {
+    const std::string path = tracePath("summary");
+    {
+        TraceFileSink sink(path, { "alpha", "beta", "gamma" });
+        std::vector<WatchEvent> events = { eventAt(5, 0, 1, 1), eventAt(6, 0, 2, 2), eventAt(7, 1, 1, 3) };
+        events[1].kind = EventKind::Read;
+        sink.consume(events);
+    }
+
+    const TraceReader trace(path);
+    const std::vector<TraceSummary> summaries = summarizeTrace(trace, TraceFilter{});
+    ASSERT_EQ(summaries.size(), 3u);
+    EXPECT_EQ(summaries[0].writes, 1u);
+    EXPECT_EQ(summaries[0].reads, 1u);
+    EXPECT_EQ(summaries[0].threads, 2u);
+    EXPECT_EQ(summaries[0].firstTime, 5u);
+    EXPECT_EQ(summaries[0].lastTime, 6u);
+    EXPECT_EQ(summaries[1].total(), 1u);
+    EXPECT_EQ(summaries[2].total(), 0u);
+    unlink(path.c_str());
+}
+
+TEST(TraceFile, RebuildsTheIndexOfAnInterruptedRecording) {
+    const std::string path = tracePath("interrupted");
+    const std::string copy = tracePath("interrupted_copy");
+    {
+        TraceFileSink sink(path, { "alpha" }, {}, 256);
+        std::vector<WatchEvent> events;
+        for (uint64_t i = 0; i < 300; ++i)
+            events.push_back(eventAt(i + 1, 0, 7, i + 1));
+        sink.consume(events);
+        sink.flush();
+        // Snapshot the file as a crash would leave it: records counted, no index yet.
+        ASSERT_EQ(std::system(("cp " + path + " " + copy).c_str()), 0);
+    }
+
+    const TraceReader trace(copy);
+    EXPECT_FALSE(trace.complete());
+    ASSERT_EQ(trace.chunks().size(), 2u);
+    EXPECT_EQ(trace.chunks()[0].records, 256u);
+    EXPECT_EQ(trace.chunks()[1].records, 44u);
+    EXPECT_EQ(trace.records(1).back().newValue, 300u);
+    unlink(path.c_str());
+    unlink(copy.c_str());
+}
+
+TEST(TraceFile, RejectsAChunkIndexThatDoesNotTileTheRecords) {
+    const std::string path = tracePath("corrupt_index");
+    {
+        TraceFileSink sink(path, { "alpha" }, {}, 256);
+        std::vector<WatchEvent> events;
+        for (uint64_t i = 0; i < 300; ++i)
+            events.push_back(eventAt(i + 1, 0, 7, i + 1));
+        sink.consume(events);
+    }
+
+    // Same total, split [1, 299]: chunk 1 would be read at record 256 and run past the data.
+    TraceHeader header{};
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    ASSERT_EQ(header.chunkCount, 2u);
+    TraceChunk chunks[2];
+    file.seekg(static_cast<std::streamoff>(header.indexOffset));
+    file.read(reinterpret_cast<char*>(chunks), sizeof(chunks));
+    chunks[0].records = 1;
+    chunks[1].records = 299;
+    file.seekp(static_cast<std::streamoff>(header.indexOffset));
+    file.write(reinterpret_cast<const char*>(chunks), sizeof(chunks));
+    file.close();
+
+    try {
+        const TraceReader trace(path);
+        FAIL() << "the corrupt index was accepted";
+    } catch (const std::runtime_error& e) {
+        EXPECT_NE(std::string(e.what()).find("corrupt chunk index"), std::string::npos) << e.what();
+    }
+    unlink(path.c_str());
+}
+
+TEST(TraceFile, RejectsOtherFilesAndBadChunkSizes) {
+    EXPECT_THROW(TraceReader("/proc/self/status"), std::runtime_error);
+    EXPECT_THROW(TraceReader("/nonexistent/trace.gwt"), std::runtime_error);
+    EXPECT_THROW(TraceFileSink(tracePath("bad"), { "alpha" }, {}, 100), std::invalid_argument);
+}
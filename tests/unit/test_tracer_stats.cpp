@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include "tracer_stats.hpp"
+
+#include <sstream>
+#include <string>
+
+TEST(TracerStats, BucketsValuesByPowersOfTwo) {
+    LogHistogram histogram;
+    EXPECT_EQ(histogram.quantile(0.5), 0u);
+
+    for (uint64_t value = 1; value <= 100; ++value)
+        histogram.record(value);
+    EXPECT_EQ(histogram.count(), 100u);
+    EXPECT_DOUBLE_EQ(histogram.mean(), 50.5);
+
+    // The median, 50, falls in [32, 64); the top quantiles are capped by the maximum.
+    EXPECT_EQ(histogram.quantile(0.5), 63u);
+    EXPECT_EQ(histogram.quantile(0.99), 100u);
+    EXPECT_EQ(histogram.quantile(0), 1u);
+
+    std::ostringstream json;
+    histogram.writeJson(json);
+    EXPECT_NE(json.str().find("\"count\": 100, \"min\": 1, \"mean\": 50.5, \"p50\": 63"), std::string::npos) << json.str();
+    EXPECT_NE(json.str().find("{\"le\": 1, \"count\": 1}, {\"le\": 3, \"count\": 2}"), std::string::npos) << json.str();
+    EXPECT_NE(json.str().find("{\"le\": 127, \"count\": 37}]"), std::string::npos) << json.str();
+}
+
+TEST(TracerStats, WritesTotalsAndRates) {
+    TracerStats stats("ptrace", 1'000'000'000);
+    stats.traps = 500;
+    stats.stoppedNanos.record(4000);
+    stats.ptracePerTrap.record(3);
+
+    TracerStats::Totals totals;
+    totals.stops = 510;
+    totals.accesses = 500;
+    totals.ptraceRequests = 1600;
+
+    std::ostringstream json;
+    stats.writeJson(json, 3'000'000'000, totals);
+    const std::string text = json.str();
+    EXPECT_NE(text.find("\"backend\": \"ptrace\""), std::string::npos) << text;
+    EXPECT_NE(text.find("\"elapsed_seconds\": 2.000"), std::string::npos) << text;
+    EXPECT_NE(text.find("\"stops\": 510"), std::string::npos) << text;
+    EXPECT_NE(text.find("\"traps_per_second\": 250.000"), std::string::npos) << text;
+    EXPECT_NE(text.find("\"stopped_ns_per_trap\": {\"count\": 1, \"min\": 4000"), std::string::npos) << text;
+    EXPECT_NE(text.find("\"memory_read_ns\": {\"count\": 0, \"min\": 0"), std::string::npos) << text;
+    EXPECT_EQ(text.back(), '\n');
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include "gwatch.hpp"
+#include "predicate.hpp"
+
+#include <sys/wait.h>
+
+#include <csignal>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+TEST(WatchSession, ResolvesAndRemovesWatches) {
+    WatchSession session((fs::current_path() / "testprog").string());
+
+    const size_t second = session.addWatch(VariableSpec{ .symbol = "second_var", .mode = WatchMode::Write });
+    EXPECT_EQ(session.watch(second).size, 4u);
+    EXPECT_NE(session.watch(second).symbolOffset, 0u);
+
+    // A failing batch adds nothing.
+    const std::vector<VariableSpec> specs = { { .symbol = "small_var" }, { .symbol = "no_such_var" } };
+    EXPECT_THROW(session.addWatches(specs), std::invalid_argument);
+    EXPECT_EQ(session.variables().size(), 1u);
+
+    // Ranges show up as their chunks, in the order events index them.
+    const size_t history = session.addWatch(VariableSpec{ .symbol = "history", .range = true });
+    const size_t field = session.addWatch(VariableSpec{ .symbol = "config.limits.max_conns" });
+    EXPECT_EQ(session.watch(field).size, 4u);
+    ASSERT_EQ(session.variables().size(), 6u);
+    EXPECT_EQ(session.variables()[2].name, "history+8");
+
+    session.removeWatch(history);
+    EXPECT_THROW(session.removeWatch(history), std::invalid_argument);
+    EXPECT_THROW((void)session.watch(history), std::invalid_argument);
+    ASSERT_EQ(session.variables().size(), 2u);
+    EXPECT_EQ(session.variables()[1].name, "config.limits.max_conns");
+}
+
+TEST(WatchSession, RejectsWatchesTheBackendCannotHonour) {
+    const std::string program = (fs::current_path() / "testprog").string();
+    const auto condition = std::make_shared<const Predicate>(Predicate::compile("new > 1"));
+
+    // perf has no dynamic linker hook, reads no values and has no per-thread instances.
+    WatchSession perf(program, {}, BackendKind::Perf);
+    const VariableSpec library{ .symbol = "linked_counter", .library = "libgwatch_testlib.so" };
+    EXPECT_THROW(perf.addWatch(library), std::invalid_argument);
+    EXPECT_THROW(perf.addWatch(VariableSpec{ .symbol = "second_var", .condition = condition }), std::invalid_argument);
+    WatchSession perfThreads((fs::current_path() / "testprog_threads").string(), {}, BackendKind::Perf);
+    EXPECT_THROW(perfThreads.addWatch(VariableSpec{ .symbol = "tls_counter" }), std::invalid_argument);
+
+    WatchSession ptrace(program);
+    EXPECT_THROW(ptrace.addWatch(VariableSpec{ .symbol = "second_var", .mode = WatchMode::Execute, .condition = condition }),
+                 std::invalid_argument);
+    VariableSpec libraryRange = library;
+    libraryRange.range = true;
+    EXPECT_THROW(ptrace.addWatch(libraryRange), std::invalid_argument);
+    EXPECT_TRUE(ptrace.variables().empty());
+}
+
+TEST(WatchSession, RejectsOptionsTheBackendCannotHonour) {
+    const std::string program = (fs::current_path() / "testprog").string();
+    const auto rejects = [&](BackendKind backend, TracerOptions options) {
+        WatchSession session(program, {}, backend, std::move(options));
+        session.addWatch(VariableSpec{ .symbol = "second_var", .mode = WatchMode::Write });
+        EXPECT_THROW(session.run([](std::span<const WatchEvent>) {}), std::invalid_argument);
+    };
+
+    rejects(BackendKind::Perf, TracerOptions{ .followChildren = true });
+    rejects(BackendKind::Perf, TracerOptions{ .scopeFunctions = { "main" } });
+    rejects(BackendKind::Perf, TracerOptions{ .controlPath = "gwatch_rejected.sock" });
+    rejects(BackendKind::Perf, TracerOptions{ .coalescePause = 1000, .coalesce = true });
+    rejects(BackendKind::Ptrace, TracerOptions{ .coalescePause = 1000 });
+    rejects(BackendKind::Ptrace, TracerOptions{ .coalesceEvents = 16 });
+    rejects(BackendKind::Ptrace, TracerOptions{ .profileTop = 10, .recordPath = "gwatch_rejected.gwt" });
+}
+
+TEST(WatchSession, DeliversTypedEventsToACallback) {
+    WatchSession session((fs::current_path() / "testprog").string());
+    session.addWatch(VariableSpec{ .symbol = "second_var", .mode = WatchMode::Write });
+    session.addWatch(VariableSpec{ .symbol = "small_var", .mode = WatchMode::Write });
+
+    std::vector<WatchEvent> events;
+    session.run([&](std::span<const WatchEvent> batch) { events.insert(events.end(), batch.begin(), batch.end()); });
+
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(events[0].varIndex, 0);
+    EXPECT_EQ(events[0].kind, EventKind::Write);
+    EXPECT_EQ(events[0].oldValue, 0u);
+    EXPECT_EQ(events[0].newValue, 42u);
+    EXPECT_EQ(events[1].varIndex, 1);
+    EXPECT_EQ(events[1].newValue, 300u);
+    EXPECT_EQ(events[1].tid, events[1].pid);
+}
+
+TEST(WatchSession, StopsFromTheCallback) {
+    WatchSession session((fs::current_path() / "testprog_service").string());
+    session.addWatch(VariableSpec{ .symbol = "service_var", .mode = WatchMode::Write });
+
+    size_t seen = 0;
+    pid_t target = 0;
+    session.run([&](std::span<const WatchEvent> batch) {
+        target = batch.front().pid;
+        seen += batch.size();
+        if (seen >= 5)
+            session.stop();
+    });
+    EXPECT_GE(seen, 5u);
+
+    // The detached target keeps running; it is still our child to reap.
+    ASSERT_GT(target, 0);
+    int status = 0;
+    EXPECT_EQ(waitpid(target, &status, WNOHANG), 0);
+    kill(target, SIGKILL);
+    EXPECT_EQ(waitpid(target, &status, 0), target);
+    EXPECT_TRUE(WIFSIGNALED(status));
+}